@@ -45,61 +45,83 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "hsa_api_trace.h"
+#include "core/inc/hsa_internal.h"
 
 static const ApiTable* HsaApiTable;
 
+// Nonzero while any table entry differs from its HSA:: default. Until then
+// calls go straight to HSA:: instead of through the table. Inline fast paths
+// in applications read it through hsa_amd_api_table_state.
+static uint32_t HsaApiIntercepted = 0;
+
+// Entries are replaced with __atomic_store_n while other threads may call
+// through them, load them to match.
+#define HSA_TABLE_CALL(name, ...)                                            \
+  (__builtin_expect(__atomic_load_n(&HsaApiIntercepted, __ATOMIC_RELAXED), 0) \
+       ? __atomic_load_n(&HsaApiTable->name##_fn, __ATOMIC_ACQUIRE)(         \
+             __VA_ARGS__)                                                     \
+       : HSA::name(__VA_ARGS__))
+
 void hsa_table_interface_init(const ApiTable* Table) { HsaApiTable = Table; }
 
 const ApiTable* hsa_table_interface_get_table() { return HsaApiTable; }
 
+void hsa_table_interface_set_intercepted(bool intercepted) {
+  __atomic_store_n(&HsaApiIntercepted, uint32_t(intercepted), __ATOMIC_RELEASE);
+}
+
+const uint32_t* hsa_table_interface_get_intercepted() {
+  return &HsaApiIntercepted;
+}
+
 // Pass through stub functions
-hsa_status_t HSA_API hsa_init() { return HsaApiTable->hsa_init_fn(); }
+hsa_status_t HSA_API hsa_init() { return HSA_TABLE_CALL(hsa_init); }
 
-hsa_status_t HSA_API hsa_shut_down() { return HsaApiTable->hsa_shut_down_fn(); }
+hsa_status_t HSA_API hsa_shut_down() { return HSA_TABLE_CALL(hsa_shut_down); }
 
 hsa_status_t HSA_API
     hsa_system_get_info(hsa_system_info_t attribute, void* value) {
-  return HsaApiTable->hsa_system_get_info_fn(attribute, value);
+  return HSA_TABLE_CALL(hsa_system_get_info, attribute, value);
 }
 
 hsa_status_t HSA_API
     hsa_system_extension_supported(uint16_t extension, uint16_t version_major,
                                    uint16_t version_minor, bool* result) {
-  return HsaApiTable->hsa_system_extension_supported_fn(
-      extension, version_major, version_minor, result);
+  return HSA_TABLE_CALL(hsa_system_extension_supported, extension,
+                        version_major, version_minor, result);
 }
 
 hsa_status_t HSA_API
     hsa_system_get_extension_table(uint16_t extension, uint16_t version_major,
                                    uint16_t version_minor, void* table) {
-  return HsaApiTable->hsa_system_get_extension_table_fn(
-      extension, version_major, version_minor, table);
+  return HSA_TABLE_CALL(hsa_system_get_extension_table, extension,
+                        version_major, version_minor, table);
 }
 
 hsa_status_t HSA_API
     hsa_iterate_agents(hsa_status_t (*callback)(hsa_agent_t agent, void* data),
                        void* data) {
-  return HsaApiTable->hsa_iterate_agents_fn(callback, data);
+  return HSA_TABLE_CALL(hsa_iterate_agents, callback, data);
 }
 
 hsa_status_t HSA_API hsa_agent_get_info(hsa_agent_t agent,
                                         hsa_agent_info_t attribute,
                                         void* value) {
-  return HsaApiTable->hsa_agent_get_info_fn(agent, attribute, value);
+  return HSA_TABLE_CALL(hsa_agent_get_info, agent, attribute, value);
 }
 
 hsa_status_t HSA_API hsa_agent_get_exception_policies(hsa_agent_t agent,
                                                       hsa_profile_t profile,
                                                       uint16_t* mask) {
-  return HsaApiTable->hsa_agent_get_exception_policies_fn(agent, profile, mask);
+  return HSA_TABLE_CALL(hsa_agent_get_exception_policies, agent, profile, mask);
 }
 
 hsa_status_t HSA_API
     hsa_agent_extension_supported(uint16_t extension, hsa_agent_t agent,
                                   uint16_t version_major,
                                   uint16_t version_minor, bool* result) {
-  return HsaApiTable->hsa_agent_extension_supported_fn(
-      extension, agent, version_major, version_minor, result);
+  return HSA_TABLE_CALL(hsa_agent_extension_supported, extension, agent,
+                        version_major, version_minor, result);
 }
 
 hsa_status_t HSA_API
@@ -108,176 +130,175 @@ hsa_status_t HSA_API
                                       void* data),
                      void* data, uint32_t private_segment_size,
                      uint32_t group_segment_size, hsa_queue_t** queue) {
-  return HsaApiTable->hsa_queue_create_fn(agent, size, type, callback, data,
-                                          private_segment_size,
-                                          group_segment_size, queue);
+  return HSA_TABLE_CALL(hsa_queue_create, agent, size, type, callback, data,
+                        private_segment_size, group_segment_size, queue);
 }
 
 hsa_status_t HSA_API
     hsa_soft_queue_create(hsa_region_t region, uint32_t size,
                           hsa_queue_type_t type, uint32_t features,
                           hsa_signal_t completion_signal, hsa_queue_t** queue) {
-  return HsaApiTable->hsa_soft_queue_create_fn(region, size, type, features,
-                                               completion_signal, queue);
+  return HSA_TABLE_CALL(hsa_soft_queue_create, region, size, type, features,
+                        completion_signal, queue);
 }
 
 hsa_status_t HSA_API hsa_queue_destroy(hsa_queue_t* queue) {
-  return HsaApiTable->hsa_queue_destroy_fn(queue);
+  return HSA_TABLE_CALL(hsa_queue_destroy, queue);
 }
 
 hsa_status_t HSA_API hsa_queue_inactivate(hsa_queue_t* queue) {
-  return HsaApiTable->hsa_queue_inactivate_fn(queue);
+  return HSA_TABLE_CALL(hsa_queue_inactivate, queue);
 }
 
 uint64_t HSA_API hsa_queue_load_read_index_acquire(const hsa_queue_t* queue) {
-  return HsaApiTable->hsa_queue_load_read_index_acquire_fn(queue);
+  return HSA_TABLE_CALL(hsa_queue_load_read_index_acquire, queue);
 }
 
 uint64_t HSA_API hsa_queue_load_read_index_relaxed(const hsa_queue_t* queue) {
-  return HsaApiTable->hsa_queue_load_read_index_relaxed_fn(queue);
+  return HSA_TABLE_CALL(hsa_queue_load_read_index_relaxed, queue);
 }
 
 uint64_t HSA_API hsa_queue_load_write_index_acquire(const hsa_queue_t* queue) {
-  return HsaApiTable->hsa_queue_load_write_index_acquire_fn(queue);
+  return HSA_TABLE_CALL(hsa_queue_load_write_index_acquire, queue);
 }
 
 uint64_t HSA_API hsa_queue_load_write_index_relaxed(const hsa_queue_t* queue) {
-  return HsaApiTable->hsa_queue_load_write_index_relaxed_fn(queue);
+  return HSA_TABLE_CALL(hsa_queue_load_write_index_relaxed, queue);
 }
 
 void HSA_API hsa_queue_store_write_index_relaxed(const hsa_queue_t* queue,
                                                  uint64_t value) {
-  return HsaApiTable->hsa_queue_store_write_index_relaxed_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_store_write_index_relaxed, queue, value);
 }
 
 void HSA_API hsa_queue_store_write_index_release(const hsa_queue_t* queue,
                                                  uint64_t value) {
-  return HsaApiTable->hsa_queue_store_write_index_release_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_store_write_index_release, queue, value);
 }
 
 uint64_t HSA_API hsa_queue_cas_write_index_acq_rel(const hsa_queue_t* queue,
                                                    uint64_t expected,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_cas_write_index_acq_rel_fn(queue, expected,
-                                                           value);
+  return HSA_TABLE_CALL(hsa_queue_cas_write_index_acq_rel, queue, expected,
+                        value);
 }
 
 uint64_t HSA_API hsa_queue_cas_write_index_acquire(const hsa_queue_t* queue,
                                                    uint64_t expected,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_cas_write_index_acquire_fn(queue, expected,
-                                                           value);
+  return HSA_TABLE_CALL(hsa_queue_cas_write_index_acquire, queue, expected,
+                        value);
 }
 
 uint64_t HSA_API hsa_queue_cas_write_index_relaxed(const hsa_queue_t* queue,
                                                    uint64_t expected,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_cas_write_index_relaxed_fn(queue, expected,
-                                                           value);
+  return HSA_TABLE_CALL(hsa_queue_cas_write_index_relaxed, queue, expected,
+                        value);
 }
 
 uint64_t HSA_API hsa_queue_cas_write_index_release(const hsa_queue_t* queue,
                                                    uint64_t expected,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_cas_write_index_release_fn(queue, expected,
-                                                           value);
+  return HSA_TABLE_CALL(hsa_queue_cas_write_index_release, queue, expected,
+                        value);
 }
 
 uint64_t HSA_API hsa_queue_add_write_index_acq_rel(const hsa_queue_t* queue,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_add_write_index_acq_rel_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_add_write_index_acq_rel, queue, value);
 }
 
 uint64_t HSA_API hsa_queue_add_write_index_acquire(const hsa_queue_t* queue,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_add_write_index_acquire_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_add_write_index_acquire, queue, value);
 }
 
 uint64_t HSA_API hsa_queue_add_write_index_relaxed(const hsa_queue_t* queue,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_add_write_index_relaxed_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_add_write_index_relaxed, queue, value);
 }
 
 uint64_t HSA_API hsa_queue_add_write_index_release(const hsa_queue_t* queue,
                                                    uint64_t value) {
-  return HsaApiTable->hsa_queue_add_write_index_release_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_add_write_index_release, queue, value);
 }
 
 void HSA_API hsa_queue_store_read_index_relaxed(const hsa_queue_t* queue,
                                                 uint64_t value) {
-  return HsaApiTable->hsa_queue_store_read_index_relaxed_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_store_read_index_relaxed, queue, value);
 }
 
 void HSA_API hsa_queue_store_read_index_release(const hsa_queue_t* queue,
                                                 uint64_t value) {
-  return HsaApiTable->hsa_queue_store_read_index_release_fn(queue, value);
+  return HSA_TABLE_CALL(hsa_queue_store_read_index_release, queue, value);
 }
 
 hsa_status_t HSA_API hsa_agent_iterate_regions(
     hsa_agent_t agent,
     hsa_status_t (*callback)(hsa_region_t region, void* data), void* data) {
-  return HsaApiTable->hsa_agent_iterate_regions_fn(agent, callback, data);
+  return HSA_TABLE_CALL(hsa_agent_iterate_regions, agent, callback, data);
 }
 
 hsa_status_t HSA_API hsa_region_get_info(hsa_region_t region,
                                          hsa_region_info_t attribute,
                                          void* value) {
-  return HsaApiTable->hsa_region_get_info_fn(region, attribute, value);
+  return HSA_TABLE_CALL(hsa_region_get_info, region, attribute, value);
 }
 
 hsa_status_t HSA_API hsa_memory_register(void* address, size_t size) {
-  return HsaApiTable->hsa_memory_register_fn(address, size);
+  return HSA_TABLE_CALL(hsa_memory_register, address, size);
 }
 
 hsa_status_t HSA_API hsa_memory_deregister(void* address, size_t size) {
-  return HsaApiTable->hsa_memory_deregister_fn(address, size);
+  return HSA_TABLE_CALL(hsa_memory_deregister, address, size);
 }
 
 hsa_status_t HSA_API
     hsa_memory_allocate(hsa_region_t region, size_t size, void** ptr) {
-  return HsaApiTable->hsa_memory_allocate_fn(region, size, ptr);
+  return HSA_TABLE_CALL(hsa_memory_allocate, region, size, ptr);
 }
 
 hsa_status_t HSA_API hsa_memory_free(void* ptr) {
-  return HsaApiTable->hsa_memory_free_fn(ptr);
+  return HSA_TABLE_CALL(hsa_memory_free, ptr);
 }
 
 hsa_status_t HSA_API hsa_memory_copy(void* dst, const void* src, size_t size) {
-  return HsaApiTable->hsa_memory_copy_fn(dst, src, size);
+  return HSA_TABLE_CALL(hsa_memory_copy, dst, src, size);
 }
 
 hsa_status_t HSA_API hsa_memory_assign_agent(void* ptr, hsa_agent_t agent,
                                              hsa_access_permission_t access) {
-  return HsaApiTable->hsa_memory_assign_agent_fn(ptr, agent, access);
+  return HSA_TABLE_CALL(hsa_memory_assign_agent, ptr, agent, access);
 }
 
 hsa_status_t HSA_API
     hsa_signal_create(hsa_signal_value_t initial_value, uint32_t num_consumers,
                       const hsa_agent_t* consumers, hsa_signal_t* signal) {
-  return HsaApiTable->hsa_signal_create_fn(initial_value, num_consumers,
-                                           consumers, signal);
+  return HSA_TABLE_CALL(hsa_signal_create, initial_value, num_consumers,
+                        consumers, signal);
 }
 
 hsa_status_t HSA_API hsa_signal_destroy(hsa_signal_t signal) {
-  return HsaApiTable->hsa_signal_destroy_fn(signal);
+  return HSA_TABLE_CALL(hsa_signal_destroy, signal);
 }
 
 hsa_signal_value_t HSA_API hsa_signal_load_relaxed(hsa_signal_t signal) {
-  return HsaApiTable->hsa_signal_load_relaxed_fn(signal);
+  return HSA_TABLE_CALL(hsa_signal_load_relaxed, signal);
 }
 
 hsa_signal_value_t HSA_API hsa_signal_load_acquire(hsa_signal_t signal) {
-  return HsaApiTable->hsa_signal_load_acquire_fn(signal);
+  return HSA_TABLE_CALL(hsa_signal_load_acquire, signal);
 }
 
 void HSA_API
     hsa_signal_store_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_store_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_store_relaxed, signal, value);
 }
 
 void HSA_API
     hsa_signal_store_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_store_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_store_release, signal, value);
 }
 
 hsa_signal_value_t HSA_API
@@ -286,8 +307,8 @@ hsa_signal_value_t HSA_API
                             hsa_signal_value_t compare_value,
                             uint64_t timeout_hint,
                             hsa_wait_state_t wait_expectancy_hint) {
-  return HsaApiTable->hsa_signal_wait_relaxed_fn(
-      signal, condition, compare_value, timeout_hint, wait_expectancy_hint);
+  return HSA_TABLE_CALL(hsa_signal_wait_relaxed, signal, condition,
+                        compare_value, timeout_hint, wait_expectancy_hint);
 }
 
 hsa_signal_value_t HSA_API
@@ -296,166 +317,166 @@ hsa_signal_value_t HSA_API
                             hsa_signal_value_t compare_value,
                             uint64_t timeout_hint,
                             hsa_wait_state_t wait_expectancy_hint) {
-  return HsaApiTable->hsa_signal_wait_acquire_fn(
-      signal, condition, compare_value, timeout_hint, wait_expectancy_hint);
+  return HSA_TABLE_CALL(hsa_signal_wait_acquire, signal, condition,
+                        compare_value, timeout_hint, wait_expectancy_hint);
 }
 
 void HSA_API
     hsa_signal_and_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_and_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_and_relaxed, signal, value);
 }
 
 void HSA_API
     hsa_signal_and_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_and_acquire_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_and_acquire, signal, value);
 }
 
 void HSA_API
     hsa_signal_and_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_and_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_and_release, signal, value);
 }
 
 void HSA_API
     hsa_signal_and_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_and_acq_rel_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_and_acq_rel, signal, value);
 }
 
 void HSA_API
     hsa_signal_or_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_or_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_or_relaxed, signal, value);
 }
 
 void HSA_API
     hsa_signal_or_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_or_acquire_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_or_acquire, signal, value);
 }
 
 void HSA_API
     hsa_signal_or_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_or_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_or_release, signal, value);
 }
 
 void HSA_API
     hsa_signal_or_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_or_acq_rel_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_or_acq_rel, signal, value);
 }
 
 void HSA_API
     hsa_signal_xor_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_xor_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_xor_relaxed, signal, value);
 }
 
 void HSA_API
     hsa_signal_xor_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_xor_acquire_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_xor_acquire, signal, value);
 }
 
 void HSA_API
     hsa_signal_xor_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_xor_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_xor_release, signal, value);
 }
 
 void HSA_API
     hsa_signal_xor_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_xor_acq_rel_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_xor_acq_rel, signal, value);
 }
 
 void HSA_API
     hsa_signal_add_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_add_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_add_relaxed, signal, value);
 }
 
 void HSA_API
     hsa_signal_add_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_add_acquire_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_add_acquire, signal, value);
 }
 
 void HSA_API
     hsa_signal_add_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_add_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_add_release, signal, value);
 }
 
 void HSA_API
     hsa_signal_add_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_add_acq_rel_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_add_acq_rel, signal, value);
 }
 
 void HSA_API
     hsa_signal_subtract_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_subtract_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_subtract_relaxed, signal, value);
 }
 
 void HSA_API
     hsa_signal_subtract_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_subtract_acquire_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_subtract_acquire, signal, value);
 }
 
 void HSA_API
     hsa_signal_subtract_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_subtract_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_subtract_release, signal, value);
 }
 
 void HSA_API
     hsa_signal_subtract_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_subtract_acq_rel_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_subtract_acq_rel, signal, value);
 }
 
 hsa_signal_value_t HSA_API
     hsa_signal_exchange_relaxed(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_exchange_relaxed_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_exchange_relaxed, signal, value);
 }
 
 hsa_signal_value_t HSA_API
     hsa_signal_exchange_acquire(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_exchange_acquire_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_exchange_acquire, signal, value);
 }
 
 hsa_signal_value_t HSA_API
     hsa_signal_exchange_release(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_exchange_release_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_exchange_release, signal, value);
 }
 
 hsa_signal_value_t HSA_API
     hsa_signal_exchange_acq_rel(hsa_signal_t signal, hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_exchange_acq_rel_fn(signal, value);
+  return HSA_TABLE_CALL(hsa_signal_exchange_acq_rel, signal, value);
 }
 
 hsa_signal_value_t HSA_API hsa_signal_cas_relaxed(hsa_signal_t signal,
                                                   hsa_signal_value_t expected,
                                                   hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_cas_relaxed_fn(signal, expected, value);
+  return HSA_TABLE_CALL(hsa_signal_cas_relaxed, signal, expected, value);
 }
 
 hsa_signal_value_t HSA_API hsa_signal_cas_acquire(hsa_signal_t signal,
                                                   hsa_signal_value_t expected,
                                                   hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_cas_acquire_fn(signal, expected, value);
+  return HSA_TABLE_CALL(hsa_signal_cas_acquire, signal, expected, value);
 }
 
 hsa_signal_value_t HSA_API hsa_signal_cas_release(hsa_signal_t signal,
                                                   hsa_signal_value_t expected,
                                                   hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_cas_release_fn(signal, expected, value);
+  return HSA_TABLE_CALL(hsa_signal_cas_release, signal, expected, value);
 }
 
 hsa_signal_value_t HSA_API hsa_signal_cas_acq_rel(hsa_signal_t signal,
                                                   hsa_signal_value_t expected,
                                                   hsa_signal_value_t value) {
-  return HsaApiTable->hsa_signal_cas_acq_rel_fn(signal, expected, value);
+  return HSA_TABLE_CALL(hsa_signal_cas_acq_rel, signal, expected, value);
 }
 
 hsa_status_t hsa_isa_from_name(const char* name, hsa_isa_t* isa) {
-  return HsaApiTable->hsa_isa_from_name_fn(name, isa);
+  return HSA_TABLE_CALL(hsa_isa_from_name, name, isa);
 }
 
 hsa_status_t HSA_API hsa_isa_get_info(hsa_isa_t isa, hsa_isa_info_t attribute,
                                       uint32_t index, void* value) {
-  return HsaApiTable->hsa_isa_get_info_fn(isa, attribute, index, value);
+  return HSA_TABLE_CALL(hsa_isa_get_info, isa, attribute, index, value);
 }
 
 hsa_status_t hsa_isa_compatible(hsa_isa_t code_object_isa, hsa_isa_t agent_isa,
                                 bool* result) {
-  return HsaApiTable->hsa_isa_compatible_fn(code_object_isa, agent_isa, result);
+  return HSA_TABLE_CALL(hsa_isa_compatible, code_object_isa, agent_isa, result);
 }
 
 hsa_status_t HSA_API hsa_code_object_serialize(
@@ -464,9 +485,9 @@ hsa_status_t HSA_API hsa_code_object_serialize(
                                    void** address),
     hsa_callback_data_t callback_data, const char* options,
     void** serialized_code_object, size_t* serialized_code_object_size) {
-  return HsaApiTable->hsa_code_object_serialize_fn(
-      code_object, alloc_callback, callback_data, options,
-      serialized_code_object, serialized_code_object_size);
+  return HSA_TABLE_CALL(hsa_code_object_serialize, code_object, alloc_callback,
+                        callback_data, options, serialized_code_object,
+                        serialized_code_object_size);
 }
 
 hsa_status_t HSA_API
@@ -474,34 +495,33 @@ hsa_status_t HSA_API
                                 size_t serialized_code_object_size,
                                 const char* options,
                                 hsa_code_object_t* code_object) {
-  return HsaApiTable->hsa_code_object_deserialize_fn(
-      serialized_code_object, serialized_code_object_size, options,
-      code_object);
+  return HSA_TABLE_CALL(hsa_code_object_deserialize, serialized_code_object,
+                        serialized_code_object_size, options, code_object);
 }
 
 hsa_status_t HSA_API hsa_code_object_destroy(hsa_code_object_t code_object) {
-  return HsaApiTable->hsa_code_object_destroy_fn(code_object);
+  return HSA_TABLE_CALL(hsa_code_object_destroy, code_object);
 }
 
 hsa_status_t HSA_API hsa_code_object_get_info(hsa_code_object_t code_object,
                                               hsa_code_object_info_t attribute,
                                               void* value) {
-  return HsaApiTable->hsa_code_object_get_info_fn(code_object, attribute,
-                                                  value);
+  return HSA_TABLE_CALL(hsa_code_object_get_info, code_object, attribute,
+                        value);
 }
 
 hsa_status_t HSA_API hsa_code_object_get_symbol(hsa_code_object_t code_object,
                                                 const char* symbol_name,
                                                 hsa_code_symbol_t* symbol) {
-  return HsaApiTable->hsa_code_object_get_symbol_fn(code_object, symbol_name,
-                                                    symbol);
+  return HSA_TABLE_CALL(hsa_code_object_get_symbol, code_object, symbol_name,
+                        symbol);
 }
 
 hsa_status_t HSA_API hsa_code_symbol_get_info(hsa_code_symbol_t code_symbol,
                                               hsa_code_symbol_info_t attribute,
                                               void* value) {
-  return HsaApiTable->hsa_code_symbol_get_info_fn(code_symbol, attribute,
-                                                  value);
+  return HSA_TABLE_CALL(hsa_code_symbol_get_info, code_symbol, attribute,
+                        value);
 }
 
 hsa_status_t HSA_API hsa_code_object_iterate_symbols(
@@ -509,20 +529,20 @@ hsa_status_t HSA_API hsa_code_object_iterate_symbols(
     hsa_status_t (*callback)(hsa_code_object_t code_object,
                              hsa_code_symbol_t symbol, void* data),
     void* data) {
-  return HsaApiTable->hsa_code_object_iterate_symbols_fn(code_object, callback,
-                                                         data);
+  return HSA_TABLE_CALL(hsa_code_object_iterate_symbols, code_object, callback,
+                        data);
 }
 
 hsa_status_t HSA_API
     hsa_executable_create(hsa_profile_t profile,
                           hsa_executable_state_t executable_state,
                           const char* options, hsa_executable_t* executable) {
-  return HsaApiTable->hsa_executable_create_fn(profile, executable_state,
-                                               options, executable);
+  return HSA_TABLE_CALL(hsa_executable_create, profile, executable_state,
+                        options, executable);
 }
 
 hsa_status_t HSA_API hsa_executable_destroy(hsa_executable_t executable) {
-  return HsaApiTable->hsa_executable_destroy_fn(executable);
+  return HSA_TABLE_CALL(hsa_executable_destroy, executable);
 }
 
 hsa_status_t HSA_API
@@ -530,27 +550,27 @@ hsa_status_t HSA_API
                                     hsa_agent_t agent,
                                     hsa_code_object_t code_object,
                                     const char* options) {
-  return HsaApiTable->hsa_executable_load_code_object_fn(executable, agent,
-                                                         code_object, options);
+  return HSA_TABLE_CALL(hsa_executable_load_code_object, executable, agent,
+                        code_object, options);
 }
 
 hsa_status_t HSA_API
     hsa_executable_freeze(hsa_executable_t executable, const char* options) {
-  return HsaApiTable->hsa_executable_freeze_fn(executable, options);
+  return HSA_TABLE_CALL(hsa_executable_freeze, executable, options);
 }
 
 hsa_status_t HSA_API hsa_executable_get_info(hsa_executable_t executable,
                                              hsa_executable_info_t attribute,
                                              void* value) {
-  return HsaApiTable->hsa_executable_get_info_fn(executable, attribute, value);
+  return HSA_TABLE_CALL(hsa_executable_get_info, executable, attribute, value);
 }
 
 hsa_status_t HSA_API
     hsa_executable_global_variable_define(hsa_executable_t executable,
                                           const char* variable_name,
                                           void* address) {
-  return HsaApiTable->hsa_executable_global_variable_define_fn(
-      executable, variable_name, address);
+  return HSA_TABLE_CALL(hsa_executable_global_variable_define, executable,
+                        variable_name, address);
 }
 
 hsa_status_t HSA_API
@@ -558,8 +578,8 @@ hsa_status_t HSA_API
                                                 hsa_agent_t agent,
                                                 const char* variable_name,
                                                 void* address) {
-  return HsaApiTable->hsa_executable_agent_global_variable_define_fn(
-      executable, agent, variable_name, address);
+  return HSA_TABLE_CALL(hsa_executable_agent_global_variable_define, executable,
+                        agent, variable_name, address);
 }
 
 hsa_status_t HSA_API
@@ -567,13 +587,13 @@ hsa_status_t HSA_API
                                             hsa_agent_t agent,
                                             const char* variable_name,
                                             void* address) {
-  return HsaApiTable->hsa_executable_readonly_variable_define_fn(
-      executable, agent, variable_name, address);
+  return HSA_TABLE_CALL(hsa_executable_readonly_variable_define, executable,
+                        agent, variable_name, address);
 }
 
 hsa_status_t HSA_API
     hsa_executable_validate(hsa_executable_t executable, uint32_t* result) {
-  return HsaApiTable->hsa_executable_validate_fn(executable, result);
+  return HSA_TABLE_CALL(hsa_executable_validate, executable, result);
 }
 
 hsa_status_t HSA_API
@@ -581,16 +601,16 @@ hsa_status_t HSA_API
                               const char* module_name, const char* symbol_name,
                               hsa_agent_t agent, int32_t call_convention,
                               hsa_executable_symbol_t* symbol) {
-  return HsaApiTable->hsa_executable_get_symbol_fn(
-      executable, module_name, symbol_name, agent, call_convention, symbol);
+  return HSA_TABLE_CALL(hsa_executable_get_symbol, executable, module_name,
+                        symbol_name, agent, call_convention, symbol);
 }
 
 hsa_status_t HSA_API
     hsa_executable_symbol_get_info(hsa_executable_symbol_t executable_symbol,
                                    hsa_executable_symbol_info_t attribute,
                                    void* value) {
-  return HsaApiTable->hsa_executable_symbol_get_info_fn(executable_symbol,
-                                                        attribute, value);
+  return HSA_TABLE_CALL(hsa_executable_symbol_get_info, executable_symbol,
+                        attribute, value);
 }
 
 hsa_status_t HSA_API hsa_executable_iterate_symbols(
@@ -598,11 +618,11 @@ hsa_status_t HSA_API hsa_executable_iterate_symbols(
     hsa_status_t (*callback)(hsa_executable_t executable,
                              hsa_executable_symbol_t symbol, void* data),
     void* data) {
-  return HsaApiTable->hsa_executable_iterate_symbols_fn(executable, callback,
-                                                        data);
+  return HSA_TABLE_CALL(hsa_executable_iterate_symbols, executable, callback,
+                        data);
 }
 
 hsa_status_t HSA_API
     hsa_status_string(hsa_status_t status, const char** status_string) {
-  return HsaApiTable->hsa_status_string_fn(status, status_string);
+  return HSA_TABLE_CALL(hsa_status_string, status, status_string);
 }
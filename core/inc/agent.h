@@ -108,6 +108,10 @@ class Agent : public Checked<0xF6BC25EB17E6F917> {
     return HSA_STATUS_ERROR;
   }
 
+  virtual hsa_status_t DmaFill(void* ptr, uint32_t value, size_t count) {
+    return HSA_STATUS_ERROR;
+  }
+
   virtual hsa_status_t IterateRegion(
       hsa_status_t (*callback)(hsa_region_t region, void* data),
       void* data) const = 0;
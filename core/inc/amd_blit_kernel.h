@@ -37,7 +37,28 @@ class BlitKernel : public core::Blit {
   virtual hsa_status_t SubmitLinearCopyCommand(void* dst, const void* src,
                                                size_t size) override;
 
+  /// @brief Submit AQL packets to fill memory with a dword value. The first
+  /// bytes are copied from a pattern in system region memory and then
+  /// repeatedly doubled by device side copies, so only the pattern crosses
+  /// the bus. The call is blocking until the command execution is finished.
+  ///
+  /// @param ptr Memory address of the fill destination, 4 byte aligned.
+  /// @param value Value to be written to every dword.
+  /// @param count Number of dwords to be written.
+  virtual hsa_status_t SubmitLinearFillCommand(void* ptr, uint32_t value,
+                                               size_t count) override;
+
  private:
+  struct __ALIGNED__(16) KernelArgs {
+    const void* src_;
+    void* dst_;
+    uint64_t size_;
+  };
+
+  /// Write a vector copy dispatch packet into queue slot @p index.
+  void WriteCopyPacket(uint64_t index, KernelArgs* args, void* dst,
+                       const void* src, uint32_t size, bool barrier);
+
   /// Reserve a slot in the queue buffer. The call will wait until the queue
   /// buffer has a room.
   uint64_t AcquireWriteIndex(uint32_t num_packet);
@@ -66,6 +87,7 @@ class BlitKernel : public core::Blit {
 
   static const size_t kMaxCopySize;
   static const uint32_t kGroupSize;
+  static const size_t kFillPatternSize;
 };
 }  // namespace amd
 
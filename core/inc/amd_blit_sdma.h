@@ -40,6 +40,15 @@ class BlitSdma : public core::Blit {
   virtual hsa_status_t SubmitLinearCopyCommand(void* dst, const void* src,
                                                size_t size) override;
 
+  /// @brief Submit constant fill commands to fill memory with a dword value.
+  /// The call is blocking until the command execution is finished.
+  ///
+  /// @param ptr Memory address of the fill destination, 4 byte aligned.
+  /// @param value Value to be written to every dword.
+  /// @param count Number of dwords to be written.
+  virtual hsa_status_t SubmitLinearFillCommand(void* ptr, uint32_t value,
+                                               size_t count) override;
+
  private:
   /// @brief Acquires the address into queue buffer where a new command
   /// packet of specified size could be written. The address that is
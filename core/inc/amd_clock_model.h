@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// GPU to system clock correlation.
+
+#ifndef HSA_RUNTIME_CORE_INC_AMD_CLOCK_MODEL_H_
+#define HSA_RUNTIME_CORE_INC_AMD_CLOCK_MODEL_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "core/inc/thunk.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+#include "core/util/utils.h"
+
+namespace amd {
+class GpuAgentInt;
+
+/// @brief Converts GPU clock counters to the system clock domain with a
+/// linear model anchored at one GPU counter. The slope is held in 32.32 fixed
+/// point so each conversion costs one multiply and shift, with no floating
+/// point.
+class ClockConverter {
+ public:
+  ClockConverter() : gpu_base_(0), system_base_(0), scale_(0) {}
+
+  ClockConverter(uint64_t gpu_base, uint64_t system_base, uint64_t scale)
+      : gpu_base_(gpu_base), system_base_(system_base), scale_(scale) {}
+
+  __forceinline uint64_t Convert(uint64_t gpu_counter) const {
+    const __int128 delta = int64_t(gpu_counter - gpu_base_);
+    return system_base_ +
+           uint64_t((delta * __int128(scale_)) >> kFractionBits);
+  }
+
+  static const int kFractionBits = 32;
+
+ private:
+  uint64_t gpu_base_;
+  uint64_t system_base_;
+  uint64_t scale_;
+};
+
+/// @brief Least squares fit of the system clock against the GPU clock over a
+/// sliding window of clock samples.
+///
+/// Samples are added by one writer at a time. The fitted coefficients are
+/// published through a sequence lock, so readers never block and never call
+/// into the kernel driver.
+class ClockModel {
+ public:
+  ClockModel();
+
+  /// @brief Adds a clock sample and republishes the fit. Callers must
+  /// serialize calls.
+  void AddSample(const HsaClockCounters& sample);
+
+  /// @brief Reads the latest fit into @p clock and the GPU counter of the
+  /// newest sample into @p sampled. Returns false until two samples with
+  /// distinct GPU counters have been added.
+  bool Read(ClockConverter& clock, uint64_t& sampled) const;
+
+  /// @brief Returns a converter mapping GPU counters one to one onto the
+  /// system clock from the newest sample, for use while no fit exists.
+  /// Callers must serialize with AddSample.
+  ClockConverter Anchor() const;
+
+ private:
+  static const uint32_t kWindow = 16;
+
+  struct Sample {
+    uint64_t gpu;
+    uint64_t system;
+  };
+
+  void Fit();
+
+  // Sample window, a ring indexed by next_.
+  Sample samples_[kWindow];
+  uint32_t count_;
+  uint32_t next_;
+
+  // Published coefficients, valid when sequence_ is even and unchanged across
+  // the read.
+  std::atomic<uint32_t> sequence_;
+  std::atomic<uint64_t> gpu_base_;
+  std::atomic<uint64_t> system_base_;
+  std::atomic<uint64_t> scale_;
+  std::atomic<uint64_t> sampled_;
+  std::atomic<bool> ready_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClockModel);
+};
+
+/// @brief Background thread feeding clock samples of every GPU agent to its
+/// clock model.
+///
+/// The thread starts on the first translation that runs past the newest
+/// sample and wakes every HSA_CLOCK_SAMPLE_MS milliseconds (default 100).
+/// Setting HSA_CLOCK_SAMPLE_MS to 0 disables the service, and agents then
+/// sample their clocks on demand.
+class ClockService {
+ public:
+  ClockService();
+  ~ClockService();
+
+  void AddAgent(GpuAgentInt* agent);
+
+  /// @brief Starts the sampling thread if it is not running yet. Returns
+  /// false when the service is disabled or the thread cannot be created.
+  bool Start() {
+    if (running_.load(std::memory_order_acquire)) return true;
+    return StartThread();
+  }
+
+  /// @brief Stops the sampling thread and forgets all agents.
+  void Shutdown();
+
+ private:
+  bool StartThread();
+
+  static void SampleLoop(void* arg);
+
+  std::vector<GpuAgentInt*> agents_;
+  std::atomic<bool> running_;
+  bool disabled_;
+  bool exit_;
+  uint32_t period_ms_;
+  os::Thread thread_;
+  os::EventHandle wake_;
+  KernelMutex lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ClockService);
+};
+
+}  // namespace amd
+
+#endif  // header guard
@@ -185,6 +185,12 @@ namespace amd {
 
     uint64_t ElfSize(const void* buffer);
 
+    // Size of the ELF64 image in the first max_size bytes of buffer: the end
+    // of its headers or of its furthest section, whichever is larger.
+    // Returns 0 if the header is not a current ELF64 header or any header or
+    // section lies outside max_size, so untrusted images can be measured.
+    uint64_t ElfSize(const void* buffer, uint64_t max_size);
+
     std::string GetNoteString(uint32_t s_size, const char* s);
 
   }
@@ -49,11 +49,14 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_GPU_AGENT_H_
 #define HSA_RUNTIME_CORE_INC_AMD_GPU_AGENT_H_
 
+#include <atomic>
 #include <vector>
 
 #include "core/inc/runtime.h"
 #include "core/inc/agent.h"
+#include "core/inc/amd_clock_model.h"
 #include "core/inc/blit.h"
+#include "core/inc/queue_multiplexer.h"
 #include "core/inc/signal.h"
 #include "core/inc/thunk.h"
 #include "core/util/small_heap.h"
@@ -75,6 +78,11 @@ class GpuAgentInt : public core::Agent {
   virtual hsa_amd_coherency_type_t current_coherency_type() const = 0;
   virtual void TranslateTime(core::Signal* signal,
                              hsa_amd_profiling_dispatch_time_t& time) = 0;
+  /// @brief Returns the current GPU to system clock model, valid for GPU
+  /// counters up to at least @p gpu_counter.
+  virtual ClockConverter ReadClock(uint64_t gpu_counter) = 0;
+  /// @brief Adds a fresh clock sample to the clock model.
+  virtual void SampleClocks() = 0;
   virtual HSAuint32 node_id() const = 0;
 };
 
@@ -93,6 +101,8 @@ class GpuAgent : public GpuAgentInt {
 
   hsa_status_t DmaCopy(void* dst, const void* src, size_t size);
 
+  hsa_status_t DmaFill(void* ptr, uint32_t value, size_t count);
+
   hsa_status_t GetInfo(hsa_agent_info_t attribute, void* value) const;
 
   /// @brief Api to create an Aql queue
@@ -140,6 +150,7 @@ class GpuAgent : public GpuAgentInt {
       scratch.size_per_thread = scratch_per_thread_;
     }
     ScopedAcquire<KernelMutex> lock(&sclock_);
+    if (scratch_pool_.base() == NULL) AllocateScratchPool();
     scratch.queue_base = scratch_pool_.alloc(scratch.size);
     scratch.queue_process_offset =
         uintptr_t(scratch.queue_base) - uintptr_t(scratch_pool_.base());
@@ -153,6 +164,10 @@ class GpuAgent : public GpuAgentInt {
   void TranslateTime(core::Signal* signal,
                      hsa_amd_profiling_dispatch_time_t& time);
 
+  ClockConverter ReadClock(uint64_t gpu_counter);
+
+  void SampleClocks();
+
   uint16_t GetMicrocodeVersion() const;
 
   bool current_coherency_type(hsa_amd_coherency_type_t type);
@@ -181,7 +196,14 @@ class GpuAgent : public GpuAgentInt {
   static const uint32_t minAqlSize_ = 0x1000;   // 4KB min
   static const uint32_t maxAqlSize_ = 0x20000;  // 8MB max
 
-  void SyncClocks();
+  /// @brief Creates a hardware AQL queue with its own scratch slice.
+  hsa_status_t CreateHwQueue(size_t size, core::HsaEventCallback event_callback,
+                             void* data, uint32_t private_segment_size,
+                             core::Queue** queue);
+
+  /// @brief Returns the multiplexer backing virtual queues, creating it on
+  /// first use.
+  core::QueueMultiplexer* queue_multiplexer();
 
   const HSAuint32 node_id_;
 
@@ -189,17 +211,43 @@ class GpuAgent : public GpuAgentInt {
 
   hsa_amd_coherency_type_t current_coherency_type_;
 
+  /// @brief Reserves the scratch pool, which is deferred from init to the
+  /// first queue. Leaves the pool empty on failure. Called under sclock_.
+  void AllocateScratchPool();
+
   SmallHeap scratch_pool_;
 
+  // Length of the scratch pool to reserve, zero without a scratch region.
+  size_t scratch_pool_len_;
+
   size_t queue_scratch_len_;
 
   size_t scratch_per_thread_;
 
   core::Blit* blit_;
 
-  KernelMutex lock_, sclock_;
+  /// @brief Returns the blit object, creating it on first use.
+  core::Blit* blit();
+
+  core::Blit* sdma_blit_;
+
+  // Set once creating sdma_blit_ has been attempted.
+  std::atomic<bool> sdma_blit_probed_;
+
+  /// @brief Returns the SDMA blit object, creating it on first use, or NULL
+  /// if the agent has no usable SDMA engine.
+  core::Blit* sdma_blit();
+
+  // Number of hardware queues virtual queues are multiplexed onto, zero when
+  // every queue gets its own hardware queue.
+  uint32_t queue_pool_size_;
+
+  core::QueueMultiplexer* queue_mux_;
+
+  KernelMutex lock_, sclock_, clock_lock_;
 
-  HsaClockCounters t0_, t1_;
+  // Fit of the system clock against the GPU clock, written under clock_lock_.
+  ClockModel clock_model_;
 
   std::vector<HsaCacheProperties> cache_props_;
 
@@ -44,10 +44,14 @@ mes of its
 #include "amd_hsa_elf.h"
 #include "amd_hsa_kernel_code.h"
 #include "hsa.h"
+#include "amd_hsa_locks.hpp"
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <cassert>
 #include <unordered_map>
+#include <vector>
 
 namespace amd {
 namespace hsa {
@@ -279,14 +283,59 @@ namespace code {
         uint64_t width, uint64_t height, uint64_t depth, uint64_t array);
     };
 
+    /// @brief Maps code object handles to their parsed representation. Safe
+    /// to use from several threads: handles are spread over shards, each
+    /// behind its own reader/writer lock, and parsing happens outside of the
+    /// locks.
     class AmdHsaCodeManager {
     private:
+      static const size_t kShardCount = 16;
+
       typedef std::unordered_map<uint64_t, AmdHsaCode*> CodeMap;
-      CodeMap codeMap;
+
+      struct Shard {
+        amd::hsa::common::ReaderWriterLock lock;
+        CodeMap codeMap;
+      };
+
+      struct SharedCode {
+        AmdHsaCode* code;
+        size_t refs;
+      };
+
+      typedef std::unordered_map<uint64_t, std::vector<SharedCode>> ContentMap;
+
+      Shard shards[kShardCount];
+
+      std::atomic<bool> contentCache;
+      std::mutex contentLock;
+      ContentMap contentMap;
+      std::unordered_map<AmdHsaCode*, uint64_t> contentHashes;
+
+      Shard& ShardOf(uint64_t handle);
+      AmdHsaCode* Parse(hsa_code_object_t handle);
+      AmdHsaCode* ParseShared(hsa_code_object_t handle);
+      void Release(AmdHsaCode* code);
+
+      AmdHsaCodeManager(const AmdHsaCodeManager&);
+      AmdHsaCodeManager& operator=(const AmdHsaCodeManager&);
 
     public:
+      AmdHsaCodeManager();
+      ~AmdHsaCodeManager();
+
+      /// @brief Returns the parsed representation of @p handle, parsing it on
+      /// first use. The pointer is used after the shard lock is dropped and
+      /// stays valid until Destroy is called for the same handle; as with
+      /// hsa_code_object_destroy, callers must not destroy a code object
+      /// while other threads still use it.
       AmdHsaCode* FromHandle(hsa_code_object_t handle);
       bool Destroy(hsa_code_object_t handle);
+
+      /// @brief Shares one parsed representation between code objects with
+      /// identical contents. Set with HSA_CODE_OBJECT_CONTENT_CACHE=1. Code
+      /// objects parsed before a change keep their representation.
+      void EnableContentCache(bool enable) { contentCache.store(enable, std::memory_order_relaxed); }
     };
 }
 }
@@ -53,6 +53,7 @@
 #include "hsa_ext_image.h"
 #include "amd_hsa_elf.h"
 #include "amd_load_map.h"
+#include <functional>
 #include <string>
 #include <mutex>
 #include <vector>
@@ -121,6 +122,48 @@ public:
   virtual hsa_status_t SamplerDestroy(
     hsa_agent_t agent, hsa_ext_sampler_t sampler_handle) = 0;
 
+  // Number of threads code object loading may use, including the calling
+  // thread. Contexts returning more than one must be able to allocate, copy
+  // and create samplers and images from several threads at once.
+  virtual size_t LoadThreadCount() { return 1; }
+
+  // Calls fn(i) for every i in [0, count) on up to LoadThreadCount threads,
+  // the calling thread included, and returns once all calls returned. fn
+  // must only write state owned by its own index.
+  virtual void ParallelFor(size_t count, const std::function<void(size_t)> &fn) {
+    for (size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+  }
+
+  // Directory of the persistent code object load cache, NULL if disabled.
+  virtual const char* CacheDirectory() { return NULL; }
+
+  // Identifies the device and ISA of an agent for cache lookups. Entries
+  // written for one key are never used for another. Empty disables caching
+  // for the agent.
+  virtual std::string AgentCacheKey(hsa_agent_t agent) { return std::string(); }
+
+  // Whether segment uploads should overlap with symbol and relocation
+  // processing. Executables then upload with SegmentCopyAsync and join the
+  // copies when frozen, so code objects must stay alive until then.
+  virtual bool PipelinedLoad() { return false; }
+
+  // Starts a segment copy that may complete after the call returns. Copies
+  // complete in submission order and src must stay valid until
+  // SegmentCopyWait returns. Returns false if the copy was not started.
+  virtual bool SegmentCopyAsync(amdgpu_hsa_elf_segment_t segment, hsa_agent_t agent, void* dst, size_t offset, const void* src, size_t size) {
+    return SegmentCopy(segment, agent, dst, offset, src, size);
+  }
+
+  // Waits for every copy started with SegmentCopyAsync. Returns false if any
+  // of them failed.
+  virtual bool SegmentCopyWait() { return true; }
+
+  // Whether executables create symbol objects on first lookup or iteration
+  // rather than at load.
+  virtual bool LazySymbols() { return false; }
+
 protected:
   Context() {}
 
@@ -181,6 +181,17 @@ class HwAqlCommandProcessor : public core::Queue, public core::Signal {
   hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count,
                             const uint32_t* cu_mask);
 
+  /// @brief Hardware ring buffers are bound to the KFD queue at creation and
+  /// cannot be resized.
+  hsa_status_t Resize(uint32_t new_size) {
+    return HSA_STATUS_ERROR_INVALID_QUEUE;
+  }
+
+  /// @brief Occupancy is not tracked for hardware queues.
+  hsa_status_t GetStats(hsa_amd_queue_stats_t* stats) {
+    return HSA_STATUS_ERROR_INVALID_QUEUE;
+  }
+
   /// @brief This operation is illegal
   hsa_signal_value_t LoadRelaxed() {
     assert(false);
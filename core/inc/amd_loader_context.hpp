@@ -47,14 +47,21 @@
 #ifndef HSA_RUNTIME_CORE_INC_AMD_LOADER_CONTEXT_HPP
 #define HSA_RUNTIME_CORE_INC_AMD_LOADER_CONTEXT_HPP
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
 #include "core/inc/amd_hsa_loader.hpp"
 #include "inc/hsa.h"
 #include "inc/hsa_ext_image.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace amd {
 
@@ -76,13 +83,140 @@ struct AgentCompare {
 
 typedef std::unordered_map<hsa_agent_t, hsa_region_t, AgentHash, AgentCompare> Agent2RegionMap;
 
+//===----------------------------------------------------------------------===//
+// CodeArena.                                                                 //
+//===----------------------------------------------------------------------===//
+
+/// @brief Sub-allocates kernel code segments out of large executable chunks,
+/// so small code objects share pages and a single memory registration. A
+/// chunk is released once every segment carved from it has been freed.
+class CodeArena final {
+public:
+  /// @brief Size of a shared chunk, larger segments get a chunk of their own.
+  static const size_t kChunkSize = 2 * 1024 * 1024;
+
+  CodeArena(): current_(0) {}
+
+  ~CodeArena();
+
+  void* Allocate(size_t size, size_t align);
+
+  void Free(void *ptr);
+
+  /// @brief Whether [@p ptr, @p ptr + @p size) lies in a chunk holding live
+  /// segments.
+  bool Contains(const void *ptr, size_t size);
+
+  /// @brief Number of chunks currently mapped and registered.
+  size_t ChunkCount();
+
+  /// @brief Number of pages currently mapped for kernel code.
+  size_t PageCount();
+
+private:
+  CodeArena(const CodeArena &ca);
+  CodeArena& operator=(const CodeArena &ca);
+
+  struct Chunk {
+    size_t size;
+    size_t offset;
+    size_t live;
+  };
+
+  /// @brief Maps and registers a chunk, counted by the code arena metrics.
+  static void* MapChunk(size_t size);
+  /// @brief Unmaps a deregistered chunk returned by MapChunk.
+  static void ReleaseChunk(void *ptr, size_t size);
+  static void UnmapChunk(void *ptr, size_t size);
+
+  std::mutex mutex_;
+  std::map<uintptr_t, Chunk> chunks_;
+  uintptr_t current_;
+};
+
+//===----------------------------------------------------------------------===//
+// CopyQueue.                                                                 //
+//===----------------------------------------------------------------------===//
+
+/// @brief Runs segment copies in submission order on a background thread,
+/// started on first use.
+class CopyQueue final {
+public:
+  CopyQueue(): pending_(0), failed_(false), exit_(false) {}
+
+  ~CopyQueue();
+
+  /// @brief Queues @p copy, returns false if the worker could not be started.
+  bool Submit(const std::function<bool()> &copy);
+
+  /// @brief Waits until every queued copy ran. Returns false if any copy
+  /// failed since the last wait.
+  bool Wait();
+
+private:
+  CopyQueue(const CopyQueue &cq);
+  CopyQueue& operator=(const CopyQueue &cq);
+
+  void Run();
+
+  std::mutex lock_;
+  std::condition_variable work_;
+  std::condition_variable idle_;
+  std::deque<std::function<bool()>> copies_;
+  size_t pending_;
+  bool failed_;
+  bool exit_;
+  std::thread worker_;
+};
+
+//===----------------------------------------------------------------------===//
+// WorkerPool.                                                                //
+//===----------------------------------------------------------------------===//
+
+/// @brief Threads shared by all parallel code object loads, started on first
+/// use and kept until the pool is destroyed.
+class WorkerPool final {
+public:
+  WorkerPool(): exit_(false) {}
+
+  ~WorkerPool();
+
+  /// @brief Calls @p fn(i) for every i in [0, @p count) on the calling thread
+  /// and up to @p thread_count - 1 workers. Returns once all calls returned.
+  /// Several calls may run at once, each caller works on its own items.
+  void Run(size_t count, size_t thread_count, const std::function<void(size_t)> &fn);
+
+private:
+  WorkerPool(const WorkerPool &wp);
+  WorkerPool& operator=(const WorkerPool &wp);
+
+  struct Job {
+    const std::function<void(size_t)> *fn;
+    size_t count;
+    std::atomic<size_t> next;
+    // Workers inside Drain, guarded by lock_.
+    size_t active;
+  };
+
+  static void Drain(Job &job);
+
+  void Work();
+
+  std::mutex lock_;
+  std::condition_variable work_;
+  std::condition_variable done_;
+  std::deque<Job*> jobs_;
+  std::vector<std::thread> workers_;
+  bool exit_;
+};
+
 //===----------------------------------------------------------------------===//
 // LoaderContext.                                                             //
 //===----------------------------------------------------------------------===//
 
 class LoaderContext final: public hsa::loader::Context {
 public:
-  LoaderContext(): hsa::loader::Context() {}
+  LoaderContext();
 
   ~LoaderContext() {}
 
@@ -116,6 +250,35 @@ public:
 
   hsa_status_t SamplerDestroy(hsa_agent_t agent, hsa_ext_sampler_t sampler_handle);
 
+  size_t LoadThreadCount() override { return load_thread_count_; }
+
+  void ParallelFor(size_t count, const std::function<void(size_t)> &fn) override {
+    worker_pool_.Run(count, load_thread_count_, fn);
+  }
+
+  const char* CacheDirectory() override {
+    return cache_directory_.empty() ? NULL : cache_directory_.c_str();
+  }
+
+  std::string AgentCacheKey(hsa_agent_t agent) override;
+
+  bool PipelinedLoad() override { return pipelined_load_; }
+
+  bool LazySymbols() override { return lazy_symbols_; }
+
+  bool SegmentCopyAsync(amdgpu_hsa_elf_segment_t segment, hsa_agent_t agent, void* dst, size_t offset, const void* src, size_t size) override;
+
+  bool SegmentCopyWait() override;
+
+  /// @brief Whether [@p ptr, @p ptr + @p size) is loaded kernel code.
+  bool IsKernelCode(const void *ptr, size_t size) {
+    return code_arena_.Contains(ptr, size);
+  }
+
+  /// @brief Reads the loader settings from the environment, at every runtime
+  /// initialization.
+  void Configure();
+
   void Reset();
 
 private:
@@ -138,6 +301,20 @@ private:
 
   std::mutex agent2region_mutex_;
   Agent2RegionMap agent2region_;
+
+  CodeArena code_arena_;
+
+  size_t load_thread_count_;
+
+  std::string cache_directory_;
+
+  bool pipelined_load_;
+
+  bool lazy_symbols_;
+
+  CopyQueue copy_queue_;
+
+  WorkerPool worker_pool_;
 };
 
 } // namespace amd
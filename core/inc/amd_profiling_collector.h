@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Batched dispatch timeline collection for profiling tools.
+
+#ifndef HSA_RUNTIME_CORE_INC_AMD_PROFILING_COLLECTOR_H_
+#define HSA_RUNTIME_CORE_INC_AMD_PROFILING_COLLECTOR_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "core/inc/amd_clock_model.h"
+#include "core/util/locks.h"
+#include "core/util/utils.h"
+
+#include "inc/hsa_ext_amd.h"
+
+namespace amd {
+class GpuAgentInt;
+
+/// @brief Per-queue timelines of converted dispatch time stamps.
+///
+/// Each queue owns a fixed size ring, created on the first collection for
+/// that queue. A full ring overwrites its oldest records and counts them as
+/// dropped until the next drain.
+class ProfilingCollector {
+ public:
+  ProfilingCollector();
+
+  /// @brief Harvests the time stamps of @p count completion signals, converts
+  /// them with one read of the clock model of @p agent and appends them to the
+  /// ring of queue @p queue_id.
+  void Collect(GpuAgentInt* agent, uint64_t queue_id, uint32_t count,
+               const hsa_signal_t* signals);
+
+  /// @brief Moves up to @p capacity of the oldest records of queue
+  /// @p queue_id to @p records and returns how many were moved.
+  uint32_t Drain(uint64_t queue_id, uint32_t capacity,
+                 hsa_amd_profiling_record_t* records, uint64_t* dropped);
+
+  /// @brief Releases the ring of a destroyed queue.
+  void EraseQueue(uint64_t queue_id);
+
+ private:
+  struct Ring {
+    KernelMutex lock;
+    std::vector<hsa_amd_profiling_record_t> records;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+  };
+
+  std::shared_ptr<Ring> GetRing(uint64_t queue_id, bool create);
+
+  // Records per ring, a power of two.
+  size_t ring_size_;
+
+  std::unordered_map<uint64_t, std::shared_ptr<Ring>> rings_;
+  KernelMutex rings_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfilingCollector);
+};
+
+}  // namespace amd
+
+#endif  // header guard
@@ -19,12 +19,23 @@ class SdmaCmdwriterKv {
   virtual void WriteFenceCommand(char* command_buffer, uint32_t* fence_address,
                                  uint32_t fence_value);
 
+  virtual void WriteConstantFillCommand(char* command_buffer, void* dst,
+                                        uint32_t value, uint32_t fill_size);
+
   inline uint32_t linear_copy_command_size() {
     return linear_copy_command_size_;
   }
 
   inline uint32_t fence_command_size() { return fence_command_size_; }
 
+  inline uint32_t constant_fill_command_size() {
+    return constant_fill_command_size_;
+  }
+
+  inline size_t max_single_constant_fill_size() {
+    return max_single_constant_fill_size_;
+  }
+
   inline size_t max_single_linear_copy_size() {
     return max_single_linear_copy_size_;
   }
@@ -36,6 +47,10 @@ class SdmaCmdwriterKv {
  protected:
   uint32_t linear_copy_command_size_;
   uint32_t fence_command_size_;
+  uint32_t constant_fill_command_size_;
+
+  /// Max fill size in bytes of a single constant fill command packet.
+  size_t max_single_constant_fill_size_;
 
   /// Max copy size of a single linear copy command packet.
   size_t max_single_linear_copy_size_;
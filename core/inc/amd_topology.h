@@ -54,6 +54,19 @@ namespace amd {
 /// Should not be called directly, must be called only from Runtime::Acquire()
 void Load();
 
+/// @brief Completes initialization once nothing else needs to overlap with
+/// topology discovery. Thunk calls taking a node id must not be made before.
+/// Returns false if the agents were built from a stale topology snapshot; the
+/// caller then destroys all agents and memory regions and calls
+/// RebuildTopology.
+/// Should not be called directly, must be called only from Runtime::Load()
+bool WaitForTopology();
+
+/// @brief Builds agents and memory regions from the thunk's topology after
+/// WaitForTopology found the cached snapshot stale.
+/// Should not be called directly, must be called only from Runtime::Load()
+void RebuildTopology();
+
 /// @brief Shutdown/cleanup of runtime.
 /// Should not be called directly, must be called only from Runtime::Release()
 void Unload();
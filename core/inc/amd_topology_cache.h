@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// On-disk snapshot of the KFD topology.
+
+#ifndef HSA_RUNTIME_CORE_INC_AMD_TOPOLOGY_CACHE_H_
+#define HSA_RUNTIME_CORE_INC_AMD_TOPOLOGY_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include "core/inc/thunk.h"
+
+namespace amd {
+/// @brief Thunk view of one node as queried during discovery. Cache lists
+/// are unfiltered; memory banks are only queried for GPU nodes. Nodes the
+/// thunk fails to report are left out.
+struct NodeTopology {
+  HSAuint32 node_id;
+  HsaNodeProperties properties;
+  std::vector<HsaCacheProperties> cpu_caches;
+  std::vector<HsaCacheProperties> gpu_caches;
+  std::vector<HsaMemoryProperties> memory_banks;
+};
+
+/// @brief Thunk view of the system.
+struct Topology {
+  HsaVersionInfo version;
+  std::vector<NodeTopology> nodes;
+};
+
+/// @brief Snapshot of the topology kept on disk so that init can build agents
+/// without enumerating every node through the thunk.
+///
+/// The snapshot is keyed by the boot id, the KFD topology generation and the
+/// KFD interface version, so a reboot, a driver reload or a hot-plugged device
+/// never matches an old snapshot. Without a boot id the cache is disabled.
+/// Snapshots are written to a temporary file and renamed into place.
+class TopologyCache {
+ public:
+  explicit TopologyCache(const std::string& directory);
+
+  /// @brief Reads the snapshot taken under @p version into @p topology.
+  /// Returns false if there is none or it was taken under another key.
+  bool Lookup(const HsaVersionInfo& version, Topology& topology) const;
+
+  /// @brief Writes a snapshot, replacing any previous one. Failures are not
+  /// reported, the next init simply enumerates again.
+  void Store(const Topology& topology) const;
+
+  /// @brief Removes the snapshot, used when it is found not to match the
+  /// thunk's view after all.
+  void Invalidate() const;
+
+ private:
+  std::string Key(const HsaVersionInfo& version) const;
+
+  const std::string path_;
+
+  std::string boot_id_;
+
+  std::string generation_;
+};
+}  // namespace
+
+#endif  // header guard
@@ -36,6 +36,16 @@ class Blit {
   /// @param size Size of the data to be copied.
   virtual hsa_status_t SubmitLinearCopyCommand(void* dst, const void* src,
                                                size_t size) = 0;
+
+  /// @brief Submit a linear fill command to the the underlying compute device's
+  /// control block. The call is blocking until the command execution is
+  /// finished.
+  ///
+  /// @param ptr Memory address of the fill destination, 4 byte aligned.
+  /// @param value Value to be written to every dword.
+  /// @param count Number of dwords to be written.
+  virtual hsa_status_t SubmitLinearFillCommand(void* ptr, uint32_t value,
+                                               size_t count) = 0;
 };
 }  // namespace core
 
@@ -47,10 +47,14 @@
 #ifndef HSA_RUNTIME_CORE_INC_HOST_QUEUE_H_
 #define HSA_RUNTIME_CORE_INC_HOST_QUEUE_H_
 
+#include <utility>
+#include <vector>
+
 #include "core/inc/memory_region.h"
 #include "core/inc/queue.h"
 #include "core/inc/runtime.h"
 #include "core/inc/signal.h"
+#include "core/util/locks.h"
 
 namespace core {
 class HostQueue : public Queue {
@@ -85,61 +89,95 @@ class HostQueue : public Queue {
   void StoreReadIndexRelaxed(uint64_t value) {
     atomic::Store(&amd_queue_.read_dispatch_id, value,
                   std::memory_order_relaxed);
+    OnConsume(value);
   }
 
   void StoreReadIndexRelease(uint64_t value) {
     atomic::Store(&amd_queue_.read_dispatch_id, value,
                   std::memory_order_release);
+    OnConsume(value);
   }
 
   void StoreWriteIndexRelaxed(uint64_t value) {
-    atomic::Store(&amd_queue_.write_dispatch_id, value,
-                  std::memory_order_relaxed);
+    BeforeReserve();
+    // An RMW rather than a store, so the reservation is ordered against the
+    // fence read by a resize.
+    atomic::Exchange(&amd_queue_.write_dispatch_id, value,
+                     std::memory_order_relaxed);
+    OnReserve(value);
   }
 
   void StoreWriteIndexRelease(uint64_t value) {
-    atomic::Store(&amd_queue_.write_dispatch_id, value,
-                  std::memory_order_release);
+    BeforeReserve();
+    // An RMW rather than a store, so the reservation is ordered against the
+    // fence read by a resize.
+    atomic::Exchange(&amd_queue_.write_dispatch_id, value,
+                     std::memory_order_release);
+    OnReserve(value);
   }
 
   uint64_t CasWriteIndexAcqRel(uint64_t expected, uint64_t value) {
-    return atomic::Cas(&amd_queue_.write_dispatch_id, value, expected,
-                       std::memory_order_acq_rel);
+    BeforeReserve();
+    const uint64_t old = atomic::Cas(&amd_queue_.write_dispatch_id, value,
+                                     expected, std::memory_order_acq_rel);
+    if (old == expected) OnReserve(value);
+    return old;
   }
 
   uint64_t CasWriteIndexAcquire(uint64_t expected, uint64_t value) {
-    return atomic::Cas(&amd_queue_.write_dispatch_id, value, expected,
-                       std::memory_order_acquire);
+    BeforeReserve();
+    const uint64_t old = atomic::Cas(&amd_queue_.write_dispatch_id, value,
+                                     expected, std::memory_order_acquire);
+    if (old == expected) OnReserve(value);
+    return old;
   }
 
   uint64_t CasWriteIndexRelaxed(uint64_t expected, uint64_t value) {
-    return atomic::Cas(&amd_queue_.write_dispatch_id, value, expected,
-                       std::memory_order_relaxed);
+    BeforeReserve();
+    const uint64_t old = atomic::Cas(&amd_queue_.write_dispatch_id, value,
+                                     expected, std::memory_order_relaxed);
+    if (old == expected) OnReserve(value);
+    return old;
   }
 
   uint64_t CasWriteIndexRelease(uint64_t expected, uint64_t value) {
-    return atomic::Cas(&amd_queue_.write_dispatch_id, value, expected,
-                       std::memory_order_release);
+    BeforeReserve();
+    const uint64_t old = atomic::Cas(&amd_queue_.write_dispatch_id, value,
+                                     expected, std::memory_order_release);
+    if (old == expected) OnReserve(value);
+    return old;
   }
 
   uint64_t AddWriteIndexAcqRel(uint64_t value) {
-    return atomic::Add(&amd_queue_.write_dispatch_id, value,
-                       std::memory_order_acq_rel);
+    BeforeReserve();
+    const uint64_t old = atomic::Add(&amd_queue_.write_dispatch_id, value,
+                                     std::memory_order_acq_rel);
+    OnReserve(old + value);
+    return old;
   }
 
   uint64_t AddWriteIndexAcquire(uint64_t value) {
-    return atomic::Add(&amd_queue_.write_dispatch_id, value,
-                       std::memory_order_acquire);
+    BeforeReserve();
+    const uint64_t old = atomic::Add(&amd_queue_.write_dispatch_id, value,
+                                     std::memory_order_acquire);
+    OnReserve(old + value);
+    return old;
   }
 
   uint64_t AddWriteIndexRelaxed(uint64_t value) {
-    return atomic::Add(&amd_queue_.write_dispatch_id, value,
-                       std::memory_order_relaxed);
+    BeforeReserve();
+    const uint64_t old = atomic::Add(&amd_queue_.write_dispatch_id, value,
+                                     std::memory_order_relaxed);
+    OnReserve(old + value);
+    return old;
   }
 
   uint64_t AddWriteIndexRelease(uint64_t value) {
-    return atomic::Add(&amd_queue_.write_dispatch_id, value,
-                       std::memory_order_release);
+    BeforeReserve();
+    const uint64_t old = atomic::Add(&amd_queue_.write_dispatch_id, value,
+                                     std::memory_order_release);
+    OnReserve(old + value);
+    return old;
   }
 
   hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count,
@@ -147,6 +185,20 @@ class HostQueue : public Queue {
     return HSA_STATUS_ERROR;
   }
 
+  /// @brief Grow the ring buffer to @p new_size packets.
+  ///
+  /// Reservations made after the call are held until the read index reaches
+  /// the write index observed on entry (the resize fence). The ring is then
+  /// swapped and the held reservations land in the new ring. The previous
+  /// ring is released once the read index moves past the fence, so consumers
+  /// still polling it with a stale base address never touch freed memory.
+  ///
+  /// Returns HSA_STATUS_ERROR_OUT_OF_RESOURCES and keeps the current ring if
+  /// the read index does not reach the fence within kResizeTimeoutMs.
+  hsa_status_t Resize(uint32_t new_size);
+
+  hsa_status_t GetStats(hsa_amd_queue_stats_t* stats);
+
   bool active() const { return active_; }
 
   void* operator new(size_t size) {
@@ -161,10 +213,85 @@ class HostQueue : public Queue {
 
  private:
   static const size_t kRingAlignment = 256;
-  const uint32_t size_;
+  static const uint64_t kNoFence = UINT64_MAX;
+  static const uint32_t kResizeTimeoutMs = 1000;
+
+  /// @brief Allocates a ring of @p size packets with invalid packet headers.
+  void* AllocateRing(uint32_t size);
+
+  /// @brief Performs a pending automatic grow before a new reservation is
+  /// made, while the calling producer does not own an unpublished slot.
+  __forceinline void BeforeReserve() {
+    if (atomic::Load(&grow_requested_, std::memory_order_relaxed) != 0)
+      AutoGrow();
+  }
+
+  /// @brief Records occupancy for a reservation ending at @p end and holds it
+  /// if it was made behind an in-progress resize fence.
+  __forceinline void OnReserve(uint64_t end) {
+    const uint64_t read = LoadReadIndexRelaxed();
+    const uint64_t occupancy = (end > read) ? end - read : 0;
+    if (occupancy > atomic::Load(&high_water_mark_, std::memory_order_relaxed))
+      UpdateHighWaterMark(occupancy);
+    if (occupancy > atomic::Load(&size_, std::memory_order_relaxed))
+      RecordSaturation();
+
+    // Pairs with the release RMW that reads the fence in Grow: either the
+    // reservation is included in the fence or the pending flag is visible
+    // here. Only orders the reservation RMW's read, so it is free on x86.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (atomic::Load(&resize_pending_, std::memory_order_relaxed) != 0)
+      WaitForResize(end);
+  }
+
+  /// @brief Releases retired rings the consumer has moved past.
+  __forceinline void OnConsume(uint64_t read_index) {
+    if (atomic::Load(&retired_count_, std::memory_order_relaxed) != 0)
+      ReleaseRetiredRings(read_index);
+  }
+
+  void UpdateHighWaterMark(uint64_t occupancy);
+
+  void RecordSaturation();
+
+  void WaitForResize(uint64_t end);
+
+  /// @brief Resize, giving up after @p timeout_ms if packets reserved before
+  /// the fence are not consumed.
+  hsa_status_t Grow(uint32_t new_size, uint32_t timeout_ms);
+
+  void AutoGrow();
+
+  void ReleaseRetiredRings(uint64_t read_index);
+
+  const hsa_region_t region_;
+  uint32_t size_;
   bool active_;
   void* ring_;
 
+  // Serializes resizes.
+  KernelMutex resize_lock_;
+
+  // Non-zero while a resize is waiting for the read index to reach the fence.
+  uint32_t resize_pending_;
+
+  // Write index observed when the pending resize started.
+  uint64_t resize_fence_;
+
+  // Rings replaced by a resize, each with the fence it was retired at.
+  KernelMutex retired_lock_;
+  std::vector<std::pair<void*, uint64_t> > retired_rings_;
+  uint32_t retired_count_;
+
+  // Occupancy statistics.
+  uint32_t high_water_mark_;
+  uint64_t saturated_reservations_;
+  uint32_t resize_count_;
+
+  // Automatic growth policy, see Runtime::queue_auto_grow_limit.
+  const uint32_t auto_grow_limit_;
+  uint32_t grow_requested_;
+
   DISALLOW_COPY_AND_ASSIGN(HostQueue);
 };
 }  // namespace core
@@ -49,6 +49,10 @@
 
 #include "inc/hsa_api_trace.h"
 #include "core/inc/hsa_internal.h"
+#include "core/util/locks.h"
+
+#include <cstddef>
+#include <vector>
 
 namespace core {
 struct ApiTable {
@@ -58,6 +62,52 @@ struct ApiTable {
   ApiTable();
   void Reset();
   void LinkExts(ExtTable* ptr);
+
+  /// @brief Puts function in front of the chain for the entry at byte offset
+  /// entry of ::ApiTable. The runtime keeps *next pointing at the rest of the
+  /// chain.
+  hsa_status_t AddHook(size_t entry, void* function, void** next,
+                       uint64_t* id);
+
+  /// @brief Unlinks a hook added by AddHook.
+  hsa_status_t RemoveHook(uint64_t id);
+
+  /// @brief Bypasses, or restores, the hooks of every entry in group.
+  hsa_status_t EnableGroup(hsa_amd_api_group_t group, bool enable);
+
+  /// @brief Routes the exported API through table if any entry differs from
+  /// its default, straight to HSA:: otherwise.
+  void UpdateIntercepted();
+
+ private:
+  struct Hook {
+    uint64_t id;
+    void* function;
+    void** next;
+  };
+
+  static const size_t kEntryCount =
+      offsetof(::ApiTable, std_exts_) / sizeof(void*);
+  static const size_t kGroupCount = HSA_AMD_API_GROUP_CODE_OBJECT + 1;
+
+  void** Entry(size_t index) {
+    return reinterpret_cast<void**>(&table) + index;
+  }
+
+  static hsa_amd_api_group_t EntryGroup(size_t index);
+
+  /// @brief Rewrites the next pointers of an entry's hooks and then the entry.
+  void Relink(size_t index);
+
+  ::ApiTable defaults_;
+
+  // Hooks of each entry, innermost first, and the entry value they chain to.
+  std::vector<Hook> hooks_[kEntryCount];
+  void* bases_[kEntryCount];
+
+  bool group_disabled_[kGroupCount];
+  uint64_t next_hook_id_;
+  KernelMutex lock_;
 };
 
 extern ApiTable hsa_api_table_;
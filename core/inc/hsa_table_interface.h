@@ -49,3 +49,9 @@
 void hsa_table_interface_init(const ApiTable* table);
 
 const ApiTable* hsa_table_interface_get_table();
+
+// Routes calls through the table when true, straight to HSA:: when false.
+void hsa_table_interface_set_intercepted(bool intercepted);
+
+// Word that is nonzero while calls are routed through the table.
+const uint32_t* hsa_table_interface_get_intercepted();
@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Runtime-wide counters and histograms.
+
+#ifndef HSA_RUNTIME_CORE_INC_METRICS_H_
+#define HSA_RUNTIME_CORE_INC_METRICS_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+#include "core/util/timer.h"
+#include "core/util/utils.h"
+
+#include "inc/hsa_ext_amd.h"
+
+namespace core {
+namespace metrics {
+
+// Counters and gauges: identifier, reported name, kind.
+#define HSA_METRICS_COUNTERS(X)                                            \
+  X(kSignalsCreated, "signal.created", HSA_AMD_METRIC_KIND_COUNTER)        \
+  X(kSignalsLive, "signal.live", HSA_AMD_METRIC_KIND_GAUGE)                \
+  X(kSignalWaits, "signal.waits", HSA_AMD_METRIC_KIND_COUNTER)             \
+  X(kSignalWaitSleeps, "signal.wait_sleeps", HSA_AMD_METRIC_KIND_COUNTER)  \
+  X(kQueuesCreated, "queue.created", HSA_AMD_METRIC_KIND_COUNTER)          \
+  X(kQueuesLive, "queue.live", HSA_AMD_METRIC_KIND_GAUGE)                  \
+  X(kScratchGrows, "queue.scratch_grows", HSA_AMD_METRIC_KIND_COUNTER)     \
+  X(kBlitStalls, "blit.queue_full_stalls", HSA_AMD_METRIC_KIND_COUNTER)    \
+  X(kMemoryAllocations, "memory.allocations", HSA_AMD_METRIC_KIND_COUNTER) \
+  X(kMemoryLive, "memory.live_allocations", HSA_AMD_METRIC_KIND_GAUGE)     \
+  X(kMemoryLiveBytes, "memory.live_bytes", HSA_AMD_METRIC_KIND_GAUGE)      \
+  X(kCodeObjectsLoaded, "loader.code_objects_loaded",                      \
+    HSA_AMD_METRIC_KIND_COUNTER)                                           \
+  X(kCodeArenaChunks, "loader.code_arena_chunks", HSA_AMD_METRIC_KIND_GAUGE) \
+  X(kCodeArenaPages, "loader.code_arena_pages", HSA_AMD_METRIC_KIND_GAUGE)   \
+  X(kCodeArenaRegistrations, "loader.code_arena_registrations",            \
+    HSA_AMD_METRIC_KIND_COUNTER)                                           \
+  X(kAsyncHandlersLive, "async.live_handlers", HSA_AMD_METRIC_KIND_GAUGE)  \
+  X(kAsyncHandlerCalls, "async.handler_calls", HSA_AMD_METRIC_KIND_COUNTER) \
+  X(kAsyncWakes, "async.wakes", HSA_AMD_METRIC_KIND_COUNTER)
+
+// Histograms: identifier, reported name.
+#define HSA_METRICS_HISTOGRAMS(X)                          \
+  X(kSignalWaitSpinNs, "signal.wait_spin_ns")              \
+  X(kSignalWaitSleepNs, "signal.wait_sleep_ns")            \
+  X(kScratchGrowBytes, "queue.scratch_grow_bytes")         \
+  X(kBlitQueueOccupancy, "blit.queue_occupancy_packets")   \
+  X(kMemoryAllocationBytes, "memory.allocation_bytes")     \
+  X(kCodeObjectLoadNs, "loader.code_object_load_ns")       \
+  X(kAsyncHandlerNs, "async.handler_ns")
+
+#define HSA_METRICS_ENUM(id, ...) id,
+enum Counter { HSA_METRICS_COUNTERS(HSA_METRICS_ENUM) kCounterCount };
+enum Histogram { HSA_METRICS_HISTOGRAMS(HSA_METRICS_ENUM) kHistogramCount };
+#undef HSA_METRICS_ENUM
+
+#define HSA_METRICS_COUNTER_KIND(id, name, kind) kind,
+static constexpr hsa_amd_metric_kind_t kCounterKinds[] = {
+    HSA_METRICS_COUNTERS(HSA_METRICS_COUNTER_KIND)};
+#undef HSA_METRICS_COUNTER_KIND
+
+/// @brief True while metrics are collected. Counter and histogram updates are
+/// dropped otherwise, at the cost of one load and a predicted branch. Gauges
+/// are always maintained, so they stay balanced when collection starts late.
+extern bool g_enabled;
+
+/// @brief Slow paths of Add and Record, updating the calling thread's shard.
+void AddShard(Counter id, int64_t delta);
+void RecordShard(Histogram id, uint64_t value);
+
+static __forceinline bool Enabled() { return __builtin_expect(g_enabled, 0); }
+
+static __forceinline void Add(Counter id, int64_t delta = 1) {
+  if (kCounterKinds[id] == HSA_AMD_METRIC_KIND_GAUGE || Enabled())
+    AddShard(id, delta);
+}
+
+static __forceinline void Record(Histogram id, uint64_t value) {
+  if (Enabled()) RecordShard(id, value);
+}
+
+/// @brief Records one signal wait which started at @p start and spent
+/// @p slept of its time blocked in the driver.
+static __forceinline void RecordWait(timer::fast_clock::time_point start,
+                                     timer::fast_clock::duration slept) {
+  if (!Enabled()) return;
+  const timer::fast_clock::duration total = timer::fast_clock::now() - start;
+  AddShard(kSignalWaits, 1);
+  RecordShard(kSignalWaitSpinNs,
+              uint64_t(timer::duration_cast<std::chrono::nanoseconds>(
+                           total - slept).count()));
+  if (slept.count() != 0)
+    RecordShard(kSignalWaitSleepNs,
+                uint64_t(timer::duration_cast<std::chrono::nanoseconds>(slept)
+                             .count()));
+}
+
+/// @brief Starts or stops collection. Values gathered so far are kept.
+void Enable(bool enable);
+
+/// @brief Zeroes all counters and histograms. Gauges keep their values.
+void Reset();
+
+/// @brief Calls @p callback with the sum over all threads of every metric.
+hsa_status_t Iterate(hsa_status_t (*callback)(const hsa_amd_metric_t* metric,
+                                              void* data),
+                     void* data);
+
+/// @brief Writes every metric to @p file_name, one per line.
+void Dump(const std::string& file_name);
+
+}  // namespace metrics
+}  // namespace core
+
+#endif  // header guard
@@ -55,6 +55,7 @@
 
 #include <sstream>
 #include "amd_hsa_queue.h"
+#include "hsa_ext_amd.h"
 
 namespace core {
 struct AqlPacket {
@@ -273,6 +274,20 @@ class Queue : public Checked<0xFA3906A679F9DB49> {
   virtual hsa_status_t SetCUMasking(const uint32_t num_cu_mask_count,
                                     const uint32_t* cu_mask) = 0;
 
+  /// @brief Grow the ring buffer while the queue is in use
+  ///
+  /// @param new_size Number of packets in the new ring buffer
+  ///
+  /// @return hsa_status_t
+  virtual hsa_status_t Resize(uint32_t new_size) = 0;
+
+  /// @brief Report occupancy statistics
+  ///
+  /// @param stats Statistics to be filled in
+  ///
+  /// @return hsa_status_t
+  virtual hsa_status_t GetStats(hsa_amd_queue_stats_t* stats) = 0;
+
   // Handle of Amd Queue struct
   amd_queue_t amd_queue_;
 
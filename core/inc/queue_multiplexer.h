@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HSA_RUNTIME_CORE_INC_QUEUE_MULTIPLEXER_H_
+#define HSA_RUNTIME_CORE_INC_QUEUE_MULTIPLEXER_H_
+
+#include <functional>
+#include <vector>
+
+#include "core/inc/agent.h"
+#include "core/inc/host_queue.h"
+#include "core/inc/queue.h"
+#include "core/util/locks.h"
+#include "core/util/os.h"
+
+namespace core {
+class QueueMultiplexer;
+
+/// @brief User visible queue whose packets are forwarded to a backend queue
+/// shared with other virtual queues.
+///
+/// The ring lives in system memory and is consumed by the multiplexer's
+/// forwarding thread only. A virtual queue is bound to a single backend for
+/// its lifetime so its packets reach the backend in submission order.
+class VirtualQueue : public HostQueue {
+ public:
+  VirtualQueue(QueueMultiplexer* mux, uint32_t ring_size,
+               hsa_queue_type_t type, hsa_signal_t doorbell_signal,
+               HsaEventCallback callback, void* data);
+
+  ~VirtualQueue();
+
+  Queue* backend() const { return backend_; }
+
+ private:
+  friend class QueueMultiplexer;
+
+  QueueMultiplexer* mux_;
+
+  // Backend queue the packets are forwarded to, assigned on attach.
+  Queue* backend_;
+
+  // Error callback of the user, invoked for errors raised by backend_.
+  HsaEventCallback callback_;
+  void* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(VirtualQueue);
+};
+
+/// @brief Maps many virtual queues onto a bounded pool of backend queues.
+///
+/// All virtual queues of a multiplexer share one doorbell signal. A
+/// forwarding thread drains published packets round robin, at most
+/// kForwardQuantum packets per virtual queue per round, and copies them into
+/// the bound backend, ringing the backend doorbell once per batch. Backends
+/// are created on demand until the pool is full; after that new virtual
+/// queues share the least used backend with the same private segment size.
+///
+/// Packets from different virtual queues sharing a backend are interleaved,
+/// so a barrier bit also orders against the other virtual queues on the same
+/// backend. Likewise, enabling profiling on a virtual queue enables it on its
+/// backend for good, which also timestamps the other virtual queues' packets.
+class QueueMultiplexer {
+ public:
+  /// @brief Creates a backend queue able to hold at least @p size packets
+  /// with @p private_segment_size bytes of scratch per work-item, returns
+  /// NULL on failure.
+  typedef std::function<Queue*(uint32_t size, uint32_t private_segment_size)>
+      BackendFactory;
+
+  /// @brief Maximum number of packets forwarded from one virtual queue
+  /// before the next virtual queue is serviced.
+  static const uint32_t kForwardQuantum = 16;
+
+  QueueMultiplexer(uint32_t max_backends, BackendFactory factory);
+
+  /// @brief Stops forwarding and destroys the backends. All virtual queues
+  /// must have been destroyed.
+  ~QueueMultiplexer();
+
+  /// @brief Creates a virtual queue of @p size packets, bound to a backend
+  /// created with @p private_segment_size.
+  hsa_status_t CreateQueue(uint32_t size, hsa_queue_type_t type,
+                           HsaEventCallback callback, void* data,
+                           uint32_t private_segment_size, Queue** queue);
+
+  /// @brief Backend error callback, forwards the error to every virtual queue
+  /// bound to @p source. @p data is the multiplexer.
+  static void BackendError(hsa_status_t status, hsa_queue_t* source,
+                           void* data);
+
+  uint32_t backend_count() {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    return uint32_t(backends_.size());
+  }
+
+ private:
+  friend class VirtualQueue;
+
+  struct Backend {
+    Queue* queue;
+    uint32_t private_segment_size;
+    uint32_t users;
+  };
+
+  // Doorbell value meaning no submission since the forwarder last looked.
+  static const hsa_signal_value_t kIdle = -1;
+
+  /// @brief Binds @p queue to a backend and starts servicing it.
+  hsa_status_t Attach(VirtualQueue* queue, uint32_t size,
+                      uint32_t private_segment_size);
+
+  /// @brief Stops servicing @p queue. Unforwarded packets are dropped.
+  void Detach(VirtualQueue* queue);
+
+  /// @brief Removes @p queue from queues_ and its backend's users. Must be
+  /// called with lock_ held.
+  void Unlink(VirtualQueue* queue);
+
+  /// @brief Starts the forwarding thread if it is not running yet.
+  bool StartForwarding();
+
+  static void ForwardLoop(void* arg);
+
+  /// @brief One round robin pass over the virtual queues. Returns the number
+  /// of packets forwarded, @p blocked is set when a full backend held back a
+  /// published packet. Must be called with forward_lock_ held.
+  uint32_t ForwardRound(bool* blocked);
+
+  /// @brief Forwards up to @p quantum published packets of @p queue.
+  uint32_t Forward(VirtualQueue* queue, uint32_t quantum, bool* blocked);
+
+  const uint32_t max_backends_;
+
+  BackendFactory factory_;
+
+  // Protects backends_, queues_ and cursor_. The forwarding thread only
+  // holds it to take a snapshot of queues_.
+  KernelMutex lock_;
+
+  // Held by the forwarding thread while it services the snapshot, so Detach
+  // can wait for a round that may still use the detached queue. Never held
+  // while waiting for backend space.
+  KernelMutex forward_lock_;
+
+  // Virtual queues serviced by the current round, guarded by forward_lock_.
+  std::vector<VirtualQueue*> round_;
+
+  std::vector<Backend> backends_;
+
+  std::vector<VirtualQueue*> queues_;
+
+  // Index of the virtual queue serviced first in the next round.
+  size_t cursor_;
+
+  // Doorbell shared by all virtual queues.
+  hsa_signal_t doorbell_;
+
+  os::Thread thread_;
+
+  volatile bool exit_;
+
+  DISALLOW_COPY_AND_ASSIGN(QueueMultiplexer);
+};
+}  // namespace core
+#endif  // header guard
@@ -51,6 +51,7 @@
 
 #include <vector>
 #include <map>
+#include <unordered_map>
 
 #include "core/inc/hsa_ext_interface.h"
 #include "core/inc/hsa_internal.h"
@@ -63,6 +64,7 @@
 #include "core/util/os.h"
 
 #include "core/inc/amd_loader_context.hpp"
+#include "core/inc/amd_profiling_collector.h"
 #include "amd_hsa_code.hpp"
 
 //---------------------------------------------------------------------------//
@@ -116,6 +118,25 @@ class Runtime {
 
   amd::hsa::code::AmdHsaCodeManager* code_manager();
 
+  /// @brief Maps a code object file read-only and returns the mapping as the
+  /// code object handle, no copy of the file contents is made.
+  hsa_status_t MapCodeObject(int fd, hsa_code_object_t* code_object);
+
+  /// @brief Unmaps a code object created by MapCodeObject. Returns false if
+  /// @p code_object was not created by MapCodeObject.
+  bool UnmapCodeObject(hsa_code_object_t code_object);
+
+  /// @brief Records the size of the allocation holding a code object the
+  /// runtime created by copying, so later reads can be bounded by it.
+  void AddCodeObjectSize(hsa_code_object_t code_object, size_t size);
+
+  /// @brief Forgets the size recorded by AddCodeObjectSize.
+  void RemoveCodeObjectSize(hsa_code_object_t code_object);
+
+  /// @brief Returns the number of readable bytes at a code object created by
+  /// the runtime, mapped or copied, and 0 for code objects it did not create.
+  size_t CodeObjectSize(hsa_code_object_t code_object);
+
   /// @brief Memory registration - tracks and provides page aligned regions to
   /// drivers
   bool Register(void* ptr, size_t length, bool registerWithDrivers = true);
@@ -135,6 +156,30 @@ class Runtime {
 
   hsa_status_t CopyMemory(void* dst, const void* src, size_t size);
 
+  /// @brief Writes @p value to @p count dwords starting at @p ptr, on the
+  /// device owning @p ptr when it is not system memory.
+  hsa_status_t FillMemory(void* ptr, uint32_t value, size_t count);
+
+  /// @brief Returns the dispatch properties of @p kernel_object. The
+  /// amd_kernel_code_t is read on first use only.
+  void GetKernelDescriptor(uint64_t kernel_object,
+                           hsa_amd_kernel_descriptor_t* descriptor);
+
+  /// @brief As GetKernelDescriptor, but fails instead of reading
+  /// @p kernel_object if it is neither cached nor loaded kernel code.
+  bool GetLoadedKernelDescriptor(uint64_t kernel_object,
+                                 hsa_amd_kernel_descriptor_t* descriptor);
+
+  /// @brief Drops the cached descriptors of kernel objects in
+  /// [@p begin, @p end), called when the memory holding them is freed.
+  void EraseKernelDescriptors(uint64_t begin, uint64_t end);
+
+  amd::ProfilingCollector& profiling_collector() {
+    return profiling_collector_;
+  }
+
+  amd::ClockService& clock_service() { return clock_service_; }
+
   /// @brief Backends hookup driver registration APIs in these functions.
   /// The runtime calls this with ranges which are whole pages
   /// and never registers a page more than once.
@@ -148,6 +193,10 @@ class Runtime {
 
   hsa_region_t system_region() { return system_region_; }
 
+  /// @brief Largest ring size soft queues may grow to automatically, zero when
+  /// automatic growth is disabled.
+  uint32_t queue_auto_grow_limit() const { return queue_auto_grow_limit_; }
+
   std::function<void*(size_t, size_t)>& system_allocator() {
     return system_allocator_;
   }
@@ -202,12 +251,32 @@ class Runtime {
 
   uint32_t queue_count_;
 
+  uint32_t queue_auto_grow_limit_;
+
   // Loader context.
   amd::LoaderContext loader_context_;
 
   // Code object manager.
   amd::hsa::code::AmdHsaCodeManager code_manager_;
 
+  // Code objects mapped from files, keyed by handle, value is mapping size.
+  std::map<uint64_t, size_t> mapped_code_objects_;
+
+  // Code objects copied into runtime allocations, keyed by handle, value is
+  // allocation size.
+  std::map<uint64_t, size_t> copied_code_objects_;
+
+  // Dispatch properties of loaded kernels, keyed by kernel object.
+  // Ordered so the descriptors of a freed range are erased together.
+  std::map<uint64_t, hsa_amd_kernel_descriptor_t> kernel_descriptors_;
+  amd::hsa::common::ReaderWriterLock kernel_descriptors_lock_;
+
+  // Dispatch timelines of queues with collected profiling records.
+  amd::ProfilingCollector profiling_collector_;
+
+  // Keeps the clock models of GPU agents fresh for time stamp translation.
+  amd::ClockService clock_service_;
+
   uintptr_t system_memory_limit_;
 
   // Contains list of registered memory.
@@ -224,6 +293,9 @@ class Runtime {
 
   uint64_t sys_clock_freq_;
 
+  // File receiving the metrics at shutdown, empty for none.
+  std::string metrics_file_;
+
   struct async_events_control_t {
     hsa_signal_t wake;
     os::Thread async_events_thread_;
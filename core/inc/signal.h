@@ -51,6 +51,7 @@
 
 #include "core/inc/runtime.h"
 #include "core/inc/checked.h"
+#include "core/inc/metrics.h"
 #include "core/util/utils.h"
 
 #include "core/inc/thunk.h"
@@ -72,9 +73,15 @@ class Signal : public Checked<0x71FCCA6A3D5D5276> {
     invalid_ = false;
     waiting_ = 0;
     retained_ = 0;
+    notify_event_ = NULL;
+    metrics::Add(metrics::kSignalsCreated);
+    metrics::Add(metrics::kSignalsLive);
   }
 
-  virtual ~Signal() { signal_.kind = AMD_SIGNAL_KIND_INVALID; }
+  virtual ~Signal() {
+    signal_.kind = AMD_SIGNAL_KIND_INVALID;
+    metrics::Add(metrics::kSignalsLive, -1);
+  }
 
   bool IsValid() const {
     if (CheckedType::IsValid() && !invalid_) return true;
@@ -166,6 +173,80 @@ class Signal : public Checked<0x71FCCA6A3D5D5276> {
   virtual hsa_signal_value_t CasAcqRel(hsa_signal_value_t expected,
                                        hsa_signal_value_t value) = 0;
 
+  //-------------------------
+  // kind dispatch
+  //-------------------------
+
+  // User mode signals (DefaultSignal and InterruptSignal) implement every
+  // operation as an atomic on signal_.value, followed by Notify when the value
+  // changes. The public API checks IsUserMode and runs those bodies inline;
+  // only doorbell signals pay for the virtual call.
+
+  __forceinline bool IsUserMode() const {
+    return signal_.kind == AMD_SIGNAL_KIND_USER;
+  }
+
+  /// @brief Wakes event waiters of an interrupt signal. No-op otherwise.
+  __forceinline void Notify() {
+    if (notify_event_ != NULL) hsaKmtSetEvent(notify_event_);
+  }
+
+  __forceinline hsa_signal_value_t UserLoad(std::memory_order order) {
+    return hsa_signal_value_t(atomic::Load(&signal_.value, order));
+  }
+
+  __forceinline void UserStore(hsa_signal_value_t value,
+                               std::memory_order order) {
+    atomic::Store(&signal_.value, int64_t(value), order);
+    Notify();
+  }
+
+  __forceinline void UserAnd(hsa_signal_value_t value,
+                             std::memory_order order) {
+    atomic::And(&signal_.value, int64_t(value), order);
+    Notify();
+  }
+
+  __forceinline void UserOr(hsa_signal_value_t value, std::memory_order order) {
+    atomic::Or(&signal_.value, int64_t(value), order);
+    Notify();
+  }
+
+  __forceinline void UserXor(hsa_signal_value_t value,
+                             std::memory_order order) {
+    atomic::Xor(&signal_.value, int64_t(value), order);
+    Notify();
+  }
+
+  __forceinline void UserAdd(hsa_signal_value_t value,
+                             std::memory_order order) {
+    atomic::Add(&signal_.value, int64_t(value), order);
+    Notify();
+  }
+
+  __forceinline void UserSub(hsa_signal_value_t value,
+                             std::memory_order order) {
+    atomic::Sub(&signal_.value, int64_t(value), order);
+    Notify();
+  }
+
+  __forceinline hsa_signal_value_t UserExch(hsa_signal_value_t value,
+                                            std::memory_order order) {
+    hsa_signal_value_t ret = hsa_signal_value_t(
+        atomic::Exchange(&signal_.value, int64_t(value), order));
+    Notify();
+    return ret;
+  }
+
+  __forceinline hsa_signal_value_t UserCas(hsa_signal_value_t expected,
+                                           hsa_signal_value_t value,
+                                           std::memory_order order) {
+    hsa_signal_value_t ret = hsa_signal_value_t(
+        atomic::Cas(&signal_.value, int64_t(value), int64_t(expected), order));
+    Notify();
+    return ret;
+  }
+
   //-------------------------
   // implementation specific
   //-------------------------
@@ -209,6 +290,9 @@ class Signal : public Checked<0x71FCCA6A3D5D5276> {
 
   volatile uint32_t retained_;
 
+  /// @variable Event Notify sets after a user mode operation, NULL if none.
+  HsaEvent* notify_event_;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(Signal);
 };
@@ -9,12 +9,15 @@
 #include "core/inc/amd_blit_kernel_kv.h"
 #include "core/inc/amd_gpu_agent.h"
 #include "core/inc/hsa_internal.h"
+#include "core/inc/metrics.h"
+#include "core/inc/runtime.h"
 #include "core/inc/thunk.h"
 #include "core/util/utils.h"
 
 namespace amd {
 const uint32_t BlitKernel::kGroupSize = 256;
 const size_t BlitKernel::kMaxCopySize = AlignDown(UINT32_MAX, kGroupSize);
+const size_t BlitKernel::kFillPatternSize = 64 * 1024;
 
 BlitKernel::BlitKernel()
     : core::Blit(),
@@ -154,60 +157,18 @@ hsa_status_t BlitKernel::SubmitLinearCopyCommand(void* dst, const void* src,
   // Reserve write index for copy + fence packet.
   uint64_t write_index = AcquireWriteIndex(num_copy_packet + 1);
 
-  struct __ALIGNED__(16) KernelArgs{
-    const void* src_;
-    void* dst_;
-    uint64_t size_;
-  };
-
   KernelArgs* args = new KernelArgs[num_copy_packet];
 
   size_t total_copy_size = 0;
   for (uint32_t i = 0; i < num_copy_packet; ++i) {
-    hsa_kernel_dispatch_packet_t packet = {0};
-
-    static const uint16_t kDispatchPacketHeader =
-        (HSA_PACKET_TYPE_KERNEL_DISPATCH << HSA_PACKET_HEADER_TYPE) |
-        (0 << HSA_PACKET_HEADER_BARRIER) |
-        (HSA_FENCE_SCOPE_AGENT << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
-        (HSA_FENCE_SCOPE_NONE << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
-
-    packet.header = kDispatchPacketHeader;
-
-    packet.kernel_object = code_handle_;
-    packet.private_segment_size = code_private_segment_size_;
-
-    // Setup arguments.
     const uint32_t copy_size =
         static_cast<uint32_t>(std::min((size - total_copy_size), kMaxCopySize));
 
     void* cur_dst = static_cast<char*>(dst) + total_copy_size;
     const void* cur_src = static_cast<const char*>(src) + total_copy_size;
 
-    assert(IsMultipleOf(&args[i], 16));
-
-    args[i].src_ = cur_src;
-    args[i].dst_ = cur_dst;
-    args[i].size_ = copy_size;
-
-    packet.kernarg_address = &args[i];
-
-    // Setup working size.
-    const int kNumDimension = 1;
-    packet.setup = kNumDimension << HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS;
-    packet.grid_size_x = AlignUp(static_cast<uint32_t>(copy_size), kGroupSize);
-    packet.grid_size_y = packet.grid_size_z = 1;
-    packet.workgroup_size_x = kGroupSize;
-    packet.workgroup_size_y = packet.workgroup_size_z = 1;
-
-    // This assert to make sure kMaxCopySize is not changed to a number that
-    // could cause overflow to packet.grid_size_x.
-    assert(packet.grid_size_x >= copy_size);
-
-    // Populate queue buffer with AQL packet.
-    hsa_kernel_dispatch_packet_t* queue_buffer =
-        reinterpret_cast<hsa_kernel_dispatch_packet_t*>(queue_->base_address);
-    queue_buffer[(write_index + i) & queue_bitmask_] = packet;
+    WriteCopyPacket(write_index + i, &args[i], cur_dst, cur_src, copy_size,
+                    false);
 
     total_copy_size += copy_size;
   }
@@ -222,18 +183,127 @@ hsa_status_t BlitKernel::SubmitLinearCopyCommand(void* dst, const void* src,
   return status;
 }
 
+hsa_status_t BlitKernel::SubmitLinearFillCommand(void* ptr, uint32_t value,
+                                                 size_t count) {
+  assert(code_handle_ != 0);
+  assert(IsMultipleOf(ptr, sizeof(uint32_t)));
+
+  const size_t size = count * sizeof(uint32_t);
+  if (size == 0) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  // Seed the head of the destination from a pattern in system region memory,
+  // which the copy kernel can read.
+  const size_t pattern_size = std::min(size, kFillPatternSize);
+  uint32_t* pattern = reinterpret_cast<uint32_t*>(
+      core::Runtime::runtime_singleton_->system_allocator()(pattern_size,
+                                                            4096));
+  if (pattern == NULL) {
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+  std::fill(pattern, pattern + pattern_size / sizeof(uint32_t), value);
+
+  // Then double the filled prefix with device to device copies. Each copy
+  // reads what earlier packets wrote, so all but the first set the barrier
+  // bit.
+  uint32_t num_packet = 1;
+  for (size_t filled = pattern_size; filled < size;) {
+    filled += std::min(std::min(filled, size - filled), kMaxCopySize);
+    ++num_packet;
+  }
+
+  // Reserve write index for copy + fence packet.
+  uint64_t write_index = AcquireWriteIndex(num_packet + 1);
+
+  KernelArgs* args = new KernelArgs[num_packet];
+
+  WriteCopyPacket(write_index, &args[0], ptr, pattern,
+                  static_cast<uint32_t>(pattern_size), false);
+
+  size_t filled = pattern_size;
+  for (uint32_t i = 1; i < num_packet; ++i) {
+    const uint32_t copy_size = static_cast<uint32_t>(
+        std::min(std::min(filled, size - filled), kMaxCopySize));
+
+    WriteCopyPacket(write_index + i, &args[i], static_cast<char*>(ptr) + filled,
+                    ptr, copy_size, true);
+
+    filled += copy_size;
+  }
+  assert(filled == size);
+
+  const hsa_fence_scope_t fence_scope =
+      (IsSystemMemory(ptr)) ? HSA_FENCE_SCOPE_SYSTEM : HSA_FENCE_SCOPE_AGENT;
+  hsa_status_t status = FenceRelease(write_index, num_packet, fence_scope);
+
+  delete[] args;
+  core::Runtime::runtime_singleton_->system_deallocator()(pattern);
+
+  return status;
+}
+
+void BlitKernel::WriteCopyPacket(uint64_t index, KernelArgs* args, void* dst,
+                                 const void* src, uint32_t size, bool barrier) {
+  hsa_kernel_dispatch_packet_t packet = {0};
+
+  const uint16_t kDispatchPacketHeader =
+      (HSA_PACKET_TYPE_KERNEL_DISPATCH << HSA_PACKET_HEADER_TYPE) |
+      ((barrier ? 1 : 0) << HSA_PACKET_HEADER_BARRIER) |
+      (HSA_FENCE_SCOPE_AGENT << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_NONE << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+
+  packet.header = kDispatchPacketHeader;
+
+  packet.kernel_object = code_handle_;
+  packet.private_segment_size = code_private_segment_size_;
+
+  // Setup arguments.
+  assert(IsMultipleOf(args, 16));
+
+  args->src_ = src;
+  args->dst_ = dst;
+  args->size_ = size;
+
+  packet.kernarg_address = args;
+
+  // Setup working size.
+  const int kNumDimension = 1;
+  packet.setup = kNumDimension << HSA_KERNEL_DISPATCH_PACKET_SETUP_DIMENSIONS;
+  packet.grid_size_x = AlignUp(static_cast<uint32_t>(size), kGroupSize);
+  packet.grid_size_y = packet.grid_size_z = 1;
+  packet.workgroup_size_x = kGroupSize;
+  packet.workgroup_size_y = packet.workgroup_size_z = 1;
+
+  // This assert to make sure kMaxCopySize is not changed to a number that
+  // could cause overflow to packet.grid_size_x.
+  assert(packet.grid_size_x >= size);
+
+  // Populate queue buffer with AQL packet.
+  hsa_kernel_dispatch_packet_t* queue_buffer =
+      reinterpret_cast<hsa_kernel_dispatch_packet_t*>(queue_->base_address);
+  queue_buffer[index & queue_bitmask_] = packet;
+}
+
 uint64_t BlitKernel::AcquireWriteIndex(uint32_t num_packet) {
   assert(queue_->size >= num_packet);
 
   uint64_t write_index =
       HSA::hsa_queue_add_write_index_acq_rel(queue_, num_packet);
 
+  bool stalled = false;
   while (true) {
     // Wait until we have room in the queue;
     const uint64_t read_index = HSA::hsa_queue_load_read_index_relaxed(queue_);
     if ((write_index - read_index) < queue_->size) {
+      core::metrics::Record(core::metrics::kBlitQueueOccupancy,
+                            write_index - read_index + num_packet);
       break;
     }
+    if (!stalled) {
+      stalled = true;
+      core::metrics::Add(core::metrics::kBlitStalls);
+    }
   }
 
   return write_index;
@@ -159,6 +159,55 @@ hsa_status_t BlitSdma::SubmitLinearCopyCommand(void* dst, const void* src,
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t BlitSdma::SubmitLinearFillCommand(void* ptr, uint32_t value,
+                                                size_t count) {
+  assert(cmdwriter_ != NULL);
+  assert(IsMultipleOf(ptr, sizeof(uint32_t)));
+
+  const size_t size = count * sizeof(uint32_t);
+  const size_t max_fill_size = cmdwriter_->max_single_constant_fill_size();
+
+  // Break the fill into commands that each fit the SDMA count field and
+  // submit in batches that fit the queue buffer together with the fence.
+  const uint32_t fill_command_size = cmdwriter_->constant_fill_command_size();
+  const uint32_t max_batch_command = static_cast<uint32_t>(
+      (queue_size_ / 2 - cmdwriter_->fence_command_size()) / fill_command_size);
+
+  size_t cur_size = 0;
+  while (cur_size < size) {
+    const size_t batch_size =
+        std::min(size - cur_size, max_batch_command * max_fill_size);
+    const uint32_t num_fill_command = static_cast<uint32_t>(
+        (batch_size + max_fill_size - 1) / max_fill_size);
+
+    char* command_addr = AcquireWriteAddress(
+        num_fill_command * fill_command_size + cmdwriter_->fence_command_size());
+    if (command_addr == NULL) {
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+
+    const size_t batch_end = cur_size + batch_size;
+    for (uint32_t i = 0; i < num_fill_command; ++i) {
+      const uint32_t fill_size =
+          static_cast<uint32_t>(std::min(batch_end - cur_size, max_fill_size));
+
+      cmdwriter_->WriteConstantFillCommand(
+          command_addr, static_cast<char*>(ptr) + cur_size, value, fill_size);
+
+      ReleaseWriteAddress(command_addr, fill_command_size);
+
+      command_addr += fill_command_size;
+      cur_size += fill_size;
+    }
+
+    Fence(command_addr);
+  }
+
+  assert(cur_size == size);
+
+  return HSA_STATUS_SUCCESS;
+}
+
 char* BlitSdma::AcquireWriteAddress(uint32_t cmd_size) {
   assert(CmdIsValid(queue_start_addr_, queue_end_addr_, cmd_size));
 
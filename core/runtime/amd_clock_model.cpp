@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+#include "core/inc/amd_clock_model.h"
+
+#include <stdlib.h>
+
+#include "core/inc/amd_gpu_agent.h"
+
+namespace amd {
+// Default interval between clock samples.
+static const uint32_t kDefaultSamplePeriodMs = 100;
+
+ClockModel::ClockModel()
+    : count_(0),
+      next_(0),
+      sequence_(0),
+      gpu_base_(0),
+      system_base_(0),
+      scale_(0),
+      sampled_(0),
+      ready_(false) {}
+
+void ClockModel::AddSample(const HsaClockCounters& sample) {
+  samples_[next_].gpu = sample.GPUClockCounter;
+  samples_[next_].system = sample.SystemClockCounter;
+  next_ = (next_ + 1) % kWindow;
+  if (count_ < kWindow) count_++;
+  Fit();
+}
+
+void ClockModel::Fit() {
+  if (count_ < 2) return;
+
+  // Fit relative to the newest sample to keep the sums small.
+  const Sample& newest = samples_[(next_ + kWindow - 1) % kWindow];
+
+  double mean_x = 0, mean_y = 0;
+  for (uint32_t i = 0; i < count_; i++) {
+    mean_x += double(int64_t(samples_[i].gpu - newest.gpu));
+    mean_y += double(int64_t(samples_[i].system - newest.system));
+  }
+  mean_x /= count_;
+  mean_y /= count_;
+
+  double sxx = 0, sxy = 0;
+  for (uint32_t i = 0; i < count_; i++) {
+    const double dx = double(int64_t(samples_[i].gpu - newest.gpu)) - mean_x;
+    const double dy =
+        double(int64_t(samples_[i].system - newest.system)) - mean_y;
+    sxx += dx * dx;
+    sxy += dx * dy;
+  }
+
+  // Both clocks run forward, anything else is a bad sample set.
+  if (sxx <= 0 || sxy <= 0) return;
+
+  const double slope = sxy / sxx;
+  const double intercept = mean_y - slope * mean_x;
+
+  const uint64_t scale =
+      uint64_t(slope * double(uint64_t(1) << ClockConverter::kFractionBits));
+  const uint64_t system_base = newest.system + int64_t(intercept);
+
+  // Odd sequence numbers mark an update in progress.
+  const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  gpu_base_.store(newest.gpu, std::memory_order_relaxed);
+  system_base_.store(system_base, std::memory_order_relaxed);
+  scale_.store(scale, std::memory_order_relaxed);
+  sampled_.store(newest.gpu, std::memory_order_relaxed);
+  sequence_.store(sequence + 2, std::memory_order_release);
+  ready_.store(true, std::memory_order_release);
+}
+
+bool ClockModel::Read(ClockConverter& clock, uint64_t& sampled) const {
+  if (!ready_.load(std::memory_order_acquire)) return false;
+
+  while (true) {
+    const uint32_t sequence = sequence_.load(std::memory_order_acquire);
+    if ((sequence & 1) != 0) {
+      os::YieldThread();
+      continue;
+    }
+    const uint64_t gpu_base = gpu_base_.load(std::memory_order_relaxed);
+    const uint64_t system_base = system_base_.load(std::memory_order_relaxed);
+    const uint64_t scale = scale_.load(std::memory_order_relaxed);
+    sampled = sampled_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) == sequence) {
+      clock = ClockConverter(gpu_base, system_base, scale);
+      return true;
+    }
+  }
+}
+
+ClockConverter ClockModel::Anchor() const {
+  const uint64_t one = uint64_t(1) << ClockConverter::kFractionBits;
+  if (count_ == 0) return ClockConverter(0, 0, one);
+  const Sample& newest = samples_[(next_ + kWindow - 1) % kWindow];
+  return ClockConverter(newest.gpu, newest.system, one);
+}
+
+ClockService::ClockService()
+    : running_(false),
+      disabled_(false),
+      exit_(false),
+      period_ms_(kDefaultSamplePeriodMs),
+      thread_(NULL),
+      wake_(NULL) {
+  const std::string period = os::GetEnvVar("HSA_CLOCK_SAMPLE_MS");
+  if (!period.empty()) {
+    period_ms_ = uint32_t(atoi(period.c_str()));
+    disabled_ = (period_ms_ == 0);
+  }
+}
+
+ClockService::~ClockService() { Shutdown(); }
+
+void ClockService::AddAgent(GpuAgentInt* agent) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  agents_.push_back(agent);
+}
+
+bool ClockService::StartThread() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (running_.load(std::memory_order_relaxed)) return true;
+  if (disabled_) return false;
+
+  wake_ = os::CreateOsEvent(false, false);
+  if (wake_ == NULL) {
+    disabled_ = true;
+    return false;
+  }
+
+  exit_ = false;
+  thread_ = os::CreateThread(SampleLoop, this);
+  if (thread_ == NULL) {
+    os::DestroyOsEvent(wake_);
+    wake_ = NULL;
+    disabled_ = true;
+    return false;
+  }
+
+  running_.store(true, std::memory_order_release);
+  return true;
+}
+
+void ClockService::Shutdown() {
+  os::Thread thread;
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    thread = thread_;
+    exit_ = true;
+    if (thread != NULL) os::SetOsEvent(wake_);
+  }
+
+  // The sampling thread takes lock_ for every round, so wait outside of it.
+  if (thread != NULL) {
+    os::WaitForThread(thread);
+    os::CloseThread(thread);
+  }
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (wake_ != NULL) os::DestroyOsEvent(wake_);
+  thread_ = NULL;
+  wake_ = NULL;
+  running_.store(false, std::memory_order_release);
+  agents_.clear();
+}
+
+void ClockService::SampleLoop(void* arg) {
+  ClockService* service = reinterpret_cast<ClockService*>(arg);
+
+  while (true) {
+    os::WaitForOsEvent(service->wake_, service->period_ms_);
+
+    ScopedAcquire<KernelMutex> lock(&service->lock_);
+    if (service->exit_) return;
+    for (size_t i = 0; i < service->agents_.size(); i++)
+      service->agents_[i]->SampleClocks();
+  }
+}
+
+}  // namespace amd
@@ -51,6 +51,7 @@
 #include <climits>
 
 #include "core/inc/amd_blit_kernel.h"
+#include "core/inc/amd_blit_sdma.h"
 #include "core/inc/runtime.h"
 #include "core/inc/amd_memory_region.h"
 #include "core/inc/amd_hw_aql_command_processor.h"
@@ -67,21 +68,28 @@ GpuAgent::GpuAgent(HSAuint32 node, const HsaNodeProperties& node_props,
     : node_id_(node),
       properties_(node_props),
       current_coherency_type_(HSA_AMD_COHERENCY_TYPE_COHERENT),
+      scratch_pool_len_(0),
       blit_(NULL),
+      sdma_blit_(NULL),
+      sdma_blit_probed_(false),
+      queue_pool_size_(0),
+      queue_mux_(NULL),
       cache_props_(cache_props),
       ape1_base_(0),
       ape1_size_(0) {
-  HSAKMT_STATUS err = hsaKmtGetClockCounters(node_id_, &t0_);
-  t1_ = t0_;
-  assert(err == HSAKMT_STATUS_SUCCESS && "hsaGetClockCounters error");
-
   // Set compute_capability_ via node property, only on GPU device.
   compute_capability_.Initialize(node_props.EngineId.ui32.Major,
                                  node_props.EngineId.ui32.Minor,
                                  node_props.EngineId.ui32.Stepping);
+
+  queue_pool_size_ =
+      atoi(os::GetEnvVar("HSA_VIRTUAL_QUEUE_POOL_SIZE").c_str());
 }
 
 GpuAgent::~GpuAgent() {
+  // Backend queues return their scratch to scratch_pool_.
+  delete queue_mux_;
+
   if (ape1_base_ != 0) {
     _aligned_free(reinterpret_cast<void*>(ape1_base_));
   }
@@ -97,6 +105,13 @@ GpuAgent::~GpuAgent() {
     delete blit_;
   }
 
+  if (sdma_blit_ != NULL) {
+    hsa_status_t status = sdma_blit_->Destroy();
+    assert(status == HSA_STATUS_SUCCESS);
+
+    delete sdma_blit_;
+  }
+
   regions_.clear();
 }
 
@@ -109,11 +124,6 @@ void GpuAgent::RegisterMemoryProperties(core::MemoryRegion& region) {
   regions_.push_back(amd_region);
 
   if (amd_region->IsScratch()) {
-    HsaMemFlags flags;
-    flags.Value = 0;
-    flags.ui32.Scratch = 1;
-    flags.ui32.HostAccess = 1;
-
     scratch_per_thread_ = atoi(os::GetEnvVar("HSA_SCRATCH_MEM").c_str());
     if (scratch_per_thread_ == 0)
       scratch_per_thread_ = DEFAULT_SCRATCH_BYTES_PER_THREAD;
@@ -135,16 +145,30 @@ void GpuAgent::RegisterMemoryProperties(core::MemoryRegion& region) {
       scratchLen = 4294967296;  // 4GB apeture max
 #endif
 
-    void* scratchBase;
-    HSAKMT_STATUS err =
-        hsaKmtAllocMemory(node_id_, scratchLen, flags, &scratchBase);
-    assert(err == HSAKMT_STATUS_SUCCESS && "hsaKmtAllocMemory(Scratch) failed");
-    assert(IsMultipleOf(scratchBase, 0x1000) &&
-           "Scratch base is not page aligned!");
+    scratch_pool_len_ = scratchLen;
+  }
+}
 
-    scratch_pool_.~SmallHeap();
-    new (&scratch_pool_) SmallHeap(scratchBase, scratchLen);
+void GpuAgent::AllocateScratchPool() {
+  if (scratch_pool_len_ == 0) return;
+
+  HsaMemFlags flags;
+  flags.Value = 0;
+  flags.ui32.Scratch = 1;
+  flags.ui32.HostAccess = 1;
+
+  void* scratchBase;
+  HSAKMT_STATUS err =
+      hsaKmtAllocMemory(node_id_, scratch_pool_len_, flags, &scratchBase);
+  if (err != HSAKMT_STATUS_SUCCESS) {
+    assert(false && "hsaKmtAllocMemory(Scratch) failed");
+    return;
   }
+  assert(IsMultipleOf(scratchBase, 0x1000) &&
+         "Scratch base is not page aligned!");
+
+  scratch_pool_.~SmallHeap();
+  new (&scratch_pool_) SmallHeap(scratchBase, scratch_pool_len_);
 }
 
 hsa_status_t GpuAgent::IterateRegion(
@@ -170,7 +194,7 @@ hsa_status_t GpuAgent::IterateRegion(
   return HSA_STATUS_SUCCESS;
 }
 
-hsa_status_t GpuAgent::DmaCopy(void* dst, const void* src, size_t size) {
+core::Blit* GpuAgent::blit() {
   if (blit_ == NULL) {
     ScopedAcquire<KernelMutex> Lock(&lock_);
     if (blit_ == NULL) {
@@ -182,7 +206,40 @@ hsa_status_t GpuAgent::DmaCopy(void* dst, const void* src, size_t size) {
     }
   }
 
-  return blit_->SubmitLinearCopyCommand(dst, src, size);
+  return blit_;
+}
+
+core::Blit* GpuAgent::sdma_blit() {
+  if (!sdma_blit_probed_.load(std::memory_order_acquire)) {
+    ScopedAcquire<KernelMutex> Lock(&lock_);
+    if (!sdma_blit_probed_.load(std::memory_order_relaxed)) {
+      BlitSdma* sdma = new BlitSdma();
+      if (sdma->Initialize(*core::Agent::Convert(public_handle())) ==
+          HSA_STATUS_SUCCESS) {
+        sdma_blit_ = sdma;
+      } else {
+        sdma->Destroy();
+        delete sdma;
+      }
+      sdma_blit_probed_.store(true, std::memory_order_release);
+    }
+  }
+
+  return sdma_blit_;
+}
+
+hsa_status_t GpuAgent::DmaCopy(void* dst, const void* src, size_t size) {
+  return blit()->SubmitLinearCopyCommand(dst, src, size);
+}
+
+hsa_status_t GpuAgent::DmaFill(void* ptr, uint32_t value, size_t count) {
+  // SDMA writes the value with constant fill packets, nothing is read. The
+  // kernel blit is the fallback when the engine is unavailable.
+  core::Blit* sdma = sdma_blit();
+  if (sdma != NULL) {
+    return sdma->SubmitLinearFillCommand(ptr, value, count);
+  }
+  return blit()->SubmitLinearFillCommand(ptr, value, count);
 }
 
 hsa_status_t GpuAgent::GetInfo(hsa_agent_info_t attribute, void* value) const {
@@ -356,6 +413,43 @@ hsa_status_t GpuAgent::QueueCreate(size_t size, hsa_queue_type_t queue_type,
   // Enforce max size
   if (size > maxAqlSize_) return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
 
+  // Virtual queues share the scratch of their backend, which is created
+  // with private_segment_size.
+  if (queue_pool_size_ != 0) {
+    return queue_multiplexer()->CreateQueue(uint32_t(size), queue_type,
+                                            event_callback, data,
+                                            private_segment_size, queue);
+  }
+
+  return CreateHwQueue(size, event_callback, data, private_segment_size,
+                       queue);
+}
+
+core::QueueMultiplexer* GpuAgent::queue_multiplexer() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  if (queue_mux_ == NULL) {
+    queue_mux_ = new core::QueueMultiplexer(
+        queue_pool_size_,
+        [this](uint32_t size, uint32_t private_segment_size) -> core::Queue* {
+          core::Queue* queue = NULL;
+          CreateHwQueue(size, core::QueueMultiplexer::BackendError, queue_mux_,
+                        private_segment_size, &queue);
+          return queue;
+        });
+  }
+  return queue_mux_;
+}
+
+hsa_status_t GpuAgent::CreateHwQueue(size_t size,
+                                     core::HsaEventCallback event_callback,
+                                     void* data, uint32_t private_segment_size,
+                                     core::Queue** queue) {
+  // APU memory policy, along with APE1, is programmed on first use rather
+  // than at discovery.
+  if (properties_.NumCPUCores > 0 && ape1_base_ == 0) {
+    current_coherency_type(current_coherency_type_);
+  }
+
   // Allocate scratch memory
   ScratchInfo scratch;
 #if defined(HSA_LARGE_MODEL) && defined(__linux__)
@@ -399,19 +493,28 @@ hsa_status_t GpuAgent::QueueCreate(size_t size, hsa_queue_type_t queue_type,
 
 void GpuAgent::TranslateTime(core::Signal* signal,
                              hsa_amd_profiling_dispatch_time_t& time) {
-  // Ensure interpolation
-  if (t1_.GPUClockCounter < signal->signal_.end_ts) SyncClocks();
-
-  time.start = uint64_t(
-      (double(int64_t(t0_.SystemClockCounter - t1_.SystemClockCounter)) /
-       double(int64_t(t0_.GPUClockCounter - t1_.GPUClockCounter))) *
-          double(int64_t(signal->signal_.start_ts - t1_.GPUClockCounter)) +
-      double(t1_.SystemClockCounter));
-  time.end = uint64_t(
-      (double(int64_t(t0_.SystemClockCounter - t1_.SystemClockCounter)) /
-       double(int64_t(t0_.GPUClockCounter - t1_.GPUClockCounter))) *
-          double(int64_t(signal->signal_.end_ts - t1_.GPUClockCounter)) +
-      double(t1_.SystemClockCounter));
+  const ClockConverter clock = ReadClock(signal->signal_.end_ts);
+  time.start = clock.Convert(signal->signal_.start_ts);
+  time.end = clock.Convert(signal->signal_.end_ts);
+}
+
+ClockConverter GpuAgent::ReadClock(uint64_t gpu_counter) {
+  ClockConverter clock;
+  uint64_t sampled;
+  // Past the newest sample the model extrapolates, which is only trusted
+  // while the clock service keeps it fresh.
+  if (!clock_model_.Read(clock, sampled) ||
+      (sampled < gpu_counter &&
+       !core::Runtime::runtime_singleton_->clock_service().Start())) {
+    SampleClocks();
+    if (!clock_model_.Read(clock, sampled)) {
+      // No fit yet, e.g. the GPU counter has not moved between samples.
+      // Time stamps still advance and stay near the system clock.
+      ScopedAcquire<KernelMutex> lock(&clock_lock_);
+      clock = clock_model_.Anchor();
+    }
+  }
+  return clock;
 }
 
 bool GpuAgent::current_coherency_type(hsa_amd_coherency_type_t type) {
@@ -449,9 +552,13 @@ uint16_t GpuAgent::GetMicrocodeVersion() const {
   return (properties_.EngineId.ui32.uCode);
 }
 
-void GpuAgent::SyncClocks() {
-  HSAKMT_STATUS err = hsaKmtGetClockCounters(node_id_, &t1_);
+void GpuAgent::SampleClocks() {
+  HsaClockCounters clocks;
+  HSAKMT_STATUS err = hsaKmtGetClockCounters(node_id_, &clocks);
   assert(err == HSAKMT_STATUS_SUCCESS && "hsaGetClockCounters error");
+
+  ScopedAcquire<KernelMutex> lock(&clock_lock_);
+  clock_model_.AddSample(clocks);
 }
 
 }  // namespace
@@ -63,6 +63,7 @@
 
 #include "core/inc/runtime.h"
 #include "core/inc/amd_memory_region.h"
+#include "core/inc/metrics.h"
 #include "core/inc/signal.h"
 #include "core/inc/queue.h"
 #include "core/util/utils.h"
@@ -219,6 +220,8 @@ HwAqlCommandProcessor::HwAqlCommandProcessor(
   AMD_HSA_BITS_SET(amd_queue_.queue_properties, AMD_QUEUE_PROPERTIES_IS_PTR64,
                    0);
 #endif
+  AMD_HSA_BITS_SET(amd_queue_.queue_properties,
+                   AMD_QUEUE_PROPERTIES_INLINE_INDICES, 1);
 
   // Populate scratch resource descriptor in amd_queue_.
   SQ_BUF_RSRC_WORD0 srd0;
@@ -706,11 +709,11 @@ bool HwAqlCommandProcessor::DynamicScratchHandler(hsa_signal_value_t error_code,
 
     uint32_t scratch_request = pkt.dispatch.private_segment_size;
 
-    const amd_kernel_code_t* kernel_code_object =
-        (amd_kernel_code_t*)pkt.dispatch.kernel_object;
+    hsa_amd_kernel_descriptor_t kernel;
+    core::Runtime::runtime_singleton_->GetKernelDescriptor(
+        pkt.dispatch.kernel_object, &kernel);
 
-    if (scratch_request <
-        kernel_code_object->workitem_private_segment_byte_size) {
+    if (scratch_request < kernel.private_segment_size) {
       // Malformed AQL packet - insufficient scratch request
       queue->Inactivate();
       if (queue->errors_callback_ != NULL)
@@ -738,6 +741,8 @@ bool HwAqlCommandProcessor::DynamicScratchHandler(hsa_signal_value_t error_code,
                                 queue->public_handle(), queue->errors_data_);
       return false;
     }
+    core::metrics::Add(core::metrics::kScratchGrows);
+    core::metrics::Record(core::metrics::kScratchGrowBytes, scratch.size);
 
     SQ_BUF_RSRC_WORD0 srd0;
     SQ_BUF_RSRC_WORD2 srd2;
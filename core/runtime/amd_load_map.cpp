@@ -47,6 +47,7 @@
 #include <cassert>
 #include "core/inc/amd_hsa_loader.hpp"
 #include "core/inc/amd_load_map.h"
+#include "core/inc/metrics.h"
 #include "core/inc/runtime.h"
 
 using amd::hsa::loader::Executable;
@@ -71,7 +72,20 @@ hsa_status_t amd_executable_load_code_object(
   if (nullptr == exec) {
     return HSA_STATUS_ERROR_INVALID_EXECUTABLE;
   }
-  return exec->LoadCodeObject(agent, code_object, options, loaded_code_object);
+  if (!core::metrics::Enabled()) {
+    return exec->LoadCodeObject(agent, code_object, options, loaded_code_object);
+  }
+
+  timer::fast_clock::time_point start = timer::fast_clock::now();
+  hsa_status_t status =
+    exec->LoadCodeObject(agent, code_object, options, loaded_code_object);
+  if (HSA_STATUS_SUCCESS == status) {
+    core::metrics::AddShard(core::metrics::kCodeObjectsLoaded, 1);
+    core::metrics::RecordShard(core::metrics::kCodeObjectLoadNs,
+      uint64_t(timer::duration_cast<std::chrono::nanoseconds>(
+        timer::fast_clock::now() - start).count()));
+  }
+  return status;
 }
 
 hsa_status_t amd_iterate_executables(
@@ -45,11 +45,16 @@
 ////////////////////////////////////////////////////////////////////////////////
 #include "core/inc/amd_loader_context.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include "inc/hsa_ext_amd.h"
+#include "core/inc/metrics.h"
+#include "core/inc/runtime.h"
+#include <thread>
 #include <utility>
+#include <vector>
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
@@ -65,10 +70,361 @@
 
 namespace amd {
 
+namespace {
+
+const size_t kCodePageSize = 4096;
+
+size_t AlignSize(size_t value, size_t align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+} // namespace anonymous
+
+//===----------------------------------------------------------------------===//
+// CodeArena.                                                                 //
+//===----------------------------------------------------------------------===//
+
+CodeArena::~CodeArena() {
+  // The runtime is torn down by now, along with the registrations.
+  for (auto &chunk : chunks_) {
+    UnmapChunk((void*) chunk.first, chunk.second.size);
+  }
+}
+
+void* CodeArena::Allocate(size_t size, size_t align) {
+  assert(size);
+  assert(align);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (current_) {
+    Chunk &chunk = chunks_[current_];
+    size_t offset = AlignSize(current_ + chunk.offset, align) - current_;
+    if (offset + size <= chunk.size) {
+      chunk.offset = offset + size;
+      chunk.live++;
+      return (void*) (current_ + offset);
+    }
+  }
+
+  // Alignment beyond a page is not guaranteed by the mapping, reserve room
+  // to align inside the chunk.
+  size_t padding = align > kCodePageSize ? align : 0;
+  size_t chunk_size = AlignSize(size + padding, kCodePageSize);
+  bool shared = chunk_size <= kChunkSize / 2;
+  if (shared) {
+    chunk_size = kChunkSize;
+  }
+
+  void *base = MapChunk(chunk_size);
+  if (!base) {
+    return NULL;
+  }
+
+  uintptr_t address = (uintptr_t) base;
+  size_t offset = AlignSize(address, align) - address;
+  Chunk chunk = {chunk_size, offset + size, 1};
+  chunks_[address] = chunk;
+
+  if (shared) {
+    if (current_ && 0 == chunks_[current_].live) {
+      hsa_memory_deregister((void*) current_, chunks_[current_].size);
+      ReleaseChunk((void*) current_, chunks_[current_].size);
+      chunks_.erase(current_);
+    }
+    current_ = address;
+  }
+
+  return (void*) (address + offset);
+}
+
+void CodeArena::Free(void *ptr) {
+  assert(ptr);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto chunk = chunks_.upper_bound((uintptr_t) ptr);
+  assert(chunk != chunks_.begin());
+  --chunk;
+  assert((uintptr_t) ptr < chunk->first + chunk->second.size);
+  assert(chunk->second.live);
+
+  if (0 != --chunk->second.live) {
+    return;
+  }
+
+  if (chunk->first == current_) {
+    // Keep the chunk being filled mapped, it is about to be reused.
+    chunk->second.offset = 0;
+    return;
+  }
+
+  hsa_memory_deregister((void*) chunk->first, chunk->second.size);
+  ReleaseChunk((void*) chunk->first, chunk->second.size);
+  chunks_.erase(chunk);
+}
+
+bool CodeArena::Contains(const void *ptr, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto chunk = chunks_.upper_bound((uintptr_t) ptr);
+  if (chunk == chunks_.begin()) {
+    return false;
+  }
+  --chunk;
+  return 0 != chunk->second.live &&
+         (uintptr_t) ptr + size <= chunk->first + chunk->second.size;
+}
+
+size_t CodeArena::ChunkCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunks_.size();
+}
+
+size_t CodeArena::PageCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t pages = 0;
+  for (auto &chunk : chunks_) {
+    pages += chunk.second.size / kCodePageSize;
+  }
+  return pages;
+}
+
+void* CodeArena::MapChunk(size_t size) {
+  void *result = NULL;
+
+#if defined(_WIN32) || defined(_WIN64)
+  result = (void*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+  result = (void*)mmap(NULL, size, PROT_EXEC | PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+  if (MAP_FAILED == result) {
+    result = NULL;
+  }
+#endif
+  if (!result) {
+    return NULL;
+  }
+
+  if (HSA_STATUS_SUCCESS != hsa_memory_register(result, size)) {
+    UnmapChunk(result, size);
+    return NULL;
+  }
+
+  core::metrics::Add(core::metrics::kCodeArenaRegistrations);
+  core::metrics::Add(core::metrics::kCodeArenaChunks);
+  core::metrics::Add(core::metrics::kCodeArenaPages, size / kCodePageSize);
+  return result;
+}
+
+void CodeArena::ReleaseChunk(void *ptr, size_t size) {
+  core::metrics::Add(core::metrics::kCodeArenaChunks, -1);
+  core::metrics::Add(core::metrics::kCodeArenaPages, -(int64_t) (size / kCodePageSize));
+  UnmapChunk(ptr, size);
+}
+
+void CodeArena::UnmapChunk(void *ptr, size_t size) {
+#if defined(_WIN32) || defined(_WIN64)
+  VirtualFree(ptr, size, MEM_DECOMMIT);
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, size);
+#endif
+}
+
+//===----------------------------------------------------------------------===//
+// CopyQueue.                                                                 //
+//===----------------------------------------------------------------------===//
+
+CopyQueue::~CopyQueue() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    exit_ = true;
+  }
+  work_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+bool CopyQueue::Submit(const std::function<bool()> &copy) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!worker_.joinable()) {
+    try {
+      worker_ = std::thread(&CopyQueue::Run, this);
+    } catch (...) {
+      return false;
+    }
+  }
+  copies_.push_back(copy);
+  pending_++;
+  work_.notify_one();
+  return true;
+}
+
+bool CopyQueue::Wait() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (0 != pending_) {
+    idle_.wait(lock);
+  }
+  bool succeeded = !failed_;
+  failed_ = false;
+  return succeeded;
+}
+
+void CopyQueue::Run() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    while (copies_.empty() && !exit_) {
+      work_.wait(lock);
+    }
+    if (copies_.empty()) {
+      return;
+    }
+
+    std::function<bool()> copy = std::move(copies_.front());
+    copies_.pop_front();
+    lock.unlock();
+    bool succeeded = copy();
+    lock.lock();
+
+    failed_ |= !succeeded;
+    if (0 == --pending_) {
+      idle_.notify_all();
+    }
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// WorkerPool.                                                                //
+//===----------------------------------------------------------------------===//
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    exit_ = true;
+  }
+  work_.notify_all();
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void WorkerPool::Run(size_t count, size_t thread_count, const std::function<void(size_t)> &fn) {
+  if (thread_count < 2 || count < 2) {
+    for (size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  Job job;
+  job.fn = &fn;
+  job.count = count;
+  job.next = 0;
+  job.active = 0;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    while (workers_.size() < thread_count - 1) {
+      try {
+        workers_.push_back(std::thread(&WorkerPool::Work, this));
+      } catch (...) {
+        // Out of threads, the workers already started and the caller finish.
+        break;
+      }
+    }
+    jobs_.push_back(&job);
+  }
+  work_.notify_all();
+
+  Drain(job);
+
+  // The items are all taken, wait for workers still running one.
+  std::unique_lock<std::mutex> lock(lock_);
+  std::deque<Job*>::iterator it = std::find(jobs_.begin(), jobs_.end(), &job);
+  if (it != jobs_.end()) {
+    jobs_.erase(it);
+  }
+  while (0 != job.active) {
+    done_.wait(lock);
+  }
+}
+
+void WorkerPool::Drain(Job &job) {
+  for (size_t i = job.next++; i < job.count; i = job.next++) {
+    (*job.fn)(i);
+  }
+}
+
+void WorkerPool::Work() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    while (jobs_.empty() && !exit_) {
+      work_.wait(lock);
+    }
+    if (exit_) {
+      return;
+    }
+
+    Job *job = jobs_.front();
+    job->active++;
+    lock.unlock();
+    Drain(*job);
+    lock.lock();
+
+    // Drained jobs leave the queue so idle workers wait for the next one.
+    std::deque<Job*>::iterator it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end()) {
+      jobs_.erase(it);
+    }
+    if (0 == --job->active) {
+      done_.notify_all();
+    }
+  }
+}
+
 //===----------------------------------------------------------------------===//
 // LoaderContext - Public.                                                    //
 //===----------------------------------------------------------------------===//
 
+LoaderContext::LoaderContext(): hsa::loader::Context(), load_thread_count_(1), pipelined_load_(false), lazy_symbols_(false) {}
+
+void LoaderContext::Configure() {
+  load_thread_count_ = 1;
+  cache_directory_.clear();
+  pipelined_load_ = false;
+  lazy_symbols_ = false;
+
+  // HSA_LOADER_THREADS=N loads code objects on N threads, 0 uses all cores.
+  const char *threads = getenv("HSA_LOADER_THREADS");
+  if (threads && *threads) {
+    long count = strtol(threads, NULL, 10);
+    if (0 == count) {
+      count = (long) std::thread::hardware_concurrency();
+    }
+    if (count > 1) {
+      load_thread_count_ = (size_t) count;
+    }
+  }
+
+  // HSA_LOADER_CACHE_DIR=path keeps pre-resolved code object loads in path.
+  const char *cache_directory = getenv("HSA_LOADER_CACHE_DIR");
+  if (cache_directory) {
+    cache_directory_ = cache_directory;
+  }
+
+  // HSA_LOADER_PIPELINE=1 uploads segments in the background until freeze.
+  const char *pipeline = getenv("HSA_LOADER_PIPELINE");
+  if (pipeline && 0 == strcmp(pipeline, "1")) {
+    pipelined_load_ = true;
+  }
+
+  // HSA_LOADER_LAZY_SYMBOLS=1 creates executable symbols on first use.
+  const char *lazy_symbols = getenv("HSA_LOADER_LAZY_SYMBOLS");
+  if (lazy_symbols && 0 == strcmp(lazy_symbols, "1")) {
+    lazy_symbols_ = true;
+  }
+}
+
 hsa_isa_t LoaderContext::IsaFromName(const char *name) {
   assert(name);
 
@@ -138,6 +494,21 @@ bool LoaderContext::SegmentCopy(amdgpu_hsa_elf_segment_t segment, hsa_agent_t ag
   }
 }
 
+bool LoaderContext::SegmentCopyAsync(amdgpu_hsa_elf_segment_t segment, hsa_agent_t agent, void* dst, size_t offset, const void* src, size_t size)
+{
+  if (!pipelined_load_) {
+    return SegmentCopy(segment, agent, dst, offset, src, size);
+  }
+  return copy_queue_.Submit([this, segment, agent, dst, offset, src, size]() {
+    return SegmentCopy(segment, agent, dst, offset, src, size);
+  });
+}
+
+bool LoaderContext::SegmentCopyWait()
+{
+  return copy_queue_.Wait();
+}
+
 void LoaderContext::SegmentFree(amdgpu_hsa_elf_segment_t segment, hsa_agent_t agent, void* seg, size_t size)
 {
   switch (segment) {
@@ -198,29 +569,11 @@ void* LoaderContext::KernelCodeAlloc(hsa_agent_t agent, size_t size, size_t alig
   assert(size);
   assert(align);
 
-  hsa_status_t hsa_status = HSA_STATUS_SUCCESS;
-  void *result = NULL;
-
-#if defined(_WIN32) || defined(_WIN64)
-  result = (void*)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-#else
-  result = (void*)mmap(NULL, size, PROT_EXEC | PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-#endif
+  void *result = code_arena_.Allocate(size, align);
   if (!result) {
     return NULL;
   }
 
-  hsa_status = hsa_memory_register(result, size);
-  if (HSA_STATUS_SUCCESS != hsa_status) {
-#if defined(_WIN32) || defined(_WIN64)
-    VirtualFree(result, size, MEM_DECOMMIT);
-    VirtualFree(result, 0, MEM_RELEASE);
-#else
-    munmap(result, size);
-#endif
-    return NULL;
-  }
-
   return zero ? memset(result, 0x0, size) : result;
 }
 
@@ -237,14 +590,11 @@ void LoaderContext::KernelCodeFree(void *ptr, size_t size) {
   assert(ptr);
   assert(size);
 
-  hsa_memory_deregister(ptr, size);
+  // The arena hands the range out again, drop descriptors cached for it.
+  uint64_t begin = (uint64_t) (uintptr_t) ptr;
+  core::Runtime::runtime_singleton_->EraseKernelDescriptors(begin, begin + size);
 
-#if defined(_WIN32) || defined(_WIN64)
-  VirtualFree(ptr, size, MEM_DECOMMIT);
-  VirtualFree(ptr, 0, MEM_RELEASE);
-#else
-  munmap(ptr, size);
-#endif
+  code_arena_.Free(ptr);
 }
 
 bool LoaderContext::ImageExtensionSupported() {
@@ -304,6 +654,35 @@ hsa_status_t LoaderContext::SamplerDestroy(hsa_agent_t agent, hsa_ext_sampler_t
   return hsa_ext_sampler_destroy(agent, sampler_handle);
 }
 
+std::string LoaderContext::AgentCacheKey(hsa_agent_t agent) {
+  assert(agent.handle);
+
+  char agent_name[64] = {0};
+  hsa_status_t hsa_status = hsa_agent_get_info(agent, HSA_AGENT_INFO_NAME, agent_name);
+  if (HSA_STATUS_SUCCESS != hsa_status) {
+    return std::string();
+  }
+
+  hsa_isa_t agent_isa; agent_isa.handle = 0;
+  hsa_status = hsa_agent_get_info(agent, HSA_AGENT_INFO_ISA, &agent_isa);
+  if (HSA_STATUS_SUCCESS != hsa_status) {
+    return std::string();
+  }
+
+  uint32_t isa_name_length = 0;
+  hsa_status = hsa_isa_get_info(agent_isa, HSA_ISA_INFO_NAME_LENGTH, 0, &isa_name_length);
+  if (HSA_STATUS_SUCCESS != hsa_status || 0 == isa_name_length) {
+    return std::string();
+  }
+  std::vector<char> isa_name(isa_name_length + 1, '\0');
+  hsa_status = hsa_isa_get_info(agent_isa, HSA_ISA_INFO_NAME, 0, isa_name.data());
+  if (HSA_STATUS_SUCCESS != hsa_status) {
+    return std::string();
+  }
+
+  return std::string(agent_name, strnlen(agent_name, sizeof(agent_name))) + ";" + isa_name.data();
+}
+
 void LoaderContext::Reset() {
   std::lock_guard<std::mutex> lock(agent2region_mutex_);
   agent2region_.clear();
@@ -382,23 +761,15 @@ void* LoaderContext::AgentAlloc(hsa_agent_t agent, size_t size, size_t align, bo
 
   assert(result);
 
-  // @todo(runtime): need more efficient way of allocating zero-initialized
-  // memory.
+  // Zero on the device, allocations are at least page granular so rounding
+  // up to whole dwords stays inside the allocation.
   if (zero) {
-    void *zero_initialized = calloc(size, 1);
-    if (!zero_initialized) {
-      hsa_memory_free(result);
-      return NULL;
-    }
-
-    hsa_status = hsa_memory_copy(result, zero_initialized, size);
+    hsa_status = hsa_amd_memory_fill(
+        result, 0, (size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
     if (HSA_STATUS_SUCCESS != hsa_status) {
       hsa_memory_free(result);
-      free(zero_initialized);
       return NULL;
     }
-
-    free(zero_initialized);
   }
 
   return result;
@@ -0,0 +1,141 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+#include "core/inc/amd_profiling_collector.h"
+
+#include <stdlib.h>
+
+#include "core/inc/amd_gpu_agent.h"
+#include "core/inc/signal.h"
+#include "core/util/os.h"
+
+namespace amd {
+// Default number of records kept per queue.
+static const uint32_t kDefaultRingSize = 16384;
+
+// Smallest ring accepted from the environment.
+static const uint32_t kMinRingSize = 64;
+
+ProfilingCollector::ProfilingCollector() : ring_size_(kDefaultRingSize) {
+  const uint32_t requested =
+      uint32_t(atoi(os::GetEnvVar("HSA_PROFILING_RING_SIZE").c_str()));
+  if (requested != 0) ring_size_ = NextPow2(Max(requested, kMinRingSize));
+}
+
+std::shared_ptr<ProfilingCollector::Ring> ProfilingCollector::GetRing(
+    uint64_t queue_id, bool create) {
+  ScopedAcquire<KernelMutex> lock(&rings_lock_);
+  auto it = rings_.find(queue_id);
+  if (it != rings_.end()) return it->second;
+  if (!create) return std::shared_ptr<Ring>();
+
+  std::shared_ptr<Ring> ring(new Ring());
+  ring->records.resize(ring_size_);
+  ring->head = ring->tail = ring->dropped = 0;
+  rings_[queue_id] = ring;
+  return ring;
+}
+
+void ProfilingCollector::Collect(GpuAgentInt* agent, uint64_t queue_id,
+                                 uint32_t count, const hsa_signal_t* signals) {
+  if (count == 0) return;
+
+  // One read that covers the latest completion converts the whole batch.
+  uint64_t latest = 0;
+  for (uint32_t i = 0; i < count; i++)
+    latest = Max(latest, core::Signal::Convert(signals[i])->signal_.end_ts);
+
+  const ClockConverter clock = agent->ReadClock(latest);
+
+  std::shared_ptr<Ring> ring = GetRing(queue_id, true);
+  const uint64_t mask = ring_size_ - 1;
+
+  ScopedAcquire<KernelMutex> lock(&ring->lock);
+  for (uint32_t i = 0; i < count; i++) {
+    const amd_signal_t& signal = core::Signal::Convert(signals[i])->signal_;
+    hsa_amd_profiling_record_t& record = ring->records[ring->tail & mask];
+    record.signal = signals[i];
+    record.start = clock.Convert(signal.start_ts);
+    record.end = clock.Convert(signal.end_ts);
+    ring->tail++;
+  }
+
+  // Overwritten records are accounted for once per batch.
+  const uint64_t used = ring->tail - ring->head;
+  if (used > ring_size_) {
+    ring->dropped += used - ring_size_;
+    ring->head = ring->tail - ring_size_;
+  }
+}
+
+uint32_t ProfilingCollector::Drain(uint64_t queue_id, uint32_t capacity,
+                                   hsa_amd_profiling_record_t* records,
+                                   uint64_t* dropped) {
+  std::shared_ptr<Ring> ring = GetRing(queue_id, false);
+  if (!ring) {
+    if (dropped != NULL) *dropped = 0;
+    return 0;
+  }
+
+  const uint64_t mask = ring_size_ - 1;
+
+  ScopedAcquire<KernelMutex> lock(&ring->lock);
+  const uint32_t count =
+      uint32_t(Min(uint64_t(capacity), ring->tail - ring->head));
+  for (uint32_t i = 0; i < count; i++)
+    records[i] = ring->records[(ring->head + i) & mask];
+  ring->head += count;
+
+  if (dropped != NULL) *dropped = ring->dropped;
+  ring->dropped = 0;
+  return count;
+}
+
+void ProfilingCollector::EraseQueue(uint64_t queue_id) {
+  ScopedAcquire<KernelMutex> lock(&rings_lock_);
+  rings_.erase(queue_id);
+}
+
+}  // namespace amd
@@ -1,6 +1,7 @@
 #include "core/inc/amd_sdma_cmdwriter_kv.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstring>
 
 namespace amd {
@@ -10,6 +11,7 @@ namespace amd {
 const unsigned int SDMA_OP_NOP = 0;
 const unsigned int SDMA_OP_COPY = 1;
 const unsigned int SDMA_OP_FENCE = 5;
+const unsigned int SDMA_OP_CONST_FILL = 11;
 const unsigned int SDMA_SUBOP_COPY_LINEAR = 0;
 
 typedef struct SDMA_PKT_COPY_LINEAR_TAG {
@@ -102,6 +104,51 @@ typedef struct SDMA_PKT_FENCE_TAG {
   } DATA_UNION;
 } SDMA_PKT_FENCE;
 
+typedef struct SDMA_PKT_CONSTANT_FILL_TAG {
+  union {
+    struct {
+      unsigned int op : 8;
+      unsigned int sub_op : 8;
+      unsigned int sw : 2;
+      unsigned int reserved_0 : 12;
+      unsigned int fillsize : 2;
+    };
+    unsigned int DW_0_DATA;
+  } HEADER_UNION;
+
+  union {
+    struct {
+      unsigned int dst_addr_31_0 : 32;
+    };
+    unsigned int DW_1_DATA;
+  } DST_ADDR_LO_UNION;
+
+  union {
+    struct {
+      unsigned int dst_addr_63_32 : 32;
+    };
+    unsigned int DW_2_DATA;
+  } DST_ADDR_HI_UNION;
+
+  union {
+    struct {
+      unsigned int src_data_31_0 : 32;
+    };
+    unsigned int DW_3_DATA;
+  } DATA_UNION;
+
+  union {
+    struct {
+      unsigned int count : 22;
+      unsigned int reserved_0 : 10;
+    };
+    unsigned int DW_4_DATA;
+  } COUNT_UNION;
+} SDMA_PKT_CONSTANT_FILL;
+
+// Fill size encoding of SDMA_PKT_CONSTANT_FILL, dword fills only.
+const unsigned int SDMA_CONSTANT_FILL_DWORD = 2;
+
 inline uint32_t ptrlow32(const void* p) {
   return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(p));
 }
@@ -117,6 +164,7 @@ inline uint32_t ptrhigh32(const void* p) {
 SdmaCmdwriterKv::SdmaCmdwriterKv(size_t sdma_queue_buffer_size) {
   linear_copy_command_size_ = sizeof(SDMA_PKT_COPY_LINEAR);
   fence_command_size_ = sizeof(SDMA_PKT_FENCE);
+  constant_fill_command_size_ = sizeof(SDMA_PKT_CONSTANT_FILL);
 
   const uint32_t sync_command_size = fence_command_size_;
   const uint32_t max_num_copy_command = std::floor(
@@ -124,6 +172,7 @@ SdmaCmdwriterKv::SdmaCmdwriterKv(size_t sdma_queue_buffer_size) {
       linear_copy_command_size_);
 
   max_single_linear_copy_size_ = 0x3fffe0;
+  max_single_constant_fill_size_ = 0x3fffe0;
   max_total_linear_copy_size_ = static_cast<size_t>(
       std::min(static_cast<uint64_t>(SIZE_MAX),
                static_cast<uint64_t>(max_num_copy_command) *
@@ -152,6 +201,25 @@ void SdmaCmdwriterKv::WriteLinearCopyCommand(char* command_buffer, void* dst,
   packet_addr->DST_ADDR_HI_UNION.dst_addr_63_32 = ptrhigh32(dst);
 }
 
+void SdmaCmdwriterKv::WriteConstantFillCommand(char* command_buffer,
+                                               void* dst, uint32_t value,
+                                               uint32_t fill_size) {
+  SDMA_PKT_CONSTANT_FILL* packet_addr =
+      reinterpret_cast<SDMA_PKT_CONSTANT_FILL*>(command_buffer);
+
+  memset(packet_addr, 0, sizeof(SDMA_PKT_CONSTANT_FILL));
+
+  packet_addr->HEADER_UNION.op = SDMA_OP_CONST_FILL;
+  packet_addr->HEADER_UNION.fillsize = SDMA_CONSTANT_FILL_DWORD;
+
+  packet_addr->DST_ADDR_LO_UNION.dst_addr_31_0 = ptrlow32(dst);
+  packet_addr->DST_ADDR_HI_UNION.dst_addr_63_32 = ptrhigh32(dst);
+
+  packet_addr->DATA_UNION.src_data_31_0 = value;
+
+  packet_addr->COUNT_UNION.count = fill_size;
+}
+
 void SdmaCmdwriterKv::WriteFenceCommand(char* command_buffer,
                                         uint32_t* fence_address,
                                         uint32_t fence_value) {
@@ -48,6 +48,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <string>
 #include <vector>
 
 #include "core/inc/runtime.h"
@@ -55,7 +56,9 @@
 #include "core/inc/amd_gpu_agent.h"
 #include "core/inc/amd_dgpu_agent.h"
 #include "core/inc/amd_memory_region.h"
+#include "core/inc/amd_topology_cache.h"
 #include "core/inc/thunk.h"
+#include "core/util/os.h"
 #include "core/util/utils.h"
 
 namespace amd {
@@ -63,107 +66,103 @@ namespace amd {
 static const uint kKfdVersionMajor = 0;
 static const uint kKfdVersionMinor = 99;
 
-CpuAgent* DiscoverCpu(HSAuint32 node_id, HsaNodeProperties& node_prop) {
-  if (node_prop.NumCPUCores == 0) {
+// Background acquisition of the thunk's topology after init was served from
+// the topology cache.
+struct TopologyCheck {
+  Topology snapshot;
+  std::string cache_directory;
+  // The thunk's topology, valid if acquired is set.
+  Topology current;
+  bool acquired;
+  bool stale;
+};
+
+static os::Thread topology_thread = NULL;
+static TopologyCheck* topology_check = NULL;
+
+CpuAgent* DiscoverCpu(const NodeTopology& node) {
+  if (node.properties.NumCPUCores == 0) {
     return NULL;
   }
 
-  // Get CPU cache information.
-  std::vector<HsaCacheProperties> cache_props(node_prop.NumCaches);
-  if (HSAKMT_STATUS_SUCCESS !=
-      hsaKmtGetNodeCacheProperties(node_id, node_prop.CComputeIdLo,
-                                   node_prop.NumCaches, &cache_props[0])) {
-    cache_props.clear();
-  } else {
-    // Only store CPU D-cache.
-    for (size_t cache_id = 0; cache_id < cache_props.size(); ++cache_id) {
-      const HsaCacheType type = cache_props[cache_id].CacheType;
-      if (type.ui32.CPU != 1 || type.ui32.Instruction == 1) {
-        cache_props.erase(cache_props.begin() + cache_id);
-        --cache_id;
-      }
+  // Only store CPU D-cache.
+  std::vector<HsaCacheProperties> cache_props;
+  for (size_t cache_id = 0; cache_id < node.cpu_caches.size(); ++cache_id) {
+    const HsaCacheType type = node.cpu_caches[cache_id].CacheType;
+    if (type.ui32.CPU == 1 && type.ui32.Instruction != 1) {
+      cache_props.push_back(node.cpu_caches[cache_id]);
     }
   }
 
-  CpuAgent* cpu = new CpuAgent(node_id, node_prop, cache_props);
+  CpuAgent* cpu = new CpuAgent(node.node_id, node.properties, cache_props);
   core::Runtime::runtime_singleton_->RegisterAgent(cpu);
 
   return cpu;
 }
 
-GpuAgent* DiscoverGpu(HSAuint32 node_id, HsaNodeProperties& node_prop) {
+GpuAgent* DiscoverGpu(const NodeTopology& node) {
+  const HSAuint32 node_id = node.node_id;
+  const HsaNodeProperties& node_prop = node.properties;
   if (node_prop.NumFComputeCores == 0) {
     return NULL;
   }
 
-  // Get GPU cache information.
-  // Similar to getting CPU cache but here we use FComputeIdLo.
-  std::vector<HsaCacheProperties> cache_props(node_prop.NumCaches);
-  if (HSAKMT_STATUS_SUCCESS !=
-      hsaKmtGetNodeCacheProperties(node_id, node_prop.FComputeIdLo,
-                                   node_prop.NumCaches, &cache_props[0])) {
-    cache_props.clear();
-  } else {
-    // Only store GPU D-cache.
-    for (size_t cache_id = 0; cache_id < cache_props.size(); ++cache_id) {
-      const HsaCacheType type = cache_props[cache_id].CacheType;
-      if (type.ui32.HSACU != 1 || type.ui32.Instruction == 1) {
-        cache_props.erase(cache_props.begin() + cache_id);
-        --cache_id;
-      }
+  // Only store GPU D-cache.
+  std::vector<HsaCacheProperties> cache_props;
+  for (size_t cache_id = 0; cache_id < node.gpu_caches.size(); ++cache_id) {
+    const HsaCacheType type = node.gpu_caches[cache_id].CacheType;
+    if (type.ui32.HSACU == 1 && type.ui32.Instruction != 1) {
+      cache_props.push_back(node.gpu_caches[cache_id]);
     }
   }
 
   GpuAgent* gpu = NULL;
 
+  // The memory policy of APU nodes is programmed when the first queue is
+  // created, see GpuAgent::CreateHwQueue.
   const bool is_apu_node = (node_prop.NumCPUCores > 0);
   if (is_apu_node) {
     gpu = new GpuAgent(node_id, node_prop, cache_props);
-    gpu->current_coherency_type(HSA_AMD_COHERENCY_TYPE_COHERENT);
   } else {
     gpu = new DGpuAgent(node_id, node_prop, cache_props);
   }
 
   assert(gpu != NULL);
   core::Runtime::runtime_singleton_->RegisterAgent(gpu);
+  core::Runtime::runtime_singleton_->clock_service().AddAgent(gpu);
 
   // Discover memory regions.
   assert(node_prop.NumMemoryBanks > 0);
-  std::vector<HsaMemoryProperties> mem_props(node_prop.NumMemoryBanks);
-  if (HSAKMT_STATUS_SUCCESS ==
-      hsaKmtGetNodeMemoryProperties(node_id, node_prop.NumMemoryBanks,
-                                    &mem_props[0])) {
-    for (uint32_t mem_idx = 0; mem_idx < node_prop.NumMemoryBanks; ++mem_idx) {
-      // Ignore the one(s) with unknown size.
-      if (mem_props[mem_idx].SizeInBytes == 0) {
-        continue;
-      }
+  const std::vector<HsaMemoryProperties>& mem_props = node.memory_banks;
+  for (size_t mem_idx = 0; mem_idx < mem_props.size(); ++mem_idx) {
+    // Ignore the one(s) with unknown size.
+    if (mem_props[mem_idx].SizeInBytes == 0) {
+      continue;
+    }
 
-      if (mem_props[mem_idx].HeapType == HSA_HEAPTYPE_SYSTEM) {
-        if (core::Runtime::runtime_singleton_->system_region().handle == 0) {
-          const bool fine_grain = (is_apu_node) ? true : false;
-          MemoryRegion* system_region =
-              new MemoryRegion(fine_grain, node_id, mem_props[mem_idx]);
+    if (mem_props[mem_idx].HeapType == HSA_HEAPTYPE_SYSTEM) {
+      if (core::Runtime::runtime_singleton_->system_region().handle == 0) {
+        const bool fine_grain = (is_apu_node) ? true : false;
+        MemoryRegion* system_region =
+            new MemoryRegion(fine_grain, node_id, mem_props[mem_idx]);
 
-          core::Runtime::runtime_singleton_->RegisterMemoryRegion(
-              system_region);
-        }
-      } else {
-        switch (mem_props[mem_idx].HeapType) {
-          case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
-          case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
-          case HSA_HEAPTYPE_GPU_LDS:
-          case HSA_HEAPTYPE_GPU_SCRATCH:
-            if (gpu != NULL) {
-              MemoryRegion* region =
-                  new MemoryRegion(false, node_id, mem_props[mem_idx]);
-              core::Runtime::runtime_singleton_->RegisterMemoryRegion(region);
-              gpu->RegisterMemoryProperties(*(region));
-            }
-            break;
-          default:
-            continue;
-        }
+        core::Runtime::runtime_singleton_->RegisterMemoryRegion(system_region);
+      }
+    } else {
+      switch (mem_props[mem_idx].HeapType) {
+        case HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE:
+        case HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC:
+        case HSA_HEAPTYPE_GPU_LDS:
+        case HSA_HEAPTYPE_GPU_SCRATCH:
+          if (gpu != NULL) {
+            MemoryRegion* region =
+                new MemoryRegion(false, node_id, mem_props[mem_idx]);
+            core::Runtime::runtime_singleton_->RegisterMemoryRegion(region);
+            gpu->RegisterMemoryProperties(*(region));
+          }
+          break;
+        default:
+          continue;
       }
     }
   }
@@ -173,38 +172,110 @@ GpuAgent* DiscoverGpu(HSAuint32 node_id, HsaNodeProperties& node_prop) {
 
 /// @brief Calls Kfd thunk to get the snapshot of the topology of the system,
 /// which includes associations between, node, devices, memory and caches.
-void BuildTopology() {
-  HsaVersionInfo info;
-  if (hsaKmtGetVersion(&info) != HSAKMT_STATUS_SUCCESS) {
-    return;
-  }
-
-  if (info.KernelInterfaceMajorVersion == kKfdVersionMajor &&
-      info.KernelInterfaceMinorVersion < kKfdVersionMinor) {
-    return;
-  }
-
-  // Disable KFD event support when using open source KFD
-  if (info.KernelInterfaceMajorVersion == 1 &&
-      info.KernelInterfaceMinorVersion == 0)
-    core::g_use_interrupt_wait = false;
-
+static bool QueryTopology(const HsaVersionInfo& version, Topology& topology) {
   HsaSystemProperties props;
   hsaKmtReleaseSystemProperties();
 
   if (hsaKmtAcquireSystemProperties(&props) != HSAKMT_STATUS_SUCCESS) {
-    return;
+    return false;
   }
 
-  // Discover agents on every node in the platform.
+  topology.version = version;
+  topology.nodes.clear();
   for (HSAuint32 node_id = 0; node_id < props.NumNodes; node_id++) {
-    HsaNodeProperties node_prop = {0};
-    if (hsaKmtGetNodeProperties(node_id, &node_prop) != HSAKMT_STATUS_SUCCESS) {
+    NodeTopology node;
+    node.node_id = node_id;
+    std::memset(&node.properties, 0, sizeof(node.properties));
+    if (hsaKmtGetNodeProperties(node_id, &node.properties) !=
+        HSAKMT_STATUS_SUCCESS) {
       continue;
     }
+    const HsaNodeProperties& node_prop = node.properties;
+
+    // CPU and GPU caches are reported under their own processor ids.
+    if (node_prop.NumCPUCores != 0) {
+      node.cpu_caches.resize(node_prop.NumCaches);
+      if (node.cpu_caches.empty() ||
+          hsaKmtGetNodeCacheProperties(node_id, node_prop.CComputeIdLo,
+                                       node_prop.NumCaches,
+                                       &node.cpu_caches[0]) !=
+              HSAKMT_STATUS_SUCCESS) {
+        node.cpu_caches.clear();
+      }
+    }
+
+    if (node_prop.NumFComputeCores != 0) {
+      node.gpu_caches.resize(node_prop.NumCaches);
+      if (node.gpu_caches.empty() ||
+          hsaKmtGetNodeCacheProperties(node_id, node_prop.FComputeIdLo,
+                                       node_prop.NumCaches,
+                                       &node.gpu_caches[0]) !=
+              HSAKMT_STATUS_SUCCESS) {
+        node.gpu_caches.clear();
+      }
+
+      node.memory_banks.resize(node_prop.NumMemoryBanks);
+      if (node.memory_banks.empty() ||
+          hsaKmtGetNodeMemoryProperties(node_id, node_prop.NumMemoryBanks,
+                                        &node.memory_banks[0]) !=
+              HSAKMT_STATUS_SUCCESS) {
+        node.memory_banks.clear();
+      }
+    }
+
+    topology.nodes.push_back(node);
+  }
+
+  return true;
+}
+
+template <typename T>
+static bool SameRecords(const std::vector<T>& a, const std::vector<T>& b) {
+  return a.size() == b.size() &&
+         (a.empty() || std::memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+static bool SameTopology(const Topology& a, const Topology& b) {
+  if (a.nodes.size() != b.nodes.size()) return false;
+  for (size_t i = 0; i < a.nodes.size(); ++i) {
+    const NodeTopology& x = a.nodes[i];
+    const NodeTopology& y = b.nodes[i];
+    if (x.node_id != y.node_id ||
+        std::memcmp(&x.properties, &y.properties, sizeof(x.properties)) != 0 ||
+        !SameRecords(x.cpu_caches, y.cpu_caches) ||
+        !SameRecords(x.gpu_caches, y.gpu_caches) ||
+        !SameRecords(x.memory_banks, y.memory_banks)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief Acquires the thunk's topology, which node ids passed to later thunk
+/// calls are checked against, and replaces the cached snapshot init used if
+/// it turns out to be stale. WaitForTopology reports a stale snapshot so the
+/// agents built from it are rebuilt.
+static void AcquireTopology(void* arg) {
+  TopologyCheck* check = reinterpret_cast<TopologyCheck*>(arg);
+  check->acquired = QueryTopology(check->snapshot.version, check->current);
+  check->stale =
+      !check->acquired || !SameTopology(check->current, check->snapshot);
+  if (!check->stale) return;
+
+  TopologyCache cache(check->cache_directory);
+  if (check->acquired) {
+    cache.Store(check->current);
+  } else {
+    cache.Invalidate();
+  }
+}
 
-    const CpuAgent* cpu = DiscoverCpu(node_id, node_prop);
-    const GpuAgent* gpu = DiscoverGpu(node_id, node_prop);
+/// @brief Creates agents and memory regions for every node of @p topology.
+static void BuildAgents(const Topology& topology) {
+  // Discover agents on every node in the platform.
+  for (size_t i = 0; i < topology.nodes.size(); i++) {
+    const CpuAgent* cpu = DiscoverCpu(topology.nodes[i]);
+    const GpuAgent* gpu = DiscoverGpu(topology.nodes[i]);
 
     assert(!(cpu == NULL && gpu == NULL));
   }
@@ -251,6 +322,57 @@ void BuildTopology() {
       NULL);
 }
 
+/// @brief Builds agents and memory regions from the topology, reading it
+/// from the topology cache when HSA_TOPOLOGY_CACHE_DIR names one. On a cache
+/// hit the thunk's own topology is acquired in the background, see
+/// WaitForTopology.
+void BuildTopology() {
+  HsaVersionInfo info;
+  if (hsaKmtGetVersion(&info) != HSAKMT_STATUS_SUCCESS) {
+    return;
+  }
+
+  if (info.KernelInterfaceMajorVersion == kKfdVersionMajor &&
+      info.KernelInterfaceMinorVersion < kKfdVersionMinor) {
+    return;
+  }
+
+  // Disable KFD event support when using open source KFD
+  if (info.KernelInterfaceMajorVersion == 1 &&
+      info.KernelInterfaceMinorVersion == 0)
+    core::g_use_interrupt_wait = false;
+
+  Topology topology;
+  const std::string cache_directory = os::GetEnvVar("HSA_TOPOLOGY_CACHE_DIR");
+  if (!cache_directory.empty() &&
+      TopologyCache(cache_directory).Lookup(info, topology)) {
+    topology_check = new TopologyCheck();
+    topology_check->snapshot = topology;
+    topology_check->cache_directory = cache_directory;
+    topology_check->acquired = false;
+    topology_check->stale = false;
+    topology_thread = os::CreateThread(AcquireTopology, topology_check);
+    if (topology_thread == NULL) AcquireTopology(topology_check);
+  } else {
+    if (!QueryTopology(info, topology)) {
+      return;
+    }
+    if (!cache_directory.empty()) {
+      TopologyCache(cache_directory).Store(topology);
+    }
+  }
+
+  BuildAgents(topology);
+}
+
+static void JoinTopologyThread() {
+  if (topology_thread != NULL) {
+    os::WaitForThread(topology_thread);
+    os::CloseThread(topology_thread);
+    topology_thread = NULL;
+  }
+}
+
 void Load() {
   // Open KFD
   if (hsaKmtOpenKFD() != HSAKMT_STATUS_SUCCESS) return;
@@ -259,8 +381,58 @@ void Load() {
   BuildTopology();
 }
 
+/// @brief Anchors each GPU clock model at init, which agent construction no
+/// longer does as it must not call the thunk with a node id.
+static void SampleAgentClocks() {
+  core::Runtime::runtime_singleton_->IterateAgent(
+      [](hsa_agent_t agent, void* data) -> hsa_status_t {
+        core::Agent* core_agent = core::Agent::Convert(agent);
+        if (core_agent->device_type() ==
+            core::Agent::DeviceType::kAmdGpuDevice) {
+          reinterpret_cast<amd::GpuAgent*>(core_agent)->SampleClocks();
+        }
+        return HSA_STATUS_SUCCESS;
+      },
+      NULL);
+}
+
+bool WaitForTopology() {
+  JoinTopologyThread();
+
+  if (topology_check != NULL && topology_check->stale) {
+    debug_print("HSA runtime: topology snapshot in %s is stale, rebuilding "
+                "agents from the thunk's topology\n",
+                topology_check->cache_directory.c_str());
+    return false;
+  }
+
+  delete topology_check;
+  topology_check = NULL;
+
+  SampleAgentClocks();
+  return true;
+}
+
+void RebuildTopology() {
+  assert(topology_check != NULL && topology_check->stale);
+  assert(core::Runtime::runtime_singleton_->system_region().handle == 0);
+
+  // Like an uncached init, no agents are created if the thunk's topology
+  // could not be acquired.
+  if (topology_check->acquired) BuildAgents(topology_check->current);
+
+  delete topology_check;
+  topology_check = NULL;
+
+  SampleAgentClocks();
+}
+
 // Releases internal resources and unloads DLLs
 void Unload() {
+  JoinTopologyThread();
+  delete topology_check;
+  topology_check = NULL;
+
   hsaKmtReleaseSystemProperties();
 
   // Close KFD
@@ -0,0 +1,142 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/amd_topology_cache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "amd_hsa_cache_file.hpp"
+
+namespace amd {
+// Bump when the snapshot layout changes, older snapshots are then ignored.
+static const uint32_t kTopologyCacheMagic = 0x54415348;  // "HSAT"
+static const uint32_t kTopologyCacheVersion = 1;
+
+static const char kBootIdPath[] = "/proc/sys/kernel/random/boot_id";
+static const char kGenerationPath[] =
+    "/sys/devices/virtual/kfd/kfd/topology/generation_id";
+
+// Returns the first line of a small text file, empty if it can not be read.
+static std::string ReadLine(const char* path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+TopologyCache::TopologyCache(const std::string& directory)
+    : path_(directory + "/topology.hsa-cache"),
+      boot_id_(ReadLine(kBootIdPath)),
+      generation_(ReadLine(kGenerationPath)) {}
+
+std::string TopologyCache::Key(const HsaVersionInfo& version) const {
+  // Record sizes guard against a thunk built with different structures.
+  std::ostringstream key;
+  key << boot_id_ << ";" << generation_ << ";"
+      << version.KernelInterfaceMajorVersion << "."
+      << version.KernelInterfaceMinorVersion << ";"
+      << sizeof(HsaNodeProperties) << "," << sizeof(HsaCacheProperties) << ","
+      << sizeof(HsaMemoryProperties);
+  return key.str();
+}
+
+bool TopologyCache::Lookup(const HsaVersionInfo& version,
+                           Topology& topology) const {
+  if (boot_id_.empty()) return false;
+
+  std::string data;
+  if (!hsa::common::ReadCacheFile(path_, &data)) return false;
+  hsa::common::CacheRecordReader reader(data);
+
+  uint32_t magic, format;
+  std::string key;
+  if (!reader.Get(&magic) || magic != kTopologyCacheMagic ||
+      !reader.Get(&format) || format != kTopologyCacheVersion ||
+      !reader.GetString(&key) || key != Key(version)) {
+    return false;
+  }
+
+  uint32_t count;
+  if (!reader.Get(&count) || count == 0) return false;
+  topology.version = version;
+  topology.nodes.resize(count);
+  for (NodeTopology& node : topology.nodes) {
+    if (!reader.Get(&node.node_id) || !reader.Get(&node.properties) ||
+        !reader.GetVector(&node.cpu_caches) ||
+        !reader.GetVector(&node.gpu_caches) ||
+        !reader.GetVector(&node.memory_banks)) {
+      return false;
+    }
+  }
+
+  return reader.AtEnd();
+}
+
+void TopologyCache::Store(const Topology& topology) const {
+  if (boot_id_.empty()) return;
+
+  hsa::common::CacheRecordWriter writer;
+  writer.Put(kTopologyCacheMagic);
+  writer.Put(kTopologyCacheVersion);
+  writer.PutString(Key(topology.version));
+  writer.Put(uint32_t(topology.nodes.size()));
+  for (const NodeTopology& node : topology.nodes) {
+    writer.Put(node.node_id);
+    writer.Put(node.properties);
+    writer.PutVector(node.cpu_caches);
+    writer.PutVector(node.gpu_caches);
+    writer.PutVector(node.memory_banks);
+  }
+
+  hsa::common::WriteCacheFile(path_, writer.data());
+}
+
+void TopologyCache::Invalidate() const { remove(path_.c_str()); }
+}  // namespace amd
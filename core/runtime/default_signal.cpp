@@ -92,6 +92,9 @@ hsa_signal_value_t DefaultSignal::WaitRelaxed(hsa_signal_condition_t condition,
 
   timer::fast_clock::time_point start_time, time;
   start_time = timer::fast_clock::now();
+  MAKE_SCOPE_GUARD([&]() {
+    metrics::RecordWait(start_time, timer::fast_clock::duration(0));
+  });
 
   uint64_t hsa_freq;
   HSA::hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &hsa_freq);
@@ -53,18 +53,25 @@ namespace core {
 HostQueue::HostQueue(hsa_region_t region, uint32_t ring_size,
                      hsa_queue_type_t type, uint32_t features,
                      hsa_signal_t doorbell_signal)
-    : size_(ring_size), active_(false) {
+    : region_(region),
+      size_(ring_size),
+      active_(false),
+      ring_(NULL),
+      resize_pending_(0),
+      resize_fence_(kNoFence),
+      retired_count_(0),
+      high_water_mark_(0),
+      saturated_reservations_(0),
+      resize_count_(0),
+      auto_grow_limit_(Runtime::runtime_singleton_->queue_auto_grow_limit()),
+      grow_requested_(0) {
   HSA::hsa_memory_register(this, sizeof(HostQueue));
 
-  const size_t queue_buffer_size = size_ * sizeof(AqlPacket);
-  if (HSA_STATUS_SUCCESS !=
-      HSA::hsa_memory_allocate(region, queue_buffer_size, &ring_)) {
+  ring_ = AllocateRing(size_);
+  if (ring_ == NULL) {
     return;
   }
 
-  assert(IsMultipleOf(ring_, kRingAlignment));
-  assert(ring_ != NULL);
-
   amd_queue_.hsa_queue.base_address = ring_;
   amd_queue_.hsa_queue.size = size_;
   amd_queue_.hsa_queue.doorbell_signal = doorbell_signal;
@@ -86,8 +93,189 @@ HostQueue::HostQueue(hsa_region_t region, uint32_t ring_size,
 }
 
 HostQueue::~HostQueue() {
-  HSA::hsa_memory_free(ring_);
+  for (size_t i = 0; i < retired_rings_.size(); ++i) {
+    HSA::hsa_memory_free(retired_rings_[i].first);
+  }
+  if (ring_ != NULL) {
+    HSA::hsa_memory_free(ring_);
+  }
   HSA::hsa_memory_deregister(this, sizeof(HostQueue));
 }
 
+void* HostQueue::AllocateRing(uint32_t size) {
+  void* ring = NULL;
+  if (HSA_STATUS_SUCCESS !=
+      HSA::hsa_memory_allocate(region_, size * sizeof(AqlPacket), &ring)) {
+    return NULL;
+  }
+
+  assert(IsMultipleOf(ring, kRingAlignment));
+  assert(ring != NULL);
+
+  // Slots must not look published before a producer writes them; resize
+  // relies on this for the slots it hands to held reservations.
+  AqlPacket* packets = reinterpret_cast<AqlPacket*>(ring);
+  for (uint32_t i = 0; i < size; ++i) {
+    packets[i].dispatch.header = HSA_PACKET_TYPE_INVALID
+                                 << HSA_PACKET_HEADER_TYPE;
+  }
+
+  return ring;
+}
+
+hsa_status_t HostQueue::Resize(uint32_t new_size) {
+  return Grow(new_size, kResizeTimeoutMs);
+}
+
+hsa_status_t HostQueue::Grow(uint32_t new_size, uint32_t timeout_ms) {
+  if (!IsPowerOfTwo(new_size)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  ScopedAcquire<KernelMutex> lock(&resize_lock_);
+
+  if (new_size <= size_) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  void* ring = AllocateRing(new_size);
+  if (ring == NULL) {
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+
+  // Hold every reservation made from here on. The fence is read with a
+  // release RMW of the write index, so a reservation that follows it in the
+  // index's modification order acquires the flag in OnReserve, and one that
+  // precedes it is behind the fence.
+  atomic::Store(&resize_pending_, 1U, std::memory_order_relaxed);
+  const uint64_t fence = atomic::Add(&amd_queue_.write_dispatch_id, uint64_t(0),
+                                     std::memory_order_release);
+  atomic::Store(&resize_fence_, fence, std::memory_order_release);
+
+  // Packets reserved before the fence are consumed from the current ring. The
+  // wait is bounded since nothing guarantees a consumer is running.
+  const uint64_t deadline =
+      os::ReadAccurateClock() +
+      os::AccurateClockFrequency() * timeout_ms / 1000;
+  while (LoadReadIndexAcquire() < fence) {
+    if (os::ReadAccurateClock() >= deadline) {
+      // Release the held reservations into the current ring.
+      atomic::Store(&resize_fence_, kNoFence, std::memory_order_relaxed);
+      atomic::Store(&resize_pending_, 0U, std::memory_order_release);
+      HSA::hsa_memory_free(ring);
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+    os::YieldThread();
+  }
+
+  void* old_ring = ring_;
+  ring_ = ring;
+  atomic::Store(&amd_queue_.hsa_queue.base_address, ring_,
+                std::memory_order_release);
+  atomic::Store(&amd_queue_.hsa_queue.size, new_size,
+                std::memory_order_release);
+  atomic::Store(&size_, new_size, std::memory_order_relaxed);
+  atomic::Store(&resize_count_, resize_count_ + 1, std::memory_order_relaxed);
+
+  {
+    ScopedAcquire<KernelMutex> retired(&retired_lock_);
+    retired_rings_.push_back(std::make_pair(old_ring, fence));
+    atomic::Store(&retired_count_, uint32_t(retired_rings_.size()),
+                  std::memory_order_release);
+  }
+
+  // Release the held reservations into the new ring.
+  atomic::Store(&resize_fence_, kNoFence, std::memory_order_relaxed);
+  atomic::Store(&resize_pending_, 0U, std::memory_order_release);
+
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HostQueue::GetStats(hsa_amd_queue_stats_t* stats) {
+  stats->size = atomic::Load(&size_, std::memory_order_relaxed);
+  stats->high_water_mark =
+      atomic::Load(&high_water_mark_, std::memory_order_relaxed);
+  stats->saturated_reservations =
+      atomic::Load(&saturated_reservations_, std::memory_order_relaxed);
+  stats->resize_count = atomic::Load(&resize_count_, std::memory_order_relaxed);
+  stats->reserved = 0;
+  return HSA_STATUS_SUCCESS;
+}
+
+void HostQueue::UpdateHighWaterMark(uint64_t occupancy) {
+  const uint32_t value = uint32_t(Min(occupancy, uint64_t(UINT32_MAX)));
+  uint32_t mark = atomic::Load(&high_water_mark_, std::memory_order_relaxed);
+  while (mark < value) {
+    const uint32_t old = atomic::Cas(&high_water_mark_, value, mark,
+                                     std::memory_order_relaxed);
+    if (old == mark) {
+      break;
+    }
+    mark = old;
+  }
+}
+
+void HostQueue::RecordSaturation() {
+  atomic::Increment(&saturated_reservations_, std::memory_order_relaxed);
+  if (atomic::Load(&size_, std::memory_order_relaxed) < auto_grow_limit_) {
+    atomic::Store(&grow_requested_, 1U, std::memory_order_relaxed);
+  }
+}
+
+void HostQueue::WaitForResize(uint64_t end) {
+  while (atomic::Load(&resize_pending_, std::memory_order_acquire) != 0) {
+    // Reservations covered by the fence drain from the current ring and must
+    // not wait, or the read index could never reach the fence.
+    const uint64_t fence =
+        atomic::Load(&resize_fence_, std::memory_order_acquire);
+    if (fence != kNoFence && end <= fence) {
+      return;
+    }
+    os::YieldThread();
+  }
+}
+
+void HostQueue::AutoGrow() {
+  if (atomic::Exchange(&grow_requested_, 0U, std::memory_order_relaxed) == 0) {
+    return;
+  }
+
+  const uint32_t size = atomic::Load(&size_, std::memory_order_relaxed);
+  if (size >= auto_grow_limit_) {
+    return;
+  }
+
+  // Grow only while the queue is drained. The caller is a producer, and
+  // waiting here for a consumer that may never run would hang it, so a busy
+  // queue keeps the request for a later reservation.
+  if (LoadReadIndexAcquire() != LoadWriteIndexRelaxed() ||
+      Grow(size * 2, 0) == HSA_STATUS_ERROR_OUT_OF_RESOURCES) {
+    if (atomic::Load(&size_, std::memory_order_relaxed) == size) {
+      atomic::Store(&grow_requested_, 1U, std::memory_order_relaxed);
+    }
+  }
+  // Otherwise the queue grew, possibly by another producer, in which case
+  // the request was rejected as not larger than the current size.
+}
+
+void HostQueue::ReleaseRetiredRings(uint64_t read_index) {
+  ScopedAcquire<KernelMutex> lock(&retired_lock_);
+
+  // A ring is unreachable once the consumer has moved past the fence it was
+  // retired at, since the packet at the fence lives in its successor.
+  size_t i = 0;
+  while (i < retired_rings_.size()) {
+    if (read_index > retired_rings_[i].second) {
+      HSA::hsa_memory_free(retired_rings_[i].first);
+      retired_rings_[i] = retired_rings_.back();
+      retired_rings_.pop_back();
+    } else {
+      ++i;
+    }
+  }
+
+  atomic::Store(&retired_count_, uint32_t(retired_rings_.size()),
+                std::memory_order_relaxed);
+}
+
 }  // namespace core
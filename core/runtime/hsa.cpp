@@ -53,6 +53,7 @@
 #include "core/inc/agent.h"
 #include "core/inc/host_queue.h"
 #include "core/inc/memory_region.h"
+#include "core/inc/metrics.h"
 #include "core/inc/queue.h"
 #include "core/inc/signal.h"
 #include "core/inc/default_signal.h"
@@ -60,6 +61,7 @@
 #include "core/inc/amd_load_map.h"
 #include "core/inc/amd_loader_context.hpp"
 #include "core/runtime/isa.hpp"
+#include "amd_hsa_compress.hpp"
 
 using namespace amd::hsa::code;
 
@@ -386,6 +388,8 @@ hsa_status_t hsa_queue_create(
                               group_segment_size, &cmd_queue);
   if (cmd_queue != NULL) {
     *queue = core::Queue::Convert(cmd_queue);
+    core::metrics::Add(core::metrics::kQueuesCreated);
+    core::metrics::Add(core::metrics::kQueuesLive);
   } else {
     *queue = NULL;
   }
@@ -421,6 +425,8 @@ hsa_status_t
   }
 
   *queue = core::Queue::Convert(host_queue);
+  core::metrics::Add(core::metrics::kQueuesCreated);
+  core::metrics::Add(core::metrics::kQueuesLive);
 
   return HSA_STATUS_SUCCESS;
 }
@@ -435,7 +441,10 @@ hsa_status_t hsa_queue_destroy(hsa_queue_t* queue) {
   IS_BAD_PTR(queue);
   core::Queue* cmd_queue = core::Queue::Convert(queue);
   IS_VALID(cmd_queue);
+  core::Runtime::runtime_singleton_->profiling_collector().EraseQueue(
+      queue->id);
   delete cmd_queue;
+  core::metrics::Add(core::metrics::kQueuesLive, -1);
   return HSA_STATUS_SUCCESS;
 }
 
@@ -836,12 +845,16 @@ hsa_status_t hsa_signal_destroy(hsa_signal_t hsa_signal) {
 hsa_signal_value_t hsa_signal_load_relaxed(hsa_signal_t hsa_signal) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserLoad(std::memory_order_relaxed);
   return signal->LoadRelaxed();
 }
 
 hsa_signal_value_t hsa_signal_load_acquire(hsa_signal_t hsa_signal) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserLoad(std::memory_order_acquire);
   return signal->LoadAcquire();
 }
 
@@ -849,6 +862,8 @@ void hsa_signal_store_relaxed(hsa_signal_t hsa_signal,
                                       hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserStore(value, std::memory_order_relaxed);
   signal->StoreRelaxed(value);
 }
 
@@ -856,6 +871,8 @@ void hsa_signal_store_release(hsa_signal_t hsa_signal,
                                       hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserStore(value, std::memory_order_release);
   signal->StoreRelease(value);
 }
 
@@ -887,6 +904,8 @@ void
     hsa_signal_and_relaxed(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAnd(value, std::memory_order_relaxed);
   signal->AndRelaxed(value);
 }
 
@@ -894,6 +913,8 @@ void
     hsa_signal_and_acquire(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAnd(value, std::memory_order_acquire);
   signal->AndAcquire(value);
 }
 
@@ -901,6 +922,8 @@ void
     hsa_signal_and_release(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAnd(value, std::memory_order_release);
   signal->AndRelease(value);
 }
 
@@ -908,6 +931,8 @@ void
     hsa_signal_and_acq_rel(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAnd(value, std::memory_order_acq_rel);
   signal->AndAcqRel(value);
 }
 
@@ -915,6 +940,8 @@ void
     hsa_signal_or_relaxed(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserOr(value, std::memory_order_relaxed);
   signal->OrRelaxed(value);
 }
 
@@ -922,6 +949,8 @@ void
     hsa_signal_or_acquire(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserOr(value, std::memory_order_acquire);
   signal->OrAcquire(value);
 }
 
@@ -929,6 +958,8 @@ void
     hsa_signal_or_release(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserOr(value, std::memory_order_release);
   signal->OrRelease(value);
 }
 
@@ -936,6 +967,8 @@ void
     hsa_signal_or_acq_rel(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserOr(value, std::memory_order_acq_rel);
   signal->OrAcqRel(value);
 }
 
@@ -943,6 +976,8 @@ void
     hsa_signal_xor_relaxed(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserXor(value, std::memory_order_relaxed);
   signal->XorRelaxed(value);
 }
 
@@ -950,6 +985,8 @@ void
     hsa_signal_xor_acquire(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserXor(value, std::memory_order_acquire);
   signal->XorAcquire(value);
 }
 
@@ -957,6 +994,8 @@ void
     hsa_signal_xor_release(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserXor(value, std::memory_order_release);
   signal->XorRelease(value);
 }
 
@@ -964,6 +1003,8 @@ void
     hsa_signal_xor_acq_rel(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserXor(value, std::memory_order_acq_rel);
   signal->XorAcqRel(value);
 }
 
@@ -971,6 +1012,8 @@ void
     hsa_signal_add_relaxed(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAdd(value, std::memory_order_relaxed);
   return signal->AddRelaxed(value);
 }
 
@@ -978,6 +1021,8 @@ void
     hsa_signal_add_acquire(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAdd(value, std::memory_order_acquire);
   signal->AddAcquire(value);
 }
 
@@ -985,6 +1030,8 @@ void
     hsa_signal_add_release(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAdd(value, std::memory_order_release);
   signal->AddRelease(value);
 }
 
@@ -992,6 +1039,8 @@ void
     hsa_signal_add_acq_rel(hsa_signal_t hsa_signal, hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserAdd(value, std::memory_order_acq_rel);
   signal->AddAcqRel(value);
 }
 
@@ -999,6 +1048,8 @@ void hsa_signal_subtract_relaxed(hsa_signal_t hsa_signal,
                                          hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserSub(value, std::memory_order_relaxed);
   signal->SubRelaxed(value);
 }
 
@@ -1006,6 +1057,8 @@ void hsa_signal_subtract_acquire(hsa_signal_t hsa_signal,
                                          hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserSub(value, std::memory_order_acquire);
   signal->SubAcquire(value);
 }
 
@@ -1013,6 +1066,8 @@ void hsa_signal_subtract_release(hsa_signal_t hsa_signal,
                                          hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserSub(value, std::memory_order_release);
   signal->SubRelease(value);
 }
 
@@ -1020,6 +1075,8 @@ void hsa_signal_subtract_acq_rel(hsa_signal_t hsa_signal,
                                          hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserSub(value, std::memory_order_acq_rel);
   signal->SubAcqRel(value);
 }
 
@@ -1028,6 +1085,8 @@ hsa_signal_value_t
                                 hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserExch(value, std::memory_order_relaxed);
   return signal->ExchRelaxed(value);
 }
 
@@ -1036,6 +1095,8 @@ hsa_signal_value_t
                                 hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserExch(value, std::memory_order_acquire);
   return signal->ExchAcquire(value);
 }
 
@@ -1044,6 +1105,8 @@ hsa_signal_value_t
                                 hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserExch(value, std::memory_order_release);
   return signal->ExchRelease(value);
 }
 
@@ -1052,6 +1115,8 @@ hsa_signal_value_t
                                 hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserExch(value, std::memory_order_acq_rel);
   return signal->ExchAcqRel(value);
 }
 
@@ -1060,6 +1125,8 @@ hsa_signal_value_t hsa_signal_cas_relaxed(hsa_signal_t hsa_signal,
                                                   hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserCas(expected, value, std::memory_order_relaxed);
   return signal->CasRelaxed(expected, value);
 }
 
@@ -1068,6 +1135,8 @@ hsa_signal_value_t hsa_signal_cas_acquire(hsa_signal_t hsa_signal,
                                                   hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserCas(expected, value, std::memory_order_acquire);
   return signal->CasAcquire(expected, value);
 }
 
@@ -1076,6 +1145,8 @@ hsa_signal_value_t hsa_signal_cas_release(hsa_signal_t hsa_signal,
                                                   hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserCas(expected, value, std::memory_order_release);
   return signal->CasRelease(expected, value);
 }
 
@@ -1084,6 +1155,8 @@ hsa_signal_value_t hsa_signal_cas_acq_rel(hsa_signal_t hsa_signal,
                                                   hsa_signal_value_t value) {
   core::Signal* signal = core::Signal::Convert(hsa_signal);
   assert(IsValid(signal));
+  if (signal->IsUserMode())
+    return signal->UserCas(expected, value, std::memory_order_acq_rel);
   return signal->CasAcqRel(expected, value);
 }
 
@@ -1171,6 +1244,18 @@ hsa_status_t FindCodeObjectAllocRegionFromSystem(void *data)
   return HSA::hsa_iterate_agents(FindCodeObjectAllocRegionFromAgent, data);
 }
 
+bool HasOption(const char* options, const char* option)
+{
+  if (!options) { return false; }
+  size_t length = strlen(option);
+  for (const char* p = options; (p = strstr(p, option)); p += length) {
+    bool starts = p == options || ' ' == p[-1];
+    bool ends = '\0' == p[length] || ' ' == p[length];
+    if (starts && ends) { return true; }
+  }
+  return false;
+}
+
 } // namespace anonymous
 
 hsa_status_t hsa_code_object_serialize(
@@ -1184,10 +1269,35 @@ hsa_status_t hsa_code_object_serialize(
   IS_BAD_PTR(serialized_code_object);
   IS_BAD_PTR(serialized_code_object_size);
 
-  AmdHsaCode* code = core::Runtime::runtime_singleton_->code_manager()->FromHandle(code_object);
-  if (!code) { return HSA_STATUS_ERROR_INVALID_CODE_OBJECT; }
-  size_t elfmemsz = code->ElfSize();
-  const char* elfmemrd = code->ElfData();
+  // The handle is the address of the ELF image, its size comes from the
+  // section headers, no need to parse the code object. Headers of code
+  // objects the runtime created are checked against their memory; others,
+  // such as finalizer output, are complete images in memory by contract.
+  const char* elfmemrd = reinterpret_cast<const char*>(code_object.handle);
+  if (!elfmemrd) { return HSA_STATUS_ERROR_INVALID_CODE_OBJECT; }
+  size_t elfmemsz_max =
+      core::Runtime::runtime_singleton_->CodeObjectSize(code_object);
+  size_t elfmemsz =
+      amd::elf::ElfSize(elfmemrd, elfmemsz_max ? elfmemsz_max : UINT64_MAX);
+  if (!elfmemsz) { return HSA_STATUS_ERROR_INVALID_CODE_OBJECT; }
+
+  if (HasOption(options, "-compress")) {
+    // Compress straight into the caller's buffer, sized for the worst case.
+    hsa_status_t hsc = alloc_callback(CompressedCodeObjectBound(elfmemsz),
+                                      callback_data,
+                                      serialized_code_object);
+    if (HSA_STATUS_SUCCESS != hsc) {
+      return hsc;
+    }
+
+    size_t container_size = CompressCodeObject(elfmemrd, elfmemsz,
+                                               *serialized_code_object,
+                                               CompressedCodeObjectBound(elfmemsz));
+    if (!container_size) { return HSA_STATUS_ERROR_OUT_OF_RESOURCES; }
+    *serialized_code_object_size = container_size;
+
+    return HSA_STATUS_SUCCESS;
+  }
 
   hsa_status_t hsc = alloc_callback(elfmemsz,
                                     callback_data,
@@ -1225,24 +1335,46 @@ hsa_status_t
   }
   assert(0 != code_object_alloc_region.handle);
 
+  // Compressed containers are decompressed straight into code object memory.
+  uint64_t elf_size = 0;
+  bool compressed = IsCompressedCodeObject(serialized_code_object,
+                                           serialized_code_object_size,
+                                           &elf_size);
+  if (compressed && (0 == elf_size || elf_size > SIZE_MAX)) {
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  }
+  size_t code_object_size = compressed ? (size_t) elf_size : serialized_code_object_size;
+
   // Allocate code object memory.
   void *code_object_alloc_mem = nullptr;
   status = HSA::hsa_memory_allocate(code_object_alloc_region,
-                                    serialized_code_object_size,
+                                    code_object_size,
                                     &code_object_alloc_mem);
   if (HSA_STATUS_SUCCESS != status) {
     return status;
   }
   assert(nullptr != code_object_alloc_mem);
 
-  // Copy code object into allocated code object memory.
-  status = HSA::hsa_memory_copy(code_object_alloc_mem,
-                                serialized_code_object,
-                                serialized_code_object_size);
-  if (HSA_STATUS_SUCCESS != status) {
-    return status;
+  if (compressed) {
+    if (!DecompressCodeObject(serialized_code_object,
+                              serialized_code_object_size,
+                              code_object_alloc_mem,
+                              code_object_size)) {
+      HSA::hsa_memory_free(code_object_alloc_mem);
+      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+    }
+  } else {
+    // Copy code object into allocated code object memory.
+    status = HSA::hsa_memory_copy(code_object_alloc_mem,
+                                  serialized_code_object,
+                                  serialized_code_object_size);
+    if (HSA_STATUS_SUCCESS != status) {
+      return status;
+    }
   }
   code_object->handle = (uint64_t) (uintptr_t) code_object_alloc_mem;
+  core::Runtime::runtime_singleton_->AddCodeObjectSize(*code_object,
+                                                       code_object_size);
 
   return HSA_STATUS_SUCCESS;
 }
@@ -1259,7 +1391,11 @@ hsa_status_t hsa_code_object_destroy(hsa_code_object_t code_object) {
     return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
   }
 
-  HSA::hsa_memory_free(elfmemrd);
+  // Code objects loaded from files are mappings, not runtime allocations.
+  if (!core::Runtime::runtime_singleton_->UnmapCodeObject(code_object)) {
+    core::Runtime::runtime_singleton_->RemoveCodeObjectSize(code_object);
+    HSA::hsa_memory_free(elfmemrd);
+  }
 
   return HSA_STATUS_SUCCESS;
 }
@@ -48,12 +48,14 @@
 #include "core/inc/runtime.h"
 #include "core/inc/hsa_table_interface.h"
 
+#include <cstring>
+
 namespace core {
 
 ApiTable hsa_api_table_;
 ApiTable hsa_internal_api_table_;
 
-ApiTable::ApiTable() {
+ApiTable::ApiTable() : next_hook_id_(1) {
   table.std_exts_ = NULL;
   Reset();
 }
@@ -65,6 +67,8 @@ void ApiTable::LinkExts(ExtTable* ptr) {
 }
 
 void ApiTable::Reset() {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
   table.hsa_init_fn = HSA::hsa_init;
   table.hsa_shut_down_fn = HSA::hsa_shut_down;
   table.hsa_system_get_info_fn = HSA::hsa_system_get_info;
@@ -185,6 +189,95 @@ void ApiTable::Reset() {
   table.hsa_status_string_fn = HSA::hsa_status_string;
 
   if (table.std_exts_ != NULL) *table.std_exts_ = extension_backup;
+
+  defaults_ = table;
+  for (size_t i = 0; i < kEntryCount; ++i) hooks_[i].clear();
+  for (size_t i = 0; i < kGroupCount; ++i) group_disabled_[i] = false;
+  UpdateIntercepted();
+}
+
+hsa_amd_api_group_t ApiTable::EntryGroup(size_t index) {
+#define API_ENTRY(name) (offsetof(::ApiTable, name##_fn) / sizeof(void*))
+  if (index == API_ENTRY(hsa_agent_get_info) ||
+      (index >= API_ENTRY(hsa_agent_iterate_regions) &&
+       index <= API_ENTRY(hsa_agent_extension_supported)))
+    return HSA_AMD_API_GROUP_AGENT;
+  if (index >= API_ENTRY(hsa_queue_create) &&
+      index <= API_ENTRY(hsa_queue_store_read_index_release))
+    return HSA_AMD_API_GROUP_QUEUE;
+  if (index >= API_ENTRY(hsa_memory_register) &&
+      index <= API_ENTRY(hsa_memory_assign_agent))
+    return HSA_AMD_API_GROUP_MEMORY;
+  if (index >= API_ENTRY(hsa_signal_create) &&
+      index <= API_ENTRY(hsa_signal_cas_acq_rel))
+    return HSA_AMD_API_GROUP_SIGNAL;
+  if (index >= API_ENTRY(hsa_isa_from_name) &&
+      index <= API_ENTRY(hsa_executable_iterate_symbols))
+    return HSA_AMD_API_GROUP_CODE_OBJECT;
+#undef API_ENTRY
+  return HSA_AMD_API_GROUP_SYSTEM;
+}
+
+void ApiTable::Relink(size_t index) {
+  // Callers may be running any function of the chain, so each next pointer
+  // is valid before the entry changes.
+  void* function = bases_[index];
+  for (size_t i = 0; i < hooks_[index].size(); ++i) {
+    __atomic_store_n(hooks_[index][i].next, function, __ATOMIC_RELEASE);
+    function = hooks_[index][i].function;
+  }
+  if (group_disabled_[EntryGroup(index)]) function = bases_[index];
+  __atomic_store_n(Entry(index), function, __ATOMIC_RELEASE);
+}
+
+hsa_status_t ApiTable::AddHook(size_t entry, void* function, void** next,
+                               uint64_t* id) {
+  if (entry % sizeof(void*) != 0 || entry / sizeof(void*) >= kEntryCount ||
+      function == NULL || next == NULL || id == NULL)
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  size_t index = entry / sizeof(void*);
+  if (hooks_[index].empty()) bases_[index] = *Entry(index);
+  Hook hook = {next_hook_id_++, function, next};
+  hooks_[index].push_back(hook);
+  Relink(index);
+  UpdateIntercepted();
+  *id = hook.id;
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ApiTable::RemoveHook(uint64_t id) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  for (size_t index = 0; index < kEntryCount; ++index) {
+    std::vector<Hook>& hooks = hooks_[index];
+    for (size_t i = 0; i < hooks.size(); ++i) {
+      if (hooks[i].id != id) continue;
+      hooks.erase(hooks.begin() + i);
+      Relink(index);
+      UpdateIntercepted();
+      return HSA_STATUS_SUCCESS;
+    }
+  }
+  return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+}
+
+hsa_status_t ApiTable::EnableGroup(hsa_amd_api_group_t group, bool enable) {
+  if (size_t(group) >= kGroupCount) return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+
+  ScopedAcquire<KernelMutex> lock(&lock_);
+  group_disabled_[group] = !enable;
+  for (size_t index = 0; index < kEntryCount; ++index) {
+    if (!hooks_[index].empty() && EntryGroup(index) == group) Relink(index);
+  }
+  UpdateIntercepted();
+  return HSA_STATUS_SUCCESS;
+}
+
+void ApiTable::UpdateIntercepted() {
+  if (hsa_table_interface_get_table() != &table) return;
+  hsa_table_interface_set_intercepted(
+      memcmp(&table, &defaults_, offsetof(::ApiTable, std_exts_)) != 0);
 }
 
 class Init {
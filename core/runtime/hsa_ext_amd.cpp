@@ -44,13 +44,25 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
 #include "core/inc/runtime.h"
 #include "core/inc/agent.h"
 #include "core/inc/amd_gpu_agent.h"
 #include "core/inc/amd_hw_aql_command_processor.h"
+#include "core/inc/hsa_api_trace_int.h"
+#include "core/inc/hsa_table_interface.h"
+#include "core/inc/metrics.h"
 #include "core/inc/signal.h"
 #include "core/inc/thunk.h"
 
+#include "amd_elf_image.hpp"
+#include "amd_hsa_code_util.hpp"
+
 template <class T>
 struct ValidityError;
 template <>
@@ -195,6 +207,64 @@ hsa_amd_profiling_get_dispatch_time(hsa_agent_t agent_handle,
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t HSA_API
+hsa_amd_profiling_collect(hsa_agent_t agent_handle, hsa_queue_t* queue,
+                          uint32_t signal_count, const hsa_signal_t* signals) {
+  IS_OPEN();
+
+  IS_BAD_PTR(queue);
+
+  if (signal_count != 0 && signals == NULL) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Agent* agent = core::Agent::Convert(agent_handle);
+
+  IS_VALID(agent);
+
+  if (agent->device_type() != core::Agent::kAmdGpuDevice) {
+    return HSA_STATUS_ERROR_INVALID_AGENT;
+  }
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+
+  IS_VALID(cmd_queue);
+
+  for (uint32_t i = 0; i < signal_count; i++) {
+    core::Signal* signal = core::Signal::Convert(signals[i]);
+    IS_VALID(signal);
+  }
+
+  core::Runtime::runtime_singleton_->profiling_collector().Collect(
+      static_cast<amd::GpuAgentInt*>(agent), queue->id, signal_count, signals);
+
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API
+hsa_amd_profiling_drain(hsa_queue_t* queue, uint32_t capacity,
+                        hsa_amd_profiling_record_t* records, uint32_t* count,
+                        uint64_t* dropped) {
+  IS_OPEN();
+
+  IS_BAD_PTR(queue);
+
+  IS_BAD_PTR(count);
+
+  if (capacity != 0 && records == NULL) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+
+  IS_VALID(cmd_queue);
+
+  *count = core::Runtime::runtime_singleton_->profiling_collector().Drain(
+      queue->id, capacity, records, dropped);
+
+  return HSA_STATUS_SUCCESS;
+}
+
 hsa_status_t HSA_API
 hsa_amd_queue_sdma_create(hsa_agent_t agent_handle, size_t buffer_size,
                           void* buffer_addr, uint64_t* queue_id,
@@ -285,3 +355,193 @@ hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
   IS_VALID(cmd_queue);
   return cmd_queue->SetCUMasking(num_cu_mask_count, cu_mask);
 }
+
+hsa_status_t HSA_API hsa_amd_queue_resize(hsa_queue_t* queue, uint32_t size) {
+  IS_OPEN();
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  return cmd_queue->Resize(size);
+}
+
+hsa_status_t HSA_API hsa_amd_queue_get_stats(const hsa_queue_t* queue,
+                                             hsa_amd_queue_stats_t* stats) {
+  IS_OPEN();
+  IS_BAD_PTR(stats);
+
+  core::Queue* cmd_queue = core::Queue::Convert(queue);
+  IS_VALID(cmd_queue);
+  return cmd_queue->GetStats(stats);
+}
+
+// Files below this size are copied instead of mapped, unless sealed.
+static const size_t kCodeObjectMapThreshold = 1 << 20;
+
+static hsa_status_t LoadCodeObjectFd(int fd, hsa_code_object_t* code_object) {
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  }
+
+  // A private mapping faults with SIGBUS once the file is truncated under it.
+  // Small files are cheap to copy, so only map large files or ones whose size
+  // is pinned by a seal.
+  if ((size_t) st.st_size < kCodeObjectMapThreshold &&
+      !amd::hsa::IsFileSizeSealed(fd)) {
+    std::vector<char> buffer;
+    if (!amd::hsa::ReadFileIntoBuffer(fd, (size_t) st.st_size, buffer) ||
+        amd::elf::ElfSize(buffer.data(), buffer.size()) == 0) {
+      return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+    }
+    return HSA::hsa_code_object_deserialize(buffer.data(), buffer.size(), NULL,
+                                            code_object);
+  }
+
+  return core::Runtime::runtime_singleton_->MapCodeObject(fd, code_object);
+}
+
+hsa_status_t HSA_API hsa_amd_code_object_load_fd(int fd,
+                                                 hsa_code_object_t* code_object) {
+  IS_OPEN();
+  IS_BAD_PTR(code_object);
+
+  if (fd < 0) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  return LoadCodeObjectFd(fd, code_object);
+}
+
+hsa_status_t HSA_API hsa_amd_code_object_load_file(
+    const char* file_name, hsa_code_object_t* code_object) {
+  IS_OPEN();
+  IS_BAD_PTR(file_name);
+  IS_BAD_PTR(code_object);
+
+  int fd = open(file_name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  // A mapping outlives the descriptor.
+  hsa_status_t status = LoadCodeObjectFd(fd, code_object);
+  close(fd);
+  return status;
+}
+
+hsa_status_t HSA_API hsa_amd_memory_fill(void* ptr, uint32_t value,
+                                         size_t count) {
+  IS_OPEN();
+
+  if (ptr == NULL) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (!IsMultipleOf(ptr, sizeof(uint32_t))) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  if (count == 0) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  return core::Runtime::runtime_singleton_->FillMemory(ptr, value, count);
+}
+
+static_assert(sizeof(hsa_amd_kernel_descriptor_t) == 64,
+              "hsa_amd_kernel_descriptor_t must fill one cache line.");
+
+hsa_status_t HSA_API hsa_amd_executable_symbol_get_kernel_descriptor(
+    hsa_executable_symbol_t executable_symbol,
+    hsa_amd_kernel_descriptor_t* descriptor) {
+  IS_OPEN();
+  IS_BAD_PTR(descriptor);
+
+  hsa_symbol_kind_t kind;
+  hsa_status_t status = HSA::hsa_executable_symbol_get_info(
+      executable_symbol, HSA_EXECUTABLE_SYMBOL_INFO_TYPE, &kind);
+  if (status != HSA_STATUS_SUCCESS) {
+    return status;
+  }
+  if (kind != HSA_SYMBOL_KIND_KERNEL) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+
+  uint64_t kernel_object = 0;
+  status = HSA::hsa_executable_symbol_get_info(
+      executable_symbol, HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT,
+      &kernel_object);
+  if (status != HSA_STATUS_SUCCESS) {
+    return status;
+  }
+
+  core::Runtime::runtime_singleton_->GetKernelDescriptor(kernel_object,
+                                                         descriptor);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API hsa_amd_kernel_object_get_descriptor(
+    uint64_t kernel_object, hsa_amd_kernel_descriptor_t* descriptor) {
+  IS_OPEN();
+  IS_BAD_PTR(descriptor);
+
+  if (kernel_object == 0 ||
+      !core::Runtime::runtime_singleton_->GetLoadedKernelDescriptor(
+          kernel_object, descriptor)) {
+    return HSA_STATUS_ERROR_INVALID_ARGUMENT;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API hsa_amd_api_hook_register(size_t entry, void* function,
+                                               void** next,
+                                               hsa_amd_api_hook_t* hook) {
+  IS_OPEN();
+  IS_BAD_PTR(hook);
+
+  return core::hsa_api_table_.AddHook(entry, function, next, &hook->handle);
+}
+
+hsa_status_t HSA_API hsa_amd_api_hook_remove(hsa_amd_api_hook_t hook) {
+  IS_OPEN();
+
+  return core::hsa_api_table_.RemoveHook(hook.handle);
+}
+
+hsa_status_t HSA_API hsa_amd_api_group_enable(hsa_amd_api_group_t group,
+                                              bool enable) {
+  IS_OPEN();
+
+  return core::hsa_api_table_.EnableGroup(group, enable);
+}
+
+hsa_status_t HSA_API hsa_amd_api_table_state(const volatile uint32_t** state) {
+  IS_BAD_PTR(state);
+
+  *state = hsa_table_interface_get_intercepted();
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API hsa_amd_metrics_enable(bool enable) {
+  IS_OPEN();
+
+  core::metrics::Enable(enable);
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t HSA_API hsa_amd_metrics_iterate(
+    hsa_status_t (*callback)(const hsa_amd_metric_t* metric, void* data),
+    void* data) {
+  IS_OPEN();
+
+  IS_BAD_PTR(callback);
+
+  return core::metrics::Iterate(callback, data);
+}
+
+hsa_status_t HSA_API hsa_amd_metrics_reset() {
+  IS_OPEN();
+
+  core::metrics::Reset();
+  return HSA_STATUS_SUCCESS;
+}
@@ -80,6 +80,7 @@ InterruptSignal::InterruptSignal(hsa_signal_value_t initial_value,
   if (event_ != NULL) {
     signal_.event_id = event_->EventId;
     signal_.event_mailbox_ptr = event_->EventData.HWData2;
+    notify_event_ = event_;
   } else {
     signal_.event_id = 0;
     signal_.event_mailbox_ptr = 0;
@@ -131,6 +132,8 @@ hsa_signal_value_t InterruptSignal::WaitRelaxed(
   int64_t value;
 
   timer::fast_clock::time_point start_time = timer::fast_clock::now();
+  timer::fast_clock::duration slept(0);
+  MAKE_SCOPE_GUARD([&]() { metrics::RecordWait(start_time, slept); });
 
   // Set a polling timeout value
   // Exact time is not hugely important, it should just be a short while which
@@ -186,7 +189,10 @@ hsa_signal_value_t InterruptSignal::WaitRelaxed(
         else
           wait_ms = timer::duration_cast<std::chrono::milliseconds>(
                         time_remaining).count();
+        metrics::Add(metrics::kSignalWaitSleeps);
+        timer::fast_clock::time_point sleep_start = timer::fast_clock::now();
         hsaKmtWaitOnEvent(event_, wait_ms);
+        slept += timer::fast_clock::now() - sleep_start;
       }
     }
   }
@@ -0,0 +1,256 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+#include "core/inc/metrics.h"
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "core/util/locks.h"
+
+namespace core {
+namespace metrics {
+bool g_enabled = false;
+
+namespace {
+const uint32_t kBuckets = HSA_AMD_METRIC_HISTOGRAM_BUCKETS;
+
+#define HSA_METRICS_COUNTER_NAME(id, name, kind) name,
+const char* const kCounterNames[] = {
+    HSA_METRICS_COUNTERS(HSA_METRICS_COUNTER_NAME)};
+#undef HSA_METRICS_COUNTER_NAME
+
+#define HSA_METRICS_HISTOGRAM_NAME(id, name) name,
+const char* const kHistogramNames[] = {
+    HSA_METRICS_HISTOGRAMS(HSA_METRICS_HISTOGRAM_NAME)};
+#undef HSA_METRICS_HISTOGRAM_NAME
+
+struct HistogramShard {
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> buckets[kBuckets];
+};
+
+// Values written by one thread. Only the owner updates a shard, so updates
+// are plain loads and stores; readers sum all shards. Shards are never freed:
+// the shard of an exited thread is handed to the next new thread, which keeps
+// the sums intact.
+struct Shard {
+  std::atomic<int64_t> counters[kCounterCount];
+  HistogramShard histograms[kHistogramCount];
+  std::atomic<bool> owned;
+  Shard* next;
+};
+
+std::atomic<Shard*> shards_(NULL);
+
+// Serializes shard creation, Reset and reads of the baseline.
+KernelMutex shards_lock_;
+
+// Totals at the last Reset, subtracted from counters and histograms.
+int64_t counter_baseline_[kCounterCount];
+uint64_t histogram_baseline_[kHistogramCount][kBuckets + 2];
+
+Shard* AcquireShard() {
+  for (Shard* shard = shards_.load(std::memory_order_acquire); shard != NULL;
+       shard = shard->next) {
+    bool owned = false;
+    if (shard->owned.compare_exchange_strong(owned, true)) return shard;
+  }
+
+  Shard* shard = new Shard();
+  shard->owned.store(true, std::memory_order_relaxed);
+
+  ScopedAcquire<KernelMutex> lock(&shards_lock_);
+  shard->next = shards_.load(std::memory_order_relaxed);
+  shards_.store(shard, std::memory_order_release);
+  return shard;
+}
+
+// Returns the shard of the calling thread on thread exit.
+struct ShardOwner {
+  Shard* shard;
+
+  constexpr ShardOwner() : shard(NULL) {}
+  ~ShardOwner() {
+    if (shard != NULL) shard->owned.store(false, std::memory_order_release);
+  }
+};
+
+thread_local ShardOwner owner_;
+
+__forceinline Shard* LocalShard() {
+  if (owner_.shard == NULL) owner_.shard = AcquireShard();
+  return owner_.shard;
+}
+
+template <typename T>
+__forceinline void Bump(std::atomic<T>& value, T delta) {
+  value.store(value.load(std::memory_order_relaxed) + delta,
+              std::memory_order_relaxed);
+}
+
+// Bucket 0 holds zero, bucket i holds [2^(i-1), 2^i), the last bucket holds
+// everything above.
+__forceinline uint32_t Bucket(uint64_t value) {
+  if (value == 0) return 0;
+  return Min(uint32_t(64 - __builtin_clzll(value)), kBuckets - 1);
+}
+
+// Sums all shards into metrics, in counter then histogram order.
+void Collect(std::vector<hsa_amd_metric_t>& metrics) {
+  metrics.assign(kCounterCount + kHistogramCount, hsa_amd_metric_t());
+
+  for (Shard* shard = shards_.load(std::memory_order_acquire); shard != NULL;
+       shard = shard->next) {
+    for (uint32_t i = 0; i < kCounterCount; i++)
+      metrics[i].value += shard->counters[i].load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < kHistogramCount; i++) {
+      hsa_amd_metric_t& metric = metrics[kCounterCount + i];
+      const HistogramShard& histogram = shard->histograms[i];
+      metric.value += histogram.count.load(std::memory_order_relaxed);
+      metric.sum += histogram.sum.load(std::memory_order_relaxed);
+      for (uint32_t b = 0; b < kBuckets; b++)
+        metric.buckets[b] +=
+            histogram.buckets[b].load(std::memory_order_relaxed);
+    }
+  }
+
+  for (uint32_t i = 0; i < kCounterCount; i++) {
+    metrics[i].name = kCounterNames[i];
+    metrics[i].kind = kCounterKinds[i];
+  }
+  for (uint32_t i = 0; i < kHistogramCount; i++) {
+    metrics[kCounterCount + i].name = kHistogramNames[i];
+    metrics[kCounterCount + i].kind = HSA_AMD_METRIC_KIND_HISTOGRAM;
+  }
+}
+
+hsa_status_t DumpMetric(const hsa_amd_metric_t* metric, void* data) {
+  FILE* file = reinterpret_cast<FILE*>(data);
+  if (metric->kind != HSA_AMD_METRIC_KIND_HISTOGRAM) {
+    fprintf(file, "%s %s %lld\n", metric->name,
+            metric->kind == HSA_AMD_METRIC_KIND_GAUGE ? "gauge" : "counter",
+            (long long)metric->value);
+    return HSA_STATUS_SUCCESS;
+  }
+
+  fprintf(file, "%s histogram %lld %llu", metric->name,
+          (long long)metric->value, (unsigned long long)metric->sum);
+  for (uint32_t b = 0; b < kBuckets; b++)
+    fprintf(file, " %llu", (unsigned long long)metric->buckets[b]);
+  fprintf(file, "\n");
+  return HSA_STATUS_SUCCESS;
+}
+}  // namespace
+
+void AddShard(Counter id, int64_t delta) {
+  Bump(LocalShard()->counters[id], delta);
+}
+
+void RecordShard(Histogram id, uint64_t value) {
+  HistogramShard& histogram = LocalShard()->histograms[id];
+  Bump(histogram.count, uint64_t(1));
+  Bump(histogram.sum, value);
+  Bump(histogram.buckets[Bucket(value)], uint64_t(1));
+}
+
+void Enable(bool enable) { g_enabled = enable; }
+
+void Reset() {
+  ScopedAcquire<KernelMutex> lock(&shards_lock_);
+  std::vector<hsa_amd_metric_t> metrics;
+  Collect(metrics);
+
+  for (uint32_t i = 0; i < kCounterCount; i++)
+    counter_baseline_[i] = metrics[i].value;
+  for (uint32_t i = 0; i < kHistogramCount; i++) {
+    const hsa_amd_metric_t& metric = metrics[kCounterCount + i];
+    histogram_baseline_[i][0] = uint64_t(metric.value);
+    histogram_baseline_[i][1] = metric.sum;
+    for (uint32_t b = 0; b < kBuckets; b++)
+      histogram_baseline_[i][b + 2] = metric.buckets[b];
+  }
+}
+
+hsa_status_t Iterate(hsa_status_t (*callback)(const hsa_amd_metric_t* metric,
+                                              void* data),
+                     void* data) {
+  std::vector<hsa_amd_metric_t> metrics;
+  {
+    ScopedAcquire<KernelMutex> lock(&shards_lock_);
+    Collect(metrics);
+
+    for (uint32_t i = 0; i < kCounterCount; i++) {
+      if (metrics[i].kind != HSA_AMD_METRIC_KIND_GAUGE)
+        metrics[i].value -= counter_baseline_[i];
+    }
+    for (uint32_t i = 0; i < kHistogramCount; i++) {
+      hsa_amd_metric_t& metric = metrics[kCounterCount + i];
+      metric.value -= int64_t(histogram_baseline_[i][0]);
+      metric.sum -= histogram_baseline_[i][1];
+      for (uint32_t b = 0; b < kBuckets; b++)
+        metric.buckets[b] -= histogram_baseline_[i][b + 2];
+    }
+  }
+
+  // The callback runs unlocked so it may use the metrics API itself.
+  for (size_t i = 0; i < metrics.size(); i++) {
+    hsa_status_t status = callback(&metrics[i], data);
+    if (status != HSA_STATUS_SUCCESS) return status;
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+void Dump(const std::string& file_name) {
+  FILE* file = fopen(file_name.c_str(), "w");
+  if (file == NULL) return;
+  Iterate(DumpMetric, file);
+  fclose(file);
+}
+
+}  // namespace metrics
+}  // namespace core
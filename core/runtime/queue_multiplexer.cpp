@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "core/inc/queue_multiplexer.h"
+
+#include <cstring>
+
+#include "core/inc/runtime.h"
+#include "core/inc/signal.h"
+
+namespace core {
+VirtualQueue::VirtualQueue(QueueMultiplexer* mux, uint32_t ring_size,
+                           hsa_queue_type_t type, hsa_signal_t doorbell_signal,
+                           HsaEventCallback callback, void* data)
+    : HostQueue(Runtime::runtime_singleton_->system_region(), ring_size, type,
+                HSA_QUEUE_FEATURE_KERNEL_DISPATCH, doorbell_signal),
+      mux_(mux),
+      backend_(NULL),
+      callback_(callback),
+      data_(data) {}
+
+VirtualQueue::~VirtualQueue() {
+  if ((mux_ != NULL) && (backend_ != NULL)) {
+    mux_->Detach(this);
+  }
+}
+
+QueueMultiplexer::QueueMultiplexer(uint32_t max_backends,
+                                   BackendFactory factory)
+    : max_backends_(max_backends),
+      factory_(factory),
+      cursor_(0),
+      thread_(NULL),
+      exit_(false) {
+  assert(max_backends_ != 0 && "Multiplexer needs at least one backend.");
+  doorbell_.handle = 0;
+}
+
+QueueMultiplexer::~QueueMultiplexer() {
+  if (thread_ != NULL) {
+    exit_ = true;
+    Signal::Convert(doorbell_)->StoreRelease(0);
+    os::WaitForThread(thread_);
+    os::CloseThread(thread_);
+    thread_ = NULL;
+  }
+
+  // Queues leaked by the application must not reach back into a destroyed
+  // multiplexer.
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    queues_[i]->mux_ = NULL;
+    queues_[i]->backend_ = NULL;
+  }
+  queues_.clear();
+
+  for (size_t i = 0; i < backends_.size(); ++i) {
+    backends_[i].queue->Inactivate();
+    delete backends_[i].queue;
+  }
+  backends_.clear();
+
+  if (doorbell_.handle != 0) {
+    HSA::hsa_signal_destroy(doorbell_);
+  }
+}
+
+hsa_status_t QueueMultiplexer::CreateQueue(uint32_t size,
+                                           hsa_queue_type_t type,
+                                           HsaEventCallback callback,
+                                           void* data,
+                                           uint32_t private_segment_size,
+                                           Queue** queue) {
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    if (!StartForwarding()) {
+      return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+    }
+  }
+
+  VirtualQueue* virtual_queue =
+      new VirtualQueue(this, size, type, doorbell_, callback, data);
+  if (!virtual_queue->active()) {
+    delete virtual_queue;
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+
+  const hsa_status_t status =
+      Attach(virtual_queue, size, private_segment_size);
+  if (status != HSA_STATUS_SUCCESS) {
+    delete virtual_queue;
+    return status;
+  }
+
+  *queue = virtual_queue;
+  return HSA_STATUS_SUCCESS;
+}
+
+void QueueMultiplexer::BackendError(hsa_status_t status, hsa_queue_t* source,
+                                    void* data) {
+  QueueMultiplexer* mux = reinterpret_cast<QueueMultiplexer*>(data);
+
+  struct Notification {
+    HsaEventCallback callback;
+    hsa_queue_t* queue;
+    void* data;
+  };
+
+  // Callbacks run unlocked, they commonly destroy the queue, which detaches
+  // it under lock_.
+  std::vector<Notification> notifications;
+  {
+    ScopedAcquire<KernelMutex> lock(&mux->lock_);
+    for (size_t i = 0; i < mux->queues_.size(); ++i) {
+      VirtualQueue* queue = mux->queues_[i];
+      if ((Queue::Convert(queue->backend_) == source) &&
+          (queue->callback_ != NULL)) {
+        Notification notification = {queue->callback_, queue->public_handle(),
+                                     queue->data_};
+        notifications.push_back(notification);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < notifications.size(); ++i) {
+    notifications[i].callback(status, notifications[i].queue,
+                              notifications[i].data);
+  }
+}
+
+hsa_status_t QueueMultiplexer::Attach(VirtualQueue* queue, uint32_t size,
+                                      uint32_t private_segment_size) {
+  ScopedAcquire<KernelMutex> lock(&lock_);
+
+  // Prefer a dedicated backend while the pool has room.
+  Backend* target = NULL;
+  if (backends_.size() < max_backends_) {
+    Queue* backend = factory_(size, private_segment_size);
+    if (backend != NULL) {
+      Backend entry = {backend, private_segment_size, 0};
+      backends_.push_back(entry);
+      target = &backends_.back();
+    }
+  }
+
+  // Scratch is per backend, only share one set up for the same size.
+  if (target == NULL) {
+    for (size_t i = 0; i < backends_.size(); ++i) {
+      if ((backends_[i].private_segment_size == private_segment_size) &&
+          ((target == NULL) || (backends_[i].users < target->users))) {
+        target = &backends_[i];
+      }
+    }
+  }
+
+  if (target == NULL) {
+    return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+  }
+
+  target->users++;
+  queue->backend_ = target->queue;
+  queue->amd_queue_.hsa_queue.features =
+      target->queue->amd_queue_.hsa_queue.features;
+  queues_.push_back(queue);
+
+  return HSA_STATUS_SUCCESS;
+}
+
+void QueueMultiplexer::Detach(VirtualQueue* queue) {
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    Unlink(queue);
+  }
+
+  // A round in flight may have snapshotted the queue before it was unlinked.
+  ScopedAcquire<KernelMutex> forwarding(&forward_lock_);
+  queue->backend_ = NULL;
+}
+
+void QueueMultiplexer::Unlink(VirtualQueue* queue) {
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    if (queues_[i] == queue) {
+      queues_.erase(queues_.begin() + i);
+      if (cursor_ > i) {
+        cursor_--;
+      }
+      break;
+    }
+  }
+  if (cursor_ >= queues_.size()) {
+    cursor_ = 0;
+  }
+
+  for (size_t i = 0; i < backends_.size(); ++i) {
+    if (backends_[i].queue == queue->backend_) {
+      assert(backends_[i].users != 0);
+      backends_[i].users--;
+      break;
+    }
+  }
+}
+
+bool QueueMultiplexer::StartForwarding() {
+  if (thread_ != NULL) {
+    return true;
+  }
+
+  if (doorbell_.handle == 0) {
+    if (HSA::hsa_signal_create(kIdle, 0, NULL, &doorbell_) !=
+        HSA_STATUS_SUCCESS) {
+      doorbell_.handle = 0;
+      return false;
+    }
+  }
+
+  exit_ = false;
+  thread_ = os::CreateThread(ForwardLoop, this);
+  return (thread_ != NULL);
+}
+
+void QueueMultiplexer::ForwardLoop(void* arg) {
+  QueueMultiplexer* mux = reinterpret_cast<QueueMultiplexer*>(arg);
+  Signal* doorbell = Signal::Convert(mux->doorbell_);
+
+  while (!mux->exit_) {
+    // Reset before scanning so a doorbell rung during the pass is not lost.
+    doorbell->ExchAcqRel(kIdle);
+
+    bool blocked = false;
+    uint32_t forwarded;
+    do {
+      ScopedAcquire<KernelMutex> forwarding(&mux->forward_lock_);
+      forwarded = mux->ForwardRound(&blocked);
+    } while (forwarded != 0);
+
+    // Backends do not signal when they drain, poll until they have room. No
+    // lock is held here, so queues are created and destroyed meanwhile.
+    if (blocked) {
+      os::YieldThread();
+      continue;
+    }
+
+    doorbell->WaitAcquire(HSA_SIGNAL_CONDITION_NE, kIdle, uint64_t(-1),
+                          HSA_WAIT_STATE_BLOCKED);
+  }
+}
+
+uint32_t QueueMultiplexer::ForwardRound(bool* blocked) {
+  round_.clear();
+  {
+    ScopedAcquire<KernelMutex> lock(&lock_);
+    const size_t count = queues_.size();
+    for (size_t i = 0; i < count; ++i) {
+      round_.push_back(queues_[(cursor_ + i) % count]);
+    }
+
+    // Rotate the starting point so no virtual queue is always serviced first.
+    if (count != 0) {
+      cursor_ = (cursor_ + 1) % count;
+    }
+  }
+
+  uint32_t forwarded = 0;
+  for (size_t i = 0; i < round_.size(); ++i) {
+    forwarded += Forward(round_[i], kForwardQuantum, blocked);
+  }
+
+  return forwarded;
+}
+
+uint32_t QueueMultiplexer::Forward(VirtualQueue* queue, uint32_t quantum,
+                                   bool* blocked) {
+  static const uint32_t kTypeMask = (1 << HSA_PACKET_HEADER_WIDTH_TYPE) - 1;
+  static const uint16_t kInvalidHeader = HSA_PACKET_TYPE_INVALID
+                                         << HSA_PACKET_HEADER_TYPE;
+
+  Queue* backend = queue->backend_;
+  hsa_queue_t* backend_queue = &backend->amd_queue_.hsa_queue;
+
+  // The forwarder is the only consumer of the virtual queue and the only
+  // producer of the backend, so relaxed loads of its own indices suffice.
+  uint64_t read = queue->LoadReadIndexRelaxed();
+  const uint64_t write = queue->LoadWriteIndexAcquire();
+  uint64_t backend_write = backend->LoadWriteIndexRelaxed();
+  const uint64_t backend_read = backend->LoadReadIndexAcquire();
+
+  // The backend is shared, so profiling stays enabled on it once any of its
+  // virtual queues asks for it.
+  if (AMD_HSA_BITS_GET(queue->amd_queue_.queue_properties,
+                       AMD_QUEUE_PROPERTIES_ENABLE_PROFILING) &&
+      !AMD_HSA_BITS_GET(backend->amd_queue_.queue_properties,
+                        AMD_QUEUE_PROPERTIES_ENABLE_PROFILING)) {
+    AMD_HSA_BITS_SET(backend->amd_queue_.queue_properties,
+                     AMD_QUEUE_PROPERTIES_ENABLE_PROFILING, 1);
+  }
+
+  uint32_t count = 0;
+  while ((count < quantum) && (read < write)) {
+    if (backend_write - backend_read >= backend_queue->size) {
+      *blocked = true;
+      break;
+    }
+
+    // Reload the geometry per packet, a resize may have swapped the ring.
+    hsa_queue_t* virtual_queue = &queue->amd_queue_.hsa_queue;
+    AqlPacket* src = reinterpret_cast<AqlPacket*>(
+                         virtual_queue->base_address) +
+                     (read & (virtual_queue->size - 1));
+
+    // Header and setup are published together by the producer.
+    const uint32_t header = atomic::Load(reinterpret_cast<uint32_t*>(src),
+                                         std::memory_order_acquire);
+    if (((header >> HSA_PACKET_HEADER_TYPE) & kTypeMask) ==
+        HSA_PACKET_TYPE_INVALID) {
+      break;
+    }
+
+    AqlPacket* dst = reinterpret_cast<AqlPacket*>(backend_queue->base_address) +
+                     (backend_write & (backend_queue->size - 1));
+    memcpy(reinterpret_cast<uint32_t*>(dst) + 1,
+           reinterpret_cast<uint32_t*>(src) + 1,
+           sizeof(AqlPacket) - sizeof(uint32_t));
+    atomic::Store(reinterpret_cast<uint32_t*>(dst), header,
+                  std::memory_order_release);
+
+    // Hand the slot back to the virtual queue's producers.
+    atomic::Store(&src->dispatch.header, kInvalidHeader,
+                  std::memory_order_relaxed);
+
+    ++read;
+    ++backend_write;
+    ++count;
+  }
+
+  if (count != 0) {
+    queue->StoreReadIndexRelease(read);
+    backend->StoreWriteIndexRelease(backend_write);
+    Signal::Convert(backend_queue->doorbell_signal)
+        ->StoreRelease(hsa_signal_value_t(backend_write - 1));
+  }
+
+  return count;
+}
+
+}  // namespace core
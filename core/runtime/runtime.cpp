@@ -47,6 +47,7 @@
 #include "core/inc/runtime.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 #include <vector>
@@ -57,11 +58,15 @@
 #include "core/inc/amd_memory_region.h"
 #include "core/inc/amd_memory_registration.h"
 #include "core/inc/amd_topology.h"
+#include "core/inc/metrics.h"
 #include "core/inc/signal.h"
 #include "core/inc/thunk.h"
 
 #include "core/inc/hsa_api_trace_int.h"
 
+#include "amd_hsa_code_util.hpp"
+#include "amd_hsa_kernel_code.h"
+
 #define HSA_VERSION_MAJOR 1
 #define HSA_VERSION_MINOR 0
 
@@ -271,6 +276,61 @@ uint32_t Runtime::GetQueueId() { return atomic::Increment(&queue_count_); }
 amd::LoaderContext* Runtime::loader_context() { return &loader_context_; }
 amd::hsa::code::AmdHsaCodeManager* Runtime::code_manager() { return &code_manager_; }
 
+hsa_status_t Runtime::MapCodeObject(int fd, hsa_code_object_t* code_object) {
+  size_t size = 0;
+  const void* image = amd::hsa::MapFile(fd, &size);
+  if (image == NULL) {
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  }
+
+  // Reject anything that is not a complete ELF64 image before handing the
+  // mapping to the code object manager, which trusts the section headers.
+  if (amd::elf::ElfSize(image, size) == 0) {
+    amd::hsa::UnmapFile(image, size);
+    return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+  }
+
+  code_object->handle = reinterpret_cast<uint64_t>(image);
+  ScopedAcquire<KernelMutex> lock(&memory_lock_);
+  mapped_code_objects_[code_object->handle] = size;
+  return HSA_STATUS_SUCCESS;
+}
+
+bool Runtime::UnmapCodeObject(hsa_code_object_t code_object) {
+  size_t size = 0;
+  {
+    ScopedAcquire<KernelMutex> lock(&memory_lock_);
+    std::map<uint64_t, size_t>::iterator it =
+        mapped_code_objects_.find(code_object.handle);
+    if (it == mapped_code_objects_.end()) {
+      return false;
+    }
+    size = it->second;
+    mapped_code_objects_.erase(it);
+  }
+  amd::hsa::UnmapFile(reinterpret_cast<const void*>(code_object.handle), size);
+  return true;
+}
+
+void Runtime::AddCodeObjectSize(hsa_code_object_t code_object, size_t size) {
+  ScopedAcquire<KernelMutex> lock(&memory_lock_);
+  copied_code_objects_[code_object.handle] = size;
+}
+
+void Runtime::RemoveCodeObjectSize(hsa_code_object_t code_object) {
+  ScopedAcquire<KernelMutex> lock(&memory_lock_);
+  copied_code_objects_.erase(code_object.handle);
+}
+
+size_t Runtime::CodeObjectSize(hsa_code_object_t code_object) {
+  ScopedAcquire<KernelMutex> lock(&memory_lock_);
+  std::map<uint64_t, size_t>::const_iterator it =
+      mapped_code_objects_.find(code_object.handle);
+  if (it != mapped_code_objects_.end()) return it->second;
+  it = copied_code_objects_.find(code_object.handle);
+  return (it != copied_code_objects_.end()) ? it->second : 0;
+}
+
 bool Runtime::Register(void* ptr, size_t length, bool registerWithDrivers) {
   return registered_memory_.Register(ptr, length, registerWithDrivers);
 }
@@ -307,6 +367,13 @@ hsa_status_t Runtime::AllocateMemory(const MemoryRegion* region, size_t size,
     allocation_map_[*ptr] = AllocationRegion(region, size);
   }
 
+  if (status == HSA_STATUS_SUCCESS) {
+    metrics::Add(metrics::kMemoryAllocations);
+    metrics::Add(metrics::kMemoryLive);
+    metrics::Add(metrics::kMemoryLiveBytes, int64_t(size));
+    metrics::Record(metrics::kMemoryAllocationBytes, size);
+  }
+
   return status;
 }
 
@@ -334,6 +401,13 @@ hsa_status_t Runtime::FreeMemory(void* ptr) {
     allocation_map_.erase(it);
   }
 
+  metrics::Add(metrics::kMemoryLive, -1);
+  metrics::Add(metrics::kMemoryLiveBytes, -int64_t(size));
+
+  // Kernel objects dispatched from this allocation must not outlive it.
+  const uint64_t begin = reinterpret_cast<uintptr_t>(ptr);
+  EraseKernelDescriptors(begin, begin + size);
+
   return region->Free(ptr, size);
 }
 
@@ -419,6 +493,91 @@ hsa_status_t Runtime::CopyMemory(void* dst, const void* src, size_t size) {
   return const_cast<Agent*>(agent)->DmaCopy(dst, src, size);
 }
 
+hsa_status_t Runtime::FillMemory(void* ptr, uint32_t value, size_t count) {
+  const uintptr_t uptr = reinterpret_cast<uintptr_t>(ptr);
+
+  if (uptr < system_memory_limit_) {
+    uint32_t* dwords = reinterpret_cast<uint32_t*>(ptr);
+    std::fill(dwords, dwords + count, value);
+    return HSA_STATUS_SUCCESS;
+  }
+
+  const Agent* agent = FindAllocatedRegion(ptr).assigned_agent_;
+  if (agent == NULL) {
+    return HSA_STATUS_ERROR_INVALID_ALLOCATION;
+  }
+  assert(agent->device_type() == Agent::kAmdGpuDevice);
+
+  return const_cast<Agent*>(agent)->DmaFill(ptr, value, count);
+}
+
+void Runtime::GetKernelDescriptor(uint64_t kernel_object,
+                                  hsa_amd_kernel_descriptor_t* descriptor) {
+  assert(kernel_object != 0);
+  {
+    amd::hsa::common::ReaderLockGuard<amd::hsa::common::ReaderWriterLock>
+        lock(kernel_descriptors_lock_);
+    auto it = kernel_descriptors_.find(kernel_object);
+    if (it != kernel_descriptors_.end()) {
+      *descriptor = it->second;
+      return;
+    }
+  }
+
+  const amd_kernel_code_t* akc =
+      reinterpret_cast<const amd_kernel_code_t*>(kernel_object);
+
+  hsa_amd_kernel_descriptor_t entry = {};
+  entry.kernel_object = kernel_object;
+  entry.kernarg_segment_size = uint32_t(akc->kernarg_segment_byte_size);
+  entry.kernarg_segment_alignment = uint32_t(1)
+                                    << akc->kernarg_segment_alignment;
+  entry.group_segment_size = akc->workgroup_group_segment_byte_size;
+  entry.private_segment_size = akc->workitem_private_segment_byte_size;
+  entry.is_dynamic_callstack =
+      AMD_HSA_BITS_GET(akc->kernel_code_properties,
+                       AMD_KERNEL_CODE_PROPERTIES_IS_DYNAMIC_CALLSTACK)
+          ? 1
+          : 0;
+
+  {
+    amd::hsa::common::WriterLockGuard<amd::hsa::common::ReaderWriterLock>
+        lock(kernel_descriptors_lock_);
+    kernel_descriptors_[kernel_object] = entry;
+  }
+  *descriptor = entry;
+}
+
+bool Runtime::GetLoadedKernelDescriptor(
+    uint64_t kernel_object, hsa_amd_kernel_descriptor_t* descriptor) {
+  {
+    amd::hsa::common::ReaderLockGuard<amd::hsa::common::ReaderWriterLock>
+        lock(kernel_descriptors_lock_);
+    auto it = kernel_descriptors_.find(kernel_object);
+    if (it != kernel_descriptors_.end()) {
+      *descriptor = it->second;
+      return true;
+    }
+  }
+
+  if (!IsMultipleOf(kernel_object, 256) ||
+      !loader_context_.IsKernelCode(
+          reinterpret_cast<const void*>(kernel_object),
+          sizeof(amd_kernel_code_t))) {
+    return false;
+  }
+
+  GetKernelDescriptor(kernel_object, descriptor);
+  return true;
+}
+
+void Runtime::EraseKernelDescriptors(uint64_t begin, uint64_t end) {
+  amd::hsa::common::WriterLockGuard<amd::hsa::common::ReaderWriterLock> lock(
+      kernel_descriptors_lock_);
+  kernel_descriptors_.erase(kernel_descriptors_.lower_bound(begin),
+                            kernel_descriptors_.lower_bound(end));
+}
+
 bool Runtime::RegisterWithDrivers(void* ptr, size_t length) {
   return amd::RegisterKfdMemory(ptr, length);
 }
@@ -427,7 +586,11 @@ void Runtime::DeregisterWithDrivers(void* ptr) {
   amd::DeregisterKfdMemory(ptr);
 }
 
-Runtime::Runtime() : ref_count_(0), queue_count_(0), sys_clock_freq_(0) {
+Runtime::Runtime()
+    : ref_count_(0),
+      queue_count_(0),
+      queue_auto_grow_limit_(0),
+      sys_clock_freq_(0) {
   system_memory_limit_ =
       os::GetUserModeVirtualMemoryBase() + os::GetUserModeVirtualMemorySize();
   system_region_.handle = 0;
@@ -438,6 +601,19 @@ void Runtime::Load() {
   std::string interrupt = os::GetEnvVar("HSA_ENABLE_INTERRUPT");
   g_use_interrupt_wait = (interrupt != "0");
 
+  // Load metrics options, a dump file implies collection
+  metrics_file_ = os::GetEnvVar("HSA_METRICS_FILE");
+  if (os::GetEnvVar("HSA_METRICS") == "1" || !metrics_file_.empty())
+    metrics::Enable(true);
+
+  // Load soft queue auto grow option
+  const uint32_t grow_limit =
+      atoi(os::GetEnvVar("HSA_QUEUE_AUTO_GROW_LIMIT").c_str());
+  queue_auto_grow_limit_ = IsPowerOfTwo(grow_limit) ? grow_limit : 0;
+
+  // Load code object loader options
+  loader_context_.Configure();
+
   amd::Load();
 
   // Setup system region allocator.
@@ -465,22 +641,38 @@ void Runtime::Load() {
 
   BaseShared::SetAllocateAndFree(system_allocator_, system_deallocator_);
 
+  // Load extensions, overlapped with any topology discovery left running.
+  LoadExtensions();
+
+  if (!amd::WaitForTopology()) {
+    // The agents were built from a stale topology snapshot. Nothing outside
+    // the runtime holds them yet, so replace them with agents built from the
+    // thunk's topology.
+    UnloadExtensions();
+    clock_service_.Shutdown();
+    DestroyAgents();
+    DestroyMemoryRegions();
+    system_region_.handle = 0;
+    amd::RebuildTopology();
+    LoadExtensions();
+  }
+
   // Cache system clock frequency
   HsaClockCounters clocks;
   hsaKmtGetClockCounters(0, &clocks);
   sys_clock_freq_ = clocks.SystemClockFrequencyHz;
 
-  // Load extensions
-  LoadExtensions();
-
   // Load tools libraries
   LoadTools();
 }
 
 void Runtime::Unload() {
+  if (!metrics_file_.empty()) metrics::Dump(metrics_file_);
+
   UnloadTools();
   UnloadExtensions();
   loader_context_.Reset();
+  clock_service_.Shutdown();
   DestroyAgents();
   DestroyMemoryRegions();
   CloseTools();
@@ -564,6 +756,9 @@ void Runtime::LoadTools() {
       }
     }
   }
+
+  // Pick up entries tools replaced directly in OnLoad.
+  hsa_api_table_.UpdateIntercepted();
 }
 
 void Runtime::UnloadTools() {
@@ -661,6 +856,7 @@ hsa_status_t Runtime::SetAsyncSignalHandler(hsa_signal_t signal,
   }
 
   new_async_events_.push_back(signal, cond, value, handler, arg);
+  metrics::Add(metrics::kAsyncHandlersLive);
 
   hsa_signal_handle(async_events_control_.wake)->StoreRelease(1);
 
@@ -683,11 +879,22 @@ void Runtime::async_events_loop(void*) {
     // Reset the control signal
     if (index == 0) {
       hsa_signal_handle(async_events_control_.wake)->StoreRelaxed(0);
+      metrics::Add(metrics::kAsyncWakes);
     } else if (index != -1) {
       // No error or timout occured, process the handler
+      timer::fast_clock::time_point start;
+      if (metrics::Enabled()) start = timer::fast_clock::now();
       bool keep =
           async_events_.handler_[index](value, async_events_.arg_[index]);
+      if (metrics::Enabled()) {
+        metrics::AddShard(metrics::kAsyncHandlerCalls, 1);
+        metrics::RecordShard(
+            metrics::kAsyncHandlerNs,
+            uint64_t(timer::duration_cast<std::chrono::nanoseconds>(
+                         timer::fast_clock::now() - start).count()));
+      }
       if (!keep) {
+        metrics::Add(metrics::kAsyncHandlersLive, -1);
         hsa_signal_handle(async_events_.signal_[index])->Release();
         async_events_.copy_index(index, async_events_.size() - 1);
         async_events_.pop_back();
@@ -709,6 +916,7 @@ void Runtime::async_events_loop(void*) {
     index = 0;
     while (index != async_events_.size()) {
       if (!hsa_signal_handle(async_events_.signal_[index])->IsValid()) {
+        metrics::Add(metrics::kAsyncHandlersLive, -1);
         hsa_signal_handle(async_events_.signal_[index])->Release();
         async_events_.copy_index(index, async_events_.size() - 1);
         async_events_.pop_back();
@@ -721,6 +929,8 @@ void Runtime::async_events_loop(void*) {
   // Release wait count of all pending signals
   for (size_t i = 1; i < async_events_.size(); i++)
     hsa_signal_handle(async_events_.signal_[i])->Release();
+  metrics::Add(metrics::kAsyncHandlersLive,
+               -int64_t(async_events_.size() - 1 + new_async_events_.size()));
   async_events_.clear();
 
   for (size_t i = 0; i < new_async_events_.size(); i++)
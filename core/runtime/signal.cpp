@@ -104,6 +104,8 @@ uint32_t Signal::WaitAny(uint32_t signal_count, hsa_signal_t* hsa_signals,
   int64_t value;
 
   timer::fast_clock::time_point start_time = timer::fast_clock::now();
+  timer::fast_clock::duration slept(0);
+  MAKE_SCOPE_GUARD([&]() { metrics::RecordWait(start_time, slept); });
 
   // Set a polling timeout value
   // Exact time is not hugely important, it should just be a short while which
@@ -165,7 +167,10 @@ uint32_t Signal::WaitAny(uint32_t signal_count, hsa_signal_t* hsa_signals,
         else
           wait_ms = timer::duration_cast<std::chrono::milliseconds>(
                         time_remaining).count();
+        metrics::Add(metrics::kSignalWaitSleeps);
+        timer::fast_clock::time_point sleep_start = timer::fast_clock::now();
         hsaKmtWaitOnMultipleEvents(evts, unique_evts, false, wait_ms);
+        slept += timer::fast_clock::now() - sleep_start;
       }
     }
   }
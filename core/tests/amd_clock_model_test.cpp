@@ -0,0 +1,219 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+
+// Unit test of amd::ClockModel.
+//
+// Feeds synthetic clock samples with a known offset and drift between the
+// GPU counter and the system clock, and checks the fitted converter against
+// the exact mapping. Exits with status 0 on success.
+
+#include "core/inc/amd_clock_model.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cmath>
+
+namespace {
+
+using amd::ClockConverter;
+using amd::ClockModel;
+
+int failures = 0;
+
+void Check(bool condition, const char* message) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s\n", message);
+    ++failures;
+  }
+}
+
+// Synthetic clocks: a 100 MHz GPU counter and a nanosecond system clock that
+// runs drift_ppm faster, offset by offset_ns at GPU counter zero.
+struct Clocks {
+  uint64_t gpu_start;
+  uint64_t offset_ns;
+  double drift_ppm;
+
+  double System(uint64_t gpu) const {
+    const double ns_per_tick = 10.0 * (1.0 + drift_ppm * 1e-6);
+    return double(offset_ns) + double(gpu - gpu_start) * ns_per_tick;
+  }
+
+  HsaClockCounters Sample(uint64_t gpu, int64_t jitter_ns) const {
+    HsaClockCounters sample = {};
+    sample.GPUClockCounter = gpu;
+    sample.SystemClockCounter =
+        uint64_t(int64_t(std::llround(System(gpu))) + jitter_ns);
+    return sample;
+  }
+};
+
+// 10 ms between samples, in GPU ticks.
+const uint64_t kSamplePeriod = 1000000;
+
+// Returns |converted - expected| in nanoseconds.
+double Error(const ClockConverter& clock, const Clocks& clocks, uint64_t gpu) {
+  return std::fabs(double(clock.Convert(gpu)) - clocks.System(gpu));
+}
+
+void TestNoFitBeforeTwoSamples() {
+  ClockModel model;
+  ClockConverter clock;
+  uint64_t sampled = 0;
+  Check(!model.Read(clock, sampled), "fit reported with no samples");
+
+  const Clocks clocks = {5000, 1000000000ull, 0};
+  model.AddSample(clocks.Sample(5000, 0));
+  Check(!model.Read(clock, sampled), "fit reported with one sample");
+
+  const ClockConverter anchor = model.Anchor();
+  Check(anchor.Convert(5000) == 1000000000ull,
+        "anchor does not map the newest sample onto its system time");
+  Check(anchor.Convert(5100) == 1000000100ull,
+        "anchor does not advance one to one");
+}
+
+void TestExactFit() {
+  ClockModel model;
+  const Clocks clocks = {1ull << 40, 7000000000123ull, 37.5};
+
+  uint64_t gpu = clocks.gpu_start;
+  for (int i = 0; i < 16; ++i, gpu += kSamplePeriod) {
+    model.AddSample(clocks.Sample(gpu, 0));
+  }
+  const uint64_t newest = gpu - kSamplePeriod;
+
+  ClockConverter clock;
+  uint64_t sampled = 0;
+  Check(model.Read(clock, sampled), "no fit after 16 samples");
+  Check(sampled == newest, "sampled counter is not the newest sample");
+
+  // Rounding of each sample to whole nanoseconds bounds the error.
+  Check(Error(clock, clocks, newest) < 2.0,
+        "conversion at the newest sample is off by 2 ns or more");
+  Check(Error(clock, clocks, clocks.gpu_start) < 2.0,
+        "conversion at the oldest sample is off by 2 ns or more");
+
+  // One second past the newest sample the 32.32 slope must still hold the
+  // drift, an unfitted 10 ns/tick slope would be 37.5 us off.
+  Check(Error(clock, clocks, newest + 100000000) < 100.0,
+        "conversion 1 s past the newest sample is off by 100 ns or more");
+}
+
+void TestJitterAveraged() {
+  ClockModel model;
+  const Clocks clocks = {123456789, 42000000000ull, -120.0};
+
+  // Alternating +-500 ns read latency on every sample.
+  uint64_t gpu = clocks.gpu_start;
+  for (int i = 0; i < 16; ++i, gpu += kSamplePeriod) {
+    model.AddSample(clocks.Sample(gpu, (i & 1) ? 500 : -500));
+  }
+  const uint64_t newest = gpu - kSamplePeriod;
+
+  ClockConverter clock;
+  uint64_t sampled = 0;
+  Check(model.Read(clock, sampled), "no fit after jittered samples");
+  // The pattern tilts the fitted line by about 12 ns per 10 ms, a fit through
+  // the last two samples alone would be off by 1 us at the newest one.
+  Check(Error(clock, clocks, newest) < 200.0,
+        "jitter is not averaged at the newest sample");
+  Check(Error(clock, clocks, newest + 10000000) < 500.0,
+        "jittered fit drifts by 500 ns or more within 100 ms");
+}
+
+void TestWindowSlides() {
+  ClockModel model;
+  const Clocks before = {1000, 1000000000ull, 200.0};
+
+  uint64_t gpu = before.gpu_start;
+  for (int i = 0; i < 16; ++i, gpu += kSamplePeriod) {
+    model.AddSample(before.Sample(gpu, 0));
+  }
+
+  // The system clock is stepped and slewed. Once the window holds only new
+  // samples the old drift must be gone from the fit.
+  const Clocks after = {
+      gpu, uint64_t(std::llround(before.System(gpu))) + 250000, -80.0};
+  for (int i = 0; i < 16; ++i, gpu += kSamplePeriod) {
+    model.AddSample(after.Sample(gpu, 0));
+  }
+  const uint64_t newest = gpu - kSamplePeriod;
+
+  ClockConverter clock;
+  uint64_t sampled = 0;
+  Check(model.Read(clock, sampled), "no fit after the window slid");
+  Check(Error(clock, after, newest) < 2.0,
+        "old samples are still in the fit at the newest sample");
+  Check(Error(clock, after, newest + 100000000) < 100.0,
+        "old drift is still in the fit 1 s past the newest sample");
+}
+
+void TestBackwardsClockRejected() {
+  ClockModel model;
+  ClockConverter clock;
+  uint64_t sampled = 0;
+
+  HsaClockCounters sample = {};
+  sample.GPUClockCounter = 1000;
+  sample.SystemClockCounter = 5000000;
+  model.AddSample(sample);
+  sample.GPUClockCounter = 2000;
+  sample.SystemClockCounter = 4000000;
+  model.AddSample(sample);
+  Check(!model.Read(clock, sampled),
+        "fit published for a system clock running backwards");
+}
+
+}  // namespace
+
+int main() {
+  TestNoFitBeforeTwoSamples();
+  TestExactFit();
+  TestJitterAveraged();
+  TestWindowSlides();
+  TestBackwardsClockRejected();
+  if (failures != 0) {
+    return 1;
+  }
+  printf("amd_clock_model_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,172 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// Unit test of amd::hsa::common::ReaderWriterLock.
+//
+// Checks that readers and writers exclude each other, and that a thread
+// holding a reader lock can take it again while a writer waits, as an
+// IterateSymbols callback calling GetSymbol on an unfrozen executable does.
+// Exits with status 0 on success.
+
+#include "amd_hsa_locks.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using amd::hsa::common::ReaderLockGuard;
+using amd::hsa::common::ReaderWriterLock;
+using amd::hsa::common::WriterLockGuard;
+
+// Time after which a blocked lock operation is taken for a deadlock.
+const std::chrono::seconds kDeadlockTimeout(10);
+
+int failures = 0;
+
+void Check(bool condition, const char* message) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s\n", message);
+    ++failures;
+  }
+}
+
+// Runs body on a thread and fails, without joining it, if it does not
+// finish in time.
+template <typename Body>
+void RunWithTimeout(Body body, const char* message) {
+  std::packaged_task<void()> task(body);
+  std::future<void> done = task.get_future();
+  std::thread(std::move(task)).detach();
+  if (done.wait_for(kDeadlockTimeout) != std::future_status::ready) {
+    fprintf(stderr, "FAILED: %s\n", message);
+    // The stuck thread holds the lock, there is no clean way out.
+    _Exit(1);
+  }
+}
+
+void TestNestedReaderWithWaitingWriter() {
+  ReaderWriterLock lock;
+  std::atomic<bool> writer_done(false);
+  std::thread writer;
+
+  RunWithTimeout([&]() {
+    ReaderLockGuard<ReaderWriterLock> outer(lock);
+
+    writer = std::thread([&]() {
+      WriterLockGuard<ReaderWriterLock> guard(lock);
+      writer_done = true;
+    });
+
+    // Give the writer time to queue behind the outer reader.
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Check(!writer_done, "writer acquired the lock while a reader held it");
+
+    {
+      ReaderLockGuard<ReaderWriterLock> inner(lock);
+    }
+
+    Check(!writer_done, "writer acquired the lock while a reader held it");
+  }, "nested reader deadlocked behind a waiting writer");
+
+  RunWithTimeout([&]() { writer.join(); },
+                 "writer never acquired the lock after the readers left");
+  Check(writer_done, "writer did not run");
+}
+
+void TestExclusion() {
+  static const int kThreads = 8;
+  static const int kIterations = 20000;
+
+  ReaderWriterLock lock;
+  std::atomic<int> readers(0);
+  std::atomic<int> writers(0);
+  std::atomic<bool> violated(false);
+  uint64_t value = 0;
+
+  RunWithTimeout([&]() {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.push_back(std::thread([&, t]() {
+        for (int i = 0; i < kIterations; ++i) {
+          if (0 == (i + t) % 8) {
+            WriterLockGuard<ReaderWriterLock> guard(lock);
+            if (writers.fetch_add(1) != 0 || readers.load() != 0) {
+              violated = true;
+            }
+            ++value;
+            writers.fetch_sub(1);
+          } else {
+            ReaderLockGuard<ReaderWriterLock> guard(lock);
+            readers.fetch_add(1);
+            if (writers.load() != 0) {
+              violated = true;
+            }
+            readers.fetch_sub(1);
+          }
+        }
+      }));
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }, "readers and writers deadlocked");
+
+  Check(!violated, "a writer overlapped another reader or writer");
+  Check(value == uint64_t(kThreads) * kIterations / 8,
+        "writer updates were lost");
+}
+
+}  // namespace
+
+int main() {
+  TestNestedReaderWithWaitingWriter();
+  TestExclusion();
+  if (failures != 0) {
+    return 1;
+  }
+  printf("amd_hsa_locks_test: passed\n");
+  return 0;
+}
@@ -0,0 +1,2176 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// Micro-benchmarks of runtime hot paths, driven through the public API.
+//
+// Each benchmark is calibrated to run for at least --min-time-ms, then timed
+// --repetitions times; the median, minimum and maximum time per operation are
+// reported, one result per line, as JSON or CSV. Benchmarks run under one or
+// more runtime configurations and the runtime is shut down and initialized
+// again between configurations:
+//
+//   polling    HSA_ENABLE_INTERRUPT=0, signals are DefaultSignal
+//   interrupt  HSA_ENABLE_INTERRUPT=1, signals are InterruptSignal
+//   tools      polling, with HSA_TOOLS_LIB set to --tools-lib
+//
+// Code object benchmarks run once per --code-object, or on a code object
+// generated for the agent's ISA when none is given. Benchmarks comparing
+// settings read at initialization, such as HSA_LOADER_THREADS, set them and
+// initialize the runtime again around each run. Self-checking benchmarks,
+// such as profiling/clock_check, report an error instead of a time when the
+// runtime gives a wrong result, and the bench then exits with status 1.
+//
+// Linking against the emulated thunk (libhsakmt.so.1 from the hsakmt_emu
+// directory of the build) runs every benchmark without a GPU; there, wake
+// latencies measure the runtime and not the KFD event path, and packet round
+// trips include the emulated command processor's polling.
+//
+// Usage: hsa-runtime-bench [--filter=TEXT] [--repetitions=N]
+//            [--min-time-ms=N] [--format=json|csv] [--list]
+//            [--code-object=PATH]... [--tools-lib=PATH]
+
+#include "hsa.h"
+#include "hsa_ext_amd.h"
+#include "hsa_ext_amd_inline.h"
+#include "hsa_api_trace.h"
+
+#include <elf.h>
+
+#include "amd_hsa_elf.h"
+#include "amd_hsa_kernel_code.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+enum Config { kPolling = 1, kInterrupt = 2, kTools = 4 };
+
+const Config kConfigs[] = {kPolling, kInterrupt, kTools};
+
+const char* ConfigName(Config config) {
+  switch (config) {
+    case kPolling:
+      return "polling";
+    case kInterrupt:
+      return "interrupt";
+    case kTools:
+      return "tools";
+  }
+  return "";
+}
+
+struct Options {
+  std::string filter;
+  uint32_t repetitions = 5;
+  uint64_t min_time_ns = 200000000;
+  bool csv = false;
+  bool list = false;
+  std::vector<std::string> code_objects;
+  std::string tools_lib;
+};
+
+Options options;
+
+// Agents and regions of the current configuration.
+struct Context {
+  hsa_agent_t cpu;
+  hsa_agent_t gpu;
+  hsa_region_t system;
+};
+
+Context context;
+
+// Configuration the runtime is initialized in.
+Config current_config = kPolling;
+
+// One timed run of a benchmark body. The body performs iterations
+// repetitions of its operation, excluding setup from elapsed_ns, and sets
+// skip instead if it cannot run. Self-checking benchmarks set error when the
+// runtime gives a wrong result, which fails the whole run.
+struct Run {
+  uint64_t iterations = 0;
+  uint64_t operations = 0;  // Defaults to iterations.
+  uint64_t elapsed_ns = 0;
+  std::string skip;
+  std::string error;
+  // Benchmark specific figures, reported as "name": value.
+  std::vector<std::pair<const char*, double> > figures;
+
+  void Figure(const char* name, double value) {
+    figures.push_back(std::make_pair(name, value));
+  }
+};
+
+typedef void (*Body)(Run& run, uint64_t arg);
+
+struct Benchmark {
+  std::string name;
+  uint32_t configs;
+  Body body;
+  uint64_t arg;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+uint64_t ElapsedNs(Clock::time_point start) {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now() - start).count());
+}
+
+bool Check(Run& run, hsa_status_t status, const char* what) {
+  if (status == HSA_STATUS_SUCCESS) return true;
+  const char* text = NULL;
+  hsa_status_string(status, &text);
+  run.skip = std::string(what) + ": " + (text ? text : "unknown error");
+  return false;
+}
+
+bool HasGpu(Run& run) {
+  if (context.gpu.handle != 0) return true;
+  run.skip = "no GPU agent";
+  return false;
+}
+
+// Keeps results observable so the compiler cannot drop the timed loop.
+volatile int64_t sink;
+
+void FindContext();
+
+// Sets an environment variable read at runtime initialization for its
+// lifetime, initializing the runtime again on both ends. The configuration's
+// own reference is given up meanwhile, so agents and regions are looked up
+// again.
+class RuntimeSetting {
+ public:
+  RuntimeSetting(const char* name, const char* value) : name_(name) {
+    const char* previous = getenv(name);
+    had_previous_ = (previous != NULL);
+    if (had_previous_) previous_ = previous;
+
+    hsa_shut_down();
+    Set(value);
+    initialized_ = (hsa_init() == HSA_STATUS_SUCCESS);
+    if (initialized_) FindContext();
+  }
+
+  ~RuntimeSetting() {
+    if (initialized_) hsa_shut_down();
+    Set(had_previous_ ? previous_.c_str() : NULL);
+    if (hsa_init() == HSA_STATUS_SUCCESS) FindContext();
+  }
+
+  bool Check(Run& run) {
+    if (!initialized_) run.skip = "init with " + name_ + " set";
+    return initialized_;
+  }
+
+ private:
+  void Set(const char* value) {
+    if (value != NULL)
+      setenv(name_.c_str(), value, 1);
+    else
+      unsetenv(name_.c_str());
+  }
+
+  std::string name_;
+  std::string previous_;
+  bool had_previous_;
+  bool initialized_;
+};
+
+//===----------------------------------------------------------------------===//
+// Signals.                                                                   //
+//===----------------------------------------------------------------------===//
+
+void SignalCreateDestroy(Run& run, uint64_t metrics) {
+  if (metrics) hsa_amd_metrics_enable(true);
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    hsa_signal_t signal;
+    if (!Check(run, hsa_signal_create(0, 0, NULL, &signal), "create")) break;
+    hsa_signal_destroy(signal);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+
+  if (metrics) hsa_amd_metrics_enable(false);
+}
+
+enum LoadPath { kLoadApi, kLoadInline, kLoadHooked };
+
+void* next_load_relaxed = NULL;
+
+hsa_signal_value_t HookedLoadRelaxed(hsa_signal_t signal) {
+  typedef hsa_signal_value_t (*LoadFn)(hsa_signal_t);
+  return reinterpret_cast<LoadFn>(next_load_relaxed)(signal);
+}
+
+void SignalLoad(Run& run, uint64_t path) {
+  hsa_signal_t signal;
+  if (!Check(run, hsa_signal_create(1, 0, NULL, &signal), "create")) return;
+
+  hsa_amd_api_hook_t hook;
+  if (path == kLoadHooked &&
+      !Check(run, hsa_amd_api_hook_register(
+                      offsetof(ApiTable, hsa_signal_load_relaxed_fn),
+                      reinterpret_cast<void*>(&HookedLoadRelaxed),
+                      &next_load_relaxed, &hook),
+             "hook")) {
+    hsa_signal_destroy(signal);
+    return;
+  }
+
+  int64_t sum = 0;
+  Clock::time_point start = Clock::now();
+  if (path == kLoadInline) {
+    for (uint64_t i = 0; i < run.iterations; ++i)
+      sum += hsa_amd_inline_signal_load_relaxed(signal);
+  } else {
+    for (uint64_t i = 0; i < run.iterations; ++i)
+      sum += hsa_signal_load_relaxed(signal);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  sink = sum;
+
+  if (path == kLoadHooked) hsa_amd_api_hook_remove(hook);
+  hsa_signal_destroy(signal);
+}
+
+// A mix of the value operations a dispatch loop performs on one signal.
+void SignalMixedOps(Run& run, uint64_t) {
+  hsa_signal_t signal;
+  if (!Check(run, hsa_signal_create(0, 0, NULL, &signal), "create")) return;
+
+  int64_t sum = 0;
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    hsa_signal_add_relaxed(signal, 1);
+    const hsa_signal_value_t value = hsa_signal_load_acquire(signal);
+    hsa_signal_store_release(signal, value + 1);
+    sum += hsa_signal_cas_acq_rel(signal, value + 1, value);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  run.operations = run.iterations * 4;
+  sink = sum;
+
+  hsa_signal_destroy(signal);
+}
+
+const uint64_t kMixedKinds = 1;
+
+// Stores to 4 user signals, and with kMixedKinds also to the doorbells of 4
+// GPU queues, in a fixed pseudo-random order. User signals are DefaultSignal
+// or InterruptSignal, as the configuration creates them, and take the inline
+// path; doorbells are legacy doorbell signals and go through the virtual
+// store. Every queue is primed with one barrier packet, so the timed
+// doorbell stores repeat its index and take the doorbell lock without
+// ringing the hardware again.
+void SignalKinds(Run& run, uint64_t mixed) {
+  const size_t kSignals = 4, kOrder = 256;
+  if (mixed && !HasGpu(run)) return;
+
+  std::vector<hsa_signal_t> users;
+  std::vector<hsa_queue_t*> queues;
+  for (size_t i = 0; i < kSignals && run.skip.empty(); ++i) {
+    hsa_signal_t signal;
+    if (Check(run, hsa_signal_create(0, 0, NULL, &signal), "create"))
+      users.push_back(signal);
+  }
+  const uint16_t header =
+      (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+  for (size_t i = 0; mixed && i < kSignals && run.skip.empty(); ++i) {
+    hsa_queue_t* queue;
+    if (!Check(run, hsa_queue_create(context.gpu, 64, HSA_QUEUE_TYPE_SINGLE,
+                                     NULL, NULL, UINT32_MAX, UINT32_MAX,
+                                     &queue),
+               "queue"))
+      break;
+    queues.push_back(queue);
+    const uint64_t index = hsa_queue_add_write_index_relaxed(queue, 1);
+    hsa_barrier_and_packet_t* packet =
+        reinterpret_cast<hsa_barrier_and_packet_t*>(queue->base_address) +
+        index;
+    memset(reinterpret_cast<char*>(packet) + sizeof(packet->header), 0,
+           sizeof(*packet) - sizeof(packet->header));
+    __atomic_store_n(&packet->header, header, __ATOMIC_RELEASE);
+    hsa_signal_store_relaxed(queue->doorbell_signal, index);
+    while (hsa_queue_load_read_index_acquire(queue) <= index)
+      std::this_thread::yield();
+  }
+
+  if (run.skip.empty()) {
+    // User signals take the iteration, doorbells the index of their only
+    // packet.
+    struct Target {
+      hsa_signal_t signal;
+      bool doorbell;
+    };
+    std::vector<Target> targets;
+    for (size_t i = 0; i < users.size(); ++i) {
+      const Target target = {users[i], false};
+      targets.push_back(target);
+    }
+    for (size_t i = 0; i < queues.size(); ++i) {
+      const Target target = {queues[i]->doorbell_signal, true};
+      targets.push_back(target);
+    }
+    std::vector<Target> order(kOrder);
+    uint32_t random = 12345;
+    for (size_t i = 0; i < kOrder; ++i) {
+      random = random * 1103515245 + 12345;
+      order[i] = targets[(random >> 16) % targets.size()];
+    }
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < run.iterations; ++i) {
+      const Target& target = order[i % kOrder];
+      hsa_signal_store_relaxed(target.signal,
+                               target.doorbell ? 0 : int64_t(i));
+    }
+    run.elapsed_ns = ElapsedNs(start);
+  }
+
+  for (size_t i = 0; i < queues.size(); ++i) hsa_queue_destroy(queues[i]);
+  for (size_t i = 0; i < users.size(); ++i) hsa_signal_destroy(users[i]);
+}
+
+// Two threads take turns storing to a signal the other is waiting on; the
+// time per operation is one store-to-wake round trip divided by two.
+void SignalWakeLatency(Run& run, uint64_t) {
+  hsa_signal_t ping, pong;
+  if (!Check(run, hsa_signal_create(0, 0, NULL, &ping), "create")) return;
+  if (!Check(run, hsa_signal_create(0, 0, NULL, &pong), "create")) {
+    hsa_signal_destroy(ping);
+    return;
+  }
+
+  const uint64_t iterations = run.iterations;
+  std::thread partner([=] {
+    for (uint64_t i = 1; i <= iterations; ++i) {
+      hsa_signal_wait_acquire(ping, HSA_SIGNAL_CONDITION_EQ, i, UINT64_MAX,
+                              HSA_WAIT_STATE_BLOCKED);
+      hsa_signal_store_release(pong, i);
+    }
+  });
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 1; i <= iterations; ++i) {
+    hsa_signal_store_release(ping, i);
+    hsa_signal_wait_acquire(pong, HSA_SIGNAL_CONDITION_EQ, i, UINT64_MAX,
+                            HSA_WAIT_STATE_BLOCKED);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  run.operations = iterations * 2;
+
+  partner.join();
+  hsa_signal_destroy(ping);
+  hsa_signal_destroy(pong);
+}
+
+// Waits on count signals of which only the last is satisfied.
+void SignalWaitAny(Run& run, uint64_t count) {
+  std::vector<hsa_signal_t> signals(count);
+  std::vector<hsa_signal_condition_t> conds(count, HSA_SIGNAL_CONDITION_EQ);
+  std::vector<hsa_signal_value_t> values(count, 1);
+  for (uint64_t i = 0; i < count; ++i) {
+    if (!Check(run, hsa_signal_create(i + 1 == count ? 1 : 0, 0, NULL,
+                                      &signals[i]),
+               "create")) {
+      signals.resize(i);
+      break;
+    }
+  }
+
+  if (run.skip.empty()) {
+    hsa_signal_value_t value;
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < run.iterations; ++i)
+      sum += hsa_amd_signal_wait_any(uint32_t(count), &signals[0], &conds[0],
+                                     &values[0], UINT64_MAX,
+                                     HSA_WAIT_STATE_ACTIVE, &value);
+    run.elapsed_ns = ElapsedNs(start);
+    sink = sum;
+  }
+
+  for (size_t i = 0; i < signals.size(); ++i) hsa_signal_destroy(signals[i]);
+}
+
+void SignalWaitAnyMetrics(Run& run, uint64_t count) {
+  hsa_amd_metrics_enable(true);
+  SignalWaitAny(run, count);
+  hsa_amd_metrics_enable(false);
+}
+
+//===----------------------------------------------------------------------===//
+// Asynchronous handlers.                                                     //
+//===----------------------------------------------------------------------===//
+
+struct FanOut {
+  std::atomic<uint64_t> fired;
+};
+
+struct FanOutArg {
+  FanOut* fan_out;
+  hsa_signal_t signal;
+};
+
+const hsa_signal_value_t kFanOutStop = 2;
+
+// Rearms itself by resetting the signal, until told to stop.
+bool FanOutHandler(hsa_signal_value_t value, void* arg) {
+  FanOutArg* fan_out_arg = reinterpret_cast<FanOutArg*>(arg);
+  if (value != kFanOutStop) hsa_signal_store_relaxed(fan_out_arg->signal, 0);
+  fan_out_arg->fan_out->fired.fetch_add(1, std::memory_order_release);
+  return value != kFanOutStop;
+}
+
+bool FenceHandler(hsa_signal_value_t, void* arg) {
+  reinterpret_cast<std::atomic<bool>*>(arg)->store(true);
+  return false;
+}
+
+void WaitFired(const FanOut& fan_out, uint64_t count) {
+  while (fan_out.fired.load(std::memory_order_acquire) < count)
+    std::this_thread::yield();
+}
+
+// The handler thread releases a signal after its handler returns false. Once a
+// handler registered later has run, every earlier release has happened and
+// the signals may be destroyed. The fence signal of the previous call is
+// retired the same way; the last one is left to the runtime.
+hsa_signal_t previous_fence = {0};
+
+void FenceHandlers() {
+  hsa_signal_t fence;
+  if (hsa_signal_create(1, 0, NULL, &fence) != HSA_STATUS_SUCCESS) return;
+
+  std::atomic<bool> done(false);
+  hsa_amd_signal_async_handler(fence, HSA_SIGNAL_CONDITION_NE, 0,
+                               FenceHandler, &done);
+  while (!done.load()) std::this_thread::yield();
+
+  if (previous_fence.handle != 0) hsa_signal_destroy(previous_fence);
+  previous_fence = fence;
+}
+
+// Signals count handlers at once and times until all of them have run.
+void AsyncFanOut(Run& run, uint64_t count) {
+  FanOut fan_out;
+  fan_out.fired = 0;
+
+  std::vector<FanOutArg> args(count);
+  size_t registered = 0;
+  for (; registered < count; ++registered) {
+    FanOutArg& arg = args[registered];
+    arg.fan_out = &fan_out;
+    if (!Check(run, hsa_signal_create(0, 0, NULL, &arg.signal), "create"))
+      break;
+    if (!Check(run, hsa_amd_signal_async_handler(arg.signal,
+                                                 HSA_SIGNAL_CONDITION_NE, 0,
+                                                 FanOutHandler, &arg),
+               "register")) {
+      hsa_signal_destroy(arg.signal);
+      break;
+    }
+  }
+
+  if (run.skip.empty()) {
+    // The first round also waits for the handler thread to pick up the
+    // registrations, so it is not timed.
+    uint64_t expected = 0;
+    for (uint64_t round = 0; round <= run.iterations; ++round) {
+      Clock::time_point start = Clock::now();
+      for (size_t i = 0; i < count; ++i)
+        hsa_signal_store_relaxed(args[i].signal, 1);
+      expected += count;
+      WaitFired(fan_out, expected);
+      if (round != 0) run.elapsed_ns += ElapsedNs(start);
+    }
+  }
+
+  for (size_t i = 0; i < registered; ++i)
+    hsa_signal_store_relaxed(args[i].signal, kFanOutStop);
+  WaitFired(fan_out, fan_out.fired.load() + registered);
+  FenceHandlers();
+  for (size_t i = 0; i < registered; ++i) hsa_signal_destroy(args[i].signal);
+}
+
+//===----------------------------------------------------------------------===//
+// Queues.                                                                    //
+//===----------------------------------------------------------------------===//
+
+const uint64_t kInlineIndices = uint64_t(1) << 32;
+
+// threads threads reserve packet slots on one GPU queue, through the API or
+// through the inline index accessors. The queue is never rung, so no packet
+// is processed. The time per operation is the wall time of one reservation
+// as seen by each thread.
+void QueueReserve(Run& run, uint64_t arg) {
+  const uint32_t threads = uint32_t(arg);
+  const bool use_inline = (arg & kInlineIndices) != 0;
+  if (!HasGpu(run)) return;
+
+  hsa_queue_t* queue;
+  if (!Check(run, hsa_queue_create(context.gpu, 4096, HSA_QUEUE_TYPE_MULTI,
+                                   NULL, NULL, UINT32_MAX, UINT32_MAX,
+                                   &queue),
+             "queue create"))
+    return;
+
+  // The inline accessors fall back to the API on queues without inline
+  // indices, which would measure the API twice.
+  const amd_queue_t* amd_queue = reinterpret_cast<const amd_queue_t*>(queue);
+  if (!AMD_HSA_BITS_GET(amd_queue->queue_properties,
+                        AMD_QUEUE_PROPERTIES_INLINE_INDICES)) {
+    run.skip = "queue without inline indices";
+    hsa_queue_destroy(queue);
+    return;
+  }
+
+  const uint64_t iterations = run.iterations;
+  std::atomic<bool> go(false);
+  std::vector<std::thread> workers;
+  for (uint32_t t = 0; t < threads; ++t) {
+    workers.push_back(std::thread([&go, queue, iterations, use_inline] {
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      uint64_t sum = 0;
+      if (use_inline) {
+        for (uint64_t i = 0; i < iterations; ++i)
+          sum += hsa_amd_inline_queue_add_write_index_relaxed(queue, 1);
+      } else {
+        for (uint64_t i = 0; i < iterations; ++i)
+          sum += hsa_queue_add_write_index_relaxed(queue, 1);
+      }
+      sink = int64_t(sum);
+    }));
+  }
+
+  Clock::time_point start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+  run.elapsed_ns = ElapsedNs(start);
+
+  hsa_queue_destroy(queue);
+}
+
+// Submits a barrier-AND packet to a GPU queue and waits for its completion
+// signal, one packet at a time.
+void QueueBarrierRoundTrip(Run& run, uint64_t) {
+  if (!HasGpu(run)) return;
+
+  hsa_queue_t* queue;
+  if (!Check(run, hsa_queue_create(context.gpu, 64, HSA_QUEUE_TYPE_SINGLE, NULL,
+                                   NULL, UINT32_MAX, UINT32_MAX, &queue),
+             "queue"))
+    return;
+
+  hsa_signal_t signal;
+  if (!Check(run, hsa_signal_create(1, 0, NULL, &signal), "create")) {
+    hsa_queue_destroy(queue);
+    return;
+  }
+
+  hsa_barrier_and_packet_t* packets =
+      reinterpret_cast<hsa_barrier_and_packet_t*>(queue->base_address);
+  const uint16_t header =
+      (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    const uint64_t index = hsa_queue_add_write_index_relaxed(queue, 1);
+    hsa_barrier_and_packet_t* packet = &packets[index & (queue->size - 1)];
+    memset(reinterpret_cast<char*>(packet) + sizeof(packet->header), 0,
+           sizeof(*packet) - sizeof(packet->header));
+    packet->completion_signal = signal;
+    __atomic_store_n(&packet->header, header, __ATOMIC_RELEASE);
+    hsa_signal_store_relaxed(queue->doorbell_signal, index);
+
+    hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+                            HSA_WAIT_STATE_BLOCKED);
+    hsa_signal_store_relaxed(signal, 1);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+
+  hsa_signal_destroy(signal);
+  hsa_queue_destroy(queue);
+}
+
+// Packets submitted to each queue per iteration of QueueMultiplexing.
+const uint32_t kMuxBatch = 16;
+
+// Returns true when the completion signals of one queue's batch show no
+// packet completing before an earlier packet of the same queue. The signals
+// are read from the newest packet back, so an earlier packet still pending
+// after a later one was seen complete is out of order.
+bool InOrder(const hsa_signal_t* signals, uint32_t* pending) {
+  bool later_done = false;
+  *pending = 0;
+  for (uint32_t j = kMuxBatch; j-- > 0;) {
+    const bool done = hsa_signal_load_acquire(signals[j]) == 0;
+    if (!done && later_done) return false;
+    later_done = later_done || done;
+    if (!done) ++*pending;
+  }
+  return true;
+}
+
+// queues GPU queues each take kMuxBatch barrier packets per iteration, with
+// the barrier bit set and a completion signal per packet, and are polled
+// until all packets complete. HSA_VIRTUAL_QUEUE_POOL_SIZE is set to pool, so
+// with a pool the queues are virtual queues multiplexed onto at most pool
+// hardware queues, and with pool 0 every queue is a hardware queue. Packets
+// of one queue completing out of order are an error.
+void QueueMultiplexing(Run& run, uint64_t arg) {
+  const uint32_t pool = uint32_t(arg);
+  const uint32_t queues = uint32_t(arg >> 32);
+  if (!HasGpu(run)) return;
+  const std::string pool_size = std::to_string(pool);
+  RuntimeSetting setting("HSA_VIRTUAL_QUEUE_POOL_SIZE", pool_size.c_str());
+  if (!setting.Check(run) || !HasGpu(run)) return;
+
+  std::vector<hsa_queue_t*> created;
+  std::vector<hsa_signal_t> signals;
+  for (uint32_t q = 0; q < queues && run.skip.empty(); ++q) {
+    hsa_queue_t* queue;
+    if (!Check(run, hsa_queue_create(context.gpu, 64, HSA_QUEUE_TYPE_SINGLE,
+                                     NULL, NULL, UINT32_MAX, UINT32_MAX,
+                                     &queue),
+               "queue"))
+      break;
+    created.push_back(queue);
+    for (uint32_t j = 0; j < kMuxBatch; ++j) {
+      hsa_signal_t signal;
+      if (!Check(run, hsa_signal_create(1, 0, NULL, &signal), "create")) break;
+      signals.push_back(signal);
+    }
+  }
+
+  const uint16_t header =
+      (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+      (1 << HSA_PACKET_HEADER_BARRIER) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations && run.skip.empty(); ++i) {
+    for (uint32_t q = 0; q < queues; ++q) {
+      hsa_queue_t* queue = created[q];
+      hsa_barrier_and_packet_t* packets =
+          reinterpret_cast<hsa_barrier_and_packet_t*>(queue->base_address);
+      const uint64_t first =
+          hsa_queue_add_write_index_relaxed(queue, kMuxBatch);
+      for (uint32_t j = 0; j < kMuxBatch; ++j) {
+        hsa_barrier_and_packet_t* packet =
+            &packets[(first + j) & (queue->size - 1)];
+        memset(reinterpret_cast<char*>(packet) + sizeof(packet->header), 0,
+               sizeof(*packet) - sizeof(packet->header));
+        packet->completion_signal = signals[q * kMuxBatch + j];
+        __atomic_store_n(&packet->header, header, __ATOMIC_RELEASE);
+      }
+      hsa_signal_store_relaxed(queue->doorbell_signal,
+                               first + kMuxBatch - 1);
+    }
+
+    for (uint32_t pending = 1; pending != 0 && run.error.empty();) {
+      pending = 0;
+      for (uint32_t q = 0; q < queues; ++q) {
+        uint32_t left;
+        if (!InOrder(&signals[q * kMuxBatch], &left)) {
+          run.error = "queue " + std::to_string(q) +
+                      " completed packets out of order";
+          break;
+        }
+        pending += left;
+      }
+    }
+    if (!run.error.empty()) break;
+    for (size_t s = 0; s < signals.size(); ++s)
+      hsa_signal_store_relaxed(signals[s], 1);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  run.operations = run.iterations * queues * kMuxBatch;
+
+  for (size_t s = 0; s < signals.size(); ++s) hsa_signal_destroy(signals[s]);
+  for (size_t q = 0; q < created.size(); ++q) hsa_queue_destroy(created[q]);
+}
+
+//===----------------------------------------------------------------------===//
+// Memory.                                                                    //
+//===----------------------------------------------------------------------===//
+
+void MemoryRegister(Run& run, uint64_t size) {
+  void* buffer = NULL;
+  if (posix_memalign(&buffer, 4096, size) != 0) {
+    run.skip = "out of host memory";
+    return;
+  }
+  memset(buffer, 0, size);
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    if (!Check(run, hsa_memory_register(buffer, size), "register")) break;
+    hsa_memory_deregister(buffer, size);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+
+  free(buffer);
+}
+
+// Allocates and frees 16 blocks at a time, so frees do not always hit the
+// most recent allocation.
+void MemoryAllocate(Run& run, uint64_t size) {
+  const size_t kBatch = 16;
+  void* blocks[kBatch];
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations && run.skip.empty(); ++i) {
+    size_t allocated = 0;
+    for (; allocated < kBatch; ++allocated) {
+      if (!Check(run, hsa_memory_allocate(context.system, size,
+                                          &blocks[allocated]),
+                 "allocate"))
+        break;
+    }
+    const size_t stride = (allocated == kBatch) ? 7 : 1;
+    for (size_t b = 0; b < allocated; ++b)
+      hsa_memory_free(blocks[(b * stride) % allocated]);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  run.operations = run.iterations * kBatch;
+}
+
+//===----------------------------------------------------------------------===//
+// Runtime.                                                                   //
+//===----------------------------------------------------------------------===//
+
+// Times hsa_init and hsa_shut_down of the whole runtime, giving up the
+// configuration's own reference meanwhile. With a nonzero arg init reads the
+// topology from a cache in a scratch directory, primed before timing.
+void RuntimeInitShutDown(Run& run, uint64_t topology_cache) {
+  char directory[] = "/tmp/hsa-runtime-bench-XXXXXX";
+  if (topology_cache) {
+    if (mkdtemp(directory) == NULL) {
+      run.skip = "cannot create a topology cache directory";
+      return;
+    }
+    setenv("HSA_TOPOLOGY_CACHE_DIR", directory, 1);
+  }
+
+  hsa_shut_down();
+  if (topology_cache && hsa_init() == HSA_STATUS_SUCCESS) hsa_shut_down();
+
+  uint64_t init_ns = 0;
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    Clock::time_point init = Clock::now();
+    if (!Check(run, hsa_init(), "init")) break;
+    init_ns += ElapsedNs(init);
+    hsa_shut_down();
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  run.Figure("init_ns", double(init_ns) / double(run.iterations));
+
+  if (topology_cache) {
+    unsetenv("HSA_TOPOLOGY_CACHE_DIR");
+    remove((std::string(directory) + "/topology.hsa-cache").c_str());
+    rmdir(directory);
+  }
+
+  // Agents and regions are new objects after init, look them up again.
+  if (Check(run, hsa_init(), "init")) FindContext();
+}
+
+//===----------------------------------------------------------------------===//
+// Profiling.                                                                 //
+//===----------------------------------------------------------------------===//
+
+const uint32_t kProfilingBatch = 64;
+
+// Collects batches of completion signals into the timeline of a soft queue,
+// draining it every 64 batches.
+void ProfilingCollect(Run& run, uint64_t) {
+  if (!HasGpu(run)) return;
+
+  hsa_signal_t doorbell;
+  if (!Check(run, hsa_signal_create(0, 0, NULL, &doorbell), "create")) return;
+
+  hsa_queue_t* queue = NULL;
+  std::vector<hsa_signal_t> signals;
+  if (Check(run, hsa_soft_queue_create(context.system, 64,
+                                       HSA_QUEUE_TYPE_MULTI,
+                                       HSA_QUEUE_FEATURE_AGENT_DISPATCH,
+                                       doorbell, &queue),
+            "soft queue")) {
+    for (uint32_t i = 0; i < kProfilingBatch; ++i) {
+      hsa_signal_t signal;
+      if (!Check(run, hsa_signal_create(0, 0, NULL, &signal), "create")) break;
+      signals.push_back(signal);
+    }
+  }
+
+  if (run.skip.empty()) {
+    std::vector<hsa_amd_profiling_record_t> records(kProfilingBatch * 64);
+    uint32_t count;
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < run.iterations; ++i) {
+      hsa_amd_profiling_collect(context.gpu, queue, kProfilingBatch,
+                                &signals[0]);
+      if ((i & 63) == 63)
+        hsa_amd_profiling_drain(queue, uint32_t(records.size()), &records[0],
+                                &count, NULL);
+    }
+    run.elapsed_ns = ElapsedNs(start);
+    run.operations = run.iterations * kProfilingBatch;
+  }
+
+  for (size_t i = 0; i < signals.size(); ++i) hsa_signal_destroy(signals[i]);
+  if (queue != NULL) hsa_queue_destroy(queue);
+  hsa_signal_destroy(doorbell);
+}
+
+void ProfilingDispatchTime(Run& run, uint64_t) {
+  if (!HasGpu(run)) return;
+
+  hsa_signal_t signal;
+  if (!Check(run, hsa_signal_create(0, 0, NULL, &signal), "create")) return;
+
+  hsa_amd_profiling_dispatch_time_t time;
+  uint64_t sum = 0;
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    hsa_amd_profiling_get_dispatch_time(context.gpu, signal, &time);
+    sum += time.end;
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  sink = int64_t(sum);
+
+  hsa_signal_destroy(signal);
+}
+
+// Drift of the emulated GPU clock in the clock self-check, how far a
+// translated time stamp may fall outside the host time stamps around its
+// dispatch, and how long the clock model gets to fill its window.
+const int64_t kClockDriftPpm = 500;
+const uint64_t kClockToleranceNs = 1000;
+const uint32_t kClockWarmupMs = 50;
+
+// Checks the GPU clock model: every translated dispatch time must lie within
+// the system time stamps read before submitting the packet and after its
+// completion, with the model sampling the clocks every millisecond. On the
+// emulated thunk, arg sets the drift of the GPU clock in parts per million;
+// elsewhere the drift is the hardware's own.
+void ClockSelfCheck(Run& run, uint64_t arg) {
+  if (!HasGpu(run)) return;
+  const std::string ppm = std::to_string(int64_t(arg));
+  RuntimeSetting drift("HSA_EMU_CLOCK_PPM", ppm.c_str());
+  if (!drift.Check(run)) return;
+  RuntimeSetting period("HSA_CLOCK_SAMPLE_MS", "1");
+  if (!period.Check(run) || !HasGpu(run)) return;
+
+  uint64_t frequency = 0;
+  hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP_FREQUENCY, &frequency);
+  const uint64_t tolerance = kClockToleranceNs * frequency / 1000000000;
+
+  hsa_queue_t* queue;
+  if (!Check(run, hsa_queue_create(context.gpu, 64, HSA_QUEUE_TYPE_SINGLE, NULL,
+                                   NULL, UINT32_MAX, UINT32_MAX, &queue),
+             "queue"))
+    return;
+  hsa_signal_t signal;
+  if (!Check(run, hsa_amd_profiling_set_profiler_enabled(queue, 1),
+             "profiler") ||
+      !Check(run, hsa_signal_create(1, 0, NULL, &signal), "create")) {
+    hsa_queue_destroy(queue);
+    return;
+  }
+
+  hsa_barrier_and_packet_t* packets =
+      reinterpret_cast<hsa_barrier_and_packet_t*>(queue->base_address);
+  const uint16_t header =
+      (HSA_PACKET_TYPE_BARRIER_AND << HSA_PACKET_HEADER_TYPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_ACQUIRE_FENCE_SCOPE) |
+      (HSA_FENCE_SCOPE_SYSTEM << HSA_PACKET_HEADER_RELEASE_FENCE_SCOPE);
+
+  // Returns how far the dispatch time of one packet falls outside the host
+  // time stamps around it, in ticks.
+  auto dispatch = [&]() -> uint64_t {
+    uint64_t before, after;
+    hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP, &before);
+    const uint64_t index = hsa_queue_add_write_index_relaxed(queue, 1);
+    hsa_barrier_and_packet_t* packet = &packets[index & (queue->size - 1)];
+    memset(reinterpret_cast<char*>(packet) + sizeof(packet->header), 0,
+           sizeof(*packet) - sizeof(packet->header));
+    packet->completion_signal = signal;
+    __atomic_store_n(&packet->header, header, __ATOMIC_RELEASE);
+    hsa_signal_store_relaxed(queue->doorbell_signal, index);
+    hsa_signal_wait_acquire(signal, HSA_SIGNAL_CONDITION_EQ, 0, UINT64_MAX,
+                            HSA_WAIT_STATE_BLOCKED);
+    hsa_system_get_info(HSA_SYSTEM_INFO_TIMESTAMP, &after);
+
+    hsa_amd_profiling_dispatch_time_t time;
+    hsa_amd_profiling_get_dispatch_time(context.gpu, signal, &time);
+    hsa_signal_store_relaxed(signal, 1);
+
+    uint64_t outside = 0;
+    if (time.start < before) outside = before - time.start;
+    if (time.end < time.start)
+      outside = std::max(outside, time.start - time.end);
+    if (time.end > after) outside = std::max(outside, time.end - after);
+    return outside;
+  };
+
+  // The first translation starts the clock service.
+  dispatch();
+  std::this_thread::sleep_for(std::chrono::milliseconds(kClockWarmupMs));
+
+  uint64_t worst = 0;
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i)
+    worst = std::max(worst, dispatch());
+  run.elapsed_ns = ElapsedNs(start);
+
+  const double worst_ns = double(worst) * 1e9 / double(frequency);
+  run.Figure("max_outside_ns", worst_ns);
+  if (worst > tolerance)
+    run.error = "dispatch time " + std::to_string(uint64_t(worst_ns)) +
+                " ns outside the host time stamps";
+
+  hsa_signal_destroy(signal);
+  hsa_queue_destroy(queue);
+}
+
+//===----------------------------------------------------------------------===//
+// Tracing.                                                                   //
+//===----------------------------------------------------------------------===//
+
+// Time per hsa_signal_load_relaxed call in the polling configuration.
+double untraced_load_ns = 0;
+
+// Calls hsa_signal_load_relaxed through the API table. With the API tracer
+// as --tools-lib, the time per call in the tools configuration less the time
+// in the polling configuration is the tracer's overhead per intercepted call,
+// reported as overhead_ns; its target is below 50 ns.
+void TracerOverhead(Run& run, uint64_t) {
+  hsa_signal_t signal;
+  if (!Check(run, hsa_signal_create(1, 0, NULL, &signal), "create")) return;
+
+  int64_t sum = 0;
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i)
+    sum += hsa_signal_load_relaxed(signal);
+  run.elapsed_ns = ElapsedNs(start);
+  sink = sum;
+  hsa_signal_destroy(signal);
+
+  const double ns = double(run.elapsed_ns) / double(run.iterations);
+  if (current_config != kTools) {
+    untraced_load_ns = ns;
+  } else if (untraced_load_ns > 0) {
+    run.Figure("overhead_ns", ns - untraced_load_ns);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Code objects.                                                              //
+//===----------------------------------------------------------------------===//
+
+// Shape of a code object generated for the agent under test. Every kernel is
+// a program linkage symbol with a zeroed descriptor in .hsatext; variables and
+// relocation slots share one agent global data section, and each relocation
+// writes the address of a kernel into its own 8 byte slot.
+struct Shape {
+  uint32_t kernels;
+  uint32_t variables;
+  uint32_t relocations;
+  uint64_t data_bytes;  // Data section image beyond the slots.
+};
+
+struct CodeObjectFile {
+  std::string name;
+  std::string path;  // Written on first use for generated code objects.
+  std::vector<char> bytes;
+  bool generated;
+  Shape shape;
+};
+
+std::vector<CodeObjectFile> code_object_files;
+
+bool ReadFile(const std::string& path, std::vector<char>& bytes) {
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) return false;
+  bytes.assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return !bytes.empty();
+}
+
+bool WriteFile(const std::string& path, const std::vector<char>& bytes) {
+  std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+  file.write(&bytes[0], std::streamsize(bytes.size()));
+  return bool(file);
+}
+
+// Removes the regular files of a directory.
+void ClearDirectory(const std::string& path) {
+  if (DIR* directory = opendir(path.c_str())) {
+    while (dirent* entry = readdir(directory)) {
+      if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        remove((path + "/" + entry->d_name).c_str());
+    }
+    closedir(directory);
+  }
+}
+
+void RemoveDirectory(const std::string& path) {
+  ClearDirectory(path);
+  rmdir(path.c_str());
+}
+
+// Holds the files of generated code objects until the benchmark exits.
+std::string scratch_directory;
+
+bool ScratchPath(const std::string& name, std::string& path) {
+  if (scratch_directory.empty()) {
+    char directory[] = "/tmp/hsa-runtime-bench-XXXXXX";
+    if (mkdtemp(directory) == NULL) return false;
+    scratch_directory = directory;
+  }
+  path = scratch_directory + "/" + name;
+  return true;
+}
+
+size_t AlignBytes(std::vector<char>& bytes, size_t alignment) {
+  bytes.resize((bytes.size() + alignment - 1) / alignment * alignment);
+  return bytes.size();
+}
+
+size_t AppendBytes(std::vector<char>& bytes, const void* data, size_t size) {
+  const size_t offset = bytes.size();
+  bytes.insert(bytes.end(), reinterpret_cast<const char*>(data),
+               reinterpret_cast<const char*>(data) + size);
+  return offset;
+}
+
+template <typename T>
+size_t Append(std::vector<char>& bytes, const T& value) {
+  return AppendBytes(bytes, &value, sizeof(value));
+}
+
+size_t AppendString(std::vector<char>& strings, const std::string& text) {
+  return AppendBytes(strings, text.c_str(), text.size() + 1);
+}
+
+void AppendNote(std::vector<char>& bytes, uint32_t type, const void* desc,
+                size_t desc_size) {
+  Elf64_Nhdr header;
+  header.n_namesz = 4;
+  header.n_descsz = uint32_t(desc_size);
+  header.n_type = type;
+  Append(bytes, header);
+  AppendBytes(bytes, "AMD", 4);
+  AppendBytes(bytes, desc, desc_size);
+  AlignBytes(bytes, 4);
+}
+
+// Splits the agent's ISA name, vendor:architecture:major:minor:stepping.
+bool AgentIsa(std::vector<std::string>& fields) {
+  hsa_isa_t isa;
+  uint32_t length = 0;
+  if (hsa_agent_get_info(context.gpu, HSA_AGENT_INFO_ISA, &isa) !=
+          HSA_STATUS_SUCCESS ||
+      hsa_isa_get_info(isa, HSA_ISA_INFO_NAME_LENGTH, 0, &length) !=
+          HSA_STATUS_SUCCESS)
+    return false;
+  std::string name(length, '\0');
+  if (hsa_isa_get_info(isa, HSA_ISA_INFO_NAME, 0, &name[0]) !=
+      HSA_STATUS_SUCCESS)
+    return false;
+  name.resize(strlen(name.c_str()));
+
+  fields.clear();
+  size_t begin = 0;
+  for (size_t colon; (colon = name.find(':', begin)) != std::string::npos;
+       begin = colon + 1)
+    fields.push_back(name.substr(begin, colon - begin));
+  fields.push_back(name.substr(begin));
+  return fields.size() == 5;
+}
+
+const size_t kKernelStride = 256;
+
+bool GenerateCodeObject(const Shape& shape, std::vector<char>& elf) {
+  static_assert(sizeof(amd_kernel_code_t) <= kKernelStride,
+                "kernel descriptors overlap");
+  std::vector<std::string> isa;
+  if (shape.kernels == 0 || !AgentIsa(isa)) return false;
+
+  enum {
+    kText = 1, kData, kNote, kRela, kSymtab, kStrtab, kShstrtab, kSections
+  };
+  Elf64_Shdr sections[kSections];
+  memset(sections, 0, sizeof(sections));
+  std::vector<char> shstrtab(1, '\0'), strtab(1, '\0');
+
+  elf.assign(sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr), 0);
+
+  amd_kernel_code_t descriptor;
+  memset(&descriptor, 0, sizeof(descriptor));
+  descriptor.amd_kernel_code_version_major = AMD_KERNEL_CODE_VERSION_MAJOR;
+  descriptor.amd_machine_kind = AMD_MACHINE_KIND_AMDGPU;
+  descriptor.kernel_code_entry_byte_offset = sizeof(descriptor);
+  descriptor.kernarg_segment_alignment = 4;
+  descriptor.group_segment_alignment = 4;
+  descriptor.private_segment_alignment = 4;
+  Elf64_Shdr& text = sections[kText];
+  text.sh_offset = AlignBytes(elf, kKernelStride);
+  for (uint32_t k = 0; k < shape.kernels; ++k) {
+    Append(elf, descriptor);
+    AlignBytes(elf, kKernelStride);
+  }
+  text.sh_name = uint32_t(AppendString(shstrtab, ".hsatext"));
+  text.sh_type = SHT_PROGBITS;
+  text.sh_flags = SHF_ALLOC | SHF_EXECINSTR | SHF_WRITE |
+                  SHF_AMDGPU_HSA_CODE | SHF_AMDGPU_HSA_AGENT;
+  text.sh_size = elf.size() - text.sh_offset;
+  text.sh_addralign = kKernelStride;
+
+  const uint64_t slots = std::max(shape.variables, shape.relocations);
+  Elf64_Shdr& data = sections[kData];
+  data.sh_offset = AlignBytes(elf, 8);
+  data.sh_size = std::max<uint64_t>(slots * 8 + shape.data_bytes, 8);
+  elf.resize(elf.size() + data.sh_size, 0);
+  data.sh_name = uint32_t(AppendString(shstrtab, ".hsadata_global_agent"));
+  data.sh_type = SHT_PROGBITS;
+  data.sh_flags = SHF_ALLOC | SHF_WRITE | SHF_AMDGPU_HSA_GLOBAL |
+                  SHF_AMDGPU_HSA_AGENT;
+  data.sh_addr = (text.sh_size + 4095) & ~uint64_t(4095);
+  data.sh_addralign = 8;
+
+  Elf64_Shdr& note = sections[kNote];
+  note.sh_offset = AlignBytes(elf, 8);
+  amdgpu_hsa_note_code_object_version_t version = {2, 0};
+  AppendNote(elf, NT_AMDGPU_HSA_CODE_OBJECT_VERSION, &version,
+             sizeof(version));
+  amdgpu_hsa_note_hsail_t hsail;
+  memset(&hsail, 0, sizeof(hsail));
+  hsail.hsail_major_version = 1;
+  hsail.profile = HSA_PROFILE_FULL;
+  hsail.machine_model = HSA_MACHINE_MODEL_LARGE;
+  hsail.default_float_round = HSA_DEFAULT_FLOAT_ROUNDING_MODE_NEAR;
+  AppendNote(elf, NT_AMDGPU_HSA_HSAIL, &hsail, sizeof(hsail));
+  std::vector<char> isa_note(offsetof(amdgpu_hsa_note_isa_t,
+                                      vendor_and_architecture_name),
+                             0);
+  amdgpu_hsa_note_isa_t* isa_desc =
+      reinterpret_cast<amdgpu_hsa_note_isa_t*>(&isa_note[0]);
+  isa_desc->vendor_name_size = uint16_t(isa[0].size() + 1);
+  isa_desc->architecture_name_size = uint16_t(isa[1].size() + 1);
+  isa_desc->major = uint32_t(atoi(isa[2].c_str()));
+  isa_desc->minor = uint32_t(atoi(isa[3].c_str()));
+  isa_desc->stepping = uint32_t(atoi(isa[4].c_str()));
+  AppendString(isa_note, isa[0]);
+  AppendString(isa_note, isa[1]);
+  AppendNote(elf, NT_AMDGPU_HSA_ISA, &isa_note[0], isa_note.size());
+  note.sh_name = uint32_t(AppendString(shstrtab, ".note"));
+  note.sh_type = SHT_NOTE;
+  note.sh_size = elf.size() - note.sh_offset;
+  note.sh_addralign = 4;
+
+  Elf64_Shdr& rela = sections[kRela];
+  rela.sh_offset = AlignBytes(elf, 8);
+  for (uint32_t r = 0; r < shape.relocations; ++r) {
+    Elf64_Rela relocation;
+    relocation.r_offset = uint64_t(r) * 8;
+    relocation.r_info = ELF64_R_INFO(1 + r % shape.kernels, R_AMDGPU_64);
+    relocation.r_addend = 0;
+    Append(elf, relocation);
+  }
+  rela.sh_name = uint32_t(AppendString(shstrtab, ".rela.hsadata_global_agent"));
+  rela.sh_type = SHT_RELA;
+  rela.sh_size = elf.size() - rela.sh_offset;
+  rela.sh_link = kSymtab;
+  rela.sh_info = kData;
+  rela.sh_addralign = 8;
+  rela.sh_entsize = sizeof(Elf64_Rela);
+
+  Elf64_Shdr& symtab = sections[kSymtab];
+  symtab.sh_offset = AlignBytes(elf, 8);
+  Elf64_Sym symbol;
+  memset(&symbol, 0, sizeof(symbol));
+  Append(elf, symbol);
+  for (uint32_t k = 0; k < shape.kernels; ++k) {
+    symbol.st_name = uint32_t(
+        AppendString(strtab, "&kernel_" + std::to_string(k)));
+    symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_AMDGPU_HSA_KERNEL);
+    symbol.st_shndx = kText;
+    symbol.st_value = uint64_t(k) * kKernelStride;
+    symbol.st_size = kKernelStride;
+    Append(elf, symbol);
+  }
+  for (uint32_t v = 0; v < shape.variables; ++v) {
+    symbol.st_name = uint32_t(
+        AppendString(strtab, "&variable_" + std::to_string(v)));
+    symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_OBJECT);
+    symbol.st_shndx = kData;
+    symbol.st_value = uint64_t(v) * 8;
+    symbol.st_size = 8;
+    Append(elf, symbol);
+  }
+  symtab.sh_name = uint32_t(AppendString(shstrtab, ".symtab"));
+  symtab.sh_type = SHT_SYMTAB;
+  symtab.sh_size = elf.size() - symtab.sh_offset;
+  symtab.sh_link = kStrtab;
+  symtab.sh_info = 1;
+  symtab.sh_addralign = 8;
+  symtab.sh_entsize = sizeof(Elf64_Sym);
+
+  Elf64_Shdr& strings = sections[kStrtab];
+  strings.sh_name = uint32_t(AppendString(shstrtab, ".strtab"));
+  strings.sh_type = SHT_STRTAB;
+  strings.sh_offset = AppendBytes(elf, &strtab[0], strtab.size());
+  strings.sh_size = strtab.size();
+  strings.sh_addralign = 1;
+
+  // The section name table goes last, the parser treats the section after
+  // it as a second copy of it.
+  Elf64_Shdr& names = sections[kShstrtab];
+  names.sh_name = uint32_t(AppendString(shstrtab, ".shstrtab"));
+  names.sh_type = SHT_STRTAB;
+  names.sh_offset = AppendBytes(elf, &shstrtab[0], shstrtab.size());
+  names.sh_size = shstrtab.size();
+  names.sh_addralign = 1;
+
+  const size_t section_offset = AlignBytes(elf, 8);
+  AppendBytes(elf, sections, sizeof(sections));
+
+  Elf64_Phdr* segments = reinterpret_cast<Elf64_Phdr*>(
+      &elf[sizeof(Elf64_Ehdr)]);
+  const Elf64_Shdr* loaded[] = {&text, &data};
+  const uint32_t segment_types[] = {PT_AMDGPU_HSA_LOAD_CODE_AGENT,
+                                    PT_AMDGPU_HSA_LOAD_GLOBAL_AGENT};
+  for (size_t i = 0; i < 2; ++i) {
+    segments[i].p_type = segment_types[i];
+    segments[i].p_flags = PF_R | PF_W | (i == 0 ? PF_X : 0);
+    segments[i].p_offset = loaded[i]->sh_offset;
+    segments[i].p_vaddr = loaded[i]->sh_addr;
+    segments[i].p_paddr = 0;
+    segments[i].p_filesz = loaded[i]->sh_size;
+    segments[i].p_memsz = loaded[i]->sh_size;
+    segments[i].p_align = loaded[i]->sh_addralign;
+  }
+
+  Elf64_Ehdr* header = reinterpret_cast<Elf64_Ehdr*>(&elf[0]);
+  memcpy(header->e_ident, ELFMAG, SELFMAG);
+  header->e_ident[EI_CLASS] = ELFCLASS64;
+  header->e_ident[EI_DATA] = ELFDATA2LSB;
+  header->e_ident[EI_VERSION] = EV_CURRENT;
+  header->e_ident[EI_OSABI] = ELFOSABI_AMDGPU_HSA;
+  header->e_ident[EI_ABIVERSION] = ELFABIVERSION_AMDGPU_HSA;
+  header->e_type = ET_EXEC;
+  header->e_machine = EM_AMDGPU;
+  header->e_version = EV_CURRENT;
+  header->e_phoff = sizeof(Elf64_Ehdr);
+  header->e_shoff = section_offset;
+  header->e_ehsize = sizeof(Elf64_Ehdr);
+  header->e_phentsize = sizeof(Elf64_Phdr);
+  header->e_phnum = 2;
+  header->e_shentsize = sizeof(Elf64_Shdr);
+  header->e_shnum = kSections;
+  header->e_shstrndx = kShstrtab;
+  return true;
+}
+
+// Generates a code object on first use, once the agent whose ISA it names is
+// known, and writes it to a scratch file if its path is needed.
+bool Prepare(Run& run, CodeObjectFile& file, bool need_path = false) {
+  if (file.bytes.empty()) {
+    if (!HasGpu(run)) return false;
+    if (!GenerateCodeObject(file.shape, file.bytes)) {
+      run.skip = "cannot generate a code object for the agent's ISA";
+      return false;
+    }
+  }
+  if (need_path && file.path.empty()) {
+    std::string path;
+    if (!ScratchPath(file.name, path) || !WriteFile(path, file.bytes)) {
+      run.skip = "cannot write a scratch code object";
+      return false;
+    }
+    file.path = path;
+  }
+  return true;
+}
+
+// Resident set size in kilobytes.
+double ResidentKb() {
+  long pages = 0, resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == NULL) return 0;
+  if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose(statm);
+  return double(resident) * double(sysconf(_SC_PAGESIZE)) / 1024.0;
+}
+
+bool Deserialize(Run& run, CodeObjectFile& file,
+                 hsa_code_object_t* code_object) {
+  return Prepare(run, file) &&
+         Check(run, hsa_code_object_deserialize(
+                        const_cast<char*>(&file.bytes[0]), file.bytes.size(),
+                        NULL, code_object),
+               "deserialize");
+}
+
+void CodeObjectDeserialize(Run& run, uint64_t index) {
+  CodeObjectFile& file = code_object_files[index];
+  if (!Prepare(run, file)) return;
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    hsa_code_object_t code_object;
+    if (!Deserialize(run, file, &code_object)) break;
+    hsa_code_object_destroy(code_object);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+}
+
+void CodeObjectLoadFile(Run& run, uint64_t index) {
+  CodeObjectFile& file = code_object_files[index];
+  if (!Prepare(run, file, true)) return;
+
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    hsa_code_object_t code_object;
+    if (!Check(run, hsa_amd_code_object_load_file(file.path.c_str(),
+                                                  &code_object),
+               "load file"))
+      break;
+    hsa_code_object_destroy(code_object);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+}
+
+hsa_status_t AllocateSerialized(size_t size, hsa_callback_data_t,
+                                void** address) {
+  *address = malloc(size);
+  return (*address != NULL) ? HSA_STATUS_SUCCESS
+                            : HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+}
+
+const uint64_t kCompress = uint64_t(1) << 32;
+
+void CodeObjectSerialize(Run& run, uint64_t arg) {
+  CodeObjectFile& file = code_object_files[uint32_t(arg)];
+  const char* serialize_options = (arg & kCompress) ? "-compress" : NULL;
+
+  hsa_code_object_t code_object;
+  if (!Deserialize(run, file, &code_object)) return;
+
+  hsa_callback_data_t data = {0};
+  size_t size = 0;
+  Clock::time_point start = Clock::now();
+  for (uint64_t i = 0; i < run.iterations; ++i) {
+    void* serialized;
+    if (!Check(run, hsa_code_object_serialize(code_object, AllocateSerialized,
+                                              data, serialize_options,
+                                              &serialized, &size),
+               "serialize"))
+      break;
+    free(serialized);
+  }
+  run.elapsed_ns = ElapsedNs(start);
+  run.Figure("bytes", double(size));
+
+  hsa_code_object_destroy(code_object);
+}
+
+bool LoadExecutable(Run& run, hsa_code_object_t code_object,
+                    hsa_executable_t* executable) {
+  if (!Check(run, hsa_executable_create(HSA_PROFILE_FULL,
+                                        HSA_EXECUTABLE_STATE_UNFROZEN, "",
+                                        executable),
+             "executable create"))
+    return false;
+  if (!Check(run, hsa_executable_load_code_object(*executable, context.gpu,
+                                                  code_object, ""),
+             "executable load") ||
+      !Check(run, hsa_executable_freeze(*executable, ""), "freeze")) {
+    hsa_executable_destroy(*executable);
+    return false;
+  }
+  return true;
+}
+
+// Loads and destroys count executables per iteration, with all of them live
+// at once. The reported figure is the resident set growth per live executable.
+void CodeObjectLoad(Run& run, uint64_t arg) {
+  if (!HasGpu(run)) return;
+
+  const uint32_t count = uint32_t(arg >> 32);
+  hsa_code_object_t code_object;
+  if (!Deserialize(run, code_object_files[uint32_t(arg)], &code_object))
+    return;
+
+  std::vector<hsa_executable_t> executables(count);
+  double resident_before = ResidentKb(), resident_after = resident_before;
+  for (uint64_t i = 0; i < run.iterations && run.skip.empty(); ++i) {
+    Clock::time_point start = Clock::now();
+    uint32_t loaded = 0;
+    for (; loaded < count; ++loaded) {
+      if (!LoadExecutable(run, code_object, &executables[loaded])) break;
+    }
+    if (i == 0) resident_after = ResidentKb();
+    for (uint32_t e = 0; e < loaded; ++e)
+      hsa_executable_destroy(executables[e]);
+    run.elapsed_ns += ElapsedNs(start);
+  }
+  run.operations = run.iterations * count;
+  run.Figure("rss_kb_per_executable",
+             (resident_after - resident_before) / count);
+
+  hsa_code_object_destroy(code_object);
+}
+
+// Loads a code object one executable at a time with HSA_LOADER_THREADS set
+// to the count in the upper half of arg; a count of 1 is the serial loader.
+void CodeObjectLoadThreads(Run& run, uint64_t arg) {
+  const std::string threads = std::to_string(arg >> 32);
+  RuntimeSetting setting("HSA_LOADER_THREADS", threads.c_str());
+  if (setting.Check(run))
+    CodeObjectLoad(run, uint32_t(arg) | (uint64_t(1) << 32));
+}
+
+const uint64_t kPipelined = uint64_t(1) << 32;
+
+// Loads a code object one executable at a time with HSA_LOADER_PIPELINE set,
+// so segment images upload on the loader's copy thread until freeze, or
+// clear. The reported figure is the code object size loaded per nanosecond.
+void CodeObjectLoadPipeline(Run& run, uint64_t arg) {
+  RuntimeSetting setting("HSA_LOADER_PIPELINE",
+                         (arg & kPipelined) ? "1" : "0");
+  if (!setting.Check(run)) return;
+  CodeObjectLoad(run, uint32_t(arg) | (uint64_t(1) << 32));
+  if (run.skip.empty() && run.elapsed_ns != 0)
+    run.Figure("gb_per_s",
+               double(code_object_files[uint32_t(arg)].bytes.size()) *
+                   double(run.iterations) / double(run.elapsed_ns));
+}
+
+// Loads a code object one executable at a time. Segments with at least two
+// relocations are patched through a host shadow and written back once; the
+// reported figure is the load time per relocation.
+void CodeObjectLoadRelocations(Run& run, uint64_t index) {
+  CodeObjectLoad(run, index | (uint64_t(1) << 32));
+  const uint32_t relocations = code_object_files[index].shape.relocations;
+  if (run.skip.empty() && relocations != 0)
+    run.Figure("ns_per_relocation",
+               double(run.elapsed_ns) /
+                   (double(run.iterations) * double(relocations)));
+}
+
+struct MetricValue {
+  const char* name;
+  int64_t value;
+};
+
+hsa_status_t FindMetric(const hsa_amd_metric_t* metric, void* data) {
+  MetricValue* wanted = reinterpret_cast<MetricValue*>(data);
+  if (strcmp(metric->name, wanted->name) == 0) wanted->value = metric->value;
+  return HSA_STATUS_SUCCESS;
+}
+
+int64_t Metric(const char* name) {
+  MetricValue wanted = {name, 0};
+  hsa_amd_metrics_iterate(FindMetric, &wanted);
+  return wanted.value;
+}
+
+// Loads and destroys count executables per iteration like CodeObjectLoad,
+// with metrics collected. The reported figures are the code arena chunks,
+// pages and memory registrations taken by the live executables.
+void CodeObjectArena(Run& run, uint64_t arg) {
+  if (!HasGpu(run)) return;
+
+  const uint32_t count = uint32_t(arg >> 32);
+  hsa_code_object_t code_object;
+  if (!Deserialize(run, code_object_files[uint32_t(arg)], &code_object))
+    return;
+
+  hsa_amd_metrics_enable(true);
+  const char* const kNames[] = {"loader.code_arena_chunks",
+                                "loader.code_arena_pages",
+                                "loader.code_arena_registrations"};
+  int64_t before[3] = {0, 0, 0}, after[3] = {0, 0, 0};
+  std::vector<hsa_executable_t> executables(count);
+  for (uint64_t i = 0; i < run.iterations && run.skip.empty(); ++i) {
+    for (size_t m = 0; m < 3; ++m) before[m] = Metric(kNames[m]);
+    Clock::time_point start = Clock::now();
+    uint32_t loaded = 0;
+    for (; loaded < count; ++loaded) {
+      if (!LoadExecutable(run, code_object, &executables[loaded])) break;
+    }
+    run.elapsed_ns += ElapsedNs(start);
+    for (size_t m = 0; m < 3; ++m) after[m] = Metric(kNames[m]);
+    start = Clock::now();
+    for (uint32_t e = 0; e < loaded; ++e)
+      hsa_executable_destroy(executables[e]);
+    run.elapsed_ns += ElapsedNs(start);
+  }
+  hsa_amd_metrics_enable(false);
+  run.operations = run.iterations * count;
+  run.Figure("code_arena_chunks", double(after[0] - before[0]));
+  run.Figure("code_arena_pages", double(after[1] - before[1]));
+  run.Figure("code_arena_registrations", double(after[2] - before[2]));
+
+  hsa_code_object_destroy(code_object);
+}
+
+const uint64_t kWarmCache = uint64_t(1) << 32;
+
+// Loads a code object one executable at a time with HSA_LOADER_CACHE_DIR set
+// to a scratch directory. Cold runs empty the directory before every load,
+// which then parses the code object and records an entry; warm runs replay
+// an entry recorded before timing.
+void CodeObjectLoadCache(Run& run, uint64_t arg) {
+  if (!HasGpu(run)) return;
+
+  char directory[] = "/tmp/hsa-loader-cache-XXXXXX";
+  if (mkdtemp(directory) == NULL) {
+    run.skip = "cannot create a loader cache directory";
+    return;
+  }
+
+  {
+    RuntimeSetting setting("HSA_LOADER_CACHE_DIR", directory);
+    hsa_code_object_t code_object;
+    if (setting.Check(run) &&
+        Deserialize(run, code_object_files[uint32_t(arg)], &code_object)) {
+      const bool warm = (arg & kWarmCache) != 0;
+      hsa_executable_t executable;
+      if (warm && LoadExecutable(run, code_object, &executable))
+        hsa_executable_destroy(executable);
+
+      for (uint64_t i = 0; i < run.iterations && run.skip.empty(); ++i) {
+        if (!warm) ClearDirectory(directory);
+        Clock::time_point start = Clock::now();
+        if (LoadExecutable(run, code_object, &executable))
+          hsa_executable_destroy(executable);
+        run.elapsed_ns += ElapsedNs(start);
+      }
+
+      hsa_code_object_destroy(code_object);
+    }
+  }
+
+  RemoveDirectory(directory);
+}
+
+struct SymbolName {
+  std::string module;
+  std::string name;
+};
+
+hsa_status_t CollectSymbol(hsa_executable_t, hsa_executable_symbol_t symbol,
+                           void* data) {
+  std::vector<SymbolName>& names = *reinterpret_cast<std::vector<SymbolName>*>(data);
+
+  uint32_t length = 0;
+  hsa_executable_symbol_get_info(symbol, HSA_EXECUTABLE_SYMBOL_INFO_NAME_LENGTH,
+                                 &length);
+  SymbolName entry;
+  entry.name.resize(length);
+  hsa_executable_symbol_get_info(symbol, HSA_EXECUTABLE_SYMBOL_INFO_NAME,
+                                 &entry.name[0]);
+
+  hsa_symbol_linkage_t linkage = HSA_SYMBOL_LINKAGE_PROGRAM;
+  hsa_executable_symbol_get_info(symbol, HSA_EXECUTABLE_SYMBOL_INFO_LINKAGE,
+                                 &linkage);
+  if (linkage == HSA_SYMBOL_LINKAGE_MODULE) {
+    length = 0;
+    hsa_executable_symbol_get_info(
+        symbol, HSA_EXECUTABLE_SYMBOL_INFO_MODULE_NAME_LENGTH, &length);
+    entry.module.resize(length);
+    hsa_executable_symbol_get_info(
+        symbol, HSA_EXECUTABLE_SYMBOL_INFO_MODULE_NAME, &entry.module[0]);
+  }
+
+  names.push_back(entry);
+  return HSA_STATUS_SUCCESS;
+}
+
+// threads threads look up every symbol of a frozen executable in turn. The
+// time per operation is the wall time of one lookup as seen by each thread.
+void SymbolLookup(Run& run, uint64_t arg) {
+  if (!HasGpu(run)) return;
+
+  const uint32_t threads = uint32_t(arg >> 32);
+  hsa_code_object_t code_object;
+  if (!Deserialize(run, code_object_files[uint32_t(arg)], &code_object))
+    return;
+
+  hsa_executable_t executable;
+  if (LoadExecutable(run, code_object, &executable)) {
+    std::vector<SymbolName> names;
+    hsa_executable_iterate_symbols(executable, CollectSymbol, &names);
+
+    if (names.empty()) {
+      run.skip = "no symbols";
+    } else {
+      const uint64_t iterations = run.iterations;
+      std::atomic<bool> go(false);
+      std::vector<std::thread> workers;
+      for (uint32_t t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&, t] {
+          while (!go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+          hsa_executable_symbol_t symbol;
+          uint64_t sum = 0;
+          for (uint64_t i = 0; i < iterations; ++i) {
+            const SymbolName& entry = names[(i + t) % names.size()];
+            hsa_executable_get_symbol(
+                executable, entry.module.empty() ? NULL : entry.module.c_str(),
+                entry.name.c_str(), context.gpu, 0, &symbol);
+            sum += symbol.handle;
+          }
+          sink = int64_t(sum);
+        }));
+      }
+
+      Clock::time_point start = Clock::now();
+      go.store(true, std::memory_order_release);
+      for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+      run.elapsed_ns = ElapsedNs(start);
+    }
+
+    hsa_executable_destroy(executable);
+  }
+
+  hsa_code_object_destroy(code_object);
+}
+
+const size_t kManagedCodeObjects = 64;
+
+// threads threads query 64 deserialized copies of a generated code object in
+// turn, alternating hsa_code_object_get_info and hsa_code_object_get_symbol,
+// both of which look the handle up in the code object manager. The time per
+// operation is the wall time of one query as seen by each thread.
+void CodeManagerLookup(Run& run, uint64_t arg) {
+  const uint32_t threads = uint32_t(arg >> 32);
+  std::vector<hsa_code_object_t> code_objects;
+  for (size_t i = 0; i < kManagedCodeObjects; ++i) {
+    hsa_code_object_t code_object;
+    if (!Deserialize(run, code_object_files[uint32_t(arg)], &code_object))
+      break;
+    code_objects.push_back(code_object);
+  }
+
+  if (run.skip.empty()) {
+    const uint64_t iterations = run.iterations;
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threads; ++t) {
+      workers.push_back(std::thread([&, t] {
+        while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+        char version[64];
+        hsa_code_symbol_t symbol = {0};
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < iterations; ++i) {
+          const hsa_code_object_t code_object =
+              code_objects[(i + t) % code_objects.size()];
+          if (i & 1)
+            hsa_code_object_get_info(code_object, HSA_CODE_OBJECT_INFO_VERSION,
+                                     version);
+          else
+            hsa_code_object_get_symbol(code_object, "&kernel_0", &symbol);
+          sum += symbol.handle + uint8_t(version[0]);
+        }
+        sink = int64_t(sum);
+      }));
+    }
+
+    Clock::time_point start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+    run.elapsed_ns = ElapsedNs(start);
+  }
+
+  for (size_t i = 0; i < code_objects.size(); ++i)
+    hsa_code_object_destroy(code_objects[i]);
+}
+
+//===----------------------------------------------------------------------===//
+// Registry and driver.                                                       //
+//===----------------------------------------------------------------------===//
+
+std::vector<Benchmark> benchmarks;
+
+void Add(const std::string& name, uint32_t configs, Body body,
+         uint64_t arg = 0) {
+  Benchmark benchmark = {name, configs, body, arg};
+  benchmarks.push_back(benchmark);
+}
+
+std::string BaseName(const std::string& path) {
+  size_t slash = path.rfind('/');
+  return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+// Adds a code object generated for the agent under test, unless one of that
+// name was added before, and returns its index.
+uint64_t AddGenerated(const std::string& name, const Shape& shape) {
+  for (size_t i = 0; i < code_object_files.size(); ++i) {
+    if (code_object_files[i].generated && code_object_files[i].name == name)
+      return i;
+  }
+  CodeObjectFile file;
+  file.name = name;
+  file.generated = true;
+  file.shape = shape;
+  code_object_files.push_back(file);
+  return code_object_files.size() - 1;
+}
+
+void RegisterBenchmarks() {
+  const uint32_t kSignalConfigs = kPolling | kInterrupt;
+
+  Add("signal/create_destroy", kSignalConfigs | kTools, SignalCreateDestroy);
+  Add("signal/create_destroy/metrics", kPolling, SignalCreateDestroy, 1);
+  Add("signal/load_relaxed/api", kSignalConfigs | kTools, SignalLoad,
+      kLoadApi);
+  Add("signal/load_relaxed/inline", kSignalConfigs, SignalLoad, kLoadInline);
+  Add("signal/load_relaxed/hooked", kPolling, SignalLoad, kLoadHooked);
+  Add("signal/mixed_ops", kSignalConfigs | kTools, SignalMixedOps);
+  Add("signal/wake_latency", kSignalConfigs, SignalWakeLatency);
+  Add("signal/kinds/user", kSignalConfigs, SignalKinds);
+  Add("signal/kinds/mixed", kSignalConfigs, SignalKinds, kMixedKinds);
+
+  const uint64_t kWaitCounts[] = {1, 8, 64};
+  for (size_t i = 0; i < sizeof(kWaitCounts) / sizeof(kWaitCounts[0]); ++i)
+    Add("signal/wait_any/" + std::to_string(kWaitCounts[i]), kSignalConfigs,
+        SignalWaitAny, kWaitCounts[i]);
+  Add("signal/wait_any/8/metrics", kPolling, SignalWaitAnyMetrics, 8);
+
+  const uint64_t kFanOuts[] = {1, 16, 256};
+  for (size_t i = 0; i < sizeof(kFanOuts) / sizeof(kFanOuts[0]); ++i)
+    Add("async/fan_out/" + std::to_string(kFanOuts[i]), kInterrupt,
+        AsyncFanOut, kFanOuts[i]);
+
+  const uint64_t kThreads[] = {1, 4, 16};
+  for (size_t i = 0; i < sizeof(kThreads) / sizeof(kThreads[0]); ++i) {
+    const std::string threads = std::to_string(kThreads[i]);
+    Add("queue/reserve/threads:" + threads, kPolling, QueueReserve,
+        kThreads[i]);
+    Add("queue/reserve_inline/threads:" + threads, kPolling, QueueReserve,
+        kThreads[i] | kInlineIndices);
+  }
+
+  Add("queue/barrier_round_trip", kSignalConfigs, QueueBarrierRoundTrip);
+
+  const uint64_t kMuxQueues = 16;
+  const uint64_t kPools[] = {0, 1, 4};
+  for (size_t i = 0; i < sizeof(kPools) / sizeof(kPools[0]); ++i)
+    Add("queue/multiplexer/pool:" + std::to_string(kPools[i]) + "/queues:" +
+            std::to_string(kMuxQueues),
+        kPolling, QueueMultiplexing, kPools[i] | (kMuxQueues << 32));
+
+  const uint64_t kSizes[] = {4096, 1 << 20, 16 << 20};
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); ++i) {
+    const std::string size = std::to_string(kSizes[i]);
+    Add("memory/register/" + size, kPolling, MemoryRegister, kSizes[i]);
+    Add("memory/allocate_free/" + size, kPolling, MemoryAllocate, kSizes[i]);
+  }
+
+  Add("runtime/init_shut_down", kSignalConfigs, RuntimeInitShutDown);
+  Add("runtime/init_shut_down/topology_cache", kSignalConfigs,
+      RuntimeInitShutDown, 1);
+
+  Add("profiling/collect", kPolling, ProfilingCollect);
+  Add("profiling/dispatch_time", kPolling, ProfilingDispatchTime);
+  Add("profiling/clock_check/drift_ppm:0", kPolling, ClockSelfCheck, 0);
+  Add("profiling/clock_check/drift_ppm:" + std::to_string(kClockDriftPpm),
+      kPolling, ClockSelfCheck, uint64_t(kClockDriftPpm));
+
+  Add("tracer/overhead", kPolling | kTools, TracerOverhead);
+
+  // Without --code-object the suite runs on the small generated object the
+  // manager lookups use; otherwise that object is only added for them.
+  const Shape kSmall = {16, 16, 16, 0};
+  const size_t suite_files =
+      code_object_files.empty() ? 1 : code_object_files.size();
+  const uint64_t small = AddGenerated("generated_kernels:16", kSmall);
+  for (size_t i = 0; i < suite_files; ++i) {
+    const std::string& name = code_object_files[i].name;
+    Add("code_object/deserialize/" + name, kPolling, CodeObjectDeserialize, i);
+    Add("code_object/load_file/" + name, kPolling, CodeObjectLoadFile, i);
+    Add("code_object/serialize/" + name, kPolling, CodeObjectSerialize, i);
+    Add("code_object/serialize_compressed/" + name, kPolling,
+        CodeObjectSerialize, i | kCompress);
+    Add("code_object/load/" + name, kPolling, CodeObjectLoad,
+        i | (uint64_t(1) << 32));
+    Add("code_object/load_live:1000/" + name, kPolling, CodeObjectLoad,
+        i | (uint64_t(1000) << 32));
+    Add("code_object/symbol_lookup/threads:1/" + name, kPolling, SymbolLookup,
+        i | (uint64_t(1) << 32));
+    Add("code_object/symbol_lookup/threads:32/" + name, kPolling,
+        SymbolLookup, i | (uint64_t(32) << 32));
+  }
+
+  const Shape kKernels1k = {1024, 1024, 1024, 0};
+  const uint64_t kernels_1k =
+      AddGenerated("generated_kernels:1024", kKernels1k);
+  const uint64_t kLoaderThreads[] = {1, 4, 16};
+  for (size_t i = 0; i < sizeof(kLoaderThreads) / sizeof(kLoaderThreads[0]);
+       ++i)
+    Add("code_object/load/loader_threads:" +
+            std::to_string(kLoaderThreads[i]) + "/generated_kernels:1024",
+        kPolling, CodeObjectLoadThreads,
+        kernels_1k | (kLoaderThreads[i] << 32));
+
+  Add("code_object/load_cache/cold/generated_kernels:1024", kPolling,
+      CodeObjectLoadCache, kernels_1k);
+  Add("code_object/load_cache/warm/generated_kernels:1024", kPolling,
+      CodeObjectLoadCache, kernels_1k | kWarmCache);
+
+  // 128MB of data segment image, uploaded through hsa_memory_copy; under the
+  // emulated thunk that is the host copy standing in for a copy engine.
+  const Shape kLarge = {16, 16, 16, uint64_t(128) << 20};
+  const uint64_t large = AddGenerated("generated_data:128MB", kLarge);
+  Add("code_object/load/pipeline:0/generated_data:128MB", kPolling,
+      CodeObjectLoadPipeline, large);
+  Add("code_object/load/pipeline:1/generated_data:128MB", kPolling,
+      CodeObjectLoadPipeline, large | kPipelined);
+
+  // One relocation is written in place, 64k go through the shadow.
+  const uint32_t kRelocations[] = {1, 65536};
+  for (size_t i = 0; i < sizeof(kRelocations) / sizeof(kRelocations[0]);
+       ++i) {
+    const std::string name =
+        "generated_relocations:" + std::to_string(kRelocations[i]);
+    const Shape shape = {16, 0, kRelocations[i], 0};
+    Add("code_object/load/" + name, kPolling, CodeObjectLoadRelocations,
+        AddGenerated(name, shape));
+  }
+
+  for (size_t i = 0; i < sizeof(kThreads) / sizeof(kThreads[0]); ++i)
+    Add("code_object/manager_lookup/threads:" + std::to_string(kThreads[i]) +
+            "/generated_kernels:16",
+        kPolling, CodeManagerLookup, small | (kThreads[i] << 32));
+
+  const Shape kKernel = {1, 0, 0, 0};
+  Add("code_object/code_arena/live:1000/generated_kernels:1", kPolling,
+      CodeObjectArena,
+      AddGenerated("generated_kernels:1", kKernel) | (uint64_t(1000) << 32));
+}
+
+struct Result {
+  uint64_t iterations;
+  double median;
+  double min;
+  double max;
+  Run last;
+};
+
+bool Measure(const Benchmark& benchmark, Result& result) {
+  // Grow the iteration count until one run takes at least min_time_ns.
+  uint64_t iterations = 1;
+  for (;;) {
+    Run run;
+    run.iterations = iterations;
+    benchmark.body(run, benchmark.arg);
+    if (!run.skip.empty() || !run.error.empty()) {
+      result.last = run;
+      return false;
+    }
+    if (run.elapsed_ns >= options.min_time_ns) break;
+    const double scale =
+        1.4 * double(options.min_time_ns) / double(std::max<uint64_t>(run.elapsed_ns, 1));
+    iterations = std::max(iterations + 1,
+                          uint64_t(double(iterations) * std::min(scale, 100.0)));
+  }
+
+  std::vector<double> samples;
+  for (uint32_t r = 0; r < options.repetitions; ++r) {
+    Run run;
+    run.iterations = iterations;
+    benchmark.body(run, benchmark.arg);
+    if (!run.skip.empty() || !run.error.empty()) {
+      result.last = run;
+      return false;
+    }
+    const uint64_t operations = run.operations ? run.operations : iterations;
+    samples.push_back(double(run.elapsed_ns) / double(operations));
+    result.last = run;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  result.iterations = iterations;
+  result.median = samples[samples.size() / 2];
+  result.min = samples.front();
+  result.max = samples.back();
+  return true;
+}
+
+std::string JsonString(const std::string& text) {
+  std::string quoted = "\"";
+  for (size_t i = 0; i < text.size(); ++i) {
+    const char c = text[i];
+    if (c == '"' || c == '\\') quoted += '\\';
+    if (uint8_t(c) < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+      continue;
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+void Report(const Benchmark& benchmark, Config config, bool measured,
+            const Result& result) {
+  if (options.csv) {
+    if (measured) {
+      printf("%s,%s,%llu,%.3f,%.3f,%.3f,", benchmark.name.c_str(),
+             ConfigName(config), (unsigned long long)result.iterations,
+             result.median, result.min, result.max);
+      for (size_t i = 0; i < result.last.figures.size(); ++i)
+        printf("%s%s=%.3f", i ? ";" : "", result.last.figures[i].first,
+               result.last.figures[i].second);
+      printf(",,\n");
+    } else {
+      printf("%s,%s,,,,,,%s,%s\n", benchmark.name.c_str(), ConfigName(config),
+             result.last.skip.c_str(), result.last.error.c_str());
+    }
+  } else {
+    printf("{\"benchmark\":%s,\"config\":\"%s\"",
+           JsonString(benchmark.name).c_str(), ConfigName(config));
+    if (measured) {
+      printf(",\"iterations\":%llu,\"ns_per_op\":%.3f,\"min_ns_per_op\":%.3f,"
+             "\"max_ns_per_op\":%.3f",
+             (unsigned long long)result.iterations, result.median, result.min,
+             result.max);
+      for (size_t i = 0; i < result.last.figures.size(); ++i)
+        printf(",\"%s\":%.3f", result.last.figures[i].first,
+               result.last.figures[i].second);
+    } else if (!result.last.error.empty()) {
+      printf(",\"error\":%s", JsonString(result.last.error).c_str());
+    } else {
+      printf(",\"skipped\":%s", JsonString(result.last.skip).c_str());
+    }
+    printf("}\n");
+  }
+  fflush(stdout);
+}
+
+bool Selected(const Benchmark& benchmark, Config config) {
+  if ((benchmark.configs & config) == 0) return false;
+  if (options.filter.empty()) return true;
+  const std::string qualified =
+      std::string(ConfigName(config)) + ":" + benchmark.name;
+  return qualified.find(options.filter) != std::string::npos;
+}
+
+hsa_status_t FindAgents(hsa_agent_t agent, void*) {
+  hsa_device_type_t type;
+  hsa_agent_get_info(agent, HSA_AGENT_INFO_DEVICE, &type);
+  if (type == HSA_DEVICE_TYPE_CPU && context.cpu.handle == 0)
+    context.cpu = agent;
+  if (type == HSA_DEVICE_TYPE_GPU && context.gpu.handle == 0)
+    context.gpu = agent;
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t FindSystemRegion(hsa_region_t region, void*) {
+  hsa_region_segment_t segment;
+  hsa_region_get_info(region, HSA_REGION_INFO_SEGMENT, &segment);
+  bool alloc_allowed = false;
+  hsa_region_get_info(region, HSA_REGION_INFO_RUNTIME_ALLOC_ALLOWED,
+                      &alloc_allowed);
+  if (segment == HSA_REGION_SEGMENT_GLOBAL && alloc_allowed &&
+      context.system.handle == 0)
+    context.system = region;
+  return HSA_STATUS_SUCCESS;
+}
+
+void FindContext() {
+  memset(&context, 0, sizeof(context));
+  previous_fence.handle = 0;
+  hsa_iterate_agents(FindAgents, NULL);
+  if (context.cpu.handle != 0)
+    hsa_agent_iterate_regions(context.cpu, FindSystemRegion, NULL);
+}
+
+bool Initialize(Config config) {
+  current_config = config;
+  setenv("HSA_ENABLE_INTERRUPT", config == kInterrupt ? "1" : "0", 1);
+  if (config == kTools)
+    setenv("HSA_TOOLS_LIB", options.tools_lib.c_str(), 1);
+  else
+    unsetenv("HSA_TOOLS_LIB");
+
+  if (hsa_init() != HSA_STATUS_SUCCESS) return false;
+
+  FindContext();
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    const std::string key = arg.substr(0, equals);
+    const std::string value =
+        (equals == std::string::npos) ? "" : arg.substr(equals + 1);
+
+    if (key == "--filter") {
+      options.filter = value;
+    } else if (key == "--repetitions") {
+      options.repetitions = std::max(1, atoi(value.c_str()));
+    } else if (key == "--min-time-ms") {
+      options.min_time_ns = strtoull(value.c_str(), NULL, 10) * 1000000;
+    } else if (key == "--format" && (value == "json" || value == "csv")) {
+      options.csv = (value == "csv");
+    } else if (key == "--list") {
+      options.list = true;
+    } else if (key == "--code-object" && !value.empty()) {
+      options.code_objects.push_back(value);
+    } else if (key == "--tools-lib" && !value.empty()) {
+      options.tools_lib = value;
+    } else {
+      fprintf(stderr,
+              "usage: %s [--filter=TEXT] [--repetitions=N] [--min-time-ms=N] "
+              "[--format=json|csv] [--list] [--code-object=PATH]... "
+              "[--tools-lib=PATH]\n",
+              argv[0]);
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (!ParseOptions(argc, argv)) return 2;
+
+  for (size_t i = 0; i < options.code_objects.size(); ++i) {
+    CodeObjectFile file;
+    file.path = options.code_objects[i];
+    file.name = BaseName(file.path);
+    file.generated = false;
+    if (!ReadFile(file.path, file.bytes)) {
+      fprintf(stderr, "cannot read code object %s\n", file.path.c_str());
+      return 2;
+    }
+    code_object_files.push_back(file);
+  }
+
+  RegisterBenchmarks();
+
+  if (options.list) {
+    for (size_t c = 0; c < sizeof(kConfigs) / sizeof(kConfigs[0]); ++c) {
+      for (size_t b = 0; b < benchmarks.size(); ++b) {
+        if (Selected(benchmarks[b], kConfigs[c]))
+          printf("%s:%s\n", ConfigName(kConfigs[c]),
+                 benchmarks[b].name.c_str());
+      }
+    }
+    return 0;
+  }
+
+  bool failed = false;
+  if (options.csv)
+    printf("benchmark,config,iterations,ns_per_op,min_ns_per_op,"
+           "max_ns_per_op,figures,skipped,error\n");
+
+  for (size_t c = 0; c < sizeof(kConfigs) / sizeof(kConfigs[0]); ++c) {
+    const Config config = kConfigs[c];
+
+    std::vector<const Benchmark*> selected;
+    for (size_t b = 0; b < benchmarks.size(); ++b) {
+      if (Selected(benchmarks[b], config)) selected.push_back(&benchmarks[b]);
+    }
+    if (selected.empty()) continue;
+
+    Result result;
+    if (config == kTools && options.tools_lib.empty()) {
+      result.last.skip = "no --tools-lib";
+      for (size_t b = 0; b < selected.size(); ++b)
+        Report(*selected[b], config, false, result);
+      continue;
+    }
+
+    if (!Initialize(config)) {
+      fprintf(stderr, "hsa_init failed in the %s configuration\n",
+              ConfigName(config));
+      return 1;
+    }
+
+    for (size_t b = 0; b < selected.size(); ++b) {
+      const Benchmark& benchmark = *selected[b];
+      result = Result();
+      const bool measured = Measure(benchmark, result);
+      Report(benchmark, config, measured, result);
+      if (!result.last.error.empty()) failed = true;
+    }
+
+    hsa_shut_down();
+  }
+
+  if (!scratch_directory.empty()) RemoveDirectory(scratch_directory);
+  return failed ? 1 : 0;
+}
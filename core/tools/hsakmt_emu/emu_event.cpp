@@ -0,0 +1,216 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// Events of the emulated thunk.
+//
+// Each event is a futex word. Setting an event is one atomic store, and a
+// wake only when some thread is blocked, so interrupt signals cost about what
+// they cost with the KFD minus the ioctl. A thread waiting on several events
+// sleeps on a global generation counter that every set bumps while such
+// threads exist.
+
+#include "hsakmt_emu.h"
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace hsa {
+namespace emu {
+namespace {
+
+std::atomic<uint32_t> next_event_id(1);
+
+// Bumped by every set while multi_waiters is not 0.
+std::atomic<int32_t> generation(0);
+std::atomic<uint32_t> multi_waiters(0);
+
+void FutexWait(std::atomic<int32_t>* word, int32_t expected,
+               uint64_t timeout_ns) {
+  timespec timeout;
+  timeout.tv_sec = time_t(timeout_ns / 1000000000);
+  timeout.tv_nsec = long(timeout_ns % 1000000000);
+  syscall(SYS_futex, reinterpret_cast<int32_t*>(word), FUTEX_WAIT_PRIVATE,
+          expected, (timeout_ns == UINT64_MAX) ? NULL : &timeout, NULL, 0);
+}
+
+void FutexWakeAll(std::atomic<int32_t>* word) {
+  syscall(SYS_futex, reinterpret_cast<int32_t*>(word), FUTEX_WAKE_PRIVATE,
+          INT_MAX, NULL, NULL, 0);
+}
+
+Event* Convert(HsaEvent* event) { return reinterpret_cast<Event*>(event); }
+
+// Returns true if event is signaled, resetting it if it is an auto reset
+// event.
+bool Consume(Event* event) {
+  if (event->manual_reset) return event->signaled.load() != 0;
+  int32_t expected = 1;
+  return event->signaled.compare_exchange_strong(expected, 0);
+}
+
+// Nanoseconds left until deadline, 0 once it has passed, UINT64_MAX for an
+// infinite wait.
+uint64_t Remaining(uint64_t deadline) {
+  if (deadline == UINT64_MAX) return UINT64_MAX;
+  const uint64_t now = NowNs();
+  return (now < deadline) ? deadline - now : 0;
+}
+
+HSAKMT_STATUS WaitOne(Event* event, uint64_t deadline) {
+  event->waiters.fetch_add(1);
+  HSAKMT_STATUS status = HSAKMT_STATUS_WAIT_TIMEOUT;
+  for (;;) {
+    if (Consume(event)) {
+      status = HSAKMT_STATUS_SUCCESS;
+      break;
+    }
+    const uint64_t remaining = Remaining(deadline);
+    if (remaining == 0) break;
+    FutexWait(&event->signaled, 0, remaining);
+  }
+  event->waiters.fetch_sub(1);
+  return status;
+}
+
+// Consumes every signaled event when any is signaled, or all of them once all
+// are. Waiting on all is not atomic: an auto reset event consumed by another
+// thread between the check and the reset is still reported.
+bool ConsumeMultiple(Event** events, HSAuint32 count, bool wait_on_all) {
+  if (wait_on_all) {
+    for (HSAuint32 i = 0; i < count; ++i) {
+      if (events[i]->signaled.load() == 0) return false;
+    }
+  }
+
+  bool any = false;
+  for (HSAuint32 i = 0; i < count; ++i) any |= Consume(events[i]);
+  return wait_on_all || any;
+}
+
+HSAKMT_STATUS WaitMultiple(Event** events, HSAuint32 count, bool wait_on_all,
+                           uint64_t deadline) {
+  multi_waiters.fetch_add(1);
+  HSAKMT_STATUS status = HSAKMT_STATUS_WAIT_TIMEOUT;
+  for (;;) {
+    const int32_t observed = generation.load();
+    if (ConsumeMultiple(events, count, wait_on_all)) {
+      status = HSAKMT_STATUS_SUCCESS;
+      break;
+    }
+    const uint64_t remaining = Remaining(deadline);
+    if (remaining == 0) break;
+    FutexWait(&generation, observed, remaining);
+  }
+  multi_waiters.fetch_sub(1);
+  return status;
+}
+
+}  // namespace
+
+HSAKMT_STATUS CreateEvent(HsaEventDescriptor* descriptor, bool manual_reset,
+                          bool is_signaled, HsaEvent** event) {
+  if (descriptor == NULL || event == NULL)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  Event* emu_event = new Event();
+  memset(&emu_event->event, 0, sizeof(HsaEvent));
+  emu_event->event.EventId = next_event_id.fetch_add(1);
+  emu_event->event.EventData.EventType = descriptor->EventType;
+  emu_event->event.EventData.HWData2 =
+      reinterpret_cast<HSAuint64>(&emu_event->mailbox);
+  emu_event->mailbox.value = 0;
+  emu_event->mailbox.event = emu_event;
+  emu_event->manual_reset = manual_reset;
+  emu_event->signaled.store(is_signaled ? 1 : 0);
+  emu_event->waiters.store(0);
+
+  *event = &emu_event->event;
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS DestroyEvent(HsaEvent* event) {
+  if (event == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  delete Convert(event);
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS SetEvent(HsaEvent* event) {
+  if (event == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  Event* emu_event = Convert(event);
+
+  // Sequentially consistent with the waiter counts: either a waiter sees the
+  // event set, or the set sees the waiter and wakes it.
+  emu_event->signaled.store(1);
+  if (emu_event->waiters.load() != 0) FutexWakeAll(&emu_event->signaled);
+  if (multi_waiters.load() != 0) {
+    generation.fetch_add(1);
+    FutexWakeAll(&generation);
+  }
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS WaitOnEvents(HsaEvent* events[], HSAuint32 count,
+                           bool wait_on_all, HSAuint32 milliseconds) {
+  if (events == NULL || count == 0) return HSAKMT_STATUS_INVALID_PARAMETER;
+  for (HSAuint32 i = 0; i < count; ++i) {
+    if (events[i] == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  }
+
+  const uint64_t deadline =
+      (milliseconds == HSA_EVENTTIMEOUT_INFINITE)
+          ? UINT64_MAX
+          : NowNs() + uint64_t(milliseconds) * 1000000;
+
+  if (count == 1) return WaitOne(Convert(events[0]), deadline);
+  return WaitMultiple(reinterpret_cast<Event**>(events), count, wait_on_all,
+                      deadline);
+}
+
+void RaiseInterrupt(uint64_t mailbox_ptr, uint32_t event_id) {
+  Mailbox* mailbox = reinterpret_cast<Mailbox*>(mailbox_ptr);
+  mailbox->value = event_id;
+  SetEvent(&mailbox->event->event);
+}
+
+}  // namespace emu
+}  // namespace hsa
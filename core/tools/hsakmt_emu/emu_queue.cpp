@@ -0,0 +1,550 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// Queues of the emulated thunk.
+//
+// Every GPU node has a compute engine servicing its AQL queues and an SDMA
+// engine servicing its SDMA queues, each a host thread started with the
+// first queue and stopped with the last. An engine polls its queues in turn,
+// as the command processor does, since the runtime rings doorbells with plain
+// stores. Once idle it spins briefly, then sleeps HSA_EMU_POLL_US between
+// polls, which bounds the doorbell latency of an idle engine.
+//
+// AQL kernel dispatches do not run any code: a dispatch takes
+// HSA_EMU_KERNEL_NS (default 0) and then completes, writing profiling time
+// stamps and decrementing its completion signal like the hardware does. A
+// dispatch without a kernel object is reported through the queue's inactive
+// signal as an invalid code object. Barrier packets wait on their dependent
+// signals without blocking other queues. SDMA queues execute the linear copy,
+// constant fill, fence and NOP packets written by the runtime.
+
+#include "hsakmt_emu.h"
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "hsa.h"
+#include "amd_hsa_queue.h"
+#include "amd_hsa_signal.h"
+
+namespace hsa {
+namespace emu {
+namespace {
+
+// Engine and queue creation and destruction are serialized by this lock.
+std::mutex queues_lock;
+
+class Queue {
+ public:
+  explicit Queue(HSA_QUEUEID id) : id_(id) {}
+  virtual ~Queue() {}
+
+  HSA_QUEUEID id() const { return id_; }
+
+  // Processes the packets that can run now. Returns true if any did.
+  virtual bool Service() = 0;
+
+ private:
+  const HSA_QUEUEID id_;
+};
+
+//===----------------------------------------------------------------------===//
+// AQL queues.                                                                //
+//===----------------------------------------------------------------------===//
+
+// Error codes the command processor writes to the queue inactive signal.
+const int64_t kErrorInvalidCode = 8;
+const int64_t kErrorInvalidFormat = 32;
+
+uint8_t PacketType(uint16_t header) {
+  return uint8_t((header >> HSA_PACKET_HEADER_TYPE) &
+                 ((1 << HSA_PACKET_HEADER_WIDTH_TYPE) - 1));
+}
+
+amd_signal_t* SignalOf(hsa_signal_t signal) {
+  return reinterpret_cast<amd_signal_t*>(signal.handle);
+}
+
+void Notify(amd_signal_t* signal) {
+  if (signal->event_mailbox_ptr != 0)
+    RaiseInterrupt(signal->event_mailbox_ptr, signal->event_id);
+}
+
+class AqlQueue : public Queue {
+ public:
+  AqlQueue(HSA_QUEUEID id, void* ring, uint64_t ring_bytes,
+           HSAuint64* read_index, HSAuint64* write_index)
+      : Queue(id),
+        ring_(reinterpret_cast<hsa_kernel_dispatch_packet_t*>(ring)),
+        // The runtime may map the ring twice in a row; indices modulo either
+        // size address the same packet.
+        size_(ring_bytes / sizeof(hsa_kernel_dispatch_packet_t)),
+        read_index_(read_index),
+        write_index_(write_index),
+        queue_(reinterpret_cast<amd_queue_t*>(
+            reinterpret_cast<char*>(read_index) -
+            offsetof(amd_queue_t, read_dispatch_id))),
+        kernel_ns_(EnvValue("HSA_EMU_KERNEL_NS", 0)),
+        busy_until_(0),
+        start_ts_(0),
+        halted_(false) {
+    doorbell_ = 0;
+  }
+
+  volatile uint32_t* doorbell() { return &doorbell_; }
+
+  bool Service() {
+    if (halted_) return false;
+
+    HSAuint64 read = *read_index_;
+    const HSAuint64 write = __atomic_load_n(write_index_, __ATOMIC_ACQUIRE);
+    bool progress = false;
+
+    while (read < write) {
+      hsa_kernel_dispatch_packet_t* packet = &ring_[read % size_];
+      const uint16_t header =
+          __atomic_load_n(&packet->header, __ATOMIC_ACQUIRE);
+      const uint8_t type = PacketType(header);
+      if (type == HSA_PACKET_TYPE_INVALID || !Execute(packet, type)) break;
+
+      // Return the slot to the producer before moving past it.
+      __atomic_store_n(&packet->header,
+                       uint16_t(HSA_PACKET_TYPE_INVALID
+                                << HSA_PACKET_HEADER_TYPE),
+                       __ATOMIC_RELAXED);
+      __atomic_store_n(read_index_, ++read, __ATOMIC_RELEASE);
+      progress = true;
+    }
+
+    return progress;
+  }
+
+ private:
+  // Returns false if packet cannot complete yet, or halted the queue.
+  bool Execute(hsa_kernel_dispatch_packet_t* packet, uint8_t type) {
+    switch (type) {
+      case HSA_PACKET_TYPE_KERNEL_DISPATCH:
+        if (packet->kernel_object == 0) {
+          Halt(kErrorInvalidCode);
+          return false;
+        }
+        if (!Run()) return false;
+        Complete(packet->completion_signal);
+        return true;
+
+      case HSA_PACKET_TYPE_BARRIER_AND:
+      case HSA_PACKET_TYPE_BARRIER_OR: {
+        hsa_barrier_and_packet_t* barrier =
+            reinterpret_cast<hsa_barrier_and_packet_t*>(packet);
+        if (!Satisfied(barrier->dep_signal,
+                       type == HSA_PACKET_TYPE_BARRIER_AND))
+          return false;
+        start_ts_ = GpuClock();
+        Complete(barrier->completion_signal);
+        return true;
+      }
+
+      case HSA_PACKET_TYPE_AGENT_DISPATCH:
+      case HSA_PACKET_TYPE_VENDOR_SPECIFIC:
+        // Neither does anything on the emulated command processor.
+        return true;
+
+      default:
+        Halt(kErrorInvalidFormat);
+        return false;
+    }
+  }
+
+  // Accounts for the simulated execution time of a dispatch. Returns true
+  // once it has elapsed.
+  bool Run() {
+    if (busy_until_ == 0) {
+      start_ts_ = GpuClock();
+      if (kernel_ns_ == 0) return true;
+      busy_until_ = NowNs() + kernel_ns_;
+    }
+    if (NowNs() < busy_until_) return false;
+    busy_until_ = 0;
+    return true;
+  }
+
+  static bool Satisfied(const hsa_signal_t* deps, bool all) {
+    bool any_dep = false;
+    for (int i = 0; i < 5; ++i) {
+      if (deps[i].handle == 0) continue;
+      any_dep = true;
+      const bool done =
+          __atomic_load_n(&SignalOf(deps[i])->value, __ATOMIC_ACQUIRE) == 0;
+      if (done != all) return done;
+    }
+    return all || !any_dep;
+  }
+
+  void Complete(hsa_signal_t completion) {
+    if (completion.handle == 0) return;
+    amd_signal_t* signal = SignalOf(completion);
+
+    if (AMD_HSA_BITS_GET(queue_->queue_properties,
+                         AMD_QUEUE_PROPERTIES_ENABLE_PROFILING)) {
+      signal->start_ts = start_ts_;
+      signal->end_ts = GpuClock();
+    }
+
+    __atomic_fetch_sub(&signal->value, 1, __ATOMIC_RELEASE);
+    Notify(signal);
+  }
+
+  // Stops the queue and reports error to the runtime, as the command
+  // processor does on a malformed packet.
+  void Halt(int64_t error) {
+    halted_ = true;
+    if (queue_->queue_inactive_signal.handle == 0) {
+      fprintf(stderr, "hsakmt-emu: queue %llu halted with error %lld\n",
+              (unsigned long long)id(), (long long)error);
+      return;
+    }
+    amd_signal_t* signal = SignalOf(queue_->queue_inactive_signal);
+    __atomic_store_n(&signal->value, error, __ATOMIC_RELEASE);
+    Notify(signal);
+  }
+
+  hsa_kernel_dispatch_packet_t* const ring_;
+  const uint64_t size_;
+  volatile HSAuint64* const read_index_;
+  volatile HSAuint64* const write_index_;
+  amd_queue_t* const queue_;
+  const uint64_t kernel_ns_;
+  uint64_t busy_until_;
+  uint64_t start_ts_;
+  bool halted_;
+  volatile uint32_t doorbell_;
+};
+
+//===----------------------------------------------------------------------===//
+// SDMA queues.                                                               //
+//===----------------------------------------------------------------------===//
+
+const uint32_t kSdmaOpNop = 0;
+const uint32_t kSdmaOpCopy = 1;
+const uint32_t kSdmaOpFence = 5;
+const uint32_t kSdmaOpTrap = 6;
+const uint32_t kSdmaOpConstFill = 11;
+const uint32_t kSdmaSubOpCopyLinear = 0;
+const uint32_t kSdmaFillDword = 2;
+
+void* Address(uint32_t low, uint32_t high) {
+  return reinterpret_cast<void*>(uintptr_t(uint64_t(high) << 32 | low));
+}
+
+class SdmaQueue : public Queue {
+ public:
+  SdmaQueue(HSA_QUEUEID id, void* ring, uint64_t ring_bytes)
+      : Queue(id),
+        ring_(reinterpret_cast<char*>(ring)),
+        size_(uint32_t(ring_bytes)),
+        halted_(false) {
+    doorbell_ = 0;
+    write_offset_ = 0;
+    read_offset_ = 0;
+  }
+
+  volatile uint32_t* doorbell() { return &doorbell_; }
+  volatile uint32_t* write_offset() { return &write_offset_; }
+  volatile uint32_t* read_offset() { return &read_offset_; }
+
+  bool Service() {
+    if (halted_) return false;
+
+    uint32_t read = read_offset_;
+    const uint32_t write = __atomic_load_n(&write_offset_, __ATOMIC_ACQUIRE);
+    if (read == write) return false;
+
+    // The runtime pads the end of the ring with NOPs and wraps the write
+    // offset to 0, so a packet never straddles the end.
+    while (read != write) {
+      const uint32_t bytes =
+          Execute(reinterpret_cast<const uint32_t*>(ring_ + read));
+      if (bytes == 0) {
+        halted_ = true;
+        break;
+      }
+      read += bytes;
+      if (read >= size_) read = 0;
+    }
+
+    __atomic_store_n(&read_offset_, read, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  // Executes one packet and returns its size, or 0 for a packet the
+  // emulator does not implement.
+  uint32_t Execute(const uint32_t* packet) {
+    const uint32_t op = packet[0] & 0xff;
+    const uint32_t sub_op = (packet[0] >> 8) & 0xff;
+
+    switch (op) {
+      case kSdmaOpNop:
+        return 4 * (1 + ((packet[0] >> 16) & 0x3fff));
+
+      case kSdmaOpCopy:
+        if (sub_op != kSdmaSubOpCopyLinear) break;
+        memmove(Address(packet[5], packet[6]), Address(packet[3], packet[4]),
+                packet[1] & 0x3fffff);
+        return 7 * 4;
+
+      case kSdmaOpConstFill: {
+        char* dst = reinterpret_cast<char*>(Address(packet[1], packet[2]));
+        const uint32_t bytes = packet[4] & 0x3fffff;
+        if ((packet[0] >> 30) == kSdmaFillDword) {
+          uint32_t* dwords = reinterpret_cast<uint32_t*>(dst);
+          std::fill(dwords, dwords + bytes / 4, packet[3]);
+        } else {
+          memset(dst, int(packet[3] & 0xff), bytes);
+        }
+        return 5 * 4;
+      }
+
+      case kSdmaOpFence:
+        __atomic_store_n(
+            reinterpret_cast<uint32_t*>(Address(packet[1], packet[2])),
+            packet[3], __ATOMIC_RELEASE);
+        return 4 * 4;
+
+      case kSdmaOpTrap:
+        // No event is tied to SDMA traps in the emulator.
+        return 2 * 4;
+    }
+
+    fprintf(stderr, "hsakmt-emu: SDMA queue %llu halted on op %u:%u\n",
+            (unsigned long long)id(), op, sub_op);
+    return 0;
+  }
+
+  char* const ring_;
+  const uint32_t size_;
+  bool halted_;
+  volatile uint32_t doorbell_;
+  volatile uint32_t write_offset_;
+  volatile uint32_t read_offset_;
+};
+
+//===----------------------------------------------------------------------===//
+// Engines.                                                                   //
+//===----------------------------------------------------------------------===//
+
+class Engine {
+ public:
+  Engine()
+      : running_(false), poll_ns_(EnvValue("HSA_EMU_POLL_US", 50) * 1000) {}
+
+  // Both must be called with queues_lock held.
+  void Add(Queue* queue) {
+    std::lock_guard<std::mutex> lock(lock_);
+    queues_.push_back(queue);
+    if (!running_) {
+      running_ = true;
+      thread_ = std::thread([this] { Run(); });
+    }
+  }
+
+  void Remove(Queue* queue) {
+    bool stop = false;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      queues_.erase(std::find(queues_.begin(), queues_.end(), queue));
+      if (queues_.empty()) {
+        running_ = false;
+        stop = true;
+      }
+    }
+    if (stop) thread_.join();
+  }
+
+ private:
+  void Run() {
+    // Polls before the engine first yields, then sleeps.
+    const uint32_t kSpinPolls = 1000;
+    const uint32_t kYieldPolls = 1100;
+
+    uint32_t idle = 0;
+    for (;;) {
+      bool progress = false;
+      {
+        // Released between passes so queues can come and go.
+        std::lock_guard<std::mutex> lock(lock_);
+        if (!running_) return;
+        for (size_t i = 0; i < queues_.size(); ++i)
+          progress |= queues_[i]->Service();
+      }
+
+      if (progress) {
+        idle = 0;
+      } else if (++idle < kSpinPolls) {
+        continue;
+      } else if (idle < kYieldPolls) {
+        sched_yield();
+      } else {
+        timespec sleep;
+        sleep.tv_sec = time_t(poll_ns_ / 1000000000);
+        sleep.tv_nsec = long(poll_ns_ % 1000000000);
+        nanosleep(&sleep, NULL);
+      }
+    }
+  }
+
+  std::mutex lock_;
+  std::vector<Queue*> queues_;
+  std::thread thread_;
+  bool running_;
+  const uint64_t poll_ns_;
+};
+
+// Engines by node, compute engines at 2 * node and SDMA engines at
+// 2 * node + 1.
+std::map<uint32_t, Engine*> engines;
+
+struct QueueEntry {
+  Queue* queue;
+  Engine* engine;
+};
+
+std::map<HSA_QUEUEID, QueueEntry> queues;
+HSA_QUEUEID next_queue_id = 1;
+
+Engine* GetEngine(HSAuint32 node_id, bool sdma) {
+  Engine*& engine = engines[2 * node_id + (sdma ? 1 : 0)];
+  if (engine == NULL) engine = new Engine();
+  return engine;
+}
+
+}  // namespace
+
+HSAKMT_STATUS CreateQueue(HSAuint32 node_id, HSA_QUEUE_TYPE type,
+                          void* queue_address, HSAuint64 queue_size,
+                          HsaQueueResource* queue_resource) {
+  if (queue_address == NULL || queue_size == 0 || queue_resource == NULL)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+  if (!IsGpuNode(node_id)) return HSAKMT_STATUS_INVALID_NODE_UNIT;
+
+  std::lock_guard<std::mutex> lock(queues_lock);
+  const HSA_QUEUEID id = next_queue_id++;
+  Queue* queue = NULL;
+
+  switch (type) {
+    case HSA_QUEUE_COMPUTE_AQL: {
+      if (queue_resource->Queue_read_ptr_aql == NULL ||
+          queue_resource->Queue_write_ptr_aql == NULL)
+        return HSAKMT_STATUS_INVALID_PARAMETER;
+      AqlQueue* aql = new AqlQueue(id, queue_address, queue_size,
+                                   queue_resource->Queue_read_ptr_aql,
+                                   queue_resource->Queue_write_ptr_aql);
+      queue_resource->Queue_DoorBell = const_cast<HSAuint32*>(aql->doorbell());
+      queue = aql;
+      break;
+    }
+    case HSA_QUEUE_SDMA: {
+      SdmaQueue* sdma = new SdmaQueue(id, queue_address, queue_size);
+      queue_resource->Queue_DoorBell = const_cast<HSAuint32*>(sdma->doorbell());
+      queue_resource->Queue_write_ptr =
+          const_cast<HSAuint32*>(sdma->write_offset());
+      queue_resource->Queue_read_ptr =
+          const_cast<HSAuint32*>(sdma->read_offset());
+      queue = sdma;
+      break;
+    }
+    default:
+      // PM4 compute queues are not emulated.
+      return HSAKMT_STATUS_NOT_SUPPORTED;
+  }
+
+  queue_resource->QueueId = id;
+  QueueEntry entry = {queue, GetEngine(node_id, type == HSA_QUEUE_SDMA)};
+  queues[id] = entry;
+  entry.engine->Add(queue);
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS DestroyQueue(HSA_QUEUEID queue_id) {
+  std::lock_guard<std::mutex> lock(queues_lock);
+  std::map<HSA_QUEUEID, QueueEntry>::iterator it = queues.find(queue_id);
+  if (it == queues.end()) return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  it->second.engine->Remove(it->second.queue);
+  delete it->second.queue;
+  queues.erase(it);
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS SetQueueCUMask(HSA_QUEUEID queue_id, HSAuint32 cu_mask_count,
+                             HSAuint32* cu_mask) {
+  if (cu_mask_count == 0 || cu_mask == NULL)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+  std::lock_guard<std::mutex> lock(queues_lock);
+  // Every dispatch completes on the one engine thread whatever the mask.
+  return (queues.count(queue_id) != 0) ? HSAKMT_STATUS_SUCCESS
+                                       : HSAKMT_STATUS_INVALID_PARAMETER;
+}
+
+void ShutDownQueues() {
+  std::lock_guard<std::mutex> lock(queues_lock);
+  for (std::map<HSA_QUEUEID, QueueEntry>::iterator it = queues.begin();
+       it != queues.end(); ++it) {
+    it->second.engine->Remove(it->second.queue);
+    delete it->second.queue;
+  }
+  queues.clear();
+
+  for (std::map<uint32_t, Engine*>::iterator it = engines.begin();
+       it != engines.end(); ++it)
+    delete it->second;
+  engines.clear();
+}
+
+}  // namespace emu
+}  // namespace hsa
@@ -0,0 +1,437 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// Emulated KFD thunk, for running and benchmarking the runtime on machines
+// without a GPU or a KFD driver. It is built as libhsakmt.so.1 in the
+// hsakmt_emu directory of the build; put that directory first on
+// LD_LIBRARY_PATH to use it, or build without HSA_BUILD_LIB_PATH to link the
+// runtime against it.
+//
+// Every node is an APU node with a CPU agent and a GPU agent. Memory is
+// anonymous mmap shared with the host, events are futexes and clock counters
+// come from the monotonic clocks. AQL and SDMA queues are serviced by host
+// threads, see emu_queue.cpp; kernels are not executed.
+//
+// Environment:
+//   HSA_EMU_NODES      number of nodes (default 1)
+//   HSA_EMU_GPU        0 makes every node CPU only (default 1)
+//   HSA_EMU_ISA        GPU engine id as major.minor.stepping (default 8.0.1)
+//   HSA_EMU_CUS        compute units per GPU (default 8)
+//   HSA_EMU_KERNEL_NS  time each kernel dispatch takes (default 0)
+//   HSA_EMU_POLL_US    sleep between polls of an idle engine (default 50)
+//   HSA_EMU_CLOCK_PPM  drift of the GPU clock against the system clock, in
+//                      parts per million, may be negative (default 0)
+
+#include "hsakmt_emu.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <mutex>
+
+namespace hsa {
+namespace emu {
+namespace {
+
+// Apertures reported for the group and private segments. Nothing is mapped
+// there; the runtime only passes them on to the hardware queue descriptor.
+const HSAuint64 kLdsAperture = 0x1000000000000000ull;
+const HSAuint64 kScratchAperture = 0x1100000000000000ull;
+const HSAuint64 kScratchSize = 4ull << 30;
+
+const HSAuint32 kSimdsPerCu = 4;
+
+// Index of each memory bank of a GPU node; CPU only nodes have just the
+// system bank.
+enum Bank { kBankSystem, kBankLds, kBankScratch, kBankCount };
+
+struct Topology {
+  HSAuint32 nodes;
+  bool gpu;
+  HSAuint32 cus;
+  HSA_ENGINE_ID engine_id;
+  HSAuint32 cores_per_node;
+  HSAuint64 memory_per_node;
+  // GPU clock drift, applied from gpu_clock_base on.
+  int64_t clock_ppm;
+  HSAuint64 gpu_clock_base;
+};
+
+std::mutex kfd_lock;
+int open_count = 0;
+Topology topology;
+
+HSAuint64 ClockNs(clockid_t clock) {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return HSAuint64(ts.tv_sec) * 1000000000ull + HSAuint64(ts.tv_nsec);
+}
+
+HSA_ENGINE_ID EngineId() {
+  unsigned major = 8, minor = 0, stepping = 1;
+  const char* value = getenv("HSA_EMU_ISA");
+  if (value != NULL) sscanf(value, "%u.%u.%u", &major, &minor, &stepping);
+
+  HSA_ENGINE_ID id;
+  id.Value = 0;
+  id.ui32.Major = major;
+  id.ui32.Minor = minor;
+  id.ui32.Stepping = stepping;
+  return id;
+}
+
+void BuildTopology() {
+  topology.nodes = HSAuint32(EnvValue("HSA_EMU_NODES", 1));
+  if (topology.nodes == 0) topology.nodes = 1;
+  topology.gpu = EnvValue("HSA_EMU_GPU", 1) != 0;
+  topology.cus = HSAuint32(EnvValue("HSA_EMU_CUS", 8));
+  if (topology.cus == 0) topology.cus = 1;
+  topology.engine_id = EngineId();
+
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores < long(topology.nodes)) cores = topology.nodes;
+  topology.cores_per_node = HSAuint32(cores) / topology.nodes;
+
+  const HSAuint64 memory =
+      HSAuint64(sysconf(_SC_PHYS_PAGES)) * HSAuint64(sysconf(_SC_PAGESIZE));
+  topology.memory_per_node = memory / topology.nodes;
+
+  const char* ppm = getenv("HSA_EMU_CLOCK_PPM");
+  topology.clock_ppm = (ppm != NULL) ? strtoll(ppm, NULL, 0) : 0;
+  topology.gpu_clock_base = ClockNs(CLOCK_MONOTONIC_RAW) / 10;
+}
+
+HSAuint32 CacheKb(int name, HSAuint32 default_kb) {
+  const long bytes = sysconf(name);
+  return (bytes > 0) ? HSAuint32(bytes / 1024) : default_kb;
+}
+
+void FillCache(HsaCacheProperties& cache, HSAuint32 processor, HSAuint32 level,
+               HSAuint32 size_kb, bool cpu) {
+  memset(&cache, 0, sizeof(HsaCacheProperties));
+  cache.ProcessorIdLow = processor;
+  cache.CacheLevel = level;
+  cache.CacheSize = size_kb;
+  cache.CacheLineSize = 64;
+  cache.CacheType.ui32.Data = 1;
+  cache.CacheType.ui32.CPU = cpu ? 1 : 0;
+  cache.CacheType.ui32.HSACU = cpu ? 0 : 1;
+}
+
+}  // namespace
+
+uint64_t EnvValue(const char* name, uint64_t default_value) {
+  const char* value = getenv(name);
+  if (value == NULL || *value == '\0') return default_value;
+  return strtoull(value, NULL, 0);
+}
+
+uint64_t NowNs() { return ClockNs(CLOCK_MONOTONIC); }
+
+// Runs from the raw monotonic clock, which NTP does not slew, so the runtime's
+// clock model sees a real drift rate against the system clock.
+// HSA_EMU_CLOCK_PPM adds a known drift on top, counted from the opening of
+// the KFD so the correction stays small.
+uint64_t GpuClock() {
+  const uint64_t ticks = ClockNs(CLOCK_MONOTONIC_RAW) / 10;
+  const int64_t elapsed = int64_t(ticks - topology.gpu_clock_base);
+  return ticks + uint64_t(elapsed * topology.clock_ppm / 1000000);
+}
+
+uint32_t NodeCount() { return topology.nodes; }
+
+bool IsGpuNode(HSAuint32 node_id) {
+  return topology.gpu && node_id < topology.nodes;
+}
+
+}  // namespace emu
+}  // namespace hsa
+
+using namespace hsa::emu;
+
+#pragma GCC visibility push(default)
+
+extern "C" {
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtOpenKFD(void) {
+  std::lock_guard<std::mutex> lock(kfd_lock);
+  if (open_count++ == 0) BuildTopology();
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtCloseKFD(void) {
+  std::lock_guard<std::mutex> lock(kfd_lock);
+  if (open_count == 0) return HSAKMT_STATUS_KERNEL_IO_CHANNEL_NOT_OPENED;
+  if (--open_count == 0) ShutDownQueues();
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtGetVersion(HsaVersionInfo* VersionInfo) {
+  if (VersionInfo == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  // 1.0 would make the runtime disable interrupt signals.
+  VersionInfo->KernelInterfaceMajorVersion = 1;
+  VersionInfo->KernelInterfaceMinorVersion = 1;
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtAcquireSystemProperties(HsaSystemProperties* SystemProperties) {
+  if (SystemProperties == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  memset(SystemProperties, 0, sizeof(HsaSystemProperties));
+  SystemProperties->NumNodes = NodeCount();
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtReleaseSystemProperties(void) {
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtGetNodeProperties(HSAuint32 NodeId, HsaNodeProperties* NodeProperties) {
+  if (NodeId >= NodeCount() || NodeProperties == NULL)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  HsaNodeProperties& props = *NodeProperties;
+  memset(&props, 0, sizeof(HsaNodeProperties));
+
+  props.NumCPUCores = topology.cores_per_node;
+  props.CComputeIdLo = NodeId * topology.cores_per_node;
+  props.NumMemoryBanks = 1;
+  props.NumCaches = 2;
+  props.VendorId = 0x1002;
+
+  if (IsGpuNode(NodeId)) {
+    props.NumFComputeCores = topology.cus * kSimdsPerCu;
+    props.FComputeIdLo = 0x80000000 + NodeId * props.NumFComputeCores;
+    props.NumMemoryBanks = kBankCount;
+    props.EngineId = topology.engine_id;
+    props.WaveFrontSize = 64;
+    props.MaxWavesPerSIMD = 10;
+    props.LDSSizeInKB = 64;
+    props.NumSIMDPerCU = kSimdsPerCu;
+    props.NumShaderBanks = 1;
+    props.NumArrays = 1;
+    props.NumCUPerArray = topology.cus;
+    props.MaxSlotsScratchCU = 32;
+    props.MaxEngineClockMhzFCompute = 800;
+    // Doorbells carry the packet index rather than a ring offset.
+    props.Capability.ui32.DoorbellType = 1;
+
+    static const char kName[] = "HSA emulated GPU";
+    for (size_t i = 0; i < sizeof(kName); ++i)
+      props.MarketingName[i] = kName[i];
+  }
+
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtGetNodeMemoryProperties(HSAuint32 NodeId, HSAuint32 NumBanks,
+                              HsaMemoryProperties* MemoryProperties) {
+  if (NodeId >= NodeCount() || MemoryProperties == NULL)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  const HSAuint32 banks = IsGpuNode(NodeId) ? kBankCount : 1;
+  if (NumBanks < banks) return HSAKMT_STATUS_INVALID_PARAMETER;
+  memset(MemoryProperties, 0, NumBanks * sizeof(HsaMemoryProperties));
+
+  MemoryProperties[kBankSystem].HeapType = HSA_HEAPTYPE_SYSTEM;
+  MemoryProperties[kBankSystem].SizeInBytes = topology.memory_per_node;
+
+  if (banks > 1) {
+    MemoryProperties[kBankLds].HeapType = HSA_HEAPTYPE_GPU_LDS;
+    MemoryProperties[kBankLds].SizeInBytes = 64 * 1024;
+    MemoryProperties[kBankLds].VirtualBaseAddress = kLdsAperture;
+
+    MemoryProperties[kBankScratch].HeapType = HSA_HEAPTYPE_GPU_SCRATCH;
+    MemoryProperties[kBankScratch].SizeInBytes = kScratchSize;
+    MemoryProperties[kBankScratch].VirtualBaseAddress = kScratchAperture;
+  }
+
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtGetNodeCacheProperties(HSAuint32 NodeId, HSAuint32 ProcessorId,
+                             HSAuint32 NumCaches,
+                             HsaCacheProperties* CacheProperties) {
+  if (NodeId >= NodeCount() || NumCaches < 2 || CacheProperties == NULL)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  // The runtime asks once for the CPU cores and once for the compute units
+  // of a node, with NumCaches of the node each time.
+  if (ProcessorId == NodeId * topology.cores_per_node) {
+    FillCache(CacheProperties[0], ProcessorId, 1,
+              CacheKb(_SC_LEVEL1_DCACHE_SIZE, 32), true);
+    FillCache(CacheProperties[1], ProcessorId, 2,
+              CacheKb(_SC_LEVEL2_CACHE_SIZE, 512), true);
+  } else {
+    FillCache(CacheProperties[0], ProcessorId, 1, 16, false);
+    FillCache(CacheProperties[1], ProcessorId, 2, 512, false);
+  }
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtCreateEvent(HsaEventDescriptor* EventDesc,
+                                          bool ManualReset, bool IsSignaled,
+                                          HsaEvent** Event) {
+  return CreateEvent(EventDesc, ManualReset, IsSignaled, Event);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtDestroyEvent(HsaEvent* Event) {
+  return DestroyEvent(Event);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtSetEvent(HsaEvent* Event) {
+  return SetEvent(Event);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtWaitOnEvent(HsaEvent* Event,
+                                          HSAuint32 Milliseconds) {
+  return WaitOnEvents(&Event, 1, true, Milliseconds);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtWaitOnMultipleEvents(HsaEvent* Events[],
+                                                   HSAuint32 NumEvents,
+                                                   bool WaitOnAll,
+                                                   HSAuint32 Milliseconds) {
+  return WaitOnEvents(Events, NumEvents, WaitOnAll, Milliseconds);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtCreateQueue(
+    HSAuint32 NodeId, HSA_QUEUE_TYPE Type, HSAuint32 QueuePercentage,
+    HSA_QUEUE_PRIORITY Priority, void* QueueAddress, HSAuint64 QueueSizeInBytes,
+    HsaEvent* Event, HsaQueueResource* QueueResource) {
+  return CreateQueue(NodeId, Type, QueueAddress, QueueSizeInBytes,
+                     QueueResource);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtDestroyQueue(HSA_QUEUEID QueueId) {
+  return DestroyQueue(QueueId);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtSetQueueCUMask(HSA_QUEUEID QueueId,
+                                             HSAuint32 CUMaskCount,
+                                             HSAuint32* QueueCUMask) {
+  return SetQueueCUMask(QueueId, CUMaskCount, QueueCUMask);
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtSetMemoryPolicy(HSAuint32 Node,
+                                              HSAuint32 DefaultPolicy,
+                                              HSAuint32 AlternatePolicy,
+                                              void* MemoryAddressAlternate,
+                                              HSAuint64 MemorySizeInBytes) {
+  return (Node < NodeCount()) ? HSAKMT_STATUS_SUCCESS
+                              : HSAKMT_STATUS_INVALID_NODE_UNIT;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtAllocMemory(HSAuint32 PreferredNode,
+                                          HSAuint64 SizeInBytes,
+                                          HsaMemFlags MemFlags,
+                                          void** MemoryAddress) {
+  if (MemoryAddress == NULL || SizeInBytes == 0)
+    return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  int prot = PROT_READ | PROT_WRITE;
+  if (MemFlags.ui32.ExecuteAccess) prot |= PROT_EXEC;
+
+  // Scratch is reserved up front and mostly never touched.
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  if (MemFlags.ui32.Scratch) flags |= MAP_NORESERVE;
+
+  void* ptr = mmap(NULL, SizeInBytes, prot, flags, -1, 0);
+  if (ptr == MAP_FAILED) return HSAKMT_STATUS_NO_MEMORY;
+
+  *MemoryAddress = ptr;
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtFreeMemory(void* MemoryAddress,
+                                         HSAuint64 SizeInBytes) {
+  if (MemoryAddress == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  return (munmap(MemoryAddress, SizeInBytes) == 0)
+             ? HSAKMT_STATUS_SUCCESS
+             : HSAKMT_STATUS_INVALID_PARAMETER;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtRegisterMemory(void* MemoryAddress,
+                                             HSAuint64 MemorySizeInBytes) {
+  return (MemoryAddress != NULL) ? HSAKMT_STATUS_SUCCESS
+                                 : HSAKMT_STATUS_INVALID_PARAMETER;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtDeregisterMemory(void* MemoryAddress) {
+  return (MemoryAddress != NULL) ? HSAKMT_STATUS_SUCCESS
+                                 : HSAKMT_STATUS_INVALID_PARAMETER;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtMapMemoryToGPU(void* MemoryAddress,
+                                             HSAuint64 MemorySizeInBytes,
+                                             HSAuint64* AlternateVAGPU) {
+  if (MemoryAddress == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+  // The emulated GPU shares the host address space.
+  if (AlternateVAGPU != NULL)
+    *AlternateVAGPU = reinterpret_cast<HSAuint64>(MemoryAddress);
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtUnmapMemoryToGPU(void* MemoryAddress) {
+  return (MemoryAddress != NULL) ? HSAKMT_STATUS_SUCCESS
+                                 : HSAKMT_STATUS_INVALID_PARAMETER;
+}
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtGetClockCounters(HSAuint32 NodeId,
+                                               HsaClockCounters* Counters) {
+  if (Counters == NULL) return HSAKMT_STATUS_INVALID_PARAMETER;
+
+  const HSAuint64 system = NowNs();
+  Counters->GPUClockCounter = GpuClock();
+  Counters->CPUClockCounter = system;
+  Counters->SystemClockCounter = system;
+  Counters->SystemClockFrequencyHz = 1000000000ull;
+  return HSAKMT_STATUS_SUCCESS;
+}
+
+}  // extern "C"
+
+#pragma GCC visibility pop
@@ -0,0 +1,130 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef HSA_RUNTIME_CORE_TOOLS_HSAKMT_EMU_HSAKMT_EMU_H_
+#define HSA_RUNTIME_CORE_TOOLS_HSAKMT_EMU_HSAKMT_EMU_H_
+
+// Internal interface of the emulated KFD thunk. hsakmt_emu.cpp implements the
+// hsaKmt* entry points and the topology, emu_event.cpp the events and
+// emu_queue.cpp the host threads that stand in for the command processor and
+// the SDMA engines.
+
+#include <stdint.h>
+
+#include <atomic>
+
+#pragma GCC visibility push(default)
+#include "hsakmt.h"
+#pragma GCC visibility pop
+
+namespace hsa {
+namespace emu {
+
+//===----------------------------------------------------------------------===//
+// Configuration and clocks.                                                  //
+//===----------------------------------------------------------------------===//
+
+// Returns the unsigned integer value of environment variable name, or
+// default_value when it is unset or empty.
+uint64_t EnvValue(const char* name, uint64_t default_value);
+
+// Nanoseconds of the monotonic clock.
+uint64_t NowNs();
+
+// The emulated GPU time stamp counter, 100MHz, drifting by
+// HSA_EMU_CLOCK_PPM.
+uint64_t GpuClock();
+
+// Number of nodes, and whether a node has a GPU. Valid while the KFD is open.
+uint32_t NodeCount();
+bool IsGpuNode(HSAuint32 node_id);
+
+//===----------------------------------------------------------------------===//
+// Events.                                                                    //
+//===----------------------------------------------------------------------===//
+
+struct Event;
+
+// The interrupt mailbox of an event. HsaEvent::EventData.HWData2, and so
+// amd_signal_t::event_mailbox_ptr, points to it; a GPU writes the event id
+// there before raising the interrupt.
+struct Mailbox {
+  volatile uint64_t value;  // Must be first.
+  Event* event;
+};
+
+struct Event {
+  HsaEvent event;  // Must be first: the runtime only sees HsaEvent*.
+  Mailbox mailbox;
+  bool manual_reset;
+  // Futex word, 1 while the event is signaled.
+  std::atomic<int32_t> signaled;
+  // Threads blocked in a wait on this event alone.
+  std::atomic<uint32_t> waiters;
+};
+
+HSAKMT_STATUS CreateEvent(HsaEventDescriptor* descriptor, bool manual_reset,
+                          bool is_signaled, HsaEvent** event);
+HSAKMT_STATUS DestroyEvent(HsaEvent* event);
+HSAKMT_STATUS SetEvent(HsaEvent* event);
+HSAKMT_STATUS WaitOnEvents(HsaEvent* events[], HSAuint32 count,
+                           bool wait_on_all, HSAuint32 milliseconds);
+
+// Raises the interrupt of the event owning mailbox_ptr, as the GPU does on
+// completing a packet whose completion signal has a mailbox.
+void RaiseInterrupt(uint64_t mailbox_ptr, uint32_t event_id);
+
+//===----------------------------------------------------------------------===//
+// Queues.                                                                    //
+//===----------------------------------------------------------------------===//
+
+HSAKMT_STATUS CreateQueue(HSAuint32 node_id, HSA_QUEUE_TYPE type,
+                          void* queue_address, HSAuint64 queue_size,
+                          HsaQueueResource* queue_resource);
+HSAKMT_STATUS DestroyQueue(HSA_QUEUEID queue_id);
+HSAKMT_STATUS SetQueueCUMask(HSA_QUEUEID queue_id, HSAuint32 cu_mask_count,
+                             HSAuint32* cu_mask);
+
+// Destroys the queues left open and stops every engine thread.
+void ShutDownQueues();
+
+}  // namespace emu
+}  // namespace hsa
+
+#endif  // HSA_RUNTIME_CORE_TOOLS_HSAKMT_EMU_HSAKMT_EMU_H_
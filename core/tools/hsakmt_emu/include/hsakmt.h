@@ -0,0 +1,425 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef HSA_RUNTIME_CORE_TOOLS_HSAKMT_EMU_INCLUDE_HSAKMT_H_
+#define HSA_RUNTIME_CORE_TOOLS_HSAKMT_EMU_INCLUDE_HSAKMT_H_
+
+// KFD thunk interface implemented by the emulated thunk. CMakeLists.txt puts
+// this directory on the include path when HSA_BUILD_INC_PATH does not hold
+// the thunk's own hsakmt.h, so the runtime builds and runs without the
+// driver sources. It declares the subset of the thunk the runtime uses, with
+// the thunk's names and layouts; a runtime built against it must be linked
+// against the emulated thunk.
+
+#include <stddef.h>
+#include <stdint.h>
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HSAKMTAPI
+
+typedef unsigned char HSAuint8;
+typedef char HSAint8;
+typedef unsigned short HSAuint16;
+typedef signed short HSAint16;
+typedef unsigned int HSAuint32;
+typedef signed int HSAint32;
+typedef uint64_t HSAuint64;
+typedef int64_t HSAint64;
+
+typedef HSAuint64 HSA_QUEUEID;
+
+#define HSA_EVENTTIMEOUT_IMMEDIATE 0
+#define HSA_EVENTTIMEOUT_INFINITE 0xFFFFFFFF
+
+typedef enum _HSAKMT_STATUS {
+  HSAKMT_STATUS_SUCCESS = 0,
+  HSAKMT_STATUS_ERROR = 1,
+  HSAKMT_STATUS_DRIVER_MISMATCH = 2,
+  HSAKMT_STATUS_INVALID_PARAMETER = 3,
+  HSAKMT_STATUS_INVALID_HANDLE = 4,
+  HSAKMT_STATUS_INVALID_NODE_UNIT = 5,
+  HSAKMT_STATUS_NO_MEMORY = 6,
+  HSAKMT_STATUS_BUFFER_TOO_SMALL = 7,
+  HSAKMT_STATUS_NOT_IMPLEMENTED = 10,
+  HSAKMT_STATUS_NOT_SUPPORTED = 11,
+  HSAKMT_STATUS_UNAVAILABLE = 12,
+  HSAKMT_STATUS_OUT_OF_RESOURCES = 13,
+  HSAKMT_STATUS_KERNEL_IO_CHANNEL_NOT_OPENED = 20,
+  HSAKMT_STATUS_KERNEL_COMMUNICATION_ERROR = 21,
+  HSAKMT_STATUS_KERNEL_ALREADY_OPENED = 22,
+  HSAKMT_STATUS_HSAMMU_UNAVAILABLE = 23,
+  HSAKMT_STATUS_WAIT_FAILURE = 30,
+  HSAKMT_STATUS_WAIT_TIMEOUT = 31,
+  HSAKMT_STATUS_MEMORY_ALREADY_REGISTERED = 35,
+  HSAKMT_STATUS_MEMORY_NOT_REGISTERED = 36,
+  HSAKMT_STATUS_MEMORY_ALIGNMENT = 37
+} HSAKMT_STATUS;
+
+//===----------------------------------------------------------------------===//
+// Topology.                                                                  //
+//===----------------------------------------------------------------------===//
+
+typedef struct _HsaVersionInfo {
+  HSAuint32 KernelInterfaceMajorVersion;
+  HSAuint32 KernelInterfaceMinorVersion;
+} HsaVersionInfo;
+
+typedef struct _HsaSystemProperties {
+  HSAuint32 NumNodes;
+  HSAuint32 PlatformOem;
+  HSAuint32 PlatformId;
+  HSAuint32 PlatformRev;
+} HsaSystemProperties;
+
+typedef union {
+  HSAuint32 Value;
+  struct {
+    unsigned int HotPluggable : 1;
+    unsigned int HSAMMUPresent : 1;
+    unsigned int SharedWithGraphics : 1;
+    unsigned int QueueSizePowerOfTwo : 1;
+    unsigned int QueueSize32bit : 1;
+    unsigned int QueueIdleEvent : 1;
+    unsigned int VALimit : 1;
+    unsigned int WatchPointsSupported : 1;
+    unsigned int WatchPointsTotalBits : 4;
+    unsigned int DoorbellType : 2;
+    unsigned int Reserved : 18;
+  } ui32;
+} HSA_CAPABILITY;
+
+typedef union {
+  HSAuint32 Value;
+  struct {
+    unsigned int uCode : 10;
+    unsigned int Major : 6;
+    unsigned int Minor : 8;
+    unsigned int Stepping : 8;
+  } ui32;
+} HSA_ENGINE_ID;
+
+#define HSA_PUBLICNAME_SIZE 64
+
+typedef struct _HsaNodeProperties {
+  HSAuint32 NumCPUCores;
+  HSAuint32 NumFComputeCores;
+  HSAuint32 NumMemoryBanks;
+  HSAuint32 NumCaches;
+  HSAuint32 NumIOLinks;
+  HSAuint32 CComputeIdLo;
+  HSAuint32 FComputeIdLo;
+  HSA_CAPABILITY Capability;
+  HSAuint32 MaxWavesPerSIMD;
+  HSAuint32 LDSSizeInKB;
+  HSAuint32 GDSSizeInKB;
+  HSAuint32 WaveFrontSize;
+  HSAuint32 NumShaderBanks;
+  HSAuint32 NumArrays;
+  HSAuint32 NumCUPerArray;
+  HSAuint32 NumSIMDPerCU;
+  HSAuint32 MaxSlotsScratchCU;
+  HSA_ENGINE_ID EngineId;
+  HSAuint16 VendorId;
+  HSAuint16 DeviceId;
+  HSAuint32 LocationId;
+  HSAuint64 LocalMemSize;
+  HSAuint32 MaxEngineClockMhzFCompute;
+  HSAuint32 MaxEngineClockMhzCCompute;
+  HSAuint16 MarketingName[HSA_PUBLICNAME_SIZE];
+  HSAuint8 Reserved[64];
+} HsaNodeProperties;
+
+typedef enum _HSA_HEAPTYPE {
+  HSA_HEAPTYPE_SYSTEM = 0,
+  HSA_HEAPTYPE_FRAME_BUFFER_PUBLIC = 1,
+  HSA_HEAPTYPE_FRAME_BUFFER_PRIVATE = 2,
+  HSA_HEAPTYPE_GPU_GDS = 3,
+  HSA_HEAPTYPE_GPU_LDS = 4,
+  HSA_HEAPTYPE_GPU_SCRATCH = 5,
+  HSA_HEAPTYPE_NUMHEAPTYPES,
+  HSA_HEAPTYPE_SIZE = 0xFFFFFFFF
+} HSA_HEAPTYPE;
+
+typedef struct _HsaMemoryProperties {
+  HSA_HEAPTYPE HeapType;
+  HSAuint64 SizeInBytes;
+  HSAuint32 Flags;
+  HSAuint32 Width;
+  HSAuint32 MemoryClockMax;
+  HSAuint64 VirtualBaseAddress;
+} HsaMemoryProperties;
+
+typedef union {
+  HSAuint32 Value;
+  struct {
+    unsigned int Data : 1;
+    unsigned int Instruction : 1;
+    unsigned int CPU : 1;
+    unsigned int HSACU : 1;
+    unsigned int Reserved : 28;
+  } ui32;
+} HsaCacheType;
+
+#define HSA_CPU_SIBLINGS 256
+
+typedef struct _HsaCacheProperties {
+  HSAuint32 ProcessorIdLow;
+  HSAuint32 CacheLevel;
+  HSAuint32 CacheSize;
+  HSAuint32 CacheLineSize;
+  HSAuint32 CacheLinesPerTag;
+  HSAuint32 CacheAssociativity;
+  HSAuint32 CacheLatency;
+  HsaCacheType CacheType;
+  HSAuint32 SiblingMap[HSA_CPU_SIBLINGS];
+} HsaCacheProperties;
+
+//===----------------------------------------------------------------------===//
+// Memory.                                                                    //
+//===----------------------------------------------------------------------===//
+
+typedef enum _HSA_CACHING_TYPE {
+  HSA_CACHING_CACHED = 0,
+  HSA_CACHING_NONCACHED = 1,
+  HSA_CACHING_WRITECOMBINED = 2,
+  HSA_CACHING_RESERVED = 3,
+  HSA_CACHING_NUM_CACHING,
+  HSA_CACHING_SIZE = 0xFFFFFFFF
+} HSA_CACHING_TYPE;
+
+typedef enum _HSA_PAGE_SIZE {
+  HSA_PAGE_SIZE_4KB = 0,
+  HSA_PAGE_SIZE_64KB = 1,
+  HSA_PAGE_SIZE_2MB = 2,
+  HSA_PAGE_SIZE_1GB = 3
+} HSA_PAGE_SIZE;
+
+typedef union {
+  HSAuint32 Value;
+  struct {
+    unsigned int NonPaged : 1;
+    unsigned int CachePolicy : 2;
+    unsigned int ReadOnly : 1;
+    unsigned int PageSize : 2;
+    unsigned int HostAccess : 1;
+    unsigned int NoSubstitute : 1;
+    unsigned int GDSMemory : 1;
+    unsigned int Scratch : 1;
+    unsigned int AtomicAccessFull : 1;
+    unsigned int AtomicAccessPartial : 1;
+    unsigned int ExecuteAccess : 1;
+    unsigned int Reserved : 19;
+  } ui32;
+} HsaMemFlags;
+
+//===----------------------------------------------------------------------===//
+// Queues.                                                                    //
+//===----------------------------------------------------------------------===//
+
+typedef enum _HSA_QUEUE_PRIORITY {
+  HSA_QUEUE_PRIORITY_MINIMUM = -3,
+  HSA_QUEUE_PRIORITY_LOW = -2,
+  HSA_QUEUE_PRIORITY_BELOW_NORMAL = -1,
+  HSA_QUEUE_PRIORITY_NORMAL = 0,
+  HSA_QUEUE_PRIORITY_ABOVE_NORMAL = 1,
+  HSA_QUEUE_PRIORITY_HIGH = 2,
+  HSA_QUEUE_PRIORITY_MAXIMUM = 3,
+  HSA_QUEUE_PRIORITY_NUM_PRIORITY,
+  HSA_QUEUE_PRIORITY_SIZE = 0xFFFFFFFF
+} HSA_QUEUE_PRIORITY;
+
+typedef enum _HSA_QUEUE_TYPE {
+  HSA_QUEUE_COMPUTE = 1,
+  HSA_QUEUE_SDMA = 2,
+  HSA_QUEUE_MULTIMEDIA_DECODE = 3,
+  HSA_QUEUE_MULTIMEDIA_ENCODE = 4,
+  HSA_QUEUE_COMPUTE_AQL = 21,
+  HSA_QUEUE_DMA_AQL = 22,
+  HSA_QUEUE_TYPE_SIZE = 0xFFFFFFFF
+} HSA_QUEUE_TYPE;
+
+typedef struct _HsaQueueResource {
+  HSA_QUEUEID QueueId;
+  union {
+    HSAuint32* Queue_DoorBell;
+    HSAuint64* Queue_DoorBell_aql;
+    HSAuint64 QueueDoorBell;
+  };
+  union {
+    HSAuint32* Queue_write_ptr;
+    HSAuint64* Queue_write_ptr_aql;
+    HSAuint64 QueueWptrValue;
+  };
+  union {
+    HSAuint32* Queue_read_ptr;
+    HSAuint64* Queue_read_ptr_aql;
+    HSAuint64 QueueRptrValue;
+  };
+} HsaQueueResource;
+
+//===----------------------------------------------------------------------===//
+// Events and clocks.                                                         //
+//===----------------------------------------------------------------------===//
+
+typedef enum _HSA_EVENTTYPE {
+  HSA_EVENTTYPE_SIGNAL = 0,
+  HSA_EVENTTYPE_NODECHANGE = 1,
+  HSA_EVENTTYPE_DEVICESTATECHANGE = 2,
+  HSA_EVENTTYPE_HW_EXCEPTION = 3,
+  HSA_EVENTTYPE_SYSTEM_EVENT = 4,
+  HSA_EVENTTYPE_DEBUG_EVENT = 5,
+  HSA_EVENTTYPE_PROFILE_EVENT = 6,
+  HSA_EVENTTYPE_QUEUE_EVENT = 7,
+  HSA_EVENTTYPE_MAXID,
+  HSA_EVENTTYPE_TYPE_SIZE = 0xFFFFFFFF
+} HSA_EVENTTYPE;
+
+typedef HSAuint32 HSA_EVENTID;
+
+typedef struct _HsaSyncVar {
+  union {
+    void* UserData;
+    HSAuint64 UserDataPtrValue;
+  } SyncVar;
+  HSAuint64 SyncVarSize;
+} HsaSyncVar;
+
+typedef struct _HsaEventDescriptor {
+  HSA_EVENTTYPE EventType;
+  HSAuint32 NodeId;
+  HsaSyncVar SyncVar;
+} HsaEventDescriptor;
+
+typedef struct _HsaEventData {
+  HSA_EVENTTYPE EventType;
+  union {
+    HsaSyncVar SyncVar;
+  } EventData;
+  HSAuint64 HWData1;
+  HSAuint64 HWData2;
+  HSAuint32 HWData3;
+} HsaEventData;
+
+typedef struct _HsaEvent {
+  HSA_EVENTID EventId;
+  HsaEventData EventData;
+} HsaEvent;
+
+typedef struct _HsaClockCounters {
+  HSAuint64 GPUClockCounter;
+  HSAuint64 CPUClockCounter;
+  HSAuint64 SystemClockCounter;
+  HSAuint64 SystemClockFrequencyHz;
+} HsaClockCounters;
+
+//===----------------------------------------------------------------------===//
+// Entry points.                                                              //
+//===----------------------------------------------------------------------===//
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtOpenKFD(void);
+HSAKMT_STATUS HSAKMTAPI hsaKmtCloseKFD(void);
+HSAKMT_STATUS HSAKMTAPI hsaKmtGetVersion(HsaVersionInfo* VersionInfo);
+
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtAcquireSystemProperties(HsaSystemProperties* SystemProperties);
+HSAKMT_STATUS HSAKMTAPI hsaKmtReleaseSystemProperties(void);
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtGetNodeProperties(HSAuint32 NodeId, HsaNodeProperties* NodeProperties);
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtGetNodeMemoryProperties(HSAuint32 NodeId, HSAuint32 NumBanks,
+                              HsaMemoryProperties* MemoryProperties);
+HSAKMT_STATUS HSAKMTAPI
+hsaKmtGetNodeCacheProperties(HSAuint32 NodeId, HSAuint32 ProcessorId,
+                             HSAuint32 NumCaches,
+                             HsaCacheProperties* CacheProperties);
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtCreateEvent(HsaEventDescriptor* EventDesc,
+                                          bool ManualReset, bool IsSignaled,
+                                          HsaEvent** Event);
+HSAKMT_STATUS HSAKMTAPI hsaKmtDestroyEvent(HsaEvent* Event);
+HSAKMT_STATUS HSAKMTAPI hsaKmtSetEvent(HsaEvent* Event);
+HSAKMT_STATUS HSAKMTAPI hsaKmtWaitOnEvent(HsaEvent* Event,
+                                          HSAuint32 Milliseconds);
+HSAKMT_STATUS HSAKMTAPI hsaKmtWaitOnMultipleEvents(HsaEvent* Events[],
+                                                   HSAuint32 NumEvents,
+                                                   bool WaitOnAll,
+                                                   HSAuint32 Milliseconds);
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtCreateQueue(
+    HSAuint32 NodeId, HSA_QUEUE_TYPE Type, HSAuint32 QueuePercentage,
+    HSA_QUEUE_PRIORITY Priority, void* QueueAddress, HSAuint64 QueueSizeInBytes,
+    HsaEvent* Event, HsaQueueResource* QueueResource);
+HSAKMT_STATUS HSAKMTAPI hsaKmtDestroyQueue(HSA_QUEUEID QueueId);
+HSAKMT_STATUS HSAKMTAPI hsaKmtSetQueueCUMask(HSA_QUEUEID QueueId,
+                                             HSAuint32 CUMaskCount,
+                                             HSAuint32* QueueCUMask);
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtSetMemoryPolicy(HSAuint32 Node,
+                                              HSAuint32 DefaultPolicy,
+                                              HSAuint32 AlternatePolicy,
+                                              void* MemoryAddressAlternate,
+                                              HSAuint64 MemorySizeInBytes);
+HSAKMT_STATUS HSAKMTAPI hsaKmtAllocMemory(HSAuint32 PreferredNode,
+                                          HSAuint64 SizeInBytes,
+                                          HsaMemFlags MemFlags,
+                                          void** MemoryAddress);
+HSAKMT_STATUS HSAKMTAPI hsaKmtFreeMemory(void* MemoryAddress,
+                                         HSAuint64 SizeInBytes);
+HSAKMT_STATUS HSAKMTAPI hsaKmtRegisterMemory(void* MemoryAddress,
+                                             HSAuint64 MemorySizeInBytes);
+HSAKMT_STATUS HSAKMTAPI hsaKmtDeregisterMemory(void* MemoryAddress);
+HSAKMT_STATUS HSAKMTAPI hsaKmtMapMemoryToGPU(void* MemoryAddress,
+                                             HSAuint64 MemorySizeInBytes,
+                                             HSAuint64* AlternateVAGPU);
+HSAKMT_STATUS HSAKMTAPI hsaKmtUnmapMemoryToGPU(void* MemoryAddress);
+
+HSAKMT_STATUS HSAKMTAPI hsaKmtGetClockCounters(HSAuint32 NodeId,
+                                               HsaClockCounters* Counters);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // HSA_RUNTIME_CORE_TOOLS_HSAKMT_EMU_INCLUDE_HSAKMT_H_
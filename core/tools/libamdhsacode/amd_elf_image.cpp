@@ -145,7 +145,8 @@ namespace amd {
 
     bool FileImage::create()
     {
-      d = amd::hsa::OpenTempFile("amdelf");
+      d = amd::hsa::OpenMemoryFile("amdelf");
+      if (d < 0) { d = amd::hsa::OpenTempFile("amdelf"); }
       if (d < 0) { return error("Failed to open temporary file for elf image"); }
       return true;
     }
@@ -228,11 +229,22 @@ namespace amd {
       long size;
       if ((size = _lseek(d, 0L, SEEK_CUR)) < 0) { return perror("lseek(2) failed"); }
       if (_lseek(d, 0L, SEEK_SET) < 0) { return perror("lseek(3) failed"); }
-      char* buffer = (char*)malloc(size);
-      if (_read(d, buffer, size) < 0) { return perror("read failed"); }
-      std::ofstream out(filename.c_str(), std::ios::binary);
-      out.write(buffer, size);
-      free(buffer);
+      std::ofstream file(filename.c_str(), std::ios::binary);
+      if (file.fail()) { return error("Failed to open output file"); }
+      size_t mapped_size = 0;
+      const void* mapped = amd::hsa::MapFile(d, &mapped_size);
+      if (mapped && mapped_size >= (size_t) size) {
+        file.write((const char*) mapped, size);
+        amd::hsa::UnmapFile(mapped, mapped_size);
+      } else {
+        if (mapped) { amd::hsa::UnmapFile(mapped, mapped_size); }
+        char* buffer = (char*)malloc(size);
+        if (_read(d, buffer, size) != size) { free(buffer); return perror("read failed"); }
+        file.write(buffer, size);
+        free(buffer);
+      }
+      file.close();
+      if (file.fail()) { return error("Failed to write output file"); }
       return true;
     }
 
@@ -579,6 +591,7 @@ namespace amd {
       FileImage img;
       const char* buffer;
       size_t bufferSize;
+      std::unique_ptr<char[]> ownedBuffer;
       Elf* e;
       GElf_Ehdr ehdr;
       GElfStringTable* shstrtabSection;
@@ -1092,10 +1105,11 @@ namespace amd {
     bool GElfImage::initFromBuffer(const void* buffer, size_t size)
     {
       if (size == 0) { size = ElfSize(buffer); }
-      if (!img.create()) { return imgError(); }
-      if (!img.copyFrom(buffer, size)) { return imgError(); }
-      if (!elfBegin(ELF_C_RDWR)) { return false; }
-      return pullElf();
+      // Parse a private copy in place, the caller may release its buffer
+      // while this image is alive.
+      ownedBuffer.reset(new char[size]);
+      memcpy(ownedBuffer.get(), buffer, size);
+      return initAsBuffer(ownedBuffer.get(), size);
     }
 
     bool GElfImage::initAsBuffer(const void* buffer, size_t size)
@@ -1335,27 +1349,46 @@ namespace amd {
 
     uint64_t ElfSize(const void* emi)
     {
-      const Elf64_Ehdr *ehdr = (const Elf64_Ehdr*) emi;
-      if (NULL == ehdr || EV_CURRENT != ehdr->e_version) {
+      return ElfSize(emi, UINT64_MAX);
+    }
+
+    // Checks that count entries of entry_size bytes at offset end within
+    // max_size, and extends end to cover them.
+    static bool FitTable(uint64_t offset, uint64_t count, uint64_t entry_size,
+                         uint64_t max_size, uint64_t& end)
+    {
+      if (offset > max_size || count > (max_size - offset) / entry_size) {
         return false;
       }
+      end = std::max(end, offset + count * entry_size);
+      return true;
+    }
 
-      const Elf64_Shdr *shdr = (const Elf64_Shdr*)((char*)emi + ehdr->e_shoff);
-      if (NULL == shdr) {
-        return false;
+    uint64_t ElfSize(const void* emi, uint64_t max_size)
+    {
+      const Elf64_Ehdr *ehdr = (const Elf64_Ehdr*) emi;
+      if (NULL == ehdr || max_size < sizeof(Elf64_Ehdr) ||
+          0 != memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+          ELFCLASS64 != ehdr->e_ident[EI_CLASS] ||
+          EV_CURRENT != ehdr->e_version) {
+        return 0;
+      }
+      if ((0 != ehdr->e_shnum && sizeof(Elf64_Shdr) != ehdr->e_shentsize) ||
+          (0 != ehdr->e_phnum && sizeof(Elf64_Phdr) != ehdr->e_phentsize)) {
+        return 0;
       }
 
-      uint64_t max_offset = ehdr->e_shoff;
-      uint64_t total_size = max_offset + ehdr->e_shentsize * ehdr->e_shnum;
+      uint64_t total_size = sizeof(Elf64_Ehdr);
+      if (!FitTable(ehdr->e_shoff, ehdr->e_shnum, sizeof(Elf64_Shdr), max_size, total_size) ||
+          !FitTable(ehdr->e_phoff, ehdr->e_phnum, sizeof(Elf64_Phdr), max_size, total_size)) {
+        return 0;
+      }
 
+      const Elf64_Shdr *shdr = (const Elf64_Shdr*)((const char*)emi + ehdr->e_shoff);
       for (uint16_t i = 0; i < ehdr->e_shnum; ++i) {
-        uint64_t cur_offset = static_cast<uint64_t>(shdr[i].sh_offset);
-        if (max_offset < cur_offset) {
-          max_offset = cur_offset;
-          total_size = max_offset;
-          if (SHT_NOBITS != shdr[i].sh_type) {
-            total_size += static_cast<uint64_t>(shdr[i].sh_size);
-          }
+        if (SHT_NOBITS != shdr[i].sh_type &&
+            !FitTable(shdr[i].sh_offset, shdr[i].sh_size, 1, max_size, total_size)) {
+          return 0;
         }
       }
 
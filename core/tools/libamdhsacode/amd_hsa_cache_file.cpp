@@ -0,0 +1,92 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#include "amd_hsa_cache_file.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+#if defined(_WIN32) || defined(_WIN64)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif // _WIN32 || _WIN64
+
+namespace amd {
+namespace hsa {
+namespace common {
+
+bool ReadCacheFile(const std::string &path, std::string *data)
+{
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in) { return false; }
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  *data = contents.str();
+  return true;
+}
+
+bool WriteCacheFile(const std::string &path, const std::string &data)
+{
+  // Process and thread ids keep temporaries of concurrent writers apart.
+  std::ostringstream temp_path;
+  temp_path << path << "." << getpid() << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+  {
+    std::ofstream out(temp_path.str().c_str(), std::ios::binary | std::ios::trunc);
+    if (!out) { return false; }
+    out.write(data.data(), data.size());
+    if (!out) {
+      out.close();
+      remove(temp_path.str().c_str());
+      return false;
+    }
+  }
+  if (0 != rename(temp_path.str().c_str(), path.c_str())) {
+    remove(temp_path.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+}
+}
+}
@@ -0,0 +1,151 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef AMD_HSA_CACHE_FILE_HPP_
+#define AMD_HSA_CACHE_FILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace amd {
+namespace hsa {
+namespace common {
+
+//===----------------------------------------------------------------------===//
+// CacheRecordWriter, CacheRecordReader.                                      //
+//===----------------------------------------------------------------------===//
+
+// Flat binary records of on-disk caches. Values are stored in host layout,
+// caches are only read back on the machine that wrote them and guard layout
+// changes with their own version field.
+class CacheRecordWriter {
+public:
+  template <typename T>
+  void Put(const T &value) {
+    data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  void PutBool(bool value) { Put(uint8_t(value ? 1 : 0)); }
+
+  template <typename T>
+  void PutVector(const std::vector<T> &values) {
+    Put(uint32_t(values.size()));
+    if (!values.empty()) {
+      data_.append(reinterpret_cast<const char*>(&values[0]), values.size() * sizeof(T));
+    }
+  }
+
+  void PutString(const std::string &s) {
+    Put(uint32_t(s.size()));
+    data_.append(s);
+  }
+
+  const std::string& data() const { return data_; }
+
+private:
+  std::string data_;
+};
+
+// Reads records written by CacheRecordWriter. Every Get fails rather than
+// reading past the end, a truncated or corrupt file then simply misses.
+class CacheRecordReader {
+public:
+  explicit CacheRecordReader(const std::string &data) : data_(data), pos_(0) {}
+
+  template <typename T>
+  bool Get(T *value) {
+    if (data_.size() - pos_ < sizeof(T)) { return false; }
+    memcpy(value, data_.data() + pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return true;
+  }
+
+  // Bools are stored as one byte each, anything but 0 or 1 is corrupt.
+  bool GetBool(bool *value) {
+    uint8_t byte;
+    if (!Get(&byte) || byte > 1) { return false; }
+    *value = 1 == byte;
+    return true;
+  }
+
+  template <typename T>
+  bool GetVector(std::vector<T> *values) {
+    uint32_t count;
+    if (!Get(&count) || (data_.size() - pos_) / sizeof(T) < count) { return false; }
+    values->resize(count);
+    if (count != 0) { memcpy(&(*values)[0], data_.data() + pos_, count * sizeof(T)); }
+    pos_ += count * sizeof(T);
+    return true;
+  }
+
+  bool GetString(std::string *s) {
+    uint32_t size;
+    if (!Get(&size) || data_.size() - pos_ < size) { return false; }
+    s->assign(data_.data() + pos_, size);
+    pos_ += size;
+    return true;
+  }
+
+  bool AtEnd() const { return pos_ == data_.size(); }
+
+private:
+  const std::string &data_;
+  size_t pos_;
+};
+
+//===----------------------------------------------------------------------===//
+// Cache files.                                                               //
+//===----------------------------------------------------------------------===//
+
+// Reads the whole file at path. Returns false if it can not be read.
+bool ReadCacheFile(const std::string &path, std::string *data);
+
+// Writes data to a temporary file next to path and renames it into place, so
+// concurrent readers and writers sharing a directory see either a complete
+// file or none. Returns false and leaves no temporary behind on failure.
+bool WriteCacheFile(const std::string &path, const std::string &data);
+
+}
+}
+}
+
+#endif // AMD_HSA_CACHE_FILE_HPP_
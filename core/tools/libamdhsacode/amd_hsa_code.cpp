@@ -42,6 +42,7 @@ mes of its
 #include <iomanip>
 #include "amd_hsa_code.hpp"
 #include "amd_hsa_code_util.hpp"
+#include "amd_hsa_hash.hpp"
 #include <libelf.h>
 #include "amd_hsa_elf.h"
 #include <fstream>
@@ -927,30 +928,150 @@ namespace code {
       }
     }
 
-      AmdHsaCode* AmdHsaCodeManager::FromHandle(hsa_code_object_t c)
+      static uint64_t ContentHash(const void* buffer, size_t size)
+      {
+        return common::Fnv1a().Words(buffer, size).Word(size).Value();
+      }
+
+      AmdHsaCodeManager::AmdHsaCodeManager()
+        : contentCache(false)
       {
-        CodeMap::iterator i = codeMap.find(c.handle);
-        if (i == codeMap.end()) {
-          AmdHsaCode* code = new AmdHsaCode();
-          const void* buffer = reinterpret_cast<const void*>(c.handle);
-          if (!code->InitAsBuffer(buffer, 0)) {
+        const char* cache = getenv("HSA_CODE_OBJECT_CONTENT_CACHE");
+        if (cache && 0 == strcmp(cache, "1")) {
+          contentCache.store(true, std::memory_order_relaxed);
+        }
+      }
+
+      AmdHsaCodeManager::~AmdHsaCodeManager()
+      {
+        for (size_t s = 0; s < kShardCount; ++s) {
+          for (CodeMap::value_type& entry : shards[s].codeMap) {
+            Release(entry.second);
+          }
+        }
+      }
+
+      AmdHsaCodeManager::Shard& AmdHsaCodeManager::ShardOf(uint64_t handle)
+      {
+        // Code objects are at least 16 byte aligned, drop the zero bits.
+        return shards[(handle >> 4) % kShardCount];
+      }
+
+      AmdHsaCode* AmdHsaCodeManager::Parse(hsa_code_object_t c)
+      {
+        AmdHsaCode* code = new AmdHsaCode();
+        const void* buffer = reinterpret_cast<const void*>(c.handle);
+        if (!code->InitAsBuffer(buffer, 0)) {
+          delete code;
+          return 0;
+        }
+        return code;
+      }
+
+      AmdHsaCode* AmdHsaCodeManager::ParseShared(hsa_code_object_t c)
+      {
+        const void* buffer = reinterpret_cast<const void*>(c.handle);
+        size_t size = amd::elf::ElfSize(buffer);
+        if (0 == size) { return 0; }
+        uint64_t hash = ContentHash(buffer, size);
+
+        {
+          std::lock_guard<std::mutex> lock(contentLock);
+          ContentMap::iterator i = contentMap.find(hash);
+          if (i != contentMap.end()) {
+            for (SharedCode& shared : i->second) {
+              if (shared.code->ElfSize() == size &&
+                  0 == memcmp(shared.code->ElfData(), buffer, size)) {
+                shared.refs++;
+                return shared.code;
+              }
+            }
+          }
+        }
+
+        // The shared representation may outlive this buffer, parse a copy.
+        AmdHsaCode* code = new AmdHsaCode();
+        if (!code->InitFromBuffer(buffer, size)) {
+          delete code;
+          return 0;
+        }
+
+        std::lock_guard<std::mutex> lock(contentLock);
+        std::vector<SharedCode>& bucket = contentMap[hash];
+        for (SharedCode& shared : bucket) {
+          if (shared.code->ElfSize() == size &&
+              0 == memcmp(shared.code->ElfData(), buffer, size)) {
+            // Another thread parsed the same contents first.
             delete code;
-            return 0;
+            shared.refs++;
+            return shared.code;
+          }
+        }
+        SharedCode shared = { code, 1 };
+        bucket.push_back(shared);
+        contentHashes[code] = hash;
+        return code;
+      }
+
+      void AmdHsaCodeManager::Release(AmdHsaCode* code)
+      {
+        {
+          std::lock_guard<std::mutex> lock(contentLock);
+          std::unordered_map<AmdHsaCode*, uint64_t>::iterator h = contentHashes.find(code);
+          if (h != contentHashes.end()) {
+            ContentMap::iterator i = contentMap.find(h->second);
+            assert(i != contentMap.end());
+            for (std::vector<SharedCode>::iterator j = i->second.begin(); j != i->second.end(); ++j) {
+              if (j->code != code) { continue; }
+              if (0 != --j->refs) { return; }
+              i->second.erase(j);
+              break;
+            }
+            if (i->second.empty()) { contentMap.erase(i); }
+            contentHashes.erase(h);
           }
-          codeMap[c.handle] = code;
-          return code;
         }
-        return i->second;
+        delete code;
+      }
+
+      AmdHsaCode* AmdHsaCodeManager::FromHandle(hsa_code_object_t c)
+      {
+        Shard& shard = ShardOf(c.handle);
+        {
+          amd::hsa::common::ReaderLockGuard<amd::hsa::common::ReaderWriterLock> reader_lock(shard.lock);
+          CodeMap::iterator i = shard.codeMap.find(c.handle);
+          if (i != shard.codeMap.end()) {
+            return i->second;
+          }
+        }
+
+        AmdHsaCode* code = contentCache.load(std::memory_order_relaxed) ? ParseShared(c) : Parse(c);
+        if (!code) { return 0; }
+
+        amd::hsa::common::WriterLockGuard<amd::hsa::common::ReaderWriterLock> writer_lock(shard.lock);
+        std::pair<CodeMap::iterator, bool> inserted = shard.codeMap.insert(std::make_pair(c.handle, code));
+        if (!inserted.second) {
+          // Another thread got here first, keep its representation.
+          Release(code);
+        }
+        return inserted.first->second;
       }
 
       bool AmdHsaCodeManager::Destroy(hsa_code_object_t c)
       {
-        CodeMap::iterator i = codeMap.find(c.handle);
-        if (i == codeMap.end()) {
-          // Currently, we do not always create map entry for every code object buffer.
-          return true;
+        Shard& shard = ShardOf(c.handle);
+        AmdHsaCode* code = 0;
+        {
+          amd::hsa::common::WriterLockGuard<amd::hsa::common::ReaderWriterLock> writer_lock(shard.lock);
+          CodeMap::iterator i = shard.codeMap.find(c.handle);
+          if (i == shard.codeMap.end()) {
+            // Currently, we do not always create map entry for every code object buffer.
+            return true;
+          }
+          code = i->second;
+          shard.codeMap.erase(i);
         }
-        codeMap.erase(i);
+        Release(code);
         return true;
       }
 }
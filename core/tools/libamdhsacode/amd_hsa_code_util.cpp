@@ -41,6 +41,7 @@ mes of its
 #include <fstream>
 #include <cstring>
 #include <iomanip>
+#include <cerrno>
 #ifdef _WIN32
 #include <Windows.h>
 #include <io.h>
@@ -50,6 +51,8 @@ mes of its
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #endif // _WIN32
 
@@ -76,7 +79,7 @@ namespace common {
 bool IsAccessibleMemoryAddress(uint64_t address)
 {
   if (0 == address) {
-    return nullptr;
+    return false;
   }
 #if defined(_WIN32) || defined(_WIN64)
     MEMORY_BASIC_INFORMATION memory_info;
@@ -796,6 +799,64 @@ void CloseTempFile(int fd)
   _close(fd);
 }
 
+int OpenMemoryFile(const char* prefix)
+{
+#if defined(__linux__) && defined(SYS_memfd_create)
+  // MFD_CLOEXEC, not defined by older glibc headers.
+  return (int) syscall(SYS_memfd_create, prefix, 0x0001U);
+#else
+  return -1;
+#endif
+}
+
+const void* MapFile(int fd, size_t* size)
+{
+#ifdef _WIN32
+  return NULL;
+#else // _WIN32
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size <= 0) { return NULL; }
+  void* ptr = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (ptr == MAP_FAILED) { return NULL; }
+  *size = (size_t) st.st_size;
+  return ptr;
+#endif // _WIN32
+}
+
+void UnmapFile(const void* ptr, size_t size)
+{
+#ifndef _WIN32
+  munmap(const_cast<void*>(ptr), size);
+#endif // _WIN32
+}
+
+bool IsFileSizeSealed(int fd)
+{
+#if defined(__linux__) && defined(F_GET_SEALS)
+  int seals = fcntl(fd, F_GET_SEALS);
+  return seals >= 0 && (seals & F_SEAL_SHRINK) != 0;
+#else
+  return false;
+#endif
+}
+
+bool ReadFileIntoBuffer(int fd, size_t size, std::vector<char>& buffer)
+{
+#ifdef _WIN32
+  return false;
+#else // _WIN32
+  buffer.resize(size);
+  size_t offset = 0;
+  while (offset < size) {
+    ssize_t n = pread(fd, buffer.data() + offset, size - offset, (off_t) offset);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n <= 0) { return false; }
+    offset += (size_t) n;
+  }
+  return true;
+#endif // _WIN32
+}
+
 
 }
 }
@@ -80,6 +80,23 @@ bool ReadFileIntoBuffer(const std::string& filename, std::vector<char>& buffer);
 int OpenTempFile(const char* prefix);
 void CloseTempFile(int fd);
 
+// Create new empty anonymous file backed by memory only. Returns -1 if not
+// supported by the host, callers should fall back to OpenTempFile.
+int OpenMemoryFile(const char* prefix);
+
+// Map whole file read-only into memory. Returns NULL on failure or if file
+// is empty. Mapping stays valid after fd is closed.
+const void* MapFile(int fd, size_t* size);
+void UnmapFile(const void* ptr, size_t size);
+
+// Returns true if fd is sealed against shrinking, so a mapping of it cannot
+// fault past the end of the file.
+bool IsFileSizeSealed(int fd);
+
+// Read the first size bytes of fd into buffer, independent of the file
+// position. Returns false if fewer bytes could be read.
+bool ReadFileIntoBuffer(int fd, size_t size, std::vector<char>& buffer);
+
 // Helper function that allocates an aligned memory.
 inline void*
 alignedMalloc(size_t size, size_t alignment)
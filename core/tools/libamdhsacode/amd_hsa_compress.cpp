@@ -0,0 +1,275 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#include "amd_hsa_compress.hpp"
+
+#include <cstring>
+#include <vector>
+
+namespace amd {
+namespace hsa {
+namespace code {
+
+namespace {
+
+const size_t kMinMatch = 4;
+// The format requires the last 5 bytes to be literals and the last match to
+// start at least 12 bytes before the end of the input.
+const size_t kLastLiterals = 5;
+const size_t kMatchStartLimit = 12;
+const size_t kMaxOffset = 65535;
+const unsigned kHashLog = 16;
+
+const char kContainerMagic[4] = { 'H', 'S', 'A', 'Z' };
+const uint32_t kContainerVersion = 1;
+
+uint32_t Read32(const uint8_t* p)
+{
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t Hash32(uint32_t value)
+{
+  return (value * 2654435761U) >> (32 - kHashLog);
+}
+
+// Writes the extra bytes of a length that does not fit in a token nibble.
+uint8_t* WriteLength(uint8_t* op, size_t length)
+{
+  for (; length >= 255; length -= 255) {
+    *op++ = 255;
+  }
+  *op++ = (uint8_t) length;
+  return op;
+}
+
+bool ReadLength(const uint8_t** ip, const uint8_t* iend, size_t* length)
+{
+  uint8_t byte;
+  do {
+    if (*ip >= iend) { return false; }
+    byte = *(*ip)++;
+    *length += byte;
+  } while (255 == byte);
+  return true;
+}
+
+// Emits one sequence, match_length 0 and offset 0 for the final literals.
+uint8_t* WriteSequence(uint8_t* op, uint8_t* oend,
+                       const uint8_t* literals, size_t literal_length,
+                       size_t offset, size_t match_length, bool last)
+{
+  size_t needed = 1 + literal_length + literal_length / 255 + 1;
+  if (!last) { needed += 2 + match_length / 255 + 1; }
+  if (needed > (size_t) (oend - op)) { return nullptr; }
+
+  uint8_t* token = op++;
+  if (literal_length >= 15) {
+    *token = 15 << 4;
+    op = WriteLength(op, literal_length - 15);
+  } else {
+    *token = (uint8_t) (literal_length << 4);
+  }
+  if (literal_length) { memcpy(op, literals, literal_length); }
+  op += literal_length;
+  if (last) { return op; }
+
+  *op++ = (uint8_t) (offset & 0xFF);
+  *op++ = (uint8_t) (offset >> 8);
+  if (match_length >= 15) {
+    *token |= 15;
+    op = WriteLength(op, match_length - 15);
+  } else {
+    *token |= (uint8_t) match_length;
+  }
+  return op;
+}
+
+}
+
+size_t Lz4CompressBound(size_t size)
+{
+  return size + size / 255 + 16;
+}
+
+size_t Lz4Compress(const void* src, size_t size, void* dst, size_t capacity)
+{
+  const uint8_t* base = (const uint8_t*) src;
+  const uint8_t* ip = base;
+  const uint8_t* anchor = base;
+  const uint8_t* iend = base + size;
+  uint8_t* op = (uint8_t*) dst;
+  uint8_t* oend = op + capacity;
+
+  if (size > kMatchStartLimit) {
+    const uint8_t* mflimit = iend - kMatchStartLimit;
+    const uint8_t* matchlimit = iend - kLastLiterals;
+    std::vector<uint32_t> table(size_t(1) << kHashLog, 0);
+
+    while (ip < mflimit) {
+      uint32_t sequence = Read32(ip);
+      uint32_t& slot = table[Hash32(sequence)];
+      const uint8_t* candidate = base + slot;
+      slot = uint32_t(ip - base);
+
+      if (candidate >= ip || size_t(ip - candidate) > kMaxOffset || Read32(candidate) != sequence) {
+        ++ip;
+        continue;
+      }
+
+      while (ip > anchor && candidate > base && ip[-1] == candidate[-1]) {
+        --ip;
+        --candidate;
+      }
+      const uint8_t* match_end = ip + kMinMatch;
+      const uint8_t* candidate_end = candidate + kMinMatch;
+      while (match_end < matchlimit && *match_end == *candidate_end) {
+        ++match_end;
+        ++candidate_end;
+      }
+
+      op = WriteSequence(op, oend, anchor, size_t(ip - anchor),
+                         size_t(ip - candidate), size_t(match_end - ip) - kMinMatch, false);
+      if (!op) { return 0; }
+      ip = match_end;
+      anchor = ip;
+    }
+  }
+
+  op = WriteSequence(op, oend, anchor, size_t(iend - anchor), 0, 0, true);
+  if (!op) { return 0; }
+  return size_t(op - (uint8_t*) dst);
+}
+
+bool Lz4Decompress(const void* src, size_t size, void* dst, size_t dst_size)
+{
+  const uint8_t* ip = (const uint8_t*) src;
+  const uint8_t* iend = ip + size;
+  uint8_t* const obase = (uint8_t*) dst;
+  uint8_t* op = obase;
+  uint8_t* const oend = obase + dst_size;
+
+  while (true) {
+    if (ip >= iend) { return false; }
+    uint8_t token = *ip++;
+
+    size_t literal_length = token >> 4;
+    if (15 == literal_length && !ReadLength(&ip, iend, &literal_length)) { return false; }
+    if (literal_length > size_t(iend - ip) || literal_length > size_t(oend - op)) { return false; }
+    if (literal_length) { memcpy(op, ip, literal_length); }
+    op += literal_length;
+    ip += literal_length;
+
+    if (ip == iend) { return op == oend; }
+
+    if (iend - ip < 2) { return false; }
+    size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8);
+    ip += 2;
+    if (0 == offset || offset > size_t(op - obase)) { return false; }
+
+    size_t match_length = token & 15;
+    if (15 == match_length && !ReadLength(&ip, iend, &match_length)) { return false; }
+    match_length += kMinMatch;
+    if (match_length > size_t(oend - op)) { return false; }
+
+    const uint8_t* match = op - offset;
+    if (offset >= match_length) {
+      memcpy(op, match, match_length);
+      op += match_length;
+    } else {
+      // Overlapping match, repeats the last offset bytes.
+      for (size_t i = 0; i < match_length; ++i) {
+        *op++ = *match++;
+      }
+    }
+  }
+}
+
+size_t CompressedCodeObjectBound(size_t size)
+{
+  return sizeof(CompressedCodeObjectHeader) + Lz4CompressBound(size);
+}
+
+size_t CompressCodeObject(const void* elf, size_t size, void* dst, size_t capacity)
+{
+  if (capacity < sizeof(CompressedCodeObjectHeader)) { return 0; }
+
+  uint8_t* out = (uint8_t*) dst;
+  size_t compressed_size = Lz4Compress(elf, size, out + sizeof(CompressedCodeObjectHeader),
+                                       capacity - sizeof(CompressedCodeObjectHeader));
+  if (0 == compressed_size) { return 0; }
+
+  CompressedCodeObjectHeader header;
+  memcpy(header.magic, kContainerMagic, sizeof(header.magic));
+  header.version = kContainerVersion;
+  header.size = size;
+  header.compressed_size = compressed_size;
+  memcpy(out, &header, sizeof(header));
+  return sizeof(header) + compressed_size;
+}
+
+bool IsCompressedCodeObject(const void* buffer, size_t size, uint64_t* elf_size)
+{
+  CompressedCodeObjectHeader header;
+  if (size < sizeof(header)) { return false; }
+  memcpy(&header, buffer, sizeof(header));
+  if (0 != memcmp(header.magic, kContainerMagic, sizeof(header.magic)) ||
+      kContainerVersion != header.version ||
+      header.compressed_size > size - sizeof(header)) {
+    return false;
+  }
+  *elf_size = header.size;
+  return true;
+}
+
+bool DecompressCodeObject(const void* buffer, size_t size, void* dst, size_t dst_size)
+{
+  uint64_t elf_size = 0;
+  if (!IsCompressedCodeObject(buffer, size, &elf_size) || elf_size != dst_size) { return false; }
+
+  CompressedCodeObjectHeader header;
+  memcpy(&header, buffer, sizeof(header));
+  return Lz4Decompress((const uint8_t*) buffer + sizeof(header), (size_t) header.compressed_size, dst, dst_size);
+}
+
+}
+}
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef AMD_HSA_COMPRESS_HPP_
+#define AMD_HSA_COMPRESS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace amd {
+namespace hsa {
+namespace code {
+
+//===----------------------------------------------------------------------===//
+// LZ4 block codec.                                                           //
+//===----------------------------------------------------------------------===//
+
+// Largest compressed size of size bytes of input.
+size_t Lz4CompressBound(size_t size);
+
+// Compresses src into an LZ4 block at dst. Returns the compressed size, 0 if
+// it does not fit in capacity bytes.
+size_t Lz4Compress(const void* src, size_t size, void* dst, size_t capacity);
+
+// Decompresses the LZ4 block src into dst. Returns false if the block is
+// malformed or does not decompress to exactly dst_size bytes.
+bool Lz4Decompress(const void* src, size_t size, void* dst, size_t dst_size);
+
+//===----------------------------------------------------------------------===//
+// Compressed code object container.                                          //
+//===----------------------------------------------------------------------===//
+
+// Header of a serialized code object holding an LZ4 compressed ELF image,
+// followed by compressed_size bytes of block data.
+struct CompressedCodeObjectHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t size;
+  uint64_t compressed_size;
+};
+
+// Largest container size for an ELF image of size bytes.
+size_t CompressedCodeObjectBound(size_t size);
+
+// Writes the container for the ELF image elf to dst. Returns the container
+// size, 0 if it does not fit in capacity bytes.
+size_t CompressCodeObject(const void* elf, size_t size, void* dst, size_t capacity);
+
+// Returns true if buffer holds a container and sets elf_size to the size of
+// the ELF image it holds.
+bool IsCompressedCodeObject(const void* buffer, size_t size, uint64_t* elf_size);
+
+// Decompresses the ELF image of a container straight into dst, which must
+// hold the elf_size bytes reported by IsCompressedCodeObject.
+bool DecompressCodeObject(const void* buffer, size_t size, void* dst, size_t dst_size);
+
+}
+}
+}
+
+#endif // AMD_HSA_COMPRESS_HPP_
@@ -0,0 +1,118 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef AMD_HSA_HASH_HPP_
+#define AMD_HSA_HASH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace amd {
+namespace hsa {
+namespace common {
+
+//===----------------------------------------------------------------------===//
+// Fnv1a.                                                                     //
+//===----------------------------------------------------------------------===//
+
+// Streaming 64-bit FNV-1a, the hash for in-memory tables and cache file names.
+// Pieces fed one after another hash the same as their concatenation, except
+// that Words folds whole 8-byte words in one step for bulk contents.
+class Fnv1a {
+public:
+  Fnv1a() : hash_(0xcbf29ce484222325ULL) {}
+
+  Fnv1a& Bytes(const void *data, size_t size) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) { Step(bytes[i]); }
+    return *this;
+  }
+
+  Fnv1a& String(const char *s) {
+    for (; *s; ++s) { Step((unsigned char) *s); }
+    return *this;
+  }
+
+  Fnv1a& Word(uint64_t value) {
+    Step(value);
+    return *this;
+  }
+
+  Fnv1a& Words(const void *data, size_t size) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      uint64_t word;
+      memcpy(&word, bytes + i, sizeof(word));
+      Step(word);
+    }
+    return Bytes(bytes + i, size - i);
+  }
+
+  uint64_t Value() const { return hash_; }
+
+private:
+  void Step(uint64_t value) { hash_ = (hash_ ^ value) * 0x100000001b3ULL; }
+
+  uint64_t hash_;
+};
+
+//===----------------------------------------------------------------------===//
+// SHA-256.                                                                   //
+//===----------------------------------------------------------------------===//
+
+// SHA-256 digest, used where contents are trusted by their hash, e.g. to key
+// persistent caches.
+struct Sha256Digest {
+  uint8_t bytes[32];
+
+  bool operator==(const Sha256Digest &other) const {
+    return 0 == memcmp(bytes, other.bytes, sizeof(bytes));
+  }
+  bool operator!=(const Sha256Digest &other) const { return !(*this == other); }
+};
+
+Sha256Digest Sha256(const void *data, size_t size);
+
+}
+}
+}
+
+#endif // AMD_HSA_HASH_HPP_
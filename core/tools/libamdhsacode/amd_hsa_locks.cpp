@@ -39,51 +39,77 @@ mes of its
 
 #include "amd_hsa_locks.hpp"
 
+#include <thread>
+
 namespace amd {
 namespace hsa {
 namespace common {
 
 void ReaderWriterLock::ReaderLock()
 {
-  internal_lock_.lock();
-  while (0 < writers_count_) {
-    readers_condition_.wait(internal_lock_);
+  while (true) {
+    if (0 == (state_.fetch_add(1, std::memory_order_acquire) & kWriter)) {
+      return;
+    }
+    // A writer holds the lock, step aside until it is done. A writer that only
+    // waits does not stop readers, so a thread already holding the lock can
+    // take it again.
+    ReaderUnlock();
+    Wait([this]() { return 0 == (state_.load(std::memory_order_acquire) & kWriter); });
   }
-  readers_count_ += 1;
-  internal_lock_.unlock();
 }
 
 void ReaderWriterLock::ReaderUnlock()
 {
-  internal_lock_.lock();
-  readers_count_ -= 1;
-  if (0 == readers_count_ && 0 < writers_waiting_) {
-    writers_condition_.notify_one();
+  uint32_t state = state_.fetch_sub(1, std::memory_order_release);
+  if (1 == (state & kReaders) && 0 != (state & kWriterWaiting)) {
+    // Last reader out while a writer is waiting.
+    Wake();
   }
-  internal_lock_.unlock();
 }
 
 void ReaderWriterLock::WriterLock()
 {
-  internal_lock_.lock();
-  writers_waiting_ += 1;
-  while (0 < readers_count_ || 0 < writers_count_) {
-    writers_condition_.wait(internal_lock_);
+  writers_lock_.lock();
+  state_.fetch_or(kWriterWaiting, std::memory_order_relaxed);
+  while (true) {
+    uint32_t expected = kWriterWaiting;
+    if (state_.compare_exchange_strong(expected, kWriter, std::memory_order_acquire)) {
+      return;
+    }
+    Wait([this]() { return 0 == (state_.load(std::memory_order_acquire) & kReaders); });
   }
-  writers_count_ += 1;
-  writers_waiting_ -= 1;
-  internal_lock_.unlock();
 }
 
 void ReaderWriterLock::WriterUnlock()
 {
-  internal_lock_.lock();
-  writers_count_ -= 1;
-  if (0 < writers_waiting_) {
-    writers_condition_.notify_one();
+  state_.fetch_and(~kWriter, std::memory_order_release);
+  writers_lock_.unlock();
+  Wake();
+}
+
+template<typename Predicate>
+void ReaderWriterLock::Wait(Predicate predicate)
+{
+  static const int kSpinCount = 64;
+  for (int i = 0; i < kSpinCount; ++i) {
+    if (predicate()) {
+      return;
+    }
+    std::this_thread::yield();
   }
-  readers_condition_.notify_all();
-  internal_lock_.unlock();
+
+  std::unique_lock<std::mutex> lock(wait_lock_);
+  while (!predicate()) {
+    wait_condition_.wait(lock);
+  }
+}
+
+void ReaderWriterLock::Wake()
+{
+  // Taking wait_lock_ orders the state change before a sleeper's last check.
+  std::lock_guard<std::mutex> lock(wait_lock_);
+  wait_condition_.notify_all();
 }
 
 } // namespace common
@@ -40,8 +40,10 @@ mes of its
 #ifndef AMD_HSA_LOCKS_HPP
 #define AMD_HSA_LOCKS_HPP
 
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <mutex>
 
 namespace amd {
@@ -90,10 +92,15 @@ private:
   LockType &lock_;
 };
 
+// Reader/writer lock. Uncontended readers only touch an atomic reader count;
+// the mutex and condition variable are used only to sleep while a writer
+// holds the lock or waits for readers to leave. Readers are only held back by
+// a writer holding the lock, so a reader may take the lock again while a
+// writer waits, at the cost of writers waiting out a stream of readers.
 class ReaderWriterLock final {
 public:
   ReaderWriterLock():
-    readers_count_(0), writers_count_(0), writers_waiting_(0) {}
+    state_(0) {}
 
   ~ReaderWriterLock() {}
 
@@ -109,12 +116,21 @@ private:
   ReaderWriterLock(const ReaderWriterLock&);
   ReaderWriterLock& operator=(const ReaderWriterLock&);
 
-  size_t readers_count_;
-  size_t writers_count_;
-  size_t writers_waiting_;
-  std::mutex internal_lock_;
-  std::condition_variable_any readers_condition_;
-  std::condition_variable_any writers_condition_;
+  // The top bit is set while a writer holds the lock, the next one while a
+  // writer waits for readers to leave, and the remaining bits count readers.
+  static const uint32_t kWriter = 0x80000000;
+  static const uint32_t kWriterWaiting = 0x40000000;
+  static const uint32_t kReaders = kWriterWaiting - 1;
+
+  template<typename Predicate>
+  void Wait(Predicate predicate);
+
+  void Wake();
+
+  std::atomic<uint32_t> state_;
+  std::mutex writers_lock_;
+  std::mutex wait_lock_;
+  std::condition_variable wait_condition_;
 };
 
 } // namespace common
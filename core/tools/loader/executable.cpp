@@ -40,6 +40,7 @@ mes of its
 #include "executable.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstring>
 #include <iostream>
@@ -58,6 +59,81 @@ namespace loader {
 std::vector<Executable*> Executable::executables;
 std::mutex Executable::executables_mutex;
 
+namespace {
+
+// Returns the first failure in code object order so errors do not depend on
+// thread scheduling.
+hsa_status_t FirstError(const std::vector<hsa_status_t> &statuses)
+{
+  for (hsa_status_t status : statuses) {
+    if (status != HSA_STATUS_SUCCESS) { return status; }
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+// Segments receiving fewer relocations are patched in place.
+const size_t kShadowMinRelocations = 2;
+
+// Segment data is copied in chunks of this size so a single large code
+// segment is spread over all load threads.
+const size_t kParallelCopyChunk = 1024 * 1024;
+
+// Creates a defined kernel symbol at address. The attributes are read from
+// akc, the kernel descriptor in the code object image, since the copy at
+// address may still be uploading.
+KernelSymbol* NewKernelSymbol(const std::string &name, hsa_symbol_linkage_t linkage, uint32_t size, uint64_t address, const amd_kernel_code_t *akc)
+{
+  assert(akc);
+
+  uint32_t kernarg_segment_size =
+    uint32_t(akc->kernarg_segment_byte_size);
+  uint32_t kernarg_segment_alignment =
+    uint32_t(1 << akc->kernarg_segment_alignment);
+  uint32_t group_segment_size =
+    uint32_t(akc->workgroup_group_segment_byte_size);
+  uint32_t private_segment_size =
+    uint32_t(akc->workitem_private_segment_byte_size);
+  bool is_dynamic_callstack =
+    AMD_HSA_BITS_GET(akc->kernel_code_properties, AMD_KERNEL_CODE_PROPERTIES_IS_DYNAMIC_CALLSTACK) ? true : false;
+
+  return new KernelSymbol(true,
+                          name,
+                          linkage,
+                          true, // sym->IsDefinition()
+                          kernarg_segment_size,
+                          kernarg_segment_alignment,
+                          group_segment_size,
+                          private_segment_size,
+                          is_dynamic_callstack,
+                          size,
+                          256,
+                          address);
+}
+
+// Writes a resolved address for an address relocation. Returns false for
+// other relocation types.
+bool PatchAddress(Segment *rseg, uint64_t reladdr, uint32_t type, uint64_t addr)
+{
+  uint32_t addr32 = 0;
+  switch (type) {
+  case R_AMDGPU_32_HIGH:
+    addr32 = uint32_t((addr >> 32) & 0xFFFFFFFF);
+    rseg->Copy(reladdr, &addr32, sizeof(addr32));
+    return true;
+  case R_AMDGPU_32_LOW:
+    addr32 = uint32_t(addr & 0xFFFFFFFF);
+    rseg->Copy(reladdr, &addr32, sizeof(addr32));
+    return true;
+  case R_AMDGPU_64:
+    rseg->Copy(reladdr, &addr, sizeof(addr));
+    return true;
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
 Executable* Executable::Create(
   hsa_profile_t profile, Context *context, const char *options)
 {
@@ -455,15 +531,237 @@ bool Segment::IsAddressInSegment(uint64_t addr)
 void Segment::Copy(uint64_t addr, const void* src, size_t size)
 {
   if (size > 0) {
+    if (!shadow.empty()) {
+      size_t offset = Offset(addr);
+      assert(offset + size <= shadow.size());
+      memcpy(shadow.data() + offset, src, size);
+      for (size_t byte = offset; byte < offset + size;) {
+        size_t bit = byte % 64;
+        size_t count = std::min(size_t(64) - bit, offset + size - byte);
+        uint64_t mask = (count == 64 ? ~uint64_t(0) : ((uint64_t(1) << count) - 1)) << bit;
+        shadow_dirty[byte / 64].fetch_or(mask, std::memory_order_relaxed);
+        byte += count;
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(pending_lock);
+      if (upload_pending) {
+        pending_writes.push_back(std::make_pair(addr, size));
+        pending_data.insert(pending_data.end(), (const char*) src, (const char*) src + size);
+        return;
+      }
+    }
     owner->context()->SegmentCopy(segment, agent, ptr, Offset(addr), src, size);
   }
 }
 
+bool Segment::CopyAsync(uint64_t addr, const void* src, size_t size)
+{
+  assert(!upload_pending);
+  if (size > 0) {
+    if (!owner->context()->SegmentCopyAsync(segment, agent, ptr, Offset(addr), src, size)) {
+      return false;
+    }
+  }
+  upload_pending = true;
+  return true;
+}
+
+void Segment::BeginShadow()
+{
+  assert(shadow.empty());
+  shadow.resize(size);
+  shadow_dirty.reset(new std::atomic<uint64_t>[(size + 63) / 64]());
+}
+
+void Segment::UploadShadow()
+{
+  std::vector<char> data;
+  data.swap(shadow);
+  auto dirty = [this](size_t byte) {
+    return (shadow_dirty[byte / 64].load(std::memory_order_relaxed) >> (byte % 64)) & 1;
+  };
+  for (size_t byte = 0; byte < size;) {
+    if (!dirty(byte)) {
+      if (byte % 64 == 0 && !shadow_dirty[byte / 64].load(std::memory_order_relaxed)) {
+        byte += 64;
+      } else {
+        ++byte;
+      }
+      continue;
+    }
+    size_t first = byte;
+    while (byte < size && dirty(byte)) {
+      ++byte;
+    }
+    Copy(vaddr + first, data.data() + first, byte - first);
+  }
+  shadow_dirty.reset();
+}
+
+void Segment::Flush()
+{
+  std::vector<std::pair<uint64_t, size_t>> writes;
+  std::vector<char> written;
+  {
+    std::lock_guard<std::mutex> lock(pending_lock);
+    upload_pending = false;
+    writes.swap(pending_writes);
+    written.swap(pending_data);
+  }
+  const char *data = written.data();
+  for (auto &write : writes) {
+    Copy(write.first, data, write.second);
+    data += write.second;
+  }
+}
+
 void Segment::Destroy()
 {
   owner->context()->SegmentFree(segment, agent, ptr, size);
 }
 
+//===----------------------------------------------------------------------===//
+// LazySymbolTable.                                                           //
+//===----------------------------------------------------------------------===//
+
+LazySymbolTable::LazySymbolTable(const void *elf_data, size_t elf_size, size_t capacity, size_t names_size)
+  : elf_data_(elf_data)
+  , elf_size_(elf_size)
+  , symbols_(new LazySymbol[capacity]())
+  , count_(0)
+  , capacity_(capacity)
+{
+  // Entries point into names_, it must never reallocate.
+  names_.reserve(names_size + capacity);
+}
+
+LazySymbolTable::~LazySymbolTable()
+{
+  for (size_t i = 0; i < count_; ++i) {
+    delete symbols_[i].symbol.load(std::memory_order_relaxed);
+  }
+}
+
+LazySymbol* LazySymbolTable::Add(const std::string &name)
+{
+  assert(count_ < capacity_);
+  assert(names_.size() + name.size() + 1 <= names_.capacity());
+  size_t offset = names_.size();
+  names_.insert(names_.end(), name.c_str(), name.c_str() + name.size() + 1);
+
+  LazySymbol *lazy = &symbols_[count_++];
+  lazy->table = this;
+  lazy->name = names_.data() + offset;
+  return lazy;
+}
+
+//===----------------------------------------------------------------------===//
+// SymbolIndex.                                                               //
+//===----------------------------------------------------------------------===//
+
+size_t SymbolIndex::Hash(const char *module_name, const char *symbol_name, uint64_t agent)
+{
+  // Hash of the mangled name, then the agent.
+  common::Fnv1a hash;
+  if (*module_name) {
+    hash.String(module_name).String("::");
+  }
+  uint64_t value = hash.String(symbol_name).Word(agent).Value();
+  return (size_t) (value ^ (value >> 32));
+}
+
+void SymbolIndex::Insert(const std::string &mangled_name, hsa_agent_t agent, SymbolImpl *symbol)
+{
+  assert(symbol);
+  Entry entry;
+  entry.hash = Hash("", mangled_name.c_str(), agent.handle);
+  entry.agent = agent.handle;
+  entry.name = mangled_name.c_str();
+  entry.name_length = mangled_name.size();
+  entry.symbol = symbol;
+  entry.lazy = nullptr;
+  Insert(entry);
+}
+
+void SymbolIndex::Insert(LazySymbol *lazy, hsa_agent_t agent)
+{
+  assert(lazy);
+  Entry entry;
+  entry.hash = Hash("", lazy->name, agent.handle);
+  entry.agent = agent.handle;
+  entry.name = lazy->name;
+  entry.name_length = strlen(lazy->name);
+  entry.symbol = nullptr;
+  entry.lazy = lazy;
+  Insert(entry);
+}
+
+void SymbolIndex::Insert(const Entry &entry)
+{
+  if (2 * (count_ + 1) > entries_.size()) {
+    Grow();
+  }
+
+  size_t mask = entries_.size() - 1;
+  size_t i = entry.hash & mask;
+  while (entries_[i].name) {
+    i = (i + 1) & mask;
+  }
+  entries_[i] = entry;
+  count_++;
+}
+
+const SymbolIndex::Entry* SymbolIndex::Find(const char *module_name, const char *symbol_name, hsa_agent_t agent) const
+{
+  if (0 == count_) {
+    return nullptr;
+  }
+
+  size_t hash = Hash(module_name, symbol_name, agent.handle);
+  size_t module_length = strlen(module_name);
+  size_t prefix_length = module_length ? module_length + 2 : 0;
+  size_t name_length = strlen(symbol_name);
+
+  size_t mask = entries_.size() - 1;
+  for (size_t i = hash & mask; entries_[i].name; i = (i + 1) & mask) {
+    const Entry &entry = entries_[i];
+    if (entry.hash != hash || entry.agent != agent.handle) {
+      continue;
+    }
+    if (entry.name_length != prefix_length + name_length) {
+      continue;
+    }
+    if (module_length &&
+        (0 != memcmp(entry.name, module_name, module_length) ||
+         0 != memcmp(entry.name + module_length, "::", 2))) {
+      continue;
+    }
+    if (0 == memcmp(entry.name + prefix_length, symbol_name, name_length)) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void SymbolIndex::Grow()
+{
+  std::vector<Entry> entries(entries_.empty() ? 64 : 2 * entries_.size());
+  size_t mask = entries.size() - 1;
+  for (const Entry &entry : entries_) {
+    if (!entry.name) {
+      continue;
+    }
+    size_t i = entry.hash & mask;
+    while (entries[i].name) {
+      i = (i + 1) & mask;
+    }
+    entries[i] = entry;
+  }
+  entries_.swap(entries);
+}
+
 //===----------------------------------------------------------------------===//
 // ExecutableImpl.                                                                //
 //===----------------------------------------------------------------------===//
@@ -474,11 +772,16 @@ ExecutableImpl::ExecutableImpl(const hsa_profile_t &_profile, Context *context,
   , context_(context)
   , id_(id)
   , state_(HSA_EXECUTABLE_STATE_UNFROZEN)
+  , frozen_(false)
   , program_allocation_segment(nullptr)
 {
 }
 
 ExecutableImpl::~ExecutableImpl() {
+  if (!uploading_segments_.empty()) {
+    context_->SegmentCopyWait();
+  }
+
   for (ExecutableObject* o : objects) {
     o->Destroy();
     delete o;
@@ -504,13 +807,12 @@ hsa_status_t ExecutableImpl::DefineProgramExternalVariable(
     return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
   }
 
-  auto symbol_entry = program_symbols_.find(std::string(name));
-  if (symbol_entry != program_symbols_.end()) {
+  hsa_agent_t program_agent = {0};
+  if (symbol_index_.Find("", name, program_agent)) {
     return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
   }
 
-  program_symbols_.insert(
-    std::make_pair(std::string(name),
+  AddProgramSymbol(std::string(name),
                    new VariableSymbol(true,
                                       std::string(name),
                                       HSA_SYMBOL_LINKAGE_PROGRAM,
@@ -521,7 +823,7 @@ hsa_status_t ExecutableImpl::DefineProgramExternalVariable(
                                       0,     // TODO: align.
                                       false, // TODO: const.
                                       true,
-                                      reinterpret_cast<uint64_t>(address))));
+                                      reinterpret_cast<uint64_t>(address)));
   return HSA_STATUS_SUCCESS;
 }
 
@@ -539,24 +841,22 @@ hsa_status_t ExecutableImpl::DefineAgentExternalVariable(
     return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
   }
 
-  auto symbol_entry = agent_symbols_.find(std::make_pair(std::string(name), agent));
-  if (symbol_entry != agent_symbols_.end()) {
+  if (symbol_index_.Find("", name, agent)) {
     return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
   }
 
-  agent_symbols_.insert(
-    std::make_pair(std::make_pair(std::string(name), agent),
-                   new VariableSymbol(true,
-                                      std::string(name),
-                                      HSA_SYMBOL_LINKAGE_PROGRAM,
-                                      true,
-                                      HSA_VARIABLE_ALLOCATION_AGENT,
-                                      segment,
-                                      0,     // TODO: size.
-                                      0,     // TODO: align.
-                                      false, // TODO: const.
-                                      true,
-                                      reinterpret_cast<uint64_t>(address))));
+  AddAgentSymbol(std::string(name), agent,
+                 new VariableSymbol(true,
+                                    std::string(name),
+                                    HSA_SYMBOL_LINKAGE_PROGRAM,
+                                    true,
+                                    HSA_VARIABLE_ALLOCATION_AGENT,
+                                    segment,
+                                    0,     // TODO: size.
+                                    0,     // TODO: align.
+                                    false, // TODO: const.
+                                    true,
+                                    reinterpret_cast<uint64_t>(address)));
   return HSA_STATUS_SUCCESS;
 }
 
@@ -566,7 +866,7 @@ Symbol* ExecutableImpl::GetSymbol(
   hsa_agent_t agent,
   int32_t call_convention)
 {
-  ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
+  ExecutableReaderGuard reader_lock(rw_lock_, frozen_);
   return this->GetSymbolInternal(module_name, symbol_name, agent, call_convention);
 }
 
@@ -579,35 +879,85 @@ Symbol* ExecutableImpl::GetSymbolInternal(
   assert(module_name);
   assert(symbol_name);
 
-  std::string mangled_name = std::string(symbol_name);
-  if (mangled_name.empty()) {
+  if (!*symbol_name) {
     return nullptr;
   }
-  if (!std::string(module_name).empty()) {
-    mangled_name.insert(0, "::");
-    mangled_name.insert(0, std::string(module_name));
+
+  // TODO(spec): this is not spec compliant. Program symbols are indexed under
+  // the null agent.
+  const SymbolIndex::Entry *entry = symbol_index_.Find(module_name, symbol_name, agent);
+  if (!entry) {
+    return nullptr;
   }
+  return entry->symbol ? entry->symbol : MaterializeSymbol(entry->lazy);
+}
 
-  // TODO(spec): this is not spec compliant.
-  if (!agent.handle) {
-    auto program_symbol = program_symbols_.find(mangled_name);
-    if (program_symbol != program_symbols_.end()) {
-      return program_symbol->second;
-    }
+SymbolImpl* ExecutableImpl::MaterializeSymbol(LazySymbol *lazy)
+{
+  SymbolImpl *symbol = lazy->symbol.load(std::memory_order_acquire);
+  if (symbol) {
+    return symbol;
+  }
+
+  if (HSA_SYMBOL_KIND_VARIABLE == lazy->kind) {
+    symbol = new VariableSymbol(true,
+                                lazy->name,
+                                lazy->linkage,
+                                true, // sym->IsDefinition()
+                                lazy->allocation,
+                                lazy->segment,
+                                lazy->size,
+                                lazy->alignment,
+                                lazy->is_const,
+                                false,
+                                lazy->address);
   } else {
-    auto agent_symbol = agent_symbols_.find(std::make_pair(mangled_name, agent));
-    if (agent_symbol != agent_symbols_.end()) {
-      return agent_symbol->second;
-    }
+    KernelSymbol *kernel_symbol = new KernelSymbol(true,
+                                                   lazy->name,
+                                                   lazy->linkage,
+                                                   true, // sym->IsDefinition()
+                                                   lazy->kernarg_segment_size,
+                                                   lazy->kernarg_segment_alignment,
+                                                   lazy->group_segment_size,
+                                                   lazy->private_segment_size,
+                                                   lazy->is_dynamic_callstack,
+                                                   lazy->size,
+                                                   256,
+                                                   lazy->address);
+    kernel_symbol->debug_info = lazy->debug_info;
+    symbol = kernel_symbol;
   }
 
-  return nullptr;
+  // Readers of a frozen executable get here without a lock, the first one to
+  // publish its symbol wins.
+  SymbolImpl *expected = nullptr;
+  if (!lazy->symbol.compare_exchange_strong(expected, symbol, std::memory_order_acq_rel)) {
+    delete symbol;
+    return expected;
+  }
+  return symbol;
+}
+
+void ExecutableImpl::AddProgramSymbol(const std::string &name, SymbolImpl* symbol)
+{
+  auto inserted = program_symbols_.insert(std::make_pair(name, symbol));
+  assert(inserted.second);
+  hsa_agent_t program_agent = {0};
+  symbol_index_.Insert(inserted.first->first, program_agent, symbol);
+}
+
+void ExecutableImpl::AddAgentSymbol(const std::string &name, hsa_agent_t agent, SymbolImpl* symbol)
+{
+  assert(agent.handle);
+  auto inserted = agent_symbols_.insert(std::make_pair(std::make_pair(name, agent), symbol));
+  assert(inserted.second);
+  symbol_index_.Insert(inserted.first->first.first, agent, symbol);
 }
 
 hsa_status_t ExecutableImpl::IterateSymbols(
   iterate_symbols_f callback, void *data)
 {
-  ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
+  ExecutableReaderGuard reader_lock(rw_lock_, frozen_);
   assert(callback);
 
   for (auto &symbol_entry : program_symbols_) {
@@ -624,6 +974,15 @@ hsa_status_t ExecutableImpl::IterateSymbols(
       return hsc;
     }
   }
+  for (auto &table : lazy_symbol_tables_) {
+    for (size_t i = 0; i < table->Count(); ++i) {
+      hsa_status_t hsc =
+        callback(Executable::Handle(this), Symbol::Handle(MaterializeSymbol(table->Get(i))), data);
+      if (HSA_STATUS_SUCCESS != hsc) {
+        return hsc;
+      }
+    }
+  }
 
   return HSA_STATUS_SUCCESS;
 }
@@ -634,7 +993,7 @@ hsa_status_t ExecutableImpl::IterateLoadedCodeObjects(
     void *data),
   void *data)
 {
-  ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
+  ExecutableReaderGuard reader_lock(rw_lock_, frozen_);
   assert(callback);
 
   for (auto &loaded_code_object : loaded_code_objects) {
@@ -657,7 +1016,7 @@ hsa_status_t ExecutableImpl::IterateLoadedCodeObjects(
 hsa_status_t ExecutableImpl::GetInfo(
     hsa_executable_info_t executable_info, void *value)
 {
-  ReaderLockGuard<ReaderWriterLock> reader_lock(rw_lock_);
+  ExecutableReaderGuard reader_lock(rw_lock_, frozen_);
 
   assert(value);
 
@@ -699,6 +1058,39 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
     return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
   }
 
+  // Code objects already loaded for an agent of the same kind are replayed
+  // from the cache without parsing or ISA checks, both passed when the entry
+  // was recorded for the same contents and agent key.
+  std::string agent_key;
+  const char *cache_directory = context_->CacheDirectory();
+  if (cache_directory && code_object.handle) {
+    agent_key = context_->AgentCacheKey(agent);
+  }
+  common::Sha256Digest cache_digest;
+  size_t elf_size = 0;
+  if (!agent_key.empty()) {
+    const void *elf = reinterpret_cast<const void*>(code_object.handle);
+    elf_size = (size_t) amd::elf::ElfSize(elf);
+    if (0 == elf_size) { agent_key.clear(); }
+  }
+  if (!agent_key.empty()) {
+    const void *elf = reinterpret_cast<const void*>(code_object.handle);
+    cache_digest = common::Sha256(elf, elf_size);
+    CachedCodeObject entry;
+    if (ExecutableCache(cache_directory).Lookup(cache_digest, elf_size, agent_key, &entry)) {
+      bool has_program_segment = false;
+      for (const CachedSegment &s : entry.segments) {
+        has_program_segment |= s.segment == AMDGPU_HSA_SEGMENT_GLOBAL_PROGRAM;
+      }
+      if (!has_program_segment || nullptr == program_allocation_segment) {
+        hsa_status_t status = LoadCachedCodeObject(agent, elf, elf_size, entry);
+        if (status != HSA_STATUS_SUCCESS) { return status; }
+        if (nullptr != loaded_code_object) { *loaded_code_object = LoadedCodeObject::Handle(loaded_code_objects.back()); }
+        return HSA_STATUS_SUCCESS;
+      }
+    }
+  }
+
   code.reset(new code::AmdHsaCode());
 
   if (!code->InitAsHandle(code_object)) {
@@ -718,26 +1110,317 @@ hsa_status_t ExecutableImpl::LoadCodeObject(
   objects.push_back(new LoadedCodeObjectImpl(this, agent, code->ElfData(), code->ElfSize()));
   loaded_code_objects.push_back((LoadedCodeObjectImpl*)objects.back());
 
-  for (size_t i = 0; i < code->DataSegmentCount(); ++i) {
-    status = LoadSegment(agent, code->DataSegment(i));
+  bool program_segment_shared = nullptr != program_allocation_segment;
+
+  if (context_->LoadThreadCount() > 1) {
+    status = LoadSegmentsParallel(agent);
     if (status != HSA_STATUS_SUCCESS) { return status; }
-  }
 
-  for (size_t i = 0; i < code->SymbolCount(); ++i) {
-    status = LoadSymbol(agent, code->GetSymbol(i));
+    status = context_->LazySymbols() ? LoadSymbolsLazy(agent) : LoadSymbolsParallel(agent);
     if (status != HSA_STATUS_SUCCESS) { return status; }
-  }
 
-  for (size_t i = 0; i < code->RelocationSectionCount(); ++i) {
-    status = LoadRelocationSection(agent, code->GetRelocationSection(i));
+    BeginCodeRelocationBatch(agent);
+    status = LoadRelocationsParallel(agent);
+    EndRelocationBatch();
+    if (status != HSA_STATUS_SUCCESS) { return status; }
+  } else {
+    for (size_t i = 0; i < code->DataSegmentCount(); ++i) {
+      status = LoadSegment(agent, code->DataSegment(i));
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+    }
+
+    if (context_->LazySymbols()) {
+      status = LoadSymbolsLazy(agent);
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+    } else {
+      for (size_t i = 0; i < code->SymbolCount(); ++i) {
+        status = LoadSymbol(agent, code->GetSymbol(i));
+        if (status != HSA_STATUS_SUCCESS) { return status; }
+      }
+    }
+
+    BeginCodeRelocationBatch(agent);
+    for (size_t i = 0; i < code->RelocationSectionCount(); ++i) {
+      status = LoadRelocationSection(agent, code->GetRelocationSection(i));
+      if (status != HSA_STATUS_SUCCESS) { break; }
+    }
+    EndRelocationBatch();
     if (status != HSA_STATUS_SUCCESS) { return status; }
   }
 
+  if (!agent_key.empty() && code->ElfSize() == elf_size) {
+    CachedCodeObject entry;
+    if (RecordCodeObject(program_segment_shared, &entry)) {
+      ExecutableCache(cache_directory).Store(cache_digest, elf_size, agent_key, entry);
+    }
+  }
+
   code.reset();
   if (nullptr != loaded_code_object) { *loaded_code_object = LoadedCodeObject::Handle(loaded_code_objects.back()); }
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t ExecutableImpl::FinishUploads()
+{
+  if (uploading_segments_.empty()) {
+    return HSA_STATUS_SUCCESS;
+  }
+
+  bool uploaded = context_->SegmentCopyWait();
+  for (Segment *seg : uploading_segments_) {
+    seg->Flush();
+  }
+  uploading_segments_.clear();
+  return uploaded ? HSA_STATUS_SUCCESS : HSA_STATUS_ERROR;
+}
+
+void ExecutableImpl::BeginRelocationBatch(const std::vector<size_t> &relocation_counts)
+{
+  std::vector<Segment*> &segments = loaded_code_objects.back()->LoadedSegments();
+  assert(segments.size() == relocation_counts.size());
+  for (size_t i = 0; i < segments.size(); ++i) {
+    if (relocation_counts[i] < kShadowMinRelocations) {
+      continue;
+    }
+    segments[i]->BeginShadow();
+    shadowed_segments_.push_back(segments[i]);
+  }
+}
+
+void ExecutableImpl::BeginCodeRelocationBatch(hsa_agent_t agent)
+{
+  std::vector<Segment*> &segments = loaded_code_objects.back()->LoadedSegments();
+  std::vector<size_t> relocation_counts(segments.size(), 0);
+
+  for (size_t i = 0; i < code->RelocationSectionCount(); ++i) {
+    code::RelocationSection* rsec = code->GetRelocationSection(i);
+    Segment* rseg = SectionSegment(agent, rsec->targetSection());
+    auto found = std::find(segments.begin(), segments.end(), rseg);
+    if (found != segments.end()) {
+      relocation_counts[found - segments.begin()] += rsec->relocationCount();
+    }
+  }
+
+  BeginRelocationBatch(relocation_counts);
+}
+
+void ExecutableImpl::EndRelocationBatch()
+{
+  for (Segment *seg : shadowed_segments_) {
+    seg->UploadShadow();
+  }
+  shadowed_segments_.clear();
+}
+
+bool ExecutableImpl::RecordCodeObject(bool program_segment_shared, CachedCodeObject* entry)
+{
+  const char *elf_data = code->ElfData();
+  uint64_t elf_size = code->ElfSize();
+
+  // Segments are identified by index, addresses by offset from the segment
+  // base, matching how SectionSegment resolves them.
+  auto segment_index = [&](uint64_t vaddr, uint32_t *index) -> bool {
+    for (size_t i = 0; i < code->DataSegmentCount(); ++i) {
+      code::Segment* s = code->DataSegment(i);
+      if (s->vaddr() <= vaddr && vaddr < s->vaddr() + s->memSize()) {
+        *index = uint32_t(i);
+        return true;
+      }
+    }
+    return false;
+  };
+
+  for (size_t i = 0; i < code->DataSegmentCount(); ++i) {
+    code::Segment* s = code->DataSegment(i);
+    CachedSegment cs = CachedSegment();
+    cs.segment = (amdgpu_hsa_elf_segment_t)(s->type() - PT_LOOS);
+    if (cs.segment == AMDGPU_HSA_SEGMENT_GLOBAL_PROGRAM && program_segment_shared) {
+      return false;
+    }
+    cs.vaddr = s->vaddr();
+    cs.mem_size = s->memSize();
+    cs.align = s->align();
+    cs.image_size = s->imageSize();
+    if (cs.image_size > 0) {
+      if (s->data() < elf_data || uint64_t(s->data() - elf_data) > elf_size - cs.image_size) {
+        return false;
+      }
+      cs.image_offset = uint64_t(s->data() - elf_data);
+    }
+    entry->segments.push_back(cs);
+  }
+
+  for (size_t i = 0; i < code->SymbolCount(); ++i) {
+    code::Symbol* sym = code->GetSymbol(i);
+    CachedSymbol cs = CachedSymbol();
+    cs.name = sym->Name();
+    cs.kind = sym->Kind();
+    cs.is_declaration = sym->IsDeclaration();
+    cs.is_agent = sym->IsAgent();
+    if (!cs.is_declaration) {
+      if (!sym->IsVariableSymbol() && !sym->IsKernelSymbol()) { return false; }
+      uint64_t section_addr = sym->GetSection()->addr();
+      if (!segment_index(section_addr, &cs.segment_index)) { return false; }
+      uint64_t base = code->DataSegment(cs.segment_index)->vaddr();
+      cs.offset = sym->VAddr() - base;
+      cs.section_offset = section_addr - base;
+      cs.linkage = sym->Linkage();
+      cs.size = sym->Size();
+      if (sym->IsVariableSymbol()) {
+        cs.allocation = sym->Allocation();
+        cs.variable_segment = sym->Segment();
+        cs.alignment = sym->Alignment();
+        cs.is_const = sym->IsConst();
+      }
+    }
+    entry->symbols.push_back(cs);
+  }
+
+  for (size_t i = 0; i < code->RelocationSectionCount(); ++i) {
+    code::RelocationSection* rsec = code->GetRelocationSection(i);
+    code::Section* sec = rsec->targetSection();
+    for (size_t j = 0; j < rsec->relocationCount(); ++j) {
+      code::Relocation* rel = rsec->relocation(j);
+      switch (rel->type()) {
+      case R_AMDGPU_32_LOW:
+      case R_AMDGPU_32_HIGH:
+      case R_AMDGPU_64:
+        break;
+      case R_AMDGPU_INIT_SAMPLER:
+      case R_AMDGPU_INIT_IMAGE:
+        // Creates runtime objects on load, not replayable.
+        return false;
+      default:
+        // Ignored on load.
+        continue;
+      }
+
+      CachedRelocation cr = CachedRelocation();
+      cr.type = rel->type();
+      if (!segment_index(sec->addr(), &cr.target_segment_index)) { return false; }
+      cr.target_offset = sec->addr() + rel->offset() - code->DataSegment(cr.target_segment_index)->vaddr();
+      cr.addend = rel->addend();
+
+      amd::elf::Symbol* sym = rel->symbol();
+      switch (sym->type()) {
+      case STT_OBJECT:
+      case STT_SECTION:
+      case STT_AMDGPU_HSA_KERNEL:
+      case STT_AMDGPU_HSA_INDIRECT_FUNCTION: {
+        uint64_t section_addr = sym->section()->addr();
+        if (!segment_index(section_addr, &cr.symbol_segment_index)) { return false; }
+        cr.symbol_offset = section_addr + sym->value() - code->DataSegment(cr.symbol_segment_index)->vaddr();
+        break;
+      }
+      case STT_COMMON:
+        cr.common_name = sym->name();
+        cr.common_program = STA_AMDGPU_HSA_GLOBAL_PROGRAM == ELF64_ST_AMDGPU_ALLOCATION(sym->other());
+        if (cr.common_name.empty()) { return false; }
+        break;
+      default:
+        return false;
+      }
+      entry->relocations.push_back(cr);
+    }
+  }
+
+  return true;
+}
+
+hsa_status_t ExecutableImpl::LoadCachedCodeObject(
+  hsa_agent_t agent, const void *elf, size_t elf_size, const CachedCodeObject &entry)
+{
+  objects.push_back(new LoadedCodeObjectImpl(this, agent, elf, elf_size));
+  loaded_code_objects.push_back((LoadedCodeObjectImpl*)objects.back());
+  std::vector<Segment*> &segments = loaded_code_objects.back()->LoadedSegments();
+
+  for (const CachedSegment &cs : entry.segments) {
+    void* ptr = context_->SegmentAlloc(cs.segment, agent, cs.mem_size, cs.align, true);
+    if (!ptr) { return HSA_STATUS_ERROR_OUT_OF_RESOURCES; }
+    Segment *new_seg = new Segment(this, agent, cs.segment, ptr, cs.mem_size, cs.vaddr);
+    new_seg->Copy(cs.vaddr, (const char*) elf + cs.image_offset, cs.image_size);
+    objects.push_back(new_seg);
+    if (cs.segment == AMDGPU_HSA_SEGMENT_GLOBAL_PROGRAM) {
+      program_allocation_segment = new_seg;
+    }
+    segments.push_back(new_seg);
+  }
+
+  hsa_status_t status;
+  for (const CachedSymbol &cs : entry.symbols) {
+    if (cs.is_declaration) {
+      status = LoadDeclarationSymbol(agent, cs.name);
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+      continue;
+    }
+
+    Segment *seg = segments[cs.segment_index];
+    uint64_t address = (uint64_t) (uintptr_t) seg->Address(seg->VAddr() + cs.offset);
+    SymbolImpl *symbol = nullptr;
+    if (HSA_SYMBOL_KIND_VARIABLE == cs.kind) {
+      symbol = new VariableSymbol(true,
+                                  cs.name,
+                                  cs.linkage,
+                                  true, // sym->IsDefinition()
+                                  cs.allocation,
+                                  cs.variable_segment,
+                                  cs.size,
+                                  cs.alignment,
+                                  cs.is_const,
+                                  false,
+                                  address);
+    } else {
+      const CachedSegment &image_seg = entry.segments[cs.segment_index];
+      if (cs.offset + sizeof(amd_kernel_code_t) > image_seg.image_size) {
+        return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+      }
+      const amd_kernel_code_t *akc =
+        (const amd_kernel_code_t*) ((const char*) elf + image_seg.image_offset + cs.offset);
+      KernelSymbol *kernel_symbol = NewKernelSymbol(cs.name, cs.linkage, cs.size, address, akc);
+      kernel_symbol->debug_info.elf_raw = elf;
+      kernel_symbol->debug_info.elf_size = elf_size;
+      kernel_symbol->debug_info.kernel_name = kernel_symbol->name.c_str();
+      kernel_symbol->debug_info.owning_segment = seg->Address(seg->VAddr() + cs.section_offset);
+      symbol = kernel_symbol;
+    }
+    status = AddDefinitionSymbol(agent, cs.name, cs.is_agent, seg, symbol);
+    if (status != HSA_STATUS_SUCCESS) { return status; }
+  }
+
+  std::vector<size_t> relocation_counts(segments.size(), 0);
+  for (const CachedRelocation &cr : entry.relocations) {
+    relocation_counts[cr.target_segment_index]++;
+  }
+  BeginRelocationBatch(relocation_counts);
+
+  status = HSA_STATUS_SUCCESS;
+  for (const CachedRelocation &cr : entry.relocations) {
+    uint64_t addr;
+    if (!cr.common_name.empty()) {
+      hsa_agent_t sagent = agent;
+      if (cr.common_program) {
+        sagent.handle = 0;
+      }
+      SymbolImpl* esym = (SymbolImpl*) GetSymbolInternal("", cr.common_name.c_str(), sagent, 0);
+      if (!esym) { status = HSA_STATUS_ERROR_VARIABLE_UNDEFINED; break; }
+      addr = esym->address;
+    } else {
+      Segment *sseg = segments[cr.symbol_segment_index];
+      addr = (uint64_t) (uintptr_t) sseg->Address(sseg->VAddr() + cr.symbol_offset);
+    }
+    addr += cr.addend;
+
+    Segment *rseg = segments[cr.target_segment_index];
+    if (!PatchAddress(rseg, rseg->VAddr() + cr.target_offset, cr.type, addr)) {
+      status = HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+      break;
+    }
+  }
+  EndRelocationBatch();
+
+  return status;
+}
+
 hsa_status_t ExecutableImpl::LoadSegment(hsa_agent_t agent, code::Segment* s)
 {
   assert(s->type() < PT_LOOS + AMDGPU_HSA_SEGMENT_LAST);
@@ -752,7 +1435,17 @@ hsa_status_t ExecutableImpl::LoadSegment(hsa_agent_t agent, code::Segment* s)
     void* ptr = context_->SegmentAlloc(segment, agent, s->memSize(), s->align(), true);
     if (!ptr) { return HSA_STATUS_ERROR_OUT_OF_RESOURCES; }
     new_seg = new Segment(this, agent, segment, ptr, s->memSize(), s->vaddr());
-    new_seg->Copy(s->vaddr(), s->data(), s->imageSize());
+    if (context_->PipelinedLoad()) {
+      // Symbols and relocations are processed while the image uploads.
+      if (!new_seg->CopyAsync(s->vaddr(), s->data(), s->imageSize())) {
+        context_->SegmentFree(segment, agent, ptr, s->memSize());
+        delete new_seg;
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+      uploading_segments_.push_back(new_seg);
+    } else {
+      new_seg->Copy(s->vaddr(), s->data(), s->imageSize());
+    }
     objects.push_back(new_seg);
 
     if (segment == AMDGPU_HSA_SEGMENT_GLOBAL_PROGRAM) {
@@ -764,6 +1457,76 @@ hsa_status_t ExecutableImpl::LoadSegment(hsa_agent_t agent, code::Segment* s)
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t ExecutableImpl::LoadSegmentsParallel(hsa_agent_t agent)
+{
+  size_t count = code->DataSegmentCount();
+
+  // Decide which segments need memory up front, only the first program
+  // segment of an executable is allocated.
+  std::vector<bool> need_alloc(count, true);
+  bool program_allocated = nullptr != program_allocation_segment;
+  for (size_t i = 0; i < count; ++i) {
+    code::Segment* s = code->DataSegment(i);
+    assert(s->type() < PT_LOOS + AMDGPU_HSA_SEGMENT_LAST);
+    if ((amdgpu_hsa_elf_segment_t)(s->type() - PT_LOOS) == AMDGPU_HSA_SEGMENT_GLOBAL_PROGRAM) {
+      need_alloc[i] = !program_allocated;
+      program_allocated = true;
+    }
+  }
+
+  std::vector<Segment*> new_segs(count, nullptr);
+  std::vector<hsa_status_t> statuses(count, HSA_STATUS_SUCCESS);
+  context_->ParallelFor(count, [&](size_t i) {
+    if (!need_alloc[i]) { return; }
+    code::Segment* s = code->DataSegment(i);
+    amdgpu_hsa_elf_segment_t segment = (amdgpu_hsa_elf_segment_t)(s->type() - PT_LOOS);
+    void* ptr = context_->SegmentAlloc(segment, agent, s->memSize(), s->align(), true);
+    if (!ptr) { statuses[i] = HSA_STATUS_ERROR_OUT_OF_RESOURCES; return; }
+    new_segs[i] = new Segment(this, agent, segment, ptr, s->memSize(), s->vaddr());
+  });
+
+  // Publish in segment order; allocated segments are owned by the executable
+  // even if a later one failed, as with a serial load.
+  for (size_t i = 0; i < count; ++i) {
+    if (!new_segs[i]) { continue; }
+    objects.push_back(new_segs[i]);
+    if (new_segs[i]->ElfSegment() == AMDGPU_HSA_SEGMENT_GLOBAL_PROGRAM) {
+      program_allocation_segment = new_segs[i];
+    }
+  }
+  hsa_status_t status = FirstError(statuses);
+  if (status != HSA_STATUS_SUCCESS) { return status; }
+
+  std::vector<std::pair<size_t, uint64_t>> chunks;
+  for (size_t i = 0; i < count; ++i) {
+    Segment* seg = need_alloc[i] ? new_segs[i] : program_allocation_segment;
+    assert(seg);
+    loaded_code_objects.back()->LoadedSegments().push_back(seg);
+    if (!need_alloc[i]) { continue; }
+    if (context_->PipelinedLoad()) {
+      // Uploads are issued in segment order and overlap symbols and
+      // relocations, which run on the pool meanwhile.
+      code::Segment* s = code->DataSegment(i);
+      if (!seg->CopyAsync(s->vaddr(), s->data(), s->imageSize())) {
+        return HSA_STATUS_ERROR_OUT_OF_RESOURCES;
+      }
+      uploading_segments_.push_back(seg);
+      continue;
+    }
+    for (uint64_t offset = 0; offset < code->DataSegment(i)->imageSize(); offset += kParallelCopyChunk) {
+      chunks.push_back(std::make_pair(i, offset));
+    }
+  }
+
+  context_->ParallelFor(chunks.size(), [&](size_t c) {
+    code::Segment* s = code->DataSegment(chunks[c].first);
+    uint64_t offset = chunks[c].second;
+    size_t size = (size_t) std::min<uint64_t>(kParallelCopyChunk, s->imageSize() - offset);
+    new_segs[chunks[c].first]->Copy(s->vaddr() + offset, (const char*) s->data() + offset, size);
+  });
+  return HSA_STATUS_SUCCESS;
+}
+
 hsa_status_t ExecutableImpl::LoadSymbol(hsa_agent_t agent, code::Symbol* sym)
 {
   if (sym->IsDeclaration()) {
@@ -775,20 +1538,14 @@ hsa_status_t ExecutableImpl::LoadSymbol(hsa_agent_t agent, code::Symbol* sym)
 
 hsa_status_t ExecutableImpl::LoadDefinitionSymbol(hsa_agent_t agent, code::Symbol* sym)
 {
-  if (sym->IsAgent()) {
-    auto agent_symbol = agent_symbols_.find(std::make_pair(sym->Name(), agent));
-    if (agent_symbol != agent_symbols_.end()) {
-      // TODO(spec): this is not spec compliant.
-      return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
-    }
-  } else {
-    auto program_symbol = program_symbols_.find(sym->Name());
-    if (program_symbol != program_symbols_.end()) {
-      // TODO(spec): this is not spec compliant.
-      return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
-    }
-  }
+  SymbolImpl *symbol = nullptr;
+  hsa_status_t status = CreateDefinitionSymbol(agent, sym, &symbol);
+  if (status != HSA_STATUS_SUCCESS) { return status; }
+  return AddDefinitionSymbol(agent, sym, symbol);
+}
 
+hsa_status_t ExecutableImpl::CreateDefinitionSymbol(hsa_agent_t agent, code::Symbol* sym, SymbolImpl** result)
+{
   uint64_t address = SymbolAddress(agent, sym);
 
   SymbolImpl *symbol = nullptr;
@@ -805,60 +1562,184 @@ hsa_status_t ExecutableImpl::LoadDefinitionSymbol(hsa_agent_t agent, code::Symbo
                        false,
                        address);
   } else if (sym->IsKernelSymbol()) {
-      amd_kernel_code_t *akc = (amd_kernel_code_t*) address;
-      assert(akc);
-
-      uint32_t kernarg_segment_size =
-        uint32_t(akc->kernarg_segment_byte_size);
-      uint32_t kernarg_segment_alignment =
-        uint32_t(1 << akc->kernarg_segment_alignment);
-      uint32_t group_segment_size =
-        uint32_t(akc->workgroup_group_segment_byte_size);
-      uint32_t private_segment_size =
-        uint32_t(akc->workitem_private_segment_byte_size);
-      bool is_dynamic_callstack =
-        AMD_HSA_BITS_GET(akc->kernel_code_properties, AMD_KERNEL_CODE_PROPERTIES_IS_DYNAMIC_CALLSTACK) ? true : false;
-
-      KernelSymbol *kernel_symbol = new KernelSymbol(true,
-                                      sym->Name(),
-                                      sym->Linkage(),
-                                      true, // sym->IsDefinition()
-                                      kernarg_segment_size,
-                                      kernarg_segment_alignment,
-                                      group_segment_size,
-                                      private_segment_size,
-                                      is_dynamic_callstack,
-                                      sym->Size(),
-                                      256,
-                                      address);
+      amd_kernel_code_t akc;
+      if (!sym->GetSection()->getData(sym->SectionOffset(), &akc, sizeof(akc))) {
+        return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+      }
+      KernelSymbol *kernel_symbol = NewKernelSymbol(sym->Name(), sym->Linkage(), sym->Size(), address, &akc);
       kernel_symbol->debug_info.elf_raw = code->ElfData();
       kernel_symbol->debug_info.elf_size = code->ElfSize();
       kernel_symbol->debug_info.kernel_name = kernel_symbol->name.c_str();
       kernel_symbol->debug_info.owning_segment = (void*)SymbolSegment(agent, sym)->Address(sym->GetSection()->addr());
-      akc->runtime_loader_kernel_symbol = (uint64_t) (uintptr_t) &kernel_symbol->debug_info;
       symbol = kernel_symbol;
   } else {
     assert(!"Unexpected symbol type in LoadDefinitionSymbol");
     return HSA_STATUS_ERROR;
   }
   assert(symbol);
-  if (sym->IsAgent()) {
-    agent_symbols_.insert(std::make_pair(std::make_pair(sym->Name(), agent), symbol));
+  *result = symbol;
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ExecutableImpl::AddDefinitionSymbol(hsa_agent_t agent, code::Symbol* sym, SymbolImpl* symbol)
+{
+  return AddDefinitionSymbol(agent, sym->Name(), sym->IsAgent(), SymbolSegment(agent, sym), symbol);
+}
+
+hsa_status_t ExecutableImpl::AddDefinitionSymbol(hsa_agent_t agent, const std::string &name, bool is_agent, Segment* seg, SymbolImpl* symbol)
+{
+  hsa_agent_t key_agent = agent;
+  if (!is_agent) {
+    key_agent.handle = 0;
+  }
+  if (symbol_index_.Find("", name.c_str(), key_agent)) {
+    delete symbol;
+    // TODO(spec): this is not spec compliant.
+    return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
+  }
+
+  // Link the kernel descriptor to its symbol only once the symbol is owned by
+  // the executable.
+  if (symbol->IsKernel()) {
+    KernelSymbol *kernel_symbol = static_cast<KernelSymbol*>(symbol);
+    LinkKernelDescriptor(seg, kernel_symbol->address, &kernel_symbol->debug_info);
+  }
+
+  if (is_agent) {
+    AddAgentSymbol(name, agent, symbol);
   } else {
-    program_symbols_.insert(std::make_pair(sym->Name(), symbol));
+    AddProgramSymbol(name, symbol);
   }
   return HSA_STATUS_SUCCESS;
 }
 
-hsa_status_t ExecutableImpl::LoadDeclarationSymbol(hsa_agent_t agent, code::Symbol* sym)
+void ExecutableImpl::LinkKernelDescriptor(Segment* seg, uint64_t address, void* debug_info)
+{
+  uint64_t base = (uint64_t) (uintptr_t) seg->Address(seg->VAddr());
+  assert(base <= address && address - base < seg->Size());
+  uint64_t link = (uint64_t) (uintptr_t) debug_info;
+  seg->Copy(seg->VAddr() + (address - base) + offsetof(amd_kernel_code_t, runtime_loader_kernel_symbol),
+            &link, sizeof(link));
+}
+
+hsa_status_t ExecutableImpl::LoadSymbolsLazy(hsa_agent_t agent)
 {
-  auto program_symbol = program_symbols_.find(sym->Name());
-  if (program_symbol == program_symbols_.end()) {
-    auto agent_symbol = agent_symbols_.find(std::make_pair(sym->Name(), agent));
-    if (agent_symbol == agent_symbols_.end()) {
+  size_t count = code->SymbolCount();
+  size_t names_size = 0;
+  for (size_t i = 0; i < count; ++i) {
+    code::Symbol* sym = code->GetSymbol(i);
+    if (!sym->IsDeclaration()) {
+      names_size += sym->Name().size();
+    }
+  }
+
+  lazy_symbol_tables_.push_back(std::unique_ptr<LazySymbolTable>(
+    new LazySymbolTable(code->ElfData(), code->ElfSize(), count, names_size)));
+  LazySymbolTable *table = lazy_symbol_tables_.back().get();
+
+  for (size_t i = 0; i < count; ++i) {
+    code::Symbol* sym = code->GetSymbol(i);
+    if (sym->IsDeclaration()) {
+      hsa_status_t status = LoadDeclarationSymbol(agent, sym);
+      if (status != HSA_STATUS_SUCCESS) { return status; }
+      continue;
+    }
+
+    if (!sym->IsVariableSymbol() && !sym->IsKernelSymbol()) {
+      assert(!"Unexpected symbol type in LoadSymbolsLazy");
+      return HSA_STATUS_ERROR;
+    }
+
+    std::string name = sym->Name();
+    hsa_agent_t key_agent = agent;
+    if (!sym->IsAgent()) {
+      key_agent.handle = 0;
+    }
+    if (symbol_index_.Find("", name.c_str(), key_agent)) {
       // TODO(spec): this is not spec compliant.
-      return HSA_STATUS_ERROR_VARIABLE_UNDEFINED;
+      return HSA_STATUS_ERROR_VARIABLE_ALREADY_DEFINED;
+    }
+
+    LazySymbol *lazy = table->Add(name);
+    lazy->linkage = sym->Linkage();
+    lazy->size = sym->Size();
+    lazy->address = SymbolAddress(agent, sym);
+    if (sym->IsVariableSymbol()) {
+      lazy->kind = HSA_SYMBOL_KIND_VARIABLE;
+      lazy->allocation = sym->Allocation();
+      lazy->segment = sym->Segment();
+      lazy->alignment = sym->Alignment();
+      lazy->is_const = sym->IsConst();
+    } else {
+      amd_kernel_code_t akc;
+      if (!sym->GetSection()->getData(sym->SectionOffset(), &akc, sizeof(akc))) {
+        return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
+      }
+      lazy->kind = HSA_SYMBOL_KIND_KERNEL;
+      lazy->kernarg_segment_size = uint32_t(akc.kernarg_segment_byte_size);
+      lazy->kernarg_segment_alignment = uint32_t(1 << akc.kernarg_segment_alignment);
+      lazy->group_segment_size = uint32_t(akc.workgroup_group_segment_byte_size);
+      lazy->private_segment_size = uint32_t(akc.workitem_private_segment_byte_size);
+      lazy->is_dynamic_callstack =
+        AMD_HSA_BITS_GET(akc.kernel_code_properties, AMD_KERNEL_CODE_PROPERTIES_IS_DYNAMIC_CALLSTACK) ? true : false;
+      Segment *seg = SymbolSegment(agent, sym);
+      lazy->debug_info.elf_raw = table->ElfData();
+      lazy->debug_info.elf_size = table->ElfSize();
+      lazy->debug_info.kernel_name = lazy->name;
+      lazy->debug_info.owning_segment = seg->Address(sym->GetSection()->addr());
+      // Only the symbol object is lazy, the debugger finds the kernel through
+      // the descriptor as soon as the code object is loaded.
+      LinkKernelDescriptor(seg, lazy->address, &lazy->debug_info);
     }
+    symbol_index_.Insert(lazy, key_agent);
+  }
+  return HSA_STATUS_SUCCESS;
+}
+
+hsa_status_t ExecutableImpl::LoadSymbolsParallel(hsa_agent_t agent)
+{
+  size_t count = code->SymbolCount();
+  std::vector<SymbolImpl*> symbols(count, nullptr);
+  std::vector<hsa_status_t> statuses(count, HSA_STATUS_SUCCESS);
+  context_->ParallelFor(count, [&](size_t i) {
+    code::Symbol* sym = code->GetSymbol(i);
+    if (!sym->IsDeclaration()) {
+      statuses[i] = CreateDefinitionSymbol(agent, sym, &symbols[i]);
+    }
+  });
+
+  // Merge in symbol table order so duplicate and undefined symbol checks see
+  // the same executable state they would in a serial load.
+  hsa_status_t status = HSA_STATUS_SUCCESS;
+  size_t i = 0;
+  for (; i < count && status == HSA_STATUS_SUCCESS; ++i) {
+    code::Symbol* sym = code->GetSymbol(i);
+    if (statuses[i] != HSA_STATUS_SUCCESS) {
+      status = statuses[i];
+    } else if (sym->IsDeclaration()) {
+      status = LoadDeclarationSymbol(agent, sym);
+    } else {
+      status = AddDefinitionSymbol(agent, sym, symbols[i]);
+    }
+  }
+  for (; i < count; ++i) {
+    delete symbols[i];
+  }
+  return status;
+}
+
+hsa_status_t ExecutableImpl::LoadDeclarationSymbol(hsa_agent_t agent, code::Symbol* sym)
+{
+  return LoadDeclarationSymbol(agent, sym->Name());
+}
+
+hsa_status_t ExecutableImpl::LoadDeclarationSymbol(hsa_agent_t agent, const std::string &name)
+{
+  hsa_agent_t program_agent = {0};
+  if (!symbol_index_.Find("", name.c_str(), program_agent) &&
+      !symbol_index_.Find("", name.c_str(), agent)) {
+    // TODO(spec): this is not spec compliant.
+    return HSA_STATUS_ERROR_VARIABLE_UNDEFINED;
   }
   return HSA_STATUS_SUCCESS;
 }
@@ -903,6 +1784,24 @@ hsa_status_t ExecutableImpl::LoadRelocationSection(hsa_agent_t agent, code::Relo
   return HSA_STATUS_SUCCESS;
 }
 
+hsa_status_t ExecutableImpl::LoadRelocationsParallel(hsa_agent_t agent)
+{
+  std::vector<code::Relocation*> relocations;
+  for (size_t i = 0; i < code->RelocationSectionCount(); ++i) {
+    code::RelocationSection* sec = code->GetRelocationSection(i);
+    for (size_t j = 0; j < sec->relocationCount(); ++j) {
+      relocations.push_back(sec->relocation(j));
+    }
+  }
+
+  // Symbol maps are complete and only read from here on.
+  std::vector<hsa_status_t> statuses(relocations.size(), HSA_STATUS_SUCCESS);
+  context_->ParallelFor(relocations.size(), [&](size_t i) {
+    statuses[i] = LoadRelocation(agent, relocations[i]);
+  });
+  return FirstError(statuses);
+}
+
 hsa_status_t ExecutableImpl::LoadRelocation(hsa_agent_t agent, code::Relocation* rel)
 {
   hsa_status_t status;
@@ -939,20 +1838,7 @@ hsa_status_t ExecutableImpl::LoadRelocation(hsa_agent_t agent, code::Relocation*
       }
       addr += rel->addend();
 
-      uint32_t addr32 = 0;
-      switch (rel->type()) {
-      case R_AMDGPU_32_HIGH:
-        addr32 = uint32_t((addr >> 32) & 0xFFFFFFFF);
-        rseg->Copy(reladdr, &addr32, sizeof(addr32));
-        break;
-      case R_AMDGPU_32_LOW:
-        addr32 = uint32_t(addr & 0xFFFFFFFF);
-        rseg->Copy(reladdr, &addr32, sizeof(addr32));
-        break;
-      case R_AMDGPU_64:
-        rseg->Copy(reladdr, &addr, sizeof(addr));
-        break;
-      default:
+      if (!PatchAddress(rseg, reladdr, rel->type(), addr)) {
         return HSA_STATUS_ERROR_INVALID_CODE_OBJECT;
       }
       break;
@@ -41,10 +41,13 @@ mes of its
 #define HSA_RUNTIME_CORE_LOADER_EXECUTABLE_HPP_
 
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cstdint>
 #include <libelf.h>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -55,6 +58,7 @@ mes of its
 #include "amd_hsa_code.hpp"
 #include "amd_hsa_kernel_code.h"
 #include "amd_hsa_locks.hpp"
+#include "executable_cache.hpp"
 
 namespace amd {
 namespace hsa {
@@ -267,10 +271,24 @@ private:
   size_t size;
   uint64_t vaddr;
 
+  // Writes made while the segment image is still uploading, applied in order
+  // by Flush. Guarded by pending_lock since parallel loads patch the same
+  // segment from several threads.
+  std::mutex pending_lock;
+  bool upload_pending;
+  std::vector<std::pair<uint64_t, size_t>> pending_writes;
+  std::vector<char> pending_data;
+
+  // Host copy of the segment that Copy writes to while relocations are
+  // applied, with a bit per byte written. Bits are set atomically since
+  // parallel loads patch the same segment from several threads.
+  std::vector<char> shadow;
+  std::unique_ptr<std::atomic<uint64_t>[]> shadow_dirty;
+
 public:
   Segment(ExecutableImpl *owner_, hsa_agent_t agent_, amdgpu_hsa_elf_segment_t segment_, void* ptr_, size_t size_, uint64_t vaddr_)
     : ExecutableObject(owner_, agent_), segment(segment_),
-      ptr(ptr_), size(size_), vaddr(vaddr_) { }
+      ptr(ptr_), size(size_), vaddr(vaddr_), upload_pending(false) { }
 
   amdgpu_hsa_elf_segment_t ElfSegment() const { return segment; }
   void* Ptr() const { return ptr; }
@@ -285,6 +303,17 @@ public:
 
   bool IsAddressInSegment(uint64_t addr);
   void Copy(uint64_t addr, const void* src, size_t size);
+  // Starts uploading the segment image, Copy is deferred until Flush.
+  bool CopyAsync(uint64_t addr, const void* src, size_t size);
+  // Applies the writes deferred while the upload was in flight. Must only be
+  // called once the context has waited for the upload.
+  void Flush();
+  // Redirects Copy to a host shadow of the segment.
+  void BeginShadow();
+  // Uploads the bytes written to the shadow, one copy per run of adjacent
+  // bytes, and drops the shadow. Bytes not written through the shadow, such
+  // as earlier kernel descriptor links, are left as they are.
+  void UploadShadow();
   void Destroy() override;
 };
 
@@ -326,6 +355,122 @@ struct ASH {
 };
 typedef std::unordered_map<AgentSymbol, SymbolImpl*, ASH, ASC> AgentSymbolMap;
 
+class LazySymbolTable;
+
+// Symbol definition recorded by a lazy load, turned into a SymbolImpl on first
+// lookup or iteration.
+struct LazySymbol {
+  LazySymbolTable *table;
+  const char *name;
+  hsa_symbol_kind_t kind;
+  hsa_symbol_linkage_t linkage;
+  hsa_variable_allocation_t allocation;
+  hsa_variable_segment_t segment;
+  bool is_const;
+  uint32_t size;
+  uint32_t alignment;
+  uint64_t address;
+  // Kernel attributes, read from the code object image at load time.
+  uint32_t kernarg_segment_size;
+  uint32_t kernarg_segment_alignment;
+  uint32_t group_segment_size;
+  uint32_t private_segment_size;
+  bool is_dynamic_callstack;
+  // Target of the kernel descriptor's runtime_loader_kernel_symbol link,
+  // which is written at load time.
+  amd_runtime_loader_debug_info_t debug_info;
+  std::atomic<SymbolImpl*> symbol;
+};
+
+// Lazy symbols of one code object. Names are kept in a single buffer and
+// materialized symbols are owned by the table.
+class LazySymbolTable final {
+public:
+  LazySymbolTable(const void *elf_data, size_t elf_size, size_t capacity, size_t names_size);
+
+  ~LazySymbolTable();
+
+  // Returns a new entry named name, the remaining fields are zero.
+  LazySymbol* Add(const std::string &name);
+
+  size_t Count() const { return count_; }
+  LazySymbol* Get(size_t i) { return &symbols_[i]; }
+
+  const void* ElfData() const { return elf_data_; }
+  size_t ElfSize() const { return elf_size_; }
+
+private:
+  LazySymbolTable(const LazySymbolTable &lst);
+  LazySymbolTable& operator=(const LazySymbolTable &lst);
+
+  const void *elf_data_;
+  size_t elf_size_;
+  std::unique_ptr<LazySymbol[]> symbols_;
+  size_t count_;
+  size_t capacity_;
+  std::vector<char> names_;
+};
+
+// Open-addressed index over program and agent symbols keyed by (mangled name,
+// agent), program symbols under the null agent. Lookups hash and compare the
+// module and symbol names in place instead of building the mangled name, and
+// names are borrowed from the keys of the owning symbol maps or from lazy
+// symbol tables.
+class SymbolIndex final {
+public:
+  struct Entry {
+    size_t hash;
+    uint64_t agent;
+    const char *name;
+    size_t name_length;
+    SymbolImpl *symbol;
+    LazySymbol *lazy;
+  };
+
+  SymbolIndex(): count_(0) {}
+
+  void Insert(const std::string &mangled_name, hsa_agent_t agent, SymbolImpl *symbol);
+
+  void Insert(LazySymbol *lazy, hsa_agent_t agent);
+
+  const Entry* Find(const char *module_name, const char *symbol_name, hsa_agent_t agent) const;
+
+private:
+  SymbolIndex(const SymbolIndex &si);
+  SymbolIndex& operator=(const SymbolIndex &si);
+
+  void Insert(const Entry &entry);
+
+  static size_t Hash(const char *module_name, const char *symbol_name, uint64_t agent);
+
+  void Grow();
+
+  std::vector<Entry> entries_;
+  size_t count_;
+};
+
+// Takes the reader side of an executable's lock unless the executable is
+// frozen, frozen executables no longer change.
+class ExecutableReaderGuard final {
+public:
+  ExecutableReaderGuard(amd::hsa::common::ReaderWriterLock &lock, const std::atomic<bool> &frozen):
+    lock_(frozen.load(std::memory_order_acquire) ? nullptr : &lock)
+  {
+    if (lock_) { lock_->ReaderLock(); }
+  }
+
+  ~ExecutableReaderGuard()
+  {
+    if (lock_) { lock_->ReaderUnlock(); }
+  }
+
+private:
+  ExecutableReaderGuard(const ExecutableReaderGuard&);
+  ExecutableReaderGuard& operator=(const ExecutableReaderGuard&);
+
+  amd::hsa::common::ReaderWriterLock *lock_;
+};
+
 class ExecutableImpl final: public Executable {
 public:
   const hsa_profile_t& profile() const {
@@ -369,12 +514,18 @@ public:
       return HSA_STATUS_ERROR_FROZEN_EXECUTABLE;
     }
 
+    hsa_status_t status = FinishUploads();
+    if (HSA_STATUS_SUCCESS != status) {
+      return status;
+    }
+
     state_ = HSA_EXECUTABLE_STATE_FROZEN;
+    frozen_.store(true, std::memory_order_release);
     return HSA_STATUS_SUCCESS;
   }
 
   hsa_status_t Validate(uint32_t *result) {
-    amd::hsa::common::ReaderLockGuard<amd::hsa::common::ReaderWriterLock> reader_lock(rw_lock_);
+    ExecutableReaderGuard reader_lock(rw_lock_, frozen_);
     assert(result);
     *result = 0;
     return HSA_STATUS_SUCCESS;
@@ -410,13 +561,60 @@ private:
     hsa_agent_t agent,
     int32_t call_convention);
 
+  // Creates the SymbolImpl of a lazy symbol on first use. Safe to call from
+  // readers of a frozen executable.
+  SymbolImpl* MaterializeSymbol(LazySymbol *lazy);
+
+  void AddProgramSymbol(const std::string &name, SymbolImpl* symbol);
+  void AddAgentSymbol(const std::string &name, hsa_agent_t agent, SymbolImpl* symbol);
+
   hsa_status_t LoadSegment(hsa_agent_t agent, amd::hsa::code::Segment* seg);
   hsa_status_t LoadSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
   hsa_status_t LoadDefinitionSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
+  hsa_status_t CreateDefinitionSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym, SymbolImpl** symbol);
+  hsa_status_t AddDefinitionSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym, SymbolImpl* symbol);
+  hsa_status_t AddDefinitionSymbol(hsa_agent_t agent, const std::string &name, bool is_agent, Segment* seg, SymbolImpl* symbol);
+  // Points the runtime_loader_kernel_symbol field of the kernel descriptor at
+  // address in seg to debug_info. Goes through Segment::Copy so it is ordered
+  // after a pending upload of the segment.
+  void LinkKernelDescriptor(Segment* seg, uint64_t address, void* debug_info);
   hsa_status_t LoadDeclarationSymbol(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
+  hsa_status_t LoadDeclarationSymbol(hsa_agent_t agent, const std::string &name);
   hsa_status_t LoadRelocationSection(hsa_agent_t agent, amd::hsa::code::RelocationSection* sec);
   hsa_status_t LoadRelocation(hsa_agent_t agent, amd::hsa::code::Relocation* rel);
 
+  // Parallel variants of the loops in LoadCodeObject, used when the context
+  // allows more than one load thread. Results are merged in code object order
+  // so the executable is identical to one loaded serially.
+  hsa_status_t LoadSegmentsParallel(hsa_agent_t agent);
+  hsa_status_t LoadSymbolsParallel(hsa_agent_t agent);
+  hsa_status_t LoadRelocationsParallel(hsa_agent_t agent);
+
+  // Records definitions in a lazy symbol table instead of creating their
+  // SymbolImpl, used when the context asks for lazy symbols.
+  hsa_status_t LoadSymbolsLazy(hsa_agent_t agent);
+
+  // Describes the code object just loaded for the executable cache. Returns
+  // false if its load cannot be replayed, e.g. it creates samplers or images
+  // or shares the program segment of an earlier code object.
+  bool RecordCodeObject(bool program_segment_shared, CachedCodeObject* entry);
+
+  // Replays a cached load: allocates and copies segments, creates symbols and
+  // patches address relocations without parsing the code object.
+  hsa_status_t LoadCachedCodeObject(
+    hsa_agent_t agent, const void *elf, size_t elf_size, const CachedCodeObject &entry);
+
+  // Joins the segment uploads started by pipelined loads and applies the
+  // writes deferred behind them.
+  hsa_status_t FinishUploads();
+
+  // Shadows segments of the code object being loaded that are the target of
+  // several relocations, so patches become a few bulk uploads instead of one
+  // copy each. relocation_counts[i] counts the patches of loaded segment i.
+  void BeginRelocationBatch(const std::vector<size_t> &relocation_counts);
+  void BeginCodeRelocationBatch(hsa_agent_t agent);
+  void EndRelocationBatch();
+
   uint64_t SymbolAddress(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
   uint64_t SymbolAddress(hsa_agent_t agent, amd::elf::Symbol* sym);
   Segment* SymbolSegment(hsa_agent_t agent, amd::hsa::code::Symbol* sym);
@@ -427,12 +625,18 @@ private:
   Context *context_;
   const size_t id_;
   hsa_executable_state_t state_;
+  // Set once frozen, readers then skip rw_lock_.
+  std::atomic<bool> frozen_;
 
   ProgramSymbolMap program_symbols_;
   AgentSymbolMap agent_symbols_;
+  std::vector<std::unique_ptr<LazySymbolTable>> lazy_symbol_tables_;
+  SymbolIndex symbol_index_;
   std::vector<ExecutableObject*> objects;
   Segment *program_allocation_segment;
   std::vector<LoadedCodeObjectImpl*> loaded_code_objects;
+  std::vector<Segment*> uploading_segments_;
+  std::vector<Segment*> shadowed_segments_;
 };
 
 } // namespace loader
@@ -0,0 +1,254 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#include "executable_cache.hpp"
+#include "amd_hsa_cache_file.hpp"
+#include "amd_hsa_kernel_code.h"
+
+#include <cstdio>
+
+namespace amd {
+namespace hsa {
+namespace loader {
+
+namespace {
+
+// Bump when the entry layout changes, older entries are then ignored.
+const uint32_t kCacheMagic = 0x43415348; // "HSAC"
+const uint32_t kCacheVersion = 2;
+
+bool ValidSymbol(const CachedSymbol &s)
+{
+  switch (s.kind) {
+  case HSA_SYMBOL_KIND_VARIABLE:
+  case HSA_SYMBOL_KIND_KERNEL:
+  case HSA_SYMBOL_KIND_INDIRECT_FUNCTION:
+    break;
+  default:
+    return false;
+  }
+  switch (s.linkage) {
+  case HSA_SYMBOL_LINKAGE_MODULE:
+  case HSA_SYMBOL_LINKAGE_PROGRAM:
+    break;
+  default:
+    return false;
+  }
+  switch (s.allocation) {
+  case HSA_VARIABLE_ALLOCATION_AGENT:
+  case HSA_VARIABLE_ALLOCATION_PROGRAM:
+    break;
+  default:
+    return false;
+  }
+  switch (s.variable_segment) {
+  case HSA_VARIABLE_SEGMENT_GLOBAL:
+  case HSA_VARIABLE_SEGMENT_READONLY:
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+bool ValidRelocationType(uint32_t type)
+{
+  // Only the types recorded on a normal load are replayed.
+  return R_AMDGPU_32_LOW == type || R_AMDGPU_32_HIGH == type || R_AMDGPU_64 == type;
+}
+
+} // namespace
+
+std::string ExecutableCache::EntryPath(const common::Sha256Digest &digest, const std::string &agent_key) const
+{
+  // The leading 8 digest bytes name the file, the full digest is checked
+  // against the entry on lookup.
+  uint64_t prefix = 0;
+  for (unsigned i = 0; i < sizeof(prefix); ++i) {
+    prefix = (prefix << 8) | digest.bytes[i];
+  }
+  char name[64];
+  snprintf(name, sizeof(name), "/%016llx-%016llx.hsaco-cache",
+           (unsigned long long) prefix,
+           (unsigned long long) common::Fnv1a().Bytes(agent_key.data(), agent_key.size()).Value());
+  return directory_ + name;
+}
+
+bool ExecutableCache::Lookup(const common::Sha256Digest &digest, size_t elf_size, const std::string &agent_key,
+                             CachedCodeObject *entry) const
+{
+  std::string data;
+  if (!common::ReadCacheFile(EntryPath(digest, agent_key), &data)) { return false; }
+  common::CacheRecordReader reader(data);
+
+  // The file name only carries hashes, check the full key.
+  uint32_t magic, version;
+  common::Sha256Digest entry_digest;
+  uint64_t entry_elf_size;
+  std::string entry_agent_key;
+  if (!reader.Get(&magic) || magic != kCacheMagic ||
+      !reader.Get(&version) || version != kCacheVersion ||
+      !reader.Get(&entry_digest) || entry_digest != digest ||
+      !reader.Get(&entry_elf_size) || entry_elf_size != elf_size ||
+      !reader.GetString(&entry_agent_key) || entry_agent_key != agent_key) {
+    return false;
+  }
+
+  uint32_t count;
+  if (!reader.Get(&count)) { return false; }
+  entry->segments.resize(count);
+  for (CachedSegment &s : entry->segments) {
+    if (!reader.Get(&s.segment) || !reader.Get(&s.vaddr) ||
+        !reader.Get(&s.mem_size) || !reader.Get(&s.align) ||
+        !reader.Get(&s.image_offset) || !reader.Get(&s.image_size)) {
+      return false;
+    }
+    if (s.segment >= AMDGPU_HSA_SEGMENT_LAST || s.image_size > s.mem_size ||
+        s.image_offset > elf_size || s.image_size > elf_size - s.image_offset) {
+      return false;
+    }
+  }
+  const uint32_t segment_count = count;
+
+  if (!reader.Get(&count)) { return false; }
+  entry->symbols.resize(count);
+  for (CachedSymbol &s : entry->symbols) {
+    if (!reader.GetString(&s.name) || !reader.Get(&s.kind) ||
+        !reader.Get(&s.linkage) || !reader.GetBool(&s.is_declaration) ||
+        !reader.GetBool(&s.is_agent) || !reader.Get(&s.segment_index) ||
+        !reader.Get(&s.offset) || !reader.Get(&s.section_offset) ||
+        !reader.Get(&s.allocation) || !reader.Get(&s.variable_segment) ||
+        !reader.Get(&s.size) || !reader.Get(&s.alignment) ||
+        !reader.GetBool(&s.is_const) || !ValidSymbol(s)) {
+      return false;
+    }
+    if (s.is_declaration) { continue; }
+    uint64_t symbol_size = 1;
+    if (HSA_SYMBOL_KIND_KERNEL == s.kind) {
+      symbol_size = sizeof(amd_kernel_code_t);
+    } else if (HSA_SYMBOL_KIND_VARIABLE != s.kind) {
+      return false;
+    }
+    if (s.segment_index >= segment_count ||
+        s.offset + symbol_size > entry->segments[s.segment_index].mem_size ||
+        s.section_offset > s.offset) {
+      return false;
+    }
+  }
+
+  if (!reader.Get(&count)) { return false; }
+  entry->relocations.resize(count);
+  for (CachedRelocation &r : entry->relocations) {
+    if (!reader.Get(&r.type) || !reader.Get(&r.target_segment_index) ||
+        !reader.Get(&r.target_offset) || !reader.Get(&r.addend) ||
+        !reader.Get(&r.symbol_segment_index) || !reader.Get(&r.symbol_offset) ||
+        !reader.GetString(&r.common_name) || !reader.GetBool(&r.common_program) ||
+        !ValidRelocationType(r.type)) {
+      return false;
+    }
+    uint64_t patch_size = R_AMDGPU_64 == r.type ? sizeof(uint64_t) : sizeof(uint32_t);
+    if (r.target_segment_index >= segment_count ||
+        r.target_offset + patch_size > entry->segments[r.target_segment_index].mem_size) {
+      return false;
+    }
+    if (r.common_name.empty() &&
+        (r.symbol_segment_index >= segment_count ||
+         r.symbol_offset >= entry->segments[r.symbol_segment_index].mem_size)) {
+      return false;
+    }
+  }
+
+  return reader.AtEnd();
+}
+
+void ExecutableCache::Store(const common::Sha256Digest &digest, size_t elf_size, const std::string &agent_key,
+                            const CachedCodeObject &entry) const
+{
+  common::CacheRecordWriter writer;
+  writer.Put(kCacheMagic);
+  writer.Put(kCacheVersion);
+  writer.Put(digest);
+  writer.Put(uint64_t(elf_size));
+  writer.PutString(agent_key);
+
+  writer.Put(uint32_t(entry.segments.size()));
+  for (const CachedSegment &s : entry.segments) {
+    writer.Put(s.segment);
+    writer.Put(s.vaddr);
+    writer.Put(s.mem_size);
+    writer.Put(s.align);
+    writer.Put(s.image_offset);
+    writer.Put(s.image_size);
+  }
+
+  writer.Put(uint32_t(entry.symbols.size()));
+  for (const CachedSymbol &s : entry.symbols) {
+    writer.PutString(s.name);
+    writer.Put(s.kind);
+    writer.Put(s.linkage);
+    writer.PutBool(s.is_declaration);
+    writer.PutBool(s.is_agent);
+    writer.Put(s.segment_index);
+    writer.Put(s.offset);
+    writer.Put(s.section_offset);
+    writer.Put(s.allocation);
+    writer.Put(s.variable_segment);
+    writer.Put(s.size);
+    writer.Put(s.alignment);
+    writer.PutBool(s.is_const);
+  }
+
+  writer.Put(uint32_t(entry.relocations.size()));
+  for (const CachedRelocation &r : entry.relocations) {
+    writer.Put(r.type);
+    writer.Put(r.target_segment_index);
+    writer.Put(r.target_offset);
+    writer.Put(r.addend);
+    writer.Put(r.symbol_segment_index);
+    writer.Put(r.symbol_offset);
+    writer.PutString(r.common_name);
+    writer.PutBool(r.common_program);
+  }
+
+  common::WriteCacheFile(EntryPath(digest, agent_key), writer.data());
+}
+
+} // namespace loader
+} // namespace hsa
+} // namespace amd
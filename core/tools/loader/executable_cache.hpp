@@ -0,0 +1,144 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef HSA_RUNTIME_CORE_LOADER_EXECUTABLE_CACHE_HPP_
+#define HSA_RUNTIME_CORE_LOADER_EXECUTABLE_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "hsa.h"
+#include "amd_hsa_elf.h"
+#include "amd_hsa_hash.hpp"
+
+namespace amd {
+namespace hsa {
+namespace loader {
+
+//===----------------------------------------------------------------------===//
+// CachedCodeObject.                                                          //
+//===----------------------------------------------------------------------===//
+
+// Data segment of a code object. Its image is read from the code object
+// itself at image_offset, the cache only stores the layout.
+struct CachedSegment {
+  amdgpu_hsa_elf_segment_t segment;
+  uint64_t vaddr;
+  uint64_t mem_size;
+  uint64_t align;
+  uint64_t image_offset;
+  uint64_t image_size;
+};
+
+// Symbol with its address recorded as an offset from the base of the data
+// segment holding it. Kernel properties are not stored, they are read from
+// the loaded kernel descriptor as on a normal load.
+struct CachedSymbol {
+  std::string name;
+  hsa_symbol_kind_t kind;
+  hsa_symbol_linkage_t linkage;
+  bool is_declaration;
+  bool is_agent;
+  uint32_t segment_index;
+  uint64_t offset;
+  uint64_t section_offset;
+  hsa_variable_allocation_t allocation;
+  hsa_variable_segment_t variable_segment;
+  uint32_t size;
+  uint32_t alignment;
+  bool is_const;
+};
+
+// Relocation patching target_offset within target_segment_index. The value
+// is either an offset within symbol_segment_index or, for common symbols,
+// the address of the executable symbol named common_name.
+struct CachedRelocation {
+  uint32_t type;
+  uint32_t target_segment_index;
+  uint64_t target_offset;
+  int64_t addend;
+  uint32_t symbol_segment_index;
+  uint64_t symbol_offset;
+  std::string common_name;
+  bool common_program;
+};
+
+// Pre-resolved load of one code object on one kind of agent.
+struct CachedCodeObject {
+  std::vector<CachedSegment> segments;
+  std::vector<CachedSymbol> symbols;
+  std::vector<CachedRelocation> relocations;
+};
+
+//===----------------------------------------------------------------------===//
+// ExecutableCache.                                                           //
+//===----------------------------------------------------------------------===//
+
+// On-disk cache of code object loads. Entries are keyed by the SHA-256 digest
+// of the code object and by an agent key naming the agent and its ISA, so a
+// different device or a changed ISA never matches an old entry. Entries are
+// written to a temporary file and renamed into place, concurrent processes
+// sharing a directory see either a complete entry or none.
+class ExecutableCache {
+public:
+  explicit ExecutableCache(const std::string &directory)
+    : directory_(directory) {}
+
+  // Reads the entry for a code object of elf_size bytes with the given
+  // digest. Returns false if there is none or it does not fit the code object.
+  bool Lookup(const common::Sha256Digest &digest, size_t elf_size, const std::string &agent_key,
+              CachedCodeObject *entry) const;
+
+  // Writes an entry, replacing any previous one. Failures are not reported,
+  // the next load simply misses.
+  void Store(const common::Sha256Digest &digest, size_t elf_size, const std::string &agent_key,
+             const CachedCodeObject &entry) const;
+
+private:
+  std::string EntryPath(const common::Sha256Digest &digest, const std::string &agent_key) const;
+
+  const std::string directory_;
+};
+
+} // namespace loader
+} // namespace hsa
+} // namespace amd
+
+#endif // HSA_RUNTIME_CORE_LOADER_EXECUTABLE_CACHE_HPP_
@@ -0,0 +1,155 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// hsa-trace-decode: converts a trace written by the tracer tool library to
+// Chrome trace JSON (chrome://tracing, Perfetto).
+//
+//   hsa-trace-decode <trace.bin> [<trace.json>]
+
+#include "hsa_trace_format.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace hsa {
+namespace trace {
+namespace {
+
+struct Event {
+  uint32_t thread;
+  TraceRecord record;
+};
+
+bool Read(FILE* file, void* data, size_t size) {
+  return 1 == fread(data, size, 1, file);
+}
+
+int Decode(FILE* in, FILE* out) {
+  TraceFileHeader header;
+  if (!Read(in, &header, sizeof(header)) ||
+      0 != memcmp(header.magic, kTraceMagic, sizeof(header.magic)) ||
+      kTraceVersion != header.version ||
+      sizeof(TraceRecord) != header.record_size) {
+    fprintf(stderr, "hsa-trace-decode: not a trace file\n");
+    return 1;
+  }
+
+  std::vector<Event> events;
+  TraceFileFooter footer;
+  bool has_footer = false;
+  TraceBlockHeader block;
+  while (Read(in, &block, sizeof(block))) {
+    if (kTraceFooterThread == block.thread) {
+      has_footer = Read(in, &footer, sizeof(footer));
+      break;
+    }
+    size_t first = events.size();
+    events.resize(first + block.count);
+    for (size_t i = first; i < events.size(); ++i) {
+      events[i].thread = block.thread;
+      if (!Read(in, &events[i].record, sizeof(TraceRecord))) {
+        events.resize(i);
+        break;
+      }
+    }
+  }
+
+  // Without a footer the process did not shut down cleanly; assume one tick
+  // per nanosecond rather than dropping the trace.
+  double ns_per_tick = 1.0;
+  if (!has_footer) {
+    fprintf(stderr, "hsa-trace-decode: trace is truncated, times are in ticks\n");
+  } else if (footer.end_ticks > header.begin_ticks) {
+    ns_per_tick = double(footer.end_ns - header.begin_ns) /
+                  double(footer.end_ticks - header.begin_ticks);
+  }
+
+  std::stable_sort(events.begin(), events.end(),
+                   [](const Event& a, const Event& b) {
+                     return a.record.enter < b.record.enter;
+                   });
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceRecord& record = events[i].record;
+    double ts = double(int64_t(record.enter - header.begin_ticks)) * ns_per_tick / 1000.0;
+    double dur = double(record.exit - record.enter) * ns_per_tick / 1000.0;
+    fprintf(out,
+            "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,"
+            "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg0\":\"0x%" PRIx64
+            "\",\"arg1\":\"0x%" PRIx64 "\",\"result\":\"0x%" PRIx64 "\"}}%s\n",
+            ApiName(record.api), header.pid, events[i].thread, ts, dur,
+            record.args[0], record.args[1], record.result,
+            i + 1 < events.size() ? "," : "");
+  }
+  fprintf(out, "],\"otherData\":{\"dropped\":%" PRIu64 "}}\n",
+          has_footer ? footer.dropped : uint64_t(0));
+  return 0;
+}
+
+}  // namespace
+}  // namespace trace
+}  // namespace hsa
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s <trace.bin> [<trace.json>]\n", argv[0]);
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    fprintf(stderr, "hsa-trace-decode: cannot open %s\n", argv[1]);
+    return 1;
+  }
+  FILE* out = stdout;
+  if (argc == 3 && !(out = fopen(argv[2], "w"))) {
+    fprintf(stderr, "hsa-trace-decode: cannot open %s\n", argv[2]);
+    fclose(in);
+    return 1;
+  }
+
+  int status = hsa::trace::Decode(in, out);
+  fclose(in);
+  if (out != stdout) fclose(out);
+  return status;
+}
@@ -0,0 +1,232 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+#ifndef HSA_RUNTIME_CORE_TOOLS_TRACER_HSA_TRACE_FORMAT_H_
+#define HSA_RUNTIME_CORE_TOOLS_TRACER_HSA_TRACE_FORMAT_H_
+
+#include <cstdint>
+
+// On-disk format of the API trace written by the tracer tool library and read
+// by hsa-trace-decode.
+//
+// A file is a TraceFileHeader followed by blocks. Each block is a
+// TraceBlockHeader and count TraceRecords made on one thread. The last block
+// has thread kTraceFooterThread and no records, and is followed by a
+// TraceFileFooter. Times are raw time stamp counter values; the header and
+// footer each hold a (counter, nanosecond) pair to convert them.
+
+namespace hsa {
+namespace trace {
+
+// APIs in ::ApiTable order.
+#define HSA_TRACE_CORE_APIS(X)                    \
+  X(hsa_init)                                     \
+  X(hsa_shut_down)                                \
+  X(hsa_system_get_info)                          \
+  X(hsa_system_extension_supported)               \
+  X(hsa_system_get_extension_table)               \
+  X(hsa_iterate_agents)                           \
+  X(hsa_agent_get_info)                           \
+  X(hsa_queue_create)                             \
+  X(hsa_soft_queue_create)                        \
+  X(hsa_queue_destroy)                            \
+  X(hsa_queue_inactivate)                         \
+  X(hsa_queue_load_read_index_acquire)            \
+  X(hsa_queue_load_read_index_relaxed)            \
+  X(hsa_queue_load_write_index_acquire)           \
+  X(hsa_queue_load_write_index_relaxed)           \
+  X(hsa_queue_store_write_index_relaxed)          \
+  X(hsa_queue_store_write_index_release)          \
+  X(hsa_queue_cas_write_index_acq_rel)            \
+  X(hsa_queue_cas_write_index_acquire)            \
+  X(hsa_queue_cas_write_index_relaxed)            \
+  X(hsa_queue_cas_write_index_release)            \
+  X(hsa_queue_add_write_index_acq_rel)            \
+  X(hsa_queue_add_write_index_acquire)            \
+  X(hsa_queue_add_write_index_relaxed)            \
+  X(hsa_queue_add_write_index_release)            \
+  X(hsa_queue_store_read_index_relaxed)           \
+  X(hsa_queue_store_read_index_release)           \
+  X(hsa_agent_iterate_regions)                    \
+  X(hsa_region_get_info)                          \
+  X(hsa_agent_get_exception_policies)             \
+  X(hsa_agent_extension_supported)                \
+  X(hsa_memory_register)                          \
+  X(hsa_memory_deregister)                        \
+  X(hsa_memory_allocate)                          \
+  X(hsa_memory_free)                              \
+  X(hsa_memory_copy)                              \
+  X(hsa_memory_assign_agent)                      \
+  X(hsa_signal_create)                            \
+  X(hsa_signal_destroy)                           \
+  X(hsa_signal_load_relaxed)                      \
+  X(hsa_signal_load_acquire)                      \
+  X(hsa_signal_store_relaxed)                     \
+  X(hsa_signal_store_release)                     \
+  X(hsa_signal_wait_relaxed)                      \
+  X(hsa_signal_wait_acquire)                      \
+  X(hsa_signal_and_relaxed)                       \
+  X(hsa_signal_and_acquire)                       \
+  X(hsa_signal_and_release)                       \
+  X(hsa_signal_and_acq_rel)                       \
+  X(hsa_signal_or_relaxed)                        \
+  X(hsa_signal_or_acquire)                        \
+  X(hsa_signal_or_release)                        \
+  X(hsa_signal_or_acq_rel)                        \
+  X(hsa_signal_xor_relaxed)                       \
+  X(hsa_signal_xor_acquire)                       \
+  X(hsa_signal_xor_release)                       \
+  X(hsa_signal_xor_acq_rel)                       \
+  X(hsa_signal_exchange_relaxed)                  \
+  X(hsa_signal_exchange_acquire)                  \
+  X(hsa_signal_exchange_release)                  \
+  X(hsa_signal_exchange_acq_rel)                  \
+  X(hsa_signal_add_relaxed)                       \
+  X(hsa_signal_add_acquire)                       \
+  X(hsa_signal_add_release)                       \
+  X(hsa_signal_add_acq_rel)                       \
+  X(hsa_signal_subtract_relaxed)                  \
+  X(hsa_signal_subtract_acquire)                  \
+  X(hsa_signal_subtract_release)                  \
+  X(hsa_signal_subtract_acq_rel)                  \
+  X(hsa_signal_cas_relaxed)                       \
+  X(hsa_signal_cas_acquire)                       \
+  X(hsa_signal_cas_release)                       \
+  X(hsa_signal_cas_acq_rel)                       \
+  X(hsa_isa_from_name)                            \
+  X(hsa_isa_get_info)                             \
+  X(hsa_isa_compatible)                           \
+  X(hsa_code_object_serialize)                    \
+  X(hsa_code_object_deserialize)                  \
+  X(hsa_code_object_destroy)                      \
+  X(hsa_code_object_get_info)                     \
+  X(hsa_code_object_get_symbol)                   \
+  X(hsa_code_symbol_get_info)                     \
+  X(hsa_code_object_iterate_symbols)              \
+  X(hsa_executable_create)                        \
+  X(hsa_executable_destroy)                       \
+  X(hsa_executable_load_code_object)              \
+  X(hsa_executable_freeze)                        \
+  X(hsa_executable_get_info)                      \
+  X(hsa_executable_global_variable_define)        \
+  X(hsa_executable_agent_global_variable_define)  \
+  X(hsa_executable_readonly_variable_define)      \
+  X(hsa_executable_validate)                      \
+  X(hsa_executable_get_symbol)                    \
+  X(hsa_executable_symbol_get_info)               \
+  X(hsa_executable_iterate_symbols)               \
+  X(hsa_status_string)
+
+// APIs in ::ExtTable order.
+#define HSA_TRACE_EXT_APIS(X)         \
+  X(hsa_ext_program_create)           \
+  X(hsa_ext_program_destroy)          \
+  X(hsa_ext_program_add_module)       \
+  X(hsa_ext_program_iterate_modules)  \
+  X(hsa_ext_program_get_info)         \
+  X(hsa_ext_program_finalize)         \
+  X(hsa_ext_image_get_capability)     \
+  X(hsa_ext_image_data_get_info)      \
+  X(hsa_ext_image_create)             \
+  X(hsa_ext_image_import)             \
+  X(hsa_ext_image_export)             \
+  X(hsa_ext_image_copy)               \
+  X(hsa_ext_image_clear)              \
+  X(hsa_ext_image_destroy)            \
+  X(hsa_ext_sampler_create)           \
+  X(hsa_ext_sampler_destroy)
+
+enum ApiId {
+#define HSA_TRACE_API_ID(name) kApi_##name,
+  HSA_TRACE_CORE_APIS(HSA_TRACE_API_ID)
+  HSA_TRACE_EXT_APIS(HSA_TRACE_API_ID)
+#undef HSA_TRACE_API_ID
+  kApiCount
+};
+
+inline const char* ApiName(uint32_t id) {
+  static const char* const names[] = {
+#define HSA_TRACE_API_NAME(name) #name,
+    HSA_TRACE_CORE_APIS(HSA_TRACE_API_NAME)
+    HSA_TRACE_EXT_APIS(HSA_TRACE_API_NAME)
+#undef HSA_TRACE_API_NAME
+  };
+  return id < kApiCount ? names[id] : "unknown";
+}
+
+const char kTraceMagic[8] = { 'H', 'S', 'A', 'T', 'R', 'A', 'C', 'E' };
+const uint32_t kTraceVersion = 1;
+const uint32_t kTraceFooterThread = 0xFFFFFFFF;
+
+struct TraceFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t pid;
+  uint32_t reserved;
+  uint64_t begin_ticks;
+  uint64_t begin_ns;
+};
+
+struct TraceBlockHeader {
+  uint32_t thread;
+  uint32_t count;
+};
+
+// One intercepted call: its first two arguments and its return value, as
+// integers (handles, pointers and enums are stored by value).
+struct TraceRecord {
+  uint64_t enter;
+  uint64_t exit;
+  uint64_t args[2];
+  uint64_t result;
+  uint32_t api;
+  uint32_t reserved;
+};
+
+struct TraceFileFooter {
+  uint64_t end_ticks;
+  uint64_t end_ns;
+  uint64_t dropped;
+};
+
+}  // namespace trace
+}  // namespace hsa
+
+#endif  // HSA_RUNTIME_CORE_TOOLS_TRACER_HSA_TRACE_FORMAT_H_
@@ -0,0 +1,466 @@
+/******************************************************************************
+* University of Illinois / NCSA
+* Open Source License
+*
+* Copyright(c) 2011 - 2015  Advanced Micro Devices, Inc.
+* All rights reserved.
+*
+* Developed by:
+* Advanced Micro Devices, Inc.
+* www.amd.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* with the Software without restriction, including without limitation the
+* rights to use, copy, modify, merge, publish, distribute, sublicense, and /
+* or sell copies of the Software, and to permit persons to whom the Software
+* is furnished to do so, subject to the following conditions:
+*
+*     Redistributions of source code must retain the above copyright notice,
+* this list of conditions and the following disclaimers.
+*
+*     Redistributions in binary form must reproduce the above copyright notice,
+* this list of conditions and the following disclaimers in the documentation
+* and / or other materials provided with the distribution.
+*
+*     Neither the names of Advanced Micro Devices, Inc, nor the
+mes of its
+* contributors may be used to endorse or promote products derived from this
+* Software without specific prior written permission.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS WITH
+* THE SOFTWARE.
+******************************************************************************/
+
+// API tracing tool. Load it with HSA_TOOLS_LIB=libhsa-runtime-tracer64.so.1.
+//
+// OnLoad replaces every ::ApiTable and ::ExtTable entry with a hook that
+// stamps the call with the time stamp counter and appends a TraceRecord to a
+// ring owned by the calling thread. Rings are single producer, single
+// consumer: a flush thread drains them to the trace file in the background,
+// so the traced thread never takes a lock or makes a system call. Records are
+// dropped, and counted, if a ring fills up between flushes.
+//
+// Environment:
+//   HSA_TRACE_FILE         trace file (default hsa_trace.<pid>.bin)
+//   HSA_TRACE_BUFFER_SIZE  records per thread ring (default 16384)
+//   HSA_TRACE_FLUSH_MS     flush period in milliseconds (default 5)
+//
+// hsa-trace-decode converts the trace file to Chrome trace JSON.
+// hsa-runtime-bench's tracer/overhead benchmark, run with this library as
+// --tools-lib, reports the overhead per intercepted call. It measures about
+// 105 ns on a virtual machine, missing the 50 ns target: the two rdtsc reads
+// take 20 ns there, the rest goes to the table indirection, the in-flight
+// count Stop waits on and the record store.
+
+#include "hsa_trace_format.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "inc/hsa_api_trace.h"
+
+#define HSA_TRACER_EXPORT __attribute__((visibility("default")))
+
+namespace hsa {
+namespace trace {
+namespace {
+
+const size_t kDefaultRingSize = 16384;
+const unsigned kDefaultFlushMs = 5;
+
+inline uint64_t Ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+uint64_t Nanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+size_t EnvValue(const char* name, size_t default_value) {
+  const char* value = getenv(name);
+  if (!value || !*value) return default_value;
+  unsigned long long parsed = strtoull(value, NULL, 0);
+  return parsed ? size_t(parsed) : default_value;
+}
+
+/// @brief Per-thread record ring. Only the owning thread calls Reserve and
+/// Commit, and only the flush thread calls Drain.
+class Ring {
+ public:
+  Ring(uint32_t thread, size_t capacity)
+      : next(NULL),
+        records_(new TraceRecord[capacity]),
+        mask_(capacity - 1),
+        thread_(thread),
+        head_(0),
+        cached_tail_(0),
+        dropped_(0),
+        tail_(0) {}
+
+  /// @brief Returns the slot for the next record, NULL if the ring is full.
+  TraceRecord* Reserve() {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ > mask_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head - cached_tail_ > mask_) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        return NULL;
+      }
+    }
+    return &records_[head & mask_];
+  }
+
+  /// @brief Publishes the slot returned by Reserve.
+  void Commit() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  /// @brief Writes the published records to file as one block per
+  /// contiguous run.
+  void Drain(FILE* file) {
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    while (tail != head) {
+      size_t index = size_t(tail & mask_);
+      size_t count = size_t(head - tail);
+      if (count > mask_ + 1 - index) count = mask_ + 1 - index;
+      TraceBlockHeader block = {thread_, uint32_t(count)};
+      fwrite(&block, sizeof(block), 1, file);
+      fwrite(&records_[index], sizeof(TraceRecord), count, file);
+      tail += count;
+    }
+    tail_.store(tail, std::memory_order_release);
+  }
+
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  Ring* next;
+
+ private:
+  std::unique_ptr<TraceRecord[]> records_;
+  const size_t mask_;
+  const uint32_t thread_;
+
+  // Producer side.
+  std::atomic<uint64_t> head_;
+  uint64_t cached_tail_;
+  std::atomic<uint64_t> dropped_;
+
+  // Keeps the consumer index off the producer's cache line.
+  char pad_[64];
+
+  // Consumer side.
+  std::atomic<uint64_t> tail_;
+};
+
+struct Session {
+  std::atomic<bool> active;
+  // Hooks between checking active and their last ring access. Stop waits for
+  // it to drain before it frees the rings. On its own line since every traced
+  // thread writes it.
+  alignas(64) std::atomic<uint32_t> in_flight;
+  char pad[64 - sizeof(std::atomic<uint32_t>)];
+  std::atomic<uint32_t> id;
+  std::atomic<Ring*> rings;
+  size_t ring_size;
+  FILE* file;
+
+  std::thread flusher;
+  std::mutex flush_lock;
+  std::condition_variable flush_wake;
+  bool stop;
+  unsigned flush_ms;
+};
+
+Session session;
+
+// initial-exec keeps the hot path off __tls_get_addr; this library is loaded
+// with dlopen but only needs a few bytes of static TLS.
+#define HSA_TRACER_TLS thread_local __attribute__((tls_model("initial-exec")))
+
+HSA_TRACER_TLS Ring* thread_ring = NULL;
+HSA_TRACER_TLS uint32_t thread_session = 0;
+
+Ring* NewThreadRing() {
+  Ring* ring = new Ring(uint32_t(syscall(SYS_gettid)), session.ring_size);
+  Ring* head = session.rings.load(std::memory_order_relaxed);
+  do {
+    ring->next = head;
+  } while (!session.rings.compare_exchange_weak(head, ring,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed));
+  thread_ring = ring;
+  thread_session = session.id.load(std::memory_order_relaxed);
+  return ring;
+}
+
+inline Ring* ThreadRing() {
+  Ring* ring = thread_ring;
+  if (ring && thread_session == session.id.load(std::memory_order_relaxed))
+    return ring;
+  return NewThreadRing();
+}
+
+void DrainAll() {
+  for (Ring* ring = session.rings.load(std::memory_order_acquire); ring;
+       ring = ring->next) {
+    ring->Drain(session.file);
+  }
+}
+
+void FlushLoop() {
+  std::unique_lock<std::mutex> lock(session.flush_lock);
+  while (!session.stop) {
+    session.flush_wake.wait_for(lock,
+                                std::chrono::milliseconds(session.flush_ms));
+    DrainAll();
+  }
+}
+
+// Converts an argument or return value to the integer stored in a record.
+template <typename T>
+auto ArgValue(const T& value, int) -> decltype(uint64_t(value.handle)) {
+  return uint64_t(value.handle);
+}
+
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                        uint64_t>::type
+ArgValue(T value, int) {
+  return uint64_t(value);
+}
+
+template <typename T>
+uint64_t ArgValue(T* value, int) {
+  return uint64_t(uintptr_t(value));
+}
+
+template <typename T>
+uint64_t ArgValue(const T&, ...) {
+  return 0;
+}
+
+/// @brief Times one call and records it when it goes out of scope, after the
+/// return value is known.
+class Scope {
+ public:
+  template <typename... Args>
+  explicit Scope(uint32_t api, Args... args) : result(0), api_(api) {
+    const uint64_t values[] = {ArgValue(args, 0)..., 0, 0};
+    args_[0] = values[0];
+    args_[1] = values[1];
+    enter_ = Ticks();
+  }
+
+  ~Scope() {
+    uint64_t exit = Ticks();
+    // Pairs with Stop: either this hook sees the session inactive or Stop
+    // sees it in flight and waits before freeing the rings.
+    session.in_flight.fetch_add(1, std::memory_order_seq_cst);
+    if (session.active.load(std::memory_order_seq_cst)) Record(exit);
+    session.in_flight.fetch_sub(1, std::memory_order_release);
+  }
+
+  uint64_t result;
+
+ private:
+  void Record(uint64_t exit) {
+    Ring* ring = ThreadRing();
+    TraceRecord* record = ring->Reserve();
+    if (!record) return;
+    record->enter = enter_;
+    record->exit = exit;
+    record->args[0] = args_[0];
+    record->args[1] = args_[1];
+    record->result = result;
+    record->api = api_;
+    record->reserved = 0;
+    ring->Commit();
+  }
+
+  uint32_t api_;
+  uint64_t enter_;
+  uint64_t args_[2];
+};
+
+template <typename R>
+struct Invoke {
+  template <typename Fn, typename... Args>
+  static R Call(uint64_t* result, Fn fn, Args... args) {
+    R value = fn(args...);
+    *result = ArgValue(value, 0);
+    return value;
+  }
+};
+
+template <>
+struct Invoke<void> {
+  template <typename Fn, typename... Args>
+  static void Call(uint64_t*, Fn fn, Args... args) {
+    fn(args...);
+  }
+};
+
+template <uint32_t Api, typename Fn>
+struct Hook;
+
+template <uint32_t Api, typename R, typename... Args>
+struct Hook<Api, R (*)(Args...)> {
+  typedef R (*Fn)(Args...);
+
+  static void Install(Fn& entry) {
+    next = entry;
+    entry = Call;
+  }
+
+  static R Call(Args... args) {
+    Scope scope(Api, args...);
+    return Invoke<R>::Call(&scope.result, next, args...);
+  }
+
+  static Fn next;
+};
+
+template <uint32_t Api, typename R, typename... Args>
+typename Hook<Api, R (*)(Args...)>::Fn Hook<Api, R (*)(Args...)>::next = NULL;
+
+bool Start() {
+  std::string path;
+  const char* file = getenv("HSA_TRACE_FILE");
+  if (file && *file) {
+    path = file;
+  } else {
+    path = "hsa_trace." + std::to_string(getpid()) + ".bin";
+  }
+
+  session.file = fopen(path.c_str(), "wb");
+  if (!session.file) {
+    fprintf(stderr, "hsa tracer: cannot open %s\n", path.c_str());
+    return false;
+  }
+  setvbuf(session.file, NULL, _IOFBF, 1 << 20);
+
+  size_t ring_size = EnvValue("HSA_TRACE_BUFFER_SIZE", kDefaultRingSize);
+  session.ring_size = 1;
+  while (session.ring_size < ring_size) session.ring_size <<= 1;
+  session.flush_ms = unsigned(EnvValue("HSA_TRACE_FLUSH_MS", kDefaultFlushMs));
+
+  TraceFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kTraceVersion;
+  header.record_size = sizeof(TraceRecord);
+  header.pid = uint32_t(getpid());
+  header.begin_ns = Nanoseconds();
+  header.begin_ticks = Ticks();
+  fwrite(&header, sizeof(header), 1, session.file);
+
+  session.rings.store(NULL, std::memory_order_relaxed);
+  session.id.fetch_add(1, std::memory_order_relaxed);
+  session.stop = false;
+  session.flusher = std::thread(FlushLoop);
+  session.active.store(true, std::memory_order_release);
+  return true;
+}
+
+void Stop() {
+  session.active.store(false, std::memory_order_seq_cst);
+  // Hooks still running may hold a ring; no new ones start recording.
+  while (session.in_flight.load(std::memory_order_acquire) != 0)
+    std::this_thread::yield();
+
+  {
+    std::lock_guard<std::mutex> lock(session.flush_lock);
+    session.stop = true;
+  }
+  session.flush_wake.notify_one();
+  session.flusher.join();
+
+  DrainAll();
+
+  TraceFileFooter footer;
+  footer.end_ticks = Ticks();
+  footer.end_ns = Nanoseconds();
+  footer.dropped = 0;
+  Ring* ring = session.rings.exchange(NULL, std::memory_order_acquire);
+  while (ring) {
+    Ring* next = ring->next;
+    footer.dropped += ring->dropped();
+    delete ring;
+    ring = next;
+  }
+  TraceBlockHeader block = {kTraceFooterThread, 0};
+  fwrite(&block, sizeof(block), 1, session.file);
+  fwrite(&footer, sizeof(footer), 1, session.file);
+  fclose(session.file);
+  session.file = NULL;
+
+  if (footer.dropped) {
+    fprintf(stderr, "hsa tracer: dropped %llu records, raise HSA_TRACE_BUFFER_SIZE\n",
+            (unsigned long long)footer.dropped);
+  }
+}
+
+}  // namespace
+}  // namespace trace
+}  // namespace hsa
+
+extern "C" {
+
+HSA_TRACER_EXPORT bool OnLoad(ApiTable* table, uint64_t runtime_version,
+                              uint64_t failed_tool_count,
+                              const char* const* failed_tool_names) {
+  using namespace hsa::trace;
+
+  if (!Start()) return false;
+
+// hsa_init has already run by the time tools load, and hsa_shut_down unloads
+// this library before it returns, so neither can be hooked.
+#define HSA_TRACE_INSTALL(name)                                     \
+  if (kApi_##name != kApi_hsa_init && kApi_##name != kApi_hsa_shut_down) \
+    Hook<kApi_##name, decltype(table->name##_fn)>::Install(table->name##_fn);
+  HSA_TRACE_CORE_APIS(HSA_TRACE_INSTALL)
+#undef HSA_TRACE_INSTALL
+
+  if (ExtTable* ext = table->std_exts_) {
+#define HSA_TRACE_INSTALL_EXT(name) \
+  Hook<kApi_##name, decltype(ext->name##_fn)>::Install(ext->name##_fn);
+    HSA_TRACE_EXT_APIS(HSA_TRACE_INSTALL_EXT)
+#undef HSA_TRACE_INSTALL_EXT
+  }
+
+  return true;
+}
+
+// The runtime restores the API table after this returns.
+HSA_TRACER_EXPORT void OnUnload() { hsa::trace::Stop(); }
+
+}  // extern "C"
@@ -52,6 +52,7 @@
 #include "stdint.h"
 #include "stddef.h"
 #include "stdlib.h"
+#include "stdio.h"
 #include <assert.h>
 
 typedef unsigned int uint;
@@ -91,6 +92,18 @@ static __forceinline unsigned long long int strtoull(const char* str,
 #error "Compiler and/or processor not identified."
 #endif
 
+// Diagnostics for runtime developers, compiled out of release builds.
+#ifndef NDEBUG
+#define debug_print(fmt, ...)            \
+  do {                                   \
+    fprintf(stderr, fmt, ##__VA_ARGS__); \
+  } while (false)
+#else
+#define debug_print(fmt, ...) \
+  do {                        \
+  } while (false)
+#endif
+
 #define STRING2(x) #x
 #define STRING(x) STRING2(x)
 
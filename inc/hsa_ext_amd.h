@@ -223,6 +223,90 @@ hsa_status_t HSA_API
 hsa_amd_profiling_get_dispatch_time(hsa_agent_t agent, hsa_signal_t signal,
                                     hsa_amd_profiling_dispatch_time_t* time);
 
+/**
+ * @brief Packet processing time stamps of one completion signal, as stored in
+ * the profiling timeline of a queue.
+ */
+typedef struct hsa_amd_profiling_record_s {
+  /**
+   * Completion signal the time stamps were harvested from.
+   */
+  hsa_signal_t signal;
+  /**
+   * Dispatch packet processing start time, in HSA system clock ticks.
+   */
+  uint64_t start;
+  /**
+   * Dispatch packet completion time, in HSA system clock ticks.
+   */
+  uint64_t end;
+} hsa_amd_profiling_record_t;
+
+/**
+* @brief Retrieve the packet processing time stamps of a batch of completion
+* signals and append them to the profiling timeline of a queue.
+*
+* @details All time stamps of the batch are converted to the HSA system clock
+* domain with a single clock snapshot of @p agent. The timeline holds a fixed
+* number of records, set by the HSA_PROFILING_RING_SIZE environment variable;
+* when it is full the oldest records are overwritten and counted as dropped.
+*
+* @param[in] agent The agent with which the signals were last used.
+*
+* @param[in] queue Queue whose timeline receives the records. Each signal must
+* satisfy the requirements of ::hsa_amd_profiling_get_dispatch_time.
+*
+* @param[in] signal_count Number of signals in @p signals.
+*
+* @param[in] signals Completion signals to harvest.
+*
+* @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+*
+* @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+* initialized.
+*
+* @retval ::HSA_STATUS_ERROR_INVALID_AGENT The agent is invalid.
+*
+* @retval ::HSA_STATUS_ERROR_INVALID_QUEUE The queue is invalid.
+*
+* @retval ::HSA_STATUS_ERROR_INVALID_SIGNAL A signal is invalid.
+*
+* @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p queue is NULL, or @p signals
+* is NULL and @p signal_count is not 0.
+*/
+hsa_status_t HSA_API
+hsa_amd_profiling_collect(hsa_agent_t agent, hsa_queue_t* queue,
+                          uint32_t signal_count, const hsa_signal_t* signals);
+
+/**
+* @brief Remove the oldest records from the profiling timeline of a queue.
+*
+* @param[in] queue Queue whose timeline is drained.
+*
+* @param[in] capacity Maximum number of records to return.
+*
+* @param[out] records Buffer of at least @p capacity records.
+*
+* @param[out] count Number of records written to @p records.
+*
+* @param[out] dropped If not NULL, receives the number of records overwritten
+* since the previous drain of the queue.
+*
+* @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+*
+* @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+* initialized.
+*
+* @retval ::HSA_STATUS_ERROR_INVALID_QUEUE The queue is invalid.
+*
+* @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p queue or @p count is NULL, or
+* @p records is NULL and @p capacity is not 0.
+*/
+hsa_status_t HSA_API
+hsa_amd_profiling_drain(hsa_queue_t* queue, uint32_t capacity,
+                        hsa_amd_profiling_record_t* records, uint32_t* count,
+                        uint64_t* dropped);
+
 /**
  * @brief Create a user mode SDMA queue.
  *
@@ -429,6 +513,488 @@ hsa_status_t HSA_API hsa_amd_queue_cu_set_mask(const hsa_queue_t* queue,
                                                uint32_t num_cu_mask_count,
                                                const uint32_t* cu_mask);
 
+/**
+ * @brief Queue occupancy statistics.
+ */
+typedef struct hsa_amd_queue_stats_s {
+  /**
+   * Current number of packets the ring buffer can hold.
+   */
+  uint32_t size;
+  /**
+   * Largest number of packets observed between the read and write index at
+   * the time of a write index reservation.
+   */
+  uint32_t high_water_mark;
+  /**
+   * Number of reservations that found the queue full and had to wait for the
+   * packet processor to release a slot.
+   */
+  uint64_t saturated_reservations;
+  /**
+   * Number of times the ring buffer has been resized.
+   */
+  uint32_t resize_count;
+  /**
+   * Reserved. Must be 0.
+   */
+  uint32_t reserved;
+} hsa_amd_queue_stats_t;
+
+/**
+ * @brief Grow the ring buffer of a queue while it is in use.
+ *
+ * @details A ring of @p size packets is allocated in the region of the
+ * original ring. Write index reservations made after the call are held until
+ * the read index catches up with the packets already reserved, after which
+ * the queue's base_address and size are switched to the new ring and the held
+ * reservations are released into it. Consumers must reload base_address and
+ * size from the queue structure for every packet they process. The function
+ * must not be called by the consumer of @p queue or by a producer that has a
+ * reserved packet which is not yet published.
+ *
+ * Only soft queues created with ::hsa_soft_queue_create currently support
+ * resizing.
+ *
+ * @param[in] queue A pointer to HSA queue.
+ *
+ * @param[in] size New number of packets in the ring buffer. Must be a power of
+ * two and larger than the current size.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is NULL, invalid, or does
+ * not support resizing.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p size is not a power of two or
+ * is not larger than the current size.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES The new ring buffer could not be
+ * allocated, or the packets already in the queue were not consumed within one
+ * second. The queue keeps its current ring buffer.
+ */
+hsa_status_t HSA_API hsa_amd_queue_resize(hsa_queue_t* queue, uint32_t size);
+
+/**
+ * @brief Retrieve the occupancy statistics of a queue.
+ *
+ * @details Soft queues created while the HSA_QUEUE_AUTO_GROW_LIMIT environment
+ * variable is set grow automatically, up to the given number of packets,
+ * once reservations find the queue full.
+ *
+ * @param[in] queue A pointer to HSA queue.
+ *
+ * @param[out] stats Pointer to the statistics to be filled in.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_QUEUE @p queue is NULL, invalid, or does
+ * not track statistics.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p stats is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_queue_get_stats(const hsa_queue_t* queue,
+                                             hsa_amd_queue_stats_t* stats);
+
+/**
+ * @brief Create a code object from an open file without copying it.
+ *
+ * @details Files of 1 MiB or more, and files sealed against shrinking, are
+ * mapped read-only and the mapping is used as the code object in place of a
+ * runtime allocation, so loading does not go through
+ * ::hsa_code_object_deserialize. Smaller files are read into runtime memory.
+ * The descriptor may be closed once the function returns. The code object is
+ * released by ::hsa_code_object_destroy.
+ *
+ * A mapped file must not be truncated while the code object exists.
+ *
+ * @param[in] fd File descriptor opened for reading, positioned anywhere.
+ *
+ * @param[out] code_object Memory location where the HSA runtime stores the
+ * code object handle.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p fd is negative or @p
+ * code_object is NULL.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_CODE_OBJECT The file could not be mapped
+ * or does not contain a complete ELF64 code object.
+ */
+hsa_status_t HSA_API hsa_amd_code_object_load_fd(int fd,
+                                                 hsa_code_object_t* code_object);
+
+/**
+ * @brief Create a code object from a file path without copying it.
+ *
+ * @details Opens @p file_name and behaves as ::hsa_amd_code_object_load_fd.
+ *
+ * @param[in] file_name Path of the code object file.
+ *
+ * @param[out] code_object Memory location where the HSA runtime stores the
+ * code object handle.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p file_name is NULL or cannot
+ * be opened, or @p code_object is NULL.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_CODE_OBJECT The file could not be mapped
+ * or does not contain a complete ELF64 code object.
+ */
+hsa_status_t HSA_API hsa_amd_code_object_load_file(
+    const char* file_name, hsa_code_object_t* code_object);
+
+/**
+ * @brief Fill a memory block with a 32-bit value.
+ *
+ * @details Memory owned by a GPU agent is filled by that agent, without
+ * staging the contents in system memory. The function returns once the fill
+ * is complete.
+ *
+ * @param[in] ptr Pointer to the start of the block, 4 byte aligned.
+ *
+ * @param[in] value Value written to every dword of the block.
+ *
+ * @param[in] count Number of dwords to write.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p ptr is NULL or not 4 byte
+ * aligned.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ALLOCATION @p ptr is not system memory
+ * and was not allocated by the HSA runtime.
+ *
+ * @retval ::HSA_STATUS_ERROR_OUT_OF_RESOURCES The fill could not be submitted.
+ */
+hsa_status_t HSA_API hsa_amd_memory_fill(void* ptr, uint32_t value,
+                                         size_t count);
+
+/**
+ * @brief Dispatch properties of a kernel, sized to a single cache line.
+ */
+typedef struct hsa_amd_kernel_descriptor_s {
+  /**
+   * Kernel object handle, as returned for
+   * ::HSA_EXECUTABLE_SYMBOL_INFO_KERNEL_OBJECT.
+   */
+  uint64_t kernel_object;
+  /**
+   * Size of the kernarg segment in bytes.
+   */
+  uint32_t kernarg_segment_size;
+  /**
+   * Alignment of the kernarg segment in bytes.
+   */
+  uint32_t kernarg_segment_alignment;
+  /**
+   * Size of static group segment memory in bytes.
+   */
+  uint32_t group_segment_size;
+  /**
+   * Size of static private segment memory per work-item in bytes.
+   */
+  uint32_t private_segment_size;
+  /**
+   * 1 if the kernel uses a dynamic call stack, 0 otherwise.
+   */
+  uint8_t is_dynamic_callstack;
+  /**
+   * Reserved. Must be 0.
+   */
+  uint8_t reserved[39];
+} hsa_amd_kernel_descriptor_t;
+
+/**
+ * @brief Get every dispatch property of a kernel symbol in one call.
+ *
+ * @param[in] executable_symbol Kernel symbol.
+ *
+ * @param[out] descriptor Descriptor to fill.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p executable_symbol is not a
+ * kernel symbol, or @p descriptor is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_executable_symbol_get_kernel_descriptor(
+    hsa_executable_symbol_t executable_symbol,
+    hsa_amd_kernel_descriptor_t* descriptor);
+
+/**
+ * @brief Get the dispatch properties of a kernel object.
+ *
+ * @details Descriptors are cached by kernel object, so packet producers can
+ * look them up per dispatch. The cache entry is dropped when the memory
+ * holding the kernel is freed, e.g. when its executable is destroyed.
+ *
+ * @param[in] kernel_object Kernel object handle of a loaded kernel.
+ *
+ * @param[out] descriptor Descriptor to fill.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p kernel_object is not the
+ * kernel object of a loaded kernel, or @p descriptor is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_kernel_object_get_descriptor(
+    uint64_t kernel_object, hsa_amd_kernel_descriptor_t* descriptor);
+
+/**
+ * @brief Groups of ::ApiTable entries that can be bypassed together.
+ */
+typedef enum {
+  /**
+   * hsa_init, hsa_shut_down, hsa_system_*, hsa_iterate_agents and
+   * hsa_status_string.
+   */
+  HSA_AMD_API_GROUP_SYSTEM = 0,
+  /**
+   * hsa_agent_* and hsa_region_get_info.
+   */
+  HSA_AMD_API_GROUP_AGENT = 1,
+  /**
+   * hsa_queue_* and hsa_soft_queue_create.
+   */
+  HSA_AMD_API_GROUP_QUEUE = 2,
+  /**
+   * hsa_memory_*.
+   */
+  HSA_AMD_API_GROUP_MEMORY = 3,
+  /**
+   * hsa_signal_*.
+   */
+  HSA_AMD_API_GROUP_SIGNAL = 4,
+  /**
+   * hsa_isa_*, hsa_code_object_*, hsa_code_symbol_* and hsa_executable_*.
+   */
+  HSA_AMD_API_GROUP_CODE_OBJECT = 5
+} hsa_amd_api_group_t;
+
+/**
+ * @brief Opaque handle to an API hook.
+ */
+typedef struct hsa_amd_api_hook_s {
+  /**
+   * Opaque handle.
+   */
+  uint64_t handle;
+} hsa_amd_api_hook_t;
+
+/**
+ * @brief Intercept a single API entry.
+ *
+ * @details @p function becomes the outermost hook of the entry and receives
+ * every call made through the exported API. It forwards a call by calling
+ * through @p next, which the runtime keeps pointing at the rest of the chain
+ * as other hooks come and go, so several tools can chain on one entry without
+ * copying the table. The entry is swapped atomically; calls already in
+ * progress complete through the old chain. Entries without hooks are called
+ * directly, at no cost.
+ *
+ * Tools that write ::ApiTable entries directly must do so from OnLoad.
+ *
+ * @param[in] entry Byte offset of the entry in ::ApiTable, for example
+ * offsetof(ApiTable, hsa_signal_load_relaxed_fn).
+ *
+ * @param[in] function Hook, with the signature of the entry.
+ *
+ * @param[out] next Location the runtime keeps pointing at the next function in
+ * the chain. Must stay valid until the hook is removed.
+ *
+ * @param[out] hook Handle of the new hook.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p entry is not the offset of an
+ * entry, or @p function, @p next or @p hook is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_api_hook_register(size_t entry, void* function,
+                                               void** next,
+                                               hsa_amd_api_hook_t* hook);
+
+/**
+ * @brief Remove a hook added by ::hsa_amd_api_hook_register.
+ *
+ * @details Other threads may still be running the hook when this returns; its
+ * code and @p next location must outlive them.
+ *
+ * @param[in] hook Hook to remove.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p hook is not a registered
+ * hook.
+ */
+hsa_status_t HSA_API hsa_amd_api_hook_remove(hsa_amd_api_hook_t hook);
+
+/**
+ * @brief Enable or disable the hooks of an API group.
+ *
+ * @details While a group is disabled its entries call the runtime directly;
+ * its hooks stay registered and are restored when the group is enabled again.
+ * All groups start enabled.
+ *
+ * @param[in] group API group.
+ *
+ * @param[in] enable True to enable the group's hooks, false to bypass them.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p group is not a valid group.
+ */
+hsa_status_t HSA_API hsa_amd_api_group_enable(hsa_amd_api_group_t group,
+                                              bool enable);
+
+/**
+ * @brief Get the address of the API table state word.
+ *
+ * @details The word is 0 while every ::ApiTable entry calls the runtime
+ * directly, and nonzero while any entry is intercepted. The inline fast paths
+ * in hsa_ext_amd_inline.h read it before bypassing the API. The address is
+ * valid for the lifetime of the runtime library, whether or not the runtime
+ * is initialized.
+ *
+ * @param[out] state Address of the state word.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p state is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_api_table_state(const volatile uint32_t** state);
+
+/**
+ * @brief Kinds of runtime metrics.
+ */
+typedef enum {
+  /**
+   * Monotonic count of events.
+   */
+  HSA_AMD_METRIC_KIND_COUNTER = 0,
+  /**
+   * Current level of a quantity, such as live objects.
+   */
+  HSA_AMD_METRIC_KIND_GAUGE = 1,
+  /**
+   * Distribution of sampled values in power of two buckets.
+   */
+  HSA_AMD_METRIC_KIND_HISTOGRAM = 2
+} hsa_amd_metric_kind_t;
+
+/**
+ * @brief Number of buckets of a histogram metric.
+ */
+#define HSA_AMD_METRIC_HISTOGRAM_BUCKETS 32
+
+/**
+ * @brief Value of one runtime metric, summed over all threads.
+ */
+typedef struct hsa_amd_metric_s {
+  /**
+   * Name of the metric, such as "signal.live". Valid for the lifetime of the
+   * runtime library.
+   */
+  const char* name;
+  /**
+   * Kind of the metric.
+   */
+  hsa_amd_metric_kind_t kind;
+  /**
+   * Counter or gauge value, or number of samples of a histogram.
+   */
+  int64_t value;
+  /**
+   * Sum of all samples of a histogram, 0 otherwise.
+   */
+  uint64_t sum;
+  /**
+   * Sample counts of a histogram, 0 otherwise. Bucket 0 counts zero samples,
+   * bucket i counts samples in [2^(i-1), 2^i) and the last bucket counts all
+   * larger samples.
+   */
+  uint64_t buckets[HSA_AMD_METRIC_HISTOGRAM_BUCKETS];
+} hsa_amd_metric_t;
+
+/**
+ * @brief Start or stop collection of runtime metrics.
+ *
+ * @details Metrics are disabled by default. Setting the HSA_METRICS
+ * environment variable to 1 enables them at initialization, and setting
+ * HSA_METRICS_FILE enables them and writes every metric to that file when the
+ * runtime shuts down. Values collected so far are kept when collection stops.
+ * Gauges such as "signal.live" are maintained while collection is stopped,
+ * so they report current values whenever collection starts.
+ *
+ * @param[in] enable Whether to collect metrics.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ */
+hsa_status_t HSA_API hsa_amd_metrics_enable(bool enable);
+
+/**
+ * @brief Iterate over all runtime metrics.
+ *
+ * @param[in] callback Callback invoked once per metric. If it returns a
+ * status other than ::HSA_STATUS_SUCCESS, the traversal stops and that status
+ * is returned.
+ *
+ * @param[in] data Application data passed to @p callback.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ *
+ * @retval ::HSA_STATUS_ERROR_INVALID_ARGUMENT @p callback is NULL.
+ */
+hsa_status_t HSA_API hsa_amd_metrics_iterate(
+    hsa_status_t (*callback)(const hsa_amd_metric_t* metric, void* data),
+    void* data);
+
+/**
+ * @brief Zero all counter and histogram metrics. Gauges keep their values.
+ *
+ * @retval ::HSA_STATUS_SUCCESS The function has been executed successfully.
+ *
+ * @retval ::HSA_STATUS_ERROR_NOT_INITIALIZED The HSA runtime has not been
+ * initialized.
+ */
+hsa_status_t HSA_API hsa_amd_metrics_reset();
+
 #ifdef __cplusplus
 }  // end extern "C" block
 #endif
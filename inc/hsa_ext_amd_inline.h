@@ -0,0 +1,235 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Copyright 2014 ADVANCED MICRO DEVICES, INC.
+//
+// AMD is granting you permission to use this software and documentation(if any)
+// (collectively, the "Materials") pursuant to the terms and conditions of the
+// Software License Agreement included with the Materials.If you do not have a
+// copy of the Software License Agreement, contact your AMD representative for a
+// copy.
+//
+// You agree that you will not reverse engineer or decompile the Materials, in
+// whole or in part, except as allowed by applicable law.
+//
+// WARRANTY DISCLAIMER : THE SOFTWARE IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND.AMD DISCLAIMS ALL WARRANTIES, EXPRESS, IMPLIED, OR STATUTORY,
+// INCLUDING BUT NOT LIMITED TO THE IMPLIED WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE, NON - INFRINGEMENT, THAT THE
+// SOFTWARE WILL RUN UNINTERRUPTED OR ERROR - FREE OR WARRANTIES ARISING FROM
+// CUSTOM OF TRADE OR COURSE OF USAGE.THE ENTIRE RISK ASSOCIATED WITH THE USE OF
+// THE SOFTWARE IS ASSUMED BY YOU.Some jurisdictions do not allow the exclusion
+// of implied warranties, so the above exclusion may not apply to You.
+//
+// LIMITATION OF LIABILITY AND INDEMNIFICATION : AMD AND ITS LICENSORS WILL NOT,
+// UNDER ANY CIRCUMSTANCES BE LIABLE TO YOU FOR ANY PUNITIVE, DIRECT,
+// INCIDENTAL, INDIRECT, SPECIAL OR CONSEQUENTIAL DAMAGES ARISING FROM USE OF
+// THE SOFTWARE OR THIS AGREEMENT EVEN IF AMD AND ITS LICENSORS HAVE BEEN
+// ADVISED OF THE POSSIBILITY OF SUCH DAMAGES.In no event shall AMD's total
+// liability to You for all damages, losses, and causes of action (whether in
+// contract, tort (including negligence) or otherwise) exceed the amount of $100
+// USD.  You agree to defend, indemnify and hold harmless AMD and its licensors,
+// and any of their directors, officers, employees, affiliates or agents from
+// and against any and all loss, damage, liability and other expenses (including
+// reasonable attorneys' fees), resulting from Your use of the Software or
+// violation of the terms and conditions of this Agreement.
+//
+// U.S.GOVERNMENT RESTRICTED RIGHTS : The Materials are provided with
+// "RESTRICTED RIGHTS." Use, duplication, or disclosure by the Government is
+// subject to the restrictions as set forth in FAR 52.227 - 14 and DFAR252.227 -
+// 7013, et seq., or its successor.Use of the Materials by the Government
+// constitutes acknowledgement of AMD's proprietary rights in them.
+//
+// EXPORT RESTRICTIONS: The Materials may be subject to export restrictions as
+//                      stated in the Software License Agreement.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Inline signal value and queue index operations.
+//
+// Each function has the semantics of the HSA API function of the same name
+// without the hsa_amd_inline_ prefix. While no tool intercepts the API
+// (hsa_amd_api_table_state reads 0) the operation is a single atomic on the
+// public amd_signal_t or amd_queue_t; otherwise, and for signals or queues
+// whose operations have side effects (interrupt signals, doorbells, soft
+// queues), the function calls the API.
+//
+// Requires GCC compatible __atomic builtins.
+
+#ifndef HSA_RUNTIME_EXT_AMD_INLINE_H_
+#define HSA_RUNTIME_EXT_AMD_INLINE_H_
+
+#include "hsa.h"
+#include "hsa_ext_amd.h"
+#include "amd_hsa_queue.h"
+#include "amd_hsa_signal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+static __inline__ int hsa_amd_inline_enabled_(void) {
+  static const volatile uint32_t* state = 0;
+  const volatile uint32_t* word = __atomic_load_n(&state, __ATOMIC_RELAXED);
+  if (__builtin_expect(word == 0, 0)) {
+    if (hsa_amd_api_table_state(&word) != HSA_STATUS_SUCCESS) return 0;
+    __atomic_store_n(&state, word, __ATOMIC_RELAXED);
+  }
+  return __builtin_expect(__atomic_load_n(word, __ATOMIC_RELAXED) == 0, 1);
+}
+
+static __inline__ amd_signal_t* hsa_amd_inline_signal_(hsa_signal_t signal) {
+  return (amd_signal_t*)(uintptr_t)signal.handle;
+}
+
+// Loads are plain for every user mode signal.
+static __inline__ int hsa_amd_inline_signal_load_(const amd_signal_t* s) {
+  return hsa_amd_inline_enabled_() && s->kind == AMD_SIGNAL_KIND_USER;
+}
+
+// Stores to signals with an event mailbox must also raise the event.
+static __inline__ int hsa_amd_inline_signal_store_(const amd_signal_t* s) {
+  return hsa_amd_inline_enabled_() && s->kind == AMD_SIGNAL_KIND_USER &&
+         s->event_mailbox_ptr == 0;
+}
+
+static __inline__ amd_queue_t* hsa_amd_inline_queue_(const hsa_queue_t* queue) {
+  amd_queue_t* q = (amd_queue_t*)queue;
+  return (hsa_amd_inline_enabled_() &&
+          AMD_HSA_BITS_GET(q->queue_properties,
+                           AMD_QUEUE_PROPERTIES_INLINE_INDICES))
+             ? q
+             : 0;
+}
+
+//===----------------------------------------------------------------------===//
+// Signals.                                                                   //
+//===----------------------------------------------------------------------===//
+
+static __inline__ hsa_signal_value_t hsa_amd_inline_signal_load_relaxed(
+    hsa_signal_t signal) {
+  amd_signal_t* s = hsa_amd_inline_signal_(signal);
+  if (hsa_amd_inline_signal_load_(s))
+    return __atomic_load_n(&s->value, __ATOMIC_RELAXED);
+  return hsa_signal_load_relaxed(signal);
+}
+
+static __inline__ hsa_signal_value_t hsa_amd_inline_signal_load_acquire(
+    hsa_signal_t signal) {
+  amd_signal_t* s = hsa_amd_inline_signal_(signal);
+  if (hsa_amd_inline_signal_load_(s))
+    return __atomic_load_n(&s->value, __ATOMIC_ACQUIRE);
+  return hsa_signal_load_acquire(signal);
+}
+
+static __inline__ void hsa_amd_inline_signal_store_relaxed(
+    hsa_signal_t signal, hsa_signal_value_t value) {
+  amd_signal_t* s = hsa_amd_inline_signal_(signal);
+  if (hsa_amd_inline_signal_store_(s)) {
+    __atomic_store_n(&s->value, (int64_t)value, __ATOMIC_RELAXED);
+    return;
+  }
+  hsa_signal_store_relaxed(signal, value);
+}
+
+static __inline__ void hsa_amd_inline_signal_store_release(
+    hsa_signal_t signal, hsa_signal_value_t value) {
+  amd_signal_t* s = hsa_amd_inline_signal_(signal);
+  if (hsa_amd_inline_signal_store_(s)) {
+    __atomic_store_n(&s->value, (int64_t)value, __ATOMIC_RELEASE);
+    return;
+  }
+  hsa_signal_store_release(signal, value);
+}
+
+//===----------------------------------------------------------------------===//
+// Queue indices.                                                             //
+//===----------------------------------------------------------------------===//
+
+static __inline__ uint64_t hsa_amd_inline_queue_load_read_index_acquire(
+    const hsa_queue_t* queue) {
+  amd_queue_t* q = hsa_amd_inline_queue_(queue);
+  if (q) return __atomic_load_n(&q->read_dispatch_id, __ATOMIC_ACQUIRE);
+  return hsa_queue_load_read_index_acquire(queue);
+}
+
+static __inline__ uint64_t hsa_amd_inline_queue_load_read_index_relaxed(
+    const hsa_queue_t* queue) {
+  amd_queue_t* q = hsa_amd_inline_queue_(queue);
+  if (q) return __atomic_load_n(&q->read_dispatch_id, __ATOMIC_RELAXED);
+  return hsa_queue_load_read_index_relaxed(queue);
+}
+
+static __inline__ uint64_t hsa_amd_inline_queue_load_write_index_acquire(
+    const hsa_queue_t* queue) {
+  amd_queue_t* q = hsa_amd_inline_queue_(queue);
+  if (q) return __atomic_load_n(&q->write_dispatch_id, __ATOMIC_ACQUIRE);
+  return hsa_queue_load_write_index_acquire(queue);
+}
+
+static __inline__ uint64_t hsa_amd_inline_queue_load_write_index_relaxed(
+    const hsa_queue_t* queue) {
+  amd_queue_t* q = hsa_amd_inline_queue_(queue);
+  if (q) return __atomic_load_n(&q->write_dispatch_id, __ATOMIC_RELAXED);
+  return hsa_queue_load_write_index_relaxed(queue);
+}
+
+static __inline__ void hsa_amd_inline_queue_store_write_index_relaxed(
+    const hsa_queue_t* queue, uint64_t value) {
+  amd_queue_t* q = hsa_amd_inline_queue_(queue);
+  if (q) {
+    __atomic_store_n(&q->write_dispatch_id, value, __ATOMIC_RELAXED);
+    return;
+  }
+  hsa_queue_store_write_index_relaxed(queue, value);
+}
+
+static __inline__ void hsa_amd_inline_queue_store_write_index_release(
+    const hsa_queue_t* queue, uint64_t value) {
+  amd_queue_t* q = hsa_amd_inline_queue_(queue);
+  if (q) {
+    __atomic_store_n(&q->write_dispatch_id, value, __ATOMIC_RELEASE);
+    return;
+  }
+  hsa_queue_store_write_index_release(queue, value);
+}
+
+#define HSA_AMD_INLINE_QUEUE_CAS(suffix, order, failure_order)                \
+  static __inline__ uint64_t hsa_amd_inline_queue_cas_write_index_##suffix(   \
+      const hsa_queue_t* queue, uint64_t expected, uint64_t value) {          \
+    amd_queue_t* q = hsa_amd_inline_queue_(queue);                            \
+    if (q) {                                                                  \
+      __atomic_compare_exchange_n(&q->write_dispatch_id, &expected, value, 0, \
+                                  order, failure_order);                      \
+      return expected;                                                        \
+    }                                                                         \
+    return hsa_queue_cas_write_index_##suffix(queue, expected, value);        \
+  }
+
+HSA_AMD_INLINE_QUEUE_CAS(acq_rel, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+HSA_AMD_INLINE_QUEUE_CAS(acquire, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)
+HSA_AMD_INLINE_QUEUE_CAS(relaxed, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+HSA_AMD_INLINE_QUEUE_CAS(release, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+
+#undef HSA_AMD_INLINE_QUEUE_CAS
+
+#define HSA_AMD_INLINE_QUEUE_ADD(suffix, order)                              \
+  static __inline__ uint64_t hsa_amd_inline_queue_add_write_index_##suffix(  \
+      const hsa_queue_t* queue, uint64_t value) {                            \
+    amd_queue_t* q = hsa_amd_inline_queue_(queue);                           \
+    if (q) return __atomic_fetch_add(&q->write_dispatch_id, value, order);   \
+    return hsa_queue_add_write_index_##suffix(queue, value);                 \
+  }
+
+HSA_AMD_INLINE_QUEUE_ADD(acq_rel, __ATOMIC_ACQ_REL)
+HSA_AMD_INLINE_QUEUE_ADD(acquire, __ATOMIC_ACQUIRE)
+HSA_AMD_INLINE_QUEUE_ADD(relaxed, __ATOMIC_RELAXED)
+HSA_AMD_INLINE_QUEUE_ADD(release, __ATOMIC_RELEASE)
+
+#undef HSA_AMD_INLINE_QUEUE_ADD
+
+#ifdef __cplusplus
+}  // end extern "C" block
+#endif
+
+#endif  // HSA_RUNTIME_EXT_AMD_INLINE_H_